@@ -0,0 +1,231 @@
+/*
+* Hardware ray tracing acceleration structures (VK_KHR_acceleration_structure). Optional:
+* devices without it run everything else as before.
+* - The extension brings VK_KHR_deferred_host_operations, buffer device addresses and
+*   descriptor indexing along, and needs Vulkan 1.1. supported() checks the whole set and
+*   the features, deviceExtensions() lists what to enable, Features what to chain.
+* - Bottom level structures (BLAS) hold mesh triangles, the top level (TLAS) instances of
+*   them. BLASes are built in batches, many meshes in one vkCmdBuildAccelerationStructuresKHR,
+*   then compacted: built with ALLOW_COMPACTION, their compacted size queried, and copied
+*   into structures of that size.
+* - The TLAS is built with ALLOW_UPDATE and updated in place as instances move. Updates only
+*   refit, so it's rebuilt from scratch every TLAS_REBUILD_INTERVAL frames.
+* - ScratchArena hands out scratch ranges from one pooled buffer. Builds in a batch get
+*   separate ranges so they can run together, and the buffer is reused by the next batch
+*   instead of allocating scratch per build.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace accel {
+
+const uint32_t TLAS_REBUILD_INTERVAL = 60; // Frames
+
+// Enabled together or not at all
+inline std::vector<const char*> deviceExtensions() {
+	return {
+		VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+		VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+		VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+		VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+	};
+}
+
+// Instance version to ask for: acceleration structures need 1.1, 1.0 loaders can't go past 1.0
+inline uint32_t instanceApiVersion() {
+	auto enumerateVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+	uint32_t version = VK_API_VERSION_1_0;
+	if (enumerateVersion != nullptr && enumerateVersion(&version) != VK_SUCCESS) {
+		version = VK_API_VERSION_1_0;
+	}
+	return std::min(version, VK_API_VERSION_1_2);
+}
+
+// Features to chain into VkDeviceCreateInfo, or to query with vkGetPhysicalDeviceFeatures2
+struct Features {
+	VkPhysicalDeviceBufferDeviceAddressFeatures address{};
+	VkPhysicalDeviceAccelerationStructureFeaturesKHR structures{};
+
+	// Returns the head of the chain, in front of next
+	void* chain(void* next) {
+		address.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+		structures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+		structures.pNext = next;
+		address.pNext = &structures;
+		return &address;
+	}
+
+	static Features enabled() {
+		Features features;
+		features.address.bufferDeviceAddress = VK_TRUE;
+		features.structures.accelerationStructure = VK_TRUE;
+		return features;
+	}
+};
+
+// The instance must be 1.1 or newer, see instanceApiVersion()
+inline bool supported(VkPhysicalDevice device, uint32_t instanceVersion, const std::vector<VkExtensionProperties>& available) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (instanceVersion < VK_API_VERSION_1_1 || properties.apiVersion < VK_API_VERSION_1_1) return false;
+
+	for (const char* name : deviceExtensions()) {
+		bool found = std::any_of(available.begin(), available.end(),
+			[&](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+		if (!found) return false;
+	}
+
+	Features features;
+	VkPhysicalDeviceFeatures2 query{};
+	query.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	query.pNext = features.chain(nullptr);
+	vkGetPhysicalDeviceFeatures2(device, &query);
+	return features.address.bufferDeviceAddress && features.structures.accelerationStructure;
+}
+
+
+// Device functions of the extensions, they aren't exported by the loader
+struct Functions {
+	PFN_vkGetAccelerationStructureBuildSizesKHR getBuildSizes = nullptr;
+	PFN_vkCreateAccelerationStructureKHR create = nullptr;
+	PFN_vkDestroyAccelerationStructureKHR destroy = nullptr;
+	PFN_vkCmdBuildAccelerationStructuresKHR cmdBuild = nullptr;
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR cmdWriteProperties = nullptr;
+	PFN_vkCmdCopyAccelerationStructureKHR cmdCopy = nullptr;
+	PFN_vkGetAccelerationStructureDeviceAddressKHR getAddress = nullptr;
+	PFN_vkGetBufferDeviceAddress getBufferAddress = nullptr;
+
+	void load(VkDevice device) {
+		getBuildSizes = (PFN_vkGetAccelerationStructureBuildSizesKHR) vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR");
+		create = (PFN_vkCreateAccelerationStructureKHR) vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR");
+		destroy = (PFN_vkDestroyAccelerationStructureKHR) vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR");
+		cmdBuild = (PFN_vkCmdBuildAccelerationStructuresKHR) vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR");
+		cmdWriteProperties = (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR) vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+		cmdCopy = (PFN_vkCmdCopyAccelerationStructureKHR) vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR");
+		getAddress = (PFN_vkGetAccelerationStructureDeviceAddressKHR) vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR");
+		getBufferAddress = (PFN_vkGetBufferDeviceAddress) vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR");
+
+		if (!getBuildSizes || !create || !destroy || !cmdBuild || !cmdWriteProperties || !cmdCopy || !getAddress || !getBufferAddress) {
+			throw std::runtime_error("failed to load acceleration structure functions!");
+		}
+	}
+};
+
+
+inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+class ScratchArena {
+public:
+	// minAccelerationStructureScratchOffsetAlignment
+	explicit ScratchArena(VkDeviceSize alignment = 256) : alignment(std::max<VkDeviceSize>(alignment, 1)) {}
+
+	// Offset of a range for one build of the current batch
+	VkDeviceSize allocate(VkDeviceSize size) {
+		VkDeviceSize offset = alignUp(used, alignment);
+		used = offset + size;
+		peakBytes = std::max(peakBytes, used);
+		requestedBytes += size;
+		requests++;
+		return offset;
+	}
+
+	// Starts the next batch. The previous one must have finished on the GPU.
+	void reset() { used = 0; }
+
+	VkDeviceSize peak() const { return peakBytes; } // The pooled buffer's size
+	VkDeviceSize requested() const { return requestedBytes; } // A buffer per build would have allocated this
+	uint64_t builds() const { return requests; }
+	VkDeviceSize offsetAlignment() const { return alignment; }
+
+private:
+	VkDeviceSize alignment;
+	VkDeviceSize used = 0;
+	VkDeviceSize peakBytes = 0;
+	VkDeviceSize requestedBytes = 0;
+	uint64_t requests = 0;
+};
+
+
+struct Compaction {
+	VkDeviceSize builtBytes = 0;
+	VkDeviceSize compactedBytes = 0;
+
+	// Fraction of BLAS memory compaction gave back
+	double savings() const {
+		return builtBytes > 0 ? 1.0 - static_cast<double>(compactedBytes) / builtBytes : 0.0;
+	}
+};
+
+inline bool rebuildTlas(uint32_t frame) {
+	return frame % TLAS_REBUILD_INTERVAL == 0;
+}
+
+
+// Triangle positions (x, y, z) of a LOD level with a half extent of 1, non-indexed like the
+// shaders draw them: a box, or a tower of `segments` wall quads and a roof fan.
+inline std::vector<float> meshVertices(const scene::LodLevel& lod) {
+	std::vector<float> vertices;
+	auto add = [&](float x, float y, float z) {
+		vertices.push_back(x);
+		vertices.push_back(y);
+		vertices.push_back(z);
+	};
+
+	if (lod.segments == 0) {
+		static const float corners[8][3] = {
+			{-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+			{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}
+		};
+		static const uint32_t faces[6][4] = {
+			{0, 3, 2, 1}, {4, 5, 6, 7}, {0, 4, 7, 3}, {1, 2, 6, 5}, {0, 1, 5, 4}, {3, 7, 6, 2}
+		};
+		for (const auto& face : faces) {
+			for (uint32_t corner : {face[0], face[1], face[2], face[0], face[2], face[3]}) {
+				add(corners[corner][0], corners[corner][1], corners[corner][2]);
+			}
+		}
+		return vertices;
+	}
+
+	const float pi = 3.14159265f;
+	for (uint32_t i = 0; i < lod.segments; i++) {
+		float a0 = 2.0f * pi * i / lod.segments;
+		float a1 = 2.0f * pi * (i + 1) / lod.segments;
+		float x0 = std::cos(a0), z0 = std::sin(a0), x1 = std::cos(a1), z1 = std::sin(a1);
+
+		add(x0, -1, z0); add(x1, -1, z1); add(x1, 1, z1);
+		add(x0, -1, z0); add(x1, 1, z1); add(x0, 1, z0);
+		add(0, 1, 0); add(x1, 1, z1); add(x0, 1, z0);
+	}
+	return vertices;
+}
+
+// A box's mesh scaled to its extent and moved to its center
+inline VkAccelerationStructureInstanceKHR instance(const scene::Box& box, VkDeviceAddress blas, uint32_t index) {
+	VkAccelerationStructureInstanceKHR instance{};
+	for (int row = 0; row < 3; row++) {
+		instance.transform.matrix[row][row] = box.extent[row];
+		instance.transform.matrix[row][3] = box.center[row];
+	}
+	instance.instanceCustomIndex = index;
+	instance.mask = 0xFF;
+	instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+	instance.accelerationStructureReference = blas;
+	return instance;
+}
+
+} // namespace accel
@@ -0,0 +1,5125 @@
+/*
+* Headless benchmark suite.
+* - Build and run with `make bench`. Results go to bench_results.json.
+* - Prefers a CPU implementation (lavapipe) so numbers are comparable between machines,
+*   pass `--device <index>` to pick another one.
+* - Every scenario runs `--warmup` discarded repetitions, then `--reps` measured ones.
+* - `--daemon <socket>` keeps the device warm and serves render jobs, see warm_daemon.h.
+* - `--capture <file>` adds a scenario replaying a capture made with `VulkanTriangle.out --capture`.
+*/
+
+#include <vulkan/vulkan.h>
+
+#include "accel.h"
+#include "bvh.h"
+#include "clusters.h"
+#include "compute_primitives.h"
+#define MEMORY_STATS_HOOK_NEW
+#include "memory_stats.h"
+#include "msaa.h"
+#include "render_server.h"
+#include "replay.h"
+#include "scene.h"
+#include "shadow_atlas.h"
+#include "skinning.h"
+#include "upscaler.h"
+#include "warm_daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+const uint32_t TARGET_WIDTH = 512;
+const uint32_t TARGET_HEIGHT = 512;
+const VkFormat TARGET_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+
+double nowMs() {
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+std::vector<char> readFile(const std::string& filename) {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open file " + filename + "!");
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+
+	return buffer;
+}
+
+
+/*
+* Statistics
+*/
+
+struct Metric {
+	std::string unit;
+	bool higherIsBetter = false;
+	std::vector<double> samples;
+};
+
+struct Summary {
+	double mean = 0, median = 0, stddev = 0, min = 0, max = 0, p95 = 0;
+};
+
+
+Summary summarize(std::vector<double> samples) {
+	Summary s;
+	if (samples.empty()) return s;
+
+	std::sort(samples.begin(), samples.end());
+	size_t n = samples.size();
+
+	for (double v : samples) s.mean += v;
+	s.mean /= n;
+
+	for (double v : samples) s.stddev += (v - s.mean) * (v - s.mean);
+	s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0.0; // Sample standard deviation
+
+	s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+	s.min = samples.front();
+	s.max = samples.back();
+	s.p95 = samples[std::min(n - 1, static_cast<size_t>(std::ceil(0.95 * n)) - 1)];
+
+	return s;
+}
+
+
+// Collects the metrics a scenario reports for one repetition.
+class Measurements {
+public:
+	void add(const std::string& name, double value, const std::string& unit, bool higherIsBetter = false) {
+		if (discard) return;
+
+		auto it = metrics.find(name);
+		if (it == metrics.end()) {
+			order.push_back(name);
+			it = metrics.emplace(name, Metric{unit, higherIsBetter, {}}).first;
+		}
+		it->second.samples.push_back(value);
+	}
+
+	bool discard = false; // Set during warm-up
+	std::vector<std::string> order; // Keep metrics in the order scenarios report them
+	std::map<std::string, Metric> metrics;
+};
+
+
+/*
+* Headless Vulkan context shared by the scenarios. No window, no surface, no validation.
+*/
+
+class BenchContext {
+public:
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties{};
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t queueFamily = 0;
+	VkQueue queue = VK_NULL_HANDLE;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+
+	int deviceIndex = -1;
+	bool multiview = false; // VK_KHR_multiview enabled
+	bool accelerationStructures = false; // VK_KHR_acceleration_structure and its dependencies enabled, see accel.h
+
+	void init(int requestedDevice) {
+		deviceIndex = requestedDevice;
+		createInstance(&instance);
+		physicalDevice = pickPhysicalDevice(instance, deviceIndex);
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		memstats::deviceMemory().init(memoryProperties);
+		queueFamily = findQueueFamily(physicalDevice);
+		DeviceFeatures features = createDevice(physicalDevice, queueFamily, &device);
+		multiview = features.multiview;
+		accelerationStructures = features.accelerationStructures;
+		vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = queueFamily;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create fence!");
+		}
+	}
+
+	void cleanup() {
+		vkDestroyFence(device, fence, nullptr);
+		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyDevice(device, nullptr);
+		vkDestroyInstance(instance, nullptr);
+	}
+
+	static void createInstance(VkInstance* out) {
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Hello Triangle Bench";
+		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.pEngineName = "No Engine";
+		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.apiVersion = accel::instanceApiVersion();
+
+		// VK_KHR_multiview depends on it
+		std::vector<const char*> extensions;
+		if (hasInstanceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+
+		if (vkCreateInstance(&createInfo, nullptr, out) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create instance!");
+		}
+	}
+
+	static bool hasInstanceExtension(const char* name) {
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+		for (const auto& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		}
+		return false;
+	}
+
+	static bool hasDeviceExtension(VkPhysicalDevice device, const char* name) {
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+		for (const auto& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		}
+		return false;
+	}
+
+	// deviceIndex < 0 means prefer a CPU implementation, falling back to the first device.
+	static VkPhysicalDevice pickPhysicalDevice(VkInstance instance, int deviceIndex) {
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+		if (deviceCount == 0) {
+			throw std::runtime_error("failed to find GPUs with Vulkan support!");
+		}
+
+		std::vector<VkPhysicalDevice> devices(deviceCount);
+		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+		if (deviceIndex >= 0) {
+			if (static_cast<uint32_t>(deviceIndex) >= deviceCount) {
+				throw std::runtime_error("device index out of range!");
+			}
+			return devices[deviceIndex];
+		}
+
+		for (const auto& device : devices) {
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties(device, &props);
+			if (props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) return device;
+		}
+
+		return devices[0];
+	}
+
+	// One queue family doing graphics, compute and transfer keeps the scenarios simple.
+	static uint32_t findQueueFamily(VkPhysicalDevice device) {
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+		for (uint32_t i = 0; i < queueFamilyCount; i++) {
+			if ((queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+				(queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find a graphics + compute queue family!");
+	}
+
+	// Optional device features that were enabled
+	struct DeviceFeatures {
+		bool multiview;
+		bool accelerationStructures;
+	};
+
+	// Devices with VK_KHR_multiview must support the multiview feature, so there's nothing
+	// else to query. Acceleration structures are enabled when the device has all of accel.h's set.
+	static DeviceFeatures createDevice(VkPhysicalDevice physicalDevice, uint32_t queueFamily, VkDevice* out) {
+		float queuePriority = 1.0f;
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = queueFamily;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &queuePriority;
+
+		VkPhysicalDeviceFeatures deviceFeatures{};
+
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> available(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, available.data());
+
+		DeviceFeatures enabled{};
+		enabled.multiview = hasInstanceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) &&
+			hasDeviceExtension(physicalDevice, VK_KHR_MULTIVIEW_EXTENSION_NAME);
+		enabled.accelerationStructures = accel::supported(physicalDevice, accel::instanceApiVersion(), available);
+
+		std::vector<const char*> extensions;
+		void* next = nullptr;
+
+		VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures{};
+		multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+		multiviewFeatures.multiview = VK_TRUE;
+		if (enabled.multiview) {
+			extensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+			next = &multiviewFeatures;
+		}
+
+		accel::Features accelFeatures = accel::Features::enabled();
+		if (enabled.accelerationStructures) {
+			for (const char* name : accel::deviceExtensions()) extensions.push_back(name);
+			next = accelFeatures.chain(next);
+		}
+
+		VkDeviceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = next;
+		createInfo.queueCreateInfoCount = 1;
+		createInfo.pQueueCreateInfos = &queueCreateInfo;
+		createInfo.pEnabledFeatures = &deviceFeatures;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+
+		if (vkCreateDevice(physicalDevice, &createInfo, nullptr, out) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create logical device!");
+		}
+		return enabled;
+	}
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	void createBuffer(
+		VkDeviceSize size,
+		VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties,
+		VkBuffer& buffer,
+		VkDeviceMemory& memory,
+		memstats::DeviceMemoryCategory category = memstats::DeviceMemoryCategory::Buffer
+	) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+		// Buffers read through device addresses, acceleration structures and their inputs
+		VkMemoryAllocateFlagsInfo flagsInfo{};
+		flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+		flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext = (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? &flagsInfo : nullptr;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize, category);
+
+		vkBindBufferMemory(device, buffer, memory, 0);
+	}
+
+	void destroyBuffer(VkBuffer buffer, VkDeviceMemory memory) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		memstats::deviceMemory().onFree(memory);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	void createImage(
+		VkFormat format,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels,
+		VkImageUsageFlags usage,
+		VkImage& image,
+		VkDeviceMemory& memory,
+		uint32_t arrayLayers = 1
+	) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = {width, height, 1};
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = arrayLayers;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize,
+			memstats::DeviceMemoryCategory::Image);
+		vkBindImageMemory(device, image, memory, 0);
+	}
+
+	// Multisampled attachment that lives only inside a render pass. Returns whether its memory
+	// is lazily allocated.
+	bool createTransientImage(
+		VkFormat format,
+		uint32_t width,
+		uint32_t height,
+		VkSampleCountFlagBits samples,
+		VkImageUsageFlags usage,
+		VkImage& image,
+		VkDeviceMemory& memory
+	) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = {width, height, 1};
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = samples;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, image, &memRequirements);
+		msaa::MemoryType memoryType = msaa::transientMemoryType(memoryProperties, memRequirements.memoryTypeBits);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = memoryType.index;
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize,
+			memstats::DeviceMemoryCategory::Transient);
+		vkBindImageMemory(device, image, memory, 0);
+		return memoryType.lazy;
+	}
+
+	void destroyImage(VkImage image, VkDeviceMemory memory) {
+		vkDestroyImage(device, image, nullptr);
+		memstats::deviceMemory().onFree(memory);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	VkImageView createImageView(
+		VkImage image,
+		VkFormat format,
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+		uint32_t baseLevel = 0,
+		uint32_t levelCount = 1,
+		uint32_t baseLayer = 0,
+		uint32_t layerCount = 1 // More than 1 makes an array view
+	) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = {aspect, baseLevel, levelCount, baseLayer, layerCount};
+
+		VkImageView view;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image view!");
+		}
+		return view;
+	}
+
+	VkShaderModule createShaderModule(const std::string& path) {
+		std::vector<char> code = readFile(path);
+
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+
+		return shaderModule;
+	}
+
+	// Record with `record`, submit, and block until the GPU is done. Returns wall time of submit + wait.
+	double submitAndWait(const std::function<void(VkCommandBuffer)>& record) {
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		record(commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		double begin = nowMs();
+		if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit command buffer!");
+		}
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		double elapsed = nowMs() - begin;
+
+		vkResetFences(device, 1, &fence);
+		return elapsed;
+	}
+};
+
+
+/*
+* Offscreen color target + triangle pipeline, used by the draw and readback scenarios.
+*/
+
+struct OffscreenTarget {
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	void create(BenchContext& ctx) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = TARGET_FORMAT;
+		imageInfo.extent = {TARGET_WIDTH, TARGET_HEIGHT, 1};
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(ctx.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(ctx.device, image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = ctx.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(ctx.device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize,
+			memstats::DeviceMemoryCategory::Image);
+		vkBindImageMemory(ctx.device, image, memory, 0);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = TARGET_FORMAT;
+		viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+		if (vkCreateImageView(ctx.device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image view!");
+		}
+
+		renderPass = createRenderPass(ctx);
+		pipelineLayout = createPipelineLayout(ctx);
+		pipeline = createPipeline(ctx, renderPass, pipelineLayout, false);
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &view;
+		framebufferInfo.width = TARGET_WIDTH;
+		framebufferInfo.height = TARGET_HEIGHT;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+	}
+
+	static VkRenderPass createRenderPass(BenchContext& ctx) {
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = TARGET_FORMAT;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // Ready for readback
+
+		VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+
+		// Make the color writes visible to the readback copy
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass = 0;
+		dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+		return renderPass;
+	}
+
+	static VkPipelineLayout createPipelineLayout(BenchContext& ctx) {
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		return pipelineLayout;
+	}
+
+	// With dynamicViewport the viewport and scissor are set while recording, so one pipeline
+	// serves targets of any size.
+	static VkPipeline createPipeline(BenchContext& ctx, VkRenderPass renderPass, VkPipelineLayout pipelineLayout,
+		bool dynamicViewport, VkPipelineCache cache = VK_NULL_HANDLE) {
+		VkShaderModule vertModule = ctx.createShaderModule("shaders/bench_triangle.vert.spv");
+		VkShaderModule fragModule = ctx.createShaderModule("shaders/bench_triangle.frag.spv");
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertModule;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragModule;
+		shaderStages[1].pName = "main";
+
+		// Vertices come from gl_VertexIndex, no vertex buffers
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkViewport viewport{0.0f, 0.0f, (float) TARGET_WIDTH, (float) TARGET_HEIGHT, 0.0f, 1.0f};
+		VkRect2D scissor{{0, 0}, {TARGET_WIDTH, TARGET_HEIGHT}};
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = &viewport;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = dynamicViewport ? &dynamicState : nullptr;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(ctx.device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		vkDestroyShaderModule(ctx.device, fragModule, nullptr);
+		vkDestroyShaderModule(ctx.device, vertModule, nullptr);
+		return pipeline;
+	}
+
+	void recordDraws(VkCommandBuffer commandBuffer, uint32_t drawCount) {
+		VkClearValue clearColor{};
+		clearColor.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea = {{0, 0}, {TARGET_WIDTH, TARGET_HEIGHT}};
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		// One draw per triangle on purpose, firstInstance places it
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDraw(commandBuffer, 3, 1, 0, i);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	void destroy(BenchContext& ctx) {
+		vkDestroyPipeline(ctx.device, pipeline, nullptr);
+		vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+		vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+		vkDestroyRenderPass(ctx.device, renderPass, nullptr);
+		vkDestroyImageView(ctx.device, view, nullptr);
+		vkDestroyImage(ctx.device, image, nullptr);
+		memstats::deviceMemory().onFree(memory);
+		vkFreeMemory(ctx.device, memory, nullptr);
+	}
+};
+
+
+/*
+* The synthetic city with two phase Hi-Z occlusion culling and LOD selection, used by the
+* occlusion and lod scenarios.
+* - Phase 0 tests every box against a depth pyramid of last frame's depth and draws the
+*   survivors. A pyramid of that partial depth is built, and phase 1 re-tests only the boxes
+*   phase 0 called occluded, drawing the ones that came into view since last frame.
+* - The cull pass also picks each box's LOD from its projected geometric error, with
+*   hysteresis, and appends it to that LOD's indirect draw. A slot is one LOD of one mesh.
+* - The CPU never sees the visible set, only the draw args copied back for the stats.
+* - The pyramid is half the target size and needs a square power of two target.
+* - MsaaTarget renders the unculled city multisampled into transient color and depth,
+*   resolved into the color target at the end of the subpass.
+*/
+
+struct CityScene {
+	static constexpr uint32_t PYRAMID_SIZE = TARGET_WIDTH / 2;
+	static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+	static constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+	struct DrawPush {
+		scene::Mat4 viewProj;
+		uint32_t listBase;
+		uint32_t useList;
+		uint32_t segments;
+	};
+
+	struct CullPush {
+		scene::Mat4 viewProj;
+		float camera[4];
+		uint32_t boxCount;
+		uint32_t phase;
+		uint32_t selectLod;
+		float errorThreshold;
+		uint32_t slotCount;
+	};
+
+	scene::MeshLibrary meshes = scene::cityMeshes();
+	uint32_t cityMesh = scene::BOX_MESH;
+	uint32_t slotCount = 0;
+	uint32_t boxCount = 0;
+	uint32_t pyramidLevels = 0;
+	std::vector<uint32_t> initialArgs; // Per slot draw args with no instances, then a zero counter
+
+	VkImage colorImage = VK_NULL_HANDLE, depthImage = VK_NULL_HANDLE, pyramidImage = VK_NULL_HANDLE;
+	VkDeviceMemory colorMemory = VK_NULL_HANDLE, depthMemory = VK_NULL_HANDLE, pyramidMemory = VK_NULL_HANDLE;
+	VkImageView colorView = VK_NULL_HANDLE, depthView = VK_NULL_HANDLE, pyramidView = VK_NULL_HANDLE;
+	std::vector<VkImageView> pyramidLevelViews;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	VkBuffer boxBuffer = VK_NULL_HANDLE, argsBuffer = VK_NULL_HANDLE, drawListBuffer = VK_NULL_HANDLE;
+	VkBuffer occludedBuffer = VK_NULL_HANDLE, statsBuffer = VK_NULL_HANDLE;
+	VkBuffer meshBuffer = VK_NULL_HANDLE, lodBuffer = VK_NULL_HANDLE, lodStateBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory boxMemory = VK_NULL_HANDLE, argsMemory = VK_NULL_HANDLE, drawListMemory = VK_NULL_HANDLE;
+	VkDeviceMemory occludedMemory = VK_NULL_HANDLE, statsMemory = VK_NULL_HANDLE;
+	VkDeviceMemory meshMemory = VK_NULL_HANDLE, lodMemory = VK_NULL_HANDLE, lodStateMemory = VK_NULL_HANDLE;
+	const VkDrawIndirectCommand* stats = nullptr; // Last frame's draw args, persistently mapped
+
+	VkRenderPass clearPass = VK_NULL_HANDLE; // Phase 0 and the unculled baseline
+	VkRenderPass loadPass = VK_NULL_HANDLE; // Phase 1 draws on top
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout drawSetLayout = VK_NULL_HANDLE, hizSetLayout = VK_NULL_HANDLE, cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet drawSet = VK_NULL_HANDLE, cullSet = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> hizSets; // One per pyramid level
+
+	VkPipelineLayout drawLayout = VK_NULL_HANDLE, hizLayout = VK_NULL_HANDLE, cullLayout = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE, hizPipeline = VK_NULL_HANDLE, cullPipeline = VK_NULL_HANDLE;
+
+	struct MsaaTarget {
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkImage colorImage = VK_NULL_HANDLE, depthImage = VK_NULL_HANDLE; // No color image at 1x
+		VkDeviceMemory colorMemory = VK_NULL_HANDLE, depthMemory = VK_NULL_HANDLE;
+		VkImageView colorView = VK_NULL_HANDLE, depthView = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkDeviceSize bytes = 0; // Transient allocations
+		bool lazy = false;
+	};
+
+	void create(BenchContext& ctx, uint32_t mesh) {
+		static_assert(TARGET_WIDTH == TARGET_HEIGHT && (TARGET_WIDTH & (TARGET_WIDTH - 1)) == 0,
+			"the depth pyramid needs a square power of two target");
+
+		VkFormatProperties depthProperties;
+		vkGetPhysicalDeviceFormatProperties(ctx.physicalDevice, DEPTH_FORMAT, &depthProperties);
+		VkFormatFeatureFlags depthFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		if ((depthProperties.optimalTilingFeatures & depthFeatures) != depthFeatures) {
+			throw std::runtime_error("depth format can't be sampled on this device!");
+		}
+
+		pyramidLevels = 1;
+		while ((PYRAMID_SIZE >> pyramidLevels) > 0) pyramidLevels++;
+
+		ctx.createImage(TARGET_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, colorImage, colorMemory);
+		ctx.createImage(DEPTH_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, 1,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthImage, depthMemory);
+		ctx.createImage(PYRAMID_FORMAT, PYRAMID_SIZE, PYRAMID_SIZE, pyramidLevels,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, pyramidImage, pyramidMemory);
+
+		colorView = ctx.createImageView(colorImage, TARGET_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+		depthView = ctx.createImageView(depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+		pyramidView = ctx.createImageView(pyramidImage, PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels);
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			pyramidLevelViews.push_back(ctx.createImageView(pyramidImage, PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+		}
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = static_cast<float>(pyramidLevels);
+
+		if (vkCreateSampler(ctx.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture sampler!");
+		}
+
+		cityMesh = mesh;
+		slotCount = static_cast<uint32_t>(meshes.lods.size());
+		createBuffers(ctx);
+		createRenderPasses(ctx);
+
+		VkImageView attachments[] = {colorView, depthView};
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = clearPass;
+		framebufferInfo.attachmentCount = 2;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = TARGET_WIDTH;
+		framebufferInfo.height = TARGET_HEIGHT;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+
+		createDescriptors(ctx);
+		createDrawLayout(ctx);
+		drawPipeline = createDrawPipeline(ctx, clearPass, VK_SAMPLE_COUNT_1_BIT); // Compatible with loadPass
+		createComputePipeline(ctx, "shaders/bench_hiz.comp.spv", hizSetLayout, 0, hizLayout, hizPipeline);
+		createComputePipeline(ctx, "shaders/bench_cull.comp.spv", cullSetLayout, sizeof(CullPush), cullLayout, cullPipeline);
+
+		// Pyramid lives in GENERAL. An empty clear pass gives the first frame a far depth buffer,
+		// so everything in the frustum passes phase 0. Every box starts at LOD 0.
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			vkCmdFillBuffer(cmd, lodStateBuffer, 0, VK_WHOLE_SIZE, 0);
+			memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = pyramidImage;
+			barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+
+			beginPass(cmd, clearPass);
+			vkCmdEndRenderPass(cmd);
+		});
+	}
+
+	void createBuffers(BenchContext& ctx) {
+		std::vector<scene::Box> boxes = scene::city(cityMesh);
+		boxCount = static_cast<uint32_t>(boxes.size());
+
+		for (uint32_t phase = 0; phase < 2; phase++) {
+			for (const scene::LodLevel& lod : meshes.lods) {
+				initialArgs.insert(initialArgs.end(), {lod.vertexCount, 0, 0, 0});
+			}
+		}
+		initialArgs.push_back(0);
+		VkDeviceSize argsSize = initialArgs.size() * sizeof(uint32_t);
+
+		uploadBuffer(ctx, boxes.data(), boxes.size() * sizeof(scene::Box), boxBuffer, boxMemory);
+		uploadBuffer(ctx, meshes.meshes.data(), meshes.meshes.size() * sizeof(scene::Mesh), meshBuffer, meshMemory);
+		uploadBuffer(ctx, meshes.lods.data(), meshes.lods.size() * sizeof(scene::LodLevel), lodBuffer, lodMemory);
+
+		ctx.createBuffer(argsSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, argsBuffer, argsMemory);
+		ctx.createBuffer(2 * slotCount * boxCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawListBuffer, drawListMemory);
+		ctx.createBuffer(boxCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, occludedBuffer, occludedMemory);
+		ctx.createBuffer(boxCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lodStateBuffer, lodStateMemory);
+		ctx.createBuffer(argsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, statsBuffer, statsMemory,
+			memstats::DeviceMemoryCategory::Readback);
+
+		void* mapped;
+		vkMapMemory(ctx.device, statsMemory, 0, argsSize, 0, &mapped);
+		memset(mapped, 0, argsSize);
+		stats = static_cast<const VkDrawIndirectCommand*>(mapped);
+	}
+
+	// Device local copy of host data, through a staging buffer.
+	void uploadBuffer(BenchContext& ctx, const void* source, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory) {
+		ctx.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+		VkBuffer staging;
+		VkDeviceMemory stagingMemory;
+		ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory,
+			memstats::DeviceMemoryCategory::Staging);
+
+		void* data;
+		vkMapMemory(ctx.device, stagingMemory, 0, size, 0, &data);
+		memcpy(data, source, size);
+		vkUnmapMemory(ctx.device, stagingMemory);
+
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkBufferCopy region{0, 0, size};
+			vkCmdCopyBuffer(cmd, staging, buffer, 1, &region);
+		});
+		ctx.destroyBuffer(staging, stagingMemory);
+	}
+
+	// Stats of the last culled frame, from the draw args the cull passes left behind
+	uint64_t drawnBoxes(uint32_t phase) const {
+		uint64_t count = 0;
+		for (uint32_t slot = 0; slot < slotCount; slot++) count += stats[phase * slotCount + slot].instanceCount;
+		return count;
+	}
+
+	uint64_t drawnTriangles() const {
+		uint64_t triangles = 0;
+		for (uint32_t command = 0; command < 2 * slotCount; command++) {
+			triangles += static_cast<uint64_t>(stats[command].instanceCount) * stats[command].vertexCount / 3;
+		}
+		return triangles;
+	}
+
+	uint32_t lodSwitches() const {
+		return reinterpret_cast<const uint32_t*>(stats + 2 * slotCount)[0];
+	}
+
+	void createRenderPasses(BenchContext& ctx) {
+		for (bool clear : {true, false}) {
+			VkAttachmentDescription attachments[2]{};
+			attachments[0].format = TARGET_FORMAT;
+			attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[0].loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+			attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[0].initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			// Depth ends up sampled by the pyramid build either way
+			attachments[1] = attachments[0];
+			attachments[1].format = DEPTH_FORMAT;
+			attachments[1].initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			attachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+			VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+			VkSubpassDescription subpass{};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = 1;
+			subpass.pColorAttachments = &colorAttachmentRef;
+			subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+			// In: the pyramid build reading depth, and the other pass's writes. Out: the pyramid build.
+			VkSubpassDependency dependencies[2]{};
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+				VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+				VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			VkRenderPassCreateInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.attachmentCount = 2;
+			renderPassInfo.pAttachments = attachments;
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 2;
+			renderPassInfo.pDependencies = dependencies;
+
+			if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, clear ? &clearPass : &loadPass) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create render pass!");
+			}
+		}
+	}
+
+	VkDescriptorSetLayout createSetLayout(BenchContext& ctx, const std::vector<VkDescriptorType>& types, VkShaderStageFlags stages) {
+		std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+		for (size_t i = 0; i < types.size(); i++) {
+			bindings[i].binding = static_cast<uint32_t>(i);
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = stages;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout setLayout;
+		if (vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		return setLayout;
+	}
+
+	void createDescriptors(BenchContext& ctx) {
+		const VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		const VkDescriptorType sampled = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+		drawSetLayout = createSetLayout(ctx, {storage, storage}, VK_SHADER_STAGE_VERTEX_BIT);
+		hizSetLayout = createSetLayout(ctx, {sampled, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, VK_SHADER_STAGE_COMPUTE_BIT);
+		cullSetLayout = createSetLayout(ctx, {storage, storage, storage, storage, sampled, storage, storage, storage},
+			VK_SHADER_STAGE_COMPUTE_BIT);
+
+		VkDescriptorPoolSize poolSizes[] = {
+			{storage, 9},
+			{sampled, pyramidLevels + 1},
+			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidLevels},
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = pyramidLevels + 2;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.pPoolSizes = poolSizes;
+
+		if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(pyramidLevels, hizSetLayout);
+		layouts.push_back(drawSetLayout);
+		layouts.push_back(cullSetLayout);
+		std::vector<VkDescriptorSet> sets(layouts.size());
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+		allocInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(ctx.device, &allocInfo, sets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+		hizSets.assign(sets.begin(), sets.begin() + pyramidLevels);
+		drawSet = sets[pyramidLevels];
+		cullSet = sets[pyramidLevels + 1];
+
+		// Infos must stay put until vkUpdateDescriptorSets, hence reserve
+		std::vector<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<VkWriteDescriptorSet> writes;
+		bufferInfos.reserve(9);
+		imageInfos.reserve(2 * pyramidLevels + 1);
+
+		auto writeBuffer = [&](VkDescriptorSet set, uint32_t binding, VkBuffer buffer) {
+			bufferInfos.push_back({buffer, 0, VK_WHOLE_SIZE});
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = storage;
+			write.pBufferInfo = &bufferInfos.back();
+			writes.push_back(write);
+		};
+		auto writeImage = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout) {
+			imageInfos.push_back({type == sampled ? sampler : VK_NULL_HANDLE, view, layout});
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = type;
+			write.pImageInfo = &imageInfos.back();
+			writes.push_back(write);
+		};
+
+		writeBuffer(drawSet, 0, boxBuffer);
+		writeBuffer(drawSet, 1, drawListBuffer);
+
+		writeBuffer(cullSet, 0, boxBuffer);
+		writeBuffer(cullSet, 1, argsBuffer);
+		writeBuffer(cullSet, 2, drawListBuffer);
+		writeBuffer(cullSet, 3, occludedBuffer);
+		writeImage(cullSet, 4, sampled, pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+		writeBuffer(cullSet, 5, meshBuffer);
+		writeBuffer(cullSet, 6, lodBuffer);
+		writeBuffer(cullSet, 7, lodStateBuffer);
+
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			if (level == 0) writeImage(hizSets[0], 0, sampled, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			else writeImage(hizSets[level], 0, sampled, pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			writeImage(hizSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+		}
+
+		vkUpdateDescriptorSets(ctx.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void createDrawLayout(BenchContext& ctx) {
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPush)};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &drawSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &drawLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+	}
+
+	VkPipeline createDrawPipeline(BenchContext& ctx, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+		return createDrawPipeline(ctx, renderPass, samples, drawLayout, "shaders/bench_city.frag.spv");
+	}
+
+	// Any layout whose set 0 is drawSetLayout and whose push constants start with DrawPush
+	VkPipeline createDrawPipeline(
+		BenchContext& ctx,
+		VkRenderPass renderPass,
+		VkSampleCountFlagBits samples,
+		VkPipelineLayout layout,
+		const std::string& fragmentShader
+	) {
+		VkShaderModule vertModule = ctx.createShaderModule("shaders/bench_city.vert.spv");
+		VkShaderModule fragModule = ctx.createShaderModule(fragmentShader);
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertModule;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragModule;
+		shaderStages[1].pName = "main";
+
+		// Box corners come from gl_VertexIndex, no vertex buffers
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkViewport viewport{0.0f, 0.0f, (float) TARGET_WIDTH, (float) TARGET_HEIGHT, 0.0f, 1.0f};
+		VkRect2D scissor{{0, 0}, {TARGET_WIDTH, TARGET_HEIGHT}};
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = &viewport;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = samples;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.layout = layout;
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		vkDestroyShaderModule(ctx.device, fragModule, nullptr);
+		vkDestroyShaderModule(ctx.device, vertModule, nullptr);
+		return pipeline;
+	}
+
+	void createComputePipeline(
+		BenchContext& ctx,
+		const std::string& path,
+		VkDescriptorSetLayout setLayout,
+		uint32_t pushSize,
+		VkPipelineLayout& layout,
+		VkPipeline& pipeline
+	) {
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = pushSize > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkShaderModule computeModule = ctx.createShaderModule(path);
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = computeModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = layout;
+
+		if (vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+		vkDestroyShaderModule(ctx.device, computeModule, nullptr);
+	}
+
+	static void memoryBarrier(
+		VkCommandBuffer cmd,
+		VkPipelineStageFlags srcStage,
+		VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStage,
+		VkAccessFlags dstAccess
+	) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void beginPass(VkCommandBuffer cmd, VkRenderPass renderPass) {
+		beginPass(cmd, renderPass, framebuffer, drawPipeline, renderPass == clearPass);
+	}
+
+	void beginPass(VkCommandBuffer cmd, VkRenderPass renderPass, VkFramebuffer target, VkPipeline pipeline, bool clear) {
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = {{0.45f, 0.6f, 0.8f, 1.0f}};
+		clearValues[1].depthStencil = {1.0f, 0};
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = target;
+		renderPassInfo.renderArea = {{0, 0}, {TARGET_WIDTH, TARGET_HEIGHT}};
+		renderPassInfo.clearValueCount = clear ? 2 : 0;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, drawLayout, 0, 1, &drawSet, 0, nullptr);
+	}
+
+	// Max-reduces the current depth buffer into every pyramid level.
+	void buildPyramid(VkCommandBuffer cmd) {
+		// Last pyramid readers (the cull passes) are done before it's overwritten
+		memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			if (level > 0) {
+				memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			}
+
+			uint32_t size = std::max(1u, PYRAMID_SIZE >> level);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hizLayout, 0, 1, &hizSets[level], 0, nullptr);
+			vkCmdDispatch(cmd, (size + 7) / 8, (size + 7) / 8, 1);
+		}
+
+		memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void cull(VkCommandBuffer cmd, const scene::Camera& camera, uint32_t phase, bool selectLod, float errorThreshold) {
+		CullPush push{
+			camera.viewProj,
+			{camera.eye.x, camera.eye.y, camera.eye.z, camera.pixelsPerUnit},
+			boxCount, phase, selectLod ? 1u : 0u, errorThreshold, slotCount
+		};
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &cullSet, 0, nullptr);
+		vkCmdPushConstants(cmd, cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(cmd, (boxCount + 63) / 64, 1, 1);
+
+		// Draw args and lists for the draw, the occluded flags for phase 1, the args for the stats copy
+		memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+	}
+
+	// One indirect draw per slot, most of them empty in any given frame.
+	void drawPhase(VkCommandBuffer cmd, const scene::Camera& camera, uint32_t phase) {
+		beginPass(cmd, phase == 0 ? clearPass : loadPass);
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			uint32_t command = phase * slotCount + slot;
+			DrawPush push{camera.viewProj, command * boxCount, 1, meshes.lods[slot].segments};
+
+			vkCmdPushConstants(cmd, drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+			vkCmdDrawIndirect(cmd, argsBuffer, command * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		}
+		vkCmdEndRenderPass(cmd);
+	}
+
+	// errorThreshold is in pixels. Without selectLod everything draws at LOD 0.
+	void recordCulledFrame(VkCommandBuffer cmd, const scene::Camera& camera, bool selectLod, float errorThreshold) {
+		// Pyramid of last frame's finished depth
+		buildPyramid(cmd);
+
+		VkDeviceSize argsSize = initialArgs.size() * sizeof(uint32_t);
+		vkCmdUpdateBuffer(cmd, argsBuffer, 0, argsSize, initialArgs.data());
+		memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		cull(cmd, camera, 0, selectLod, errorThreshold);
+		drawPhase(cmd, camera, 0);
+
+		// Pyramid of what phase 0 drew, then whatever it wrongly rejected
+		buildPyramid(cmd);
+		cull(cmd, camera, 1, selectLod, errorThreshold);
+		drawPhase(cmd, camera, 1);
+
+		VkBufferCopy region{0, 0, argsSize};
+		vkCmdCopyBuffer(cmd, argsBuffer, statsBuffer, 1, &region);
+		memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	}
+
+	// The baseline: every box at LOD 0 in one instanced draw, depth test does all the work.
+	void recordUnculledFrame(VkCommandBuffer cmd, const scene::Camera& camera) {
+		const scene::LodLevel& lod = meshes.lods[meshes.meshes[cityMesh].firstLod];
+		DrawPush push{camera.viewProj, 0, 0, lod.segments};
+
+		beginPass(cmd, clearPass);
+		vkCmdPushConstants(cmd, drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+		vkCmdDraw(cmd, lod.vertexCount, boxCount, 0, 0);
+		vkCmdEndRenderPass(cmd);
+	}
+
+	// Color and depth at `samples`, cleared and never stored. Above 1x the color resolves into
+	// the scene's color target, at 1x it's drawn directly and only depth is transient.
+	MsaaTarget createMsaaTarget(BenchContext& ctx, VkSampleCountFlagBits samples) {
+		MsaaTarget target;
+		target.samples = samples;
+		bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+		VkMemoryRequirements memRequirements;
+		target.lazy = true; // Only when every attachment is
+		if (multisampled) {
+			target.lazy &= ctx.createTransientImage(TARGET_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, samples,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, target.colorImage, target.colorMemory);
+			target.colorView = ctx.createImageView(target.colorImage, TARGET_FORMAT);
+			vkGetImageMemoryRequirements(ctx.device, target.colorImage, &memRequirements);
+			target.bytes += memRequirements.size;
+		}
+		target.lazy &= ctx.createTransientImage(DEPTH_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, samples,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, target.depthImage, target.depthMemory);
+		target.depthView = ctx.createImageView(target.depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		vkGetImageMemoryRequirements(ctx.device, target.depthImage, &memRequirements);
+		target.bytes += memRequirements.size;
+
+		VkAttachmentDescription attachments[3]{};
+		attachments[0].format = TARGET_FORMAT;
+		attachments[0].samples = samples;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		attachments[1] = attachments[0];
+		attachments[1].format = DEPTH_FORMAT;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// Resolve target, written whole by the resolve
+		attachments[2] = attachments[0];
+		attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+		VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+		VkAttachmentReference resolveAttachmentRef{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pResolveAttachments = multisampled ? &resolveAttachmentRef : nullptr;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// The previous frame's writes to the same attachments
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = multisampled ? 3 : 2;
+		renderPassInfo.pAttachments = attachments;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+
+		if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &target.renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+
+		VkImageView views[] = {multisampled ? target.colorView : colorView, target.depthView, colorView};
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = target.renderPass;
+		framebufferInfo.attachmentCount = renderPassInfo.attachmentCount;
+		framebufferInfo.pAttachments = views;
+		framebufferInfo.width = TARGET_WIDTH;
+		framebufferInfo.height = TARGET_HEIGHT;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+
+		target.pipeline = createDrawPipeline(ctx, target.renderPass, samples);
+		return target;
+	}
+
+	// Bytes the transient attachments hold right now, less than target.bytes only when lazy
+	VkDeviceSize committedBytes(BenchContext& ctx, const MsaaTarget& target) const {
+		if (!target.lazy) return target.bytes;
+
+		VkDeviceSize committed = msaa::committedBytes(ctx.device, target.depthMemory, 0, true);
+		if (target.colorMemory != VK_NULL_HANDLE) committed += msaa::committedBytes(ctx.device, target.colorMemory, 0, true);
+		return committed;
+	}
+
+	// The unculled baseline, multisampled
+	void recordMsaaFrame(VkCommandBuffer cmd, const scene::Camera& camera, const MsaaTarget& target) {
+		const scene::LodLevel& lod = meshes.lods[meshes.meshes[cityMesh].firstLod];
+		DrawPush push{camera.viewProj, 0, 0, lod.segments};
+
+		beginPass(cmd, target.renderPass, target.framebuffer, target.pipeline, true);
+		vkCmdPushConstants(cmd, drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+		vkCmdDraw(cmd, lod.vertexCount, boxCount, 0, 0);
+		vkCmdEndRenderPass(cmd);
+	}
+
+	void destroyMsaaTarget(BenchContext& ctx, MsaaTarget& target) {
+		vkDestroyPipeline(ctx.device, target.pipeline, nullptr);
+		vkDestroyFramebuffer(ctx.device, target.framebuffer, nullptr);
+		vkDestroyRenderPass(ctx.device, target.renderPass, nullptr);
+		vkDestroyImageView(ctx.device, target.depthView, nullptr);
+		ctx.destroyImage(target.depthImage, target.depthMemory);
+		if (target.colorImage != VK_NULL_HANDLE) {
+			vkDestroyImageView(ctx.device, target.colorView, nullptr);
+			ctx.destroyImage(target.colorImage, target.colorMemory);
+		}
+		target = MsaaTarget{};
+	}
+
+	void destroy(BenchContext& ctx) {
+		vkDestroyPipeline(ctx.device, cullPipeline, nullptr);
+		vkDestroyPipeline(ctx.device, hizPipeline, nullptr);
+		vkDestroyPipeline(ctx.device, drawPipeline, nullptr);
+		vkDestroyPipelineLayout(ctx.device, cullLayout, nullptr);
+		vkDestroyPipelineLayout(ctx.device, hizLayout, nullptr);
+		vkDestroyPipelineLayout(ctx.device, drawLayout, nullptr);
+		vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, cullSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, hizSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, drawSetLayout, nullptr);
+		vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+		vkDestroyRenderPass(ctx.device, loadPass, nullptr);
+		vkDestroyRenderPass(ctx.device, clearPass, nullptr);
+
+		vkUnmapMemory(ctx.device, statsMemory);
+		ctx.destroyBuffer(statsBuffer, statsMemory);
+		ctx.destroyBuffer(lodStateBuffer, lodStateMemory);
+		ctx.destroyBuffer(lodBuffer, lodMemory);
+		ctx.destroyBuffer(meshBuffer, meshMemory);
+		ctx.destroyBuffer(occludedBuffer, occludedMemory);
+		ctx.destroyBuffer(drawListBuffer, drawListMemory);
+		ctx.destroyBuffer(argsBuffer, argsMemory);
+		ctx.destroyBuffer(boxBuffer, boxMemory);
+
+		vkDestroySampler(ctx.device, sampler, nullptr);
+		for (VkImageView view : pyramidLevelViews) vkDestroyImageView(ctx.device, view, nullptr);
+		vkDestroyImageView(ctx.device, pyramidView, nullptr);
+		vkDestroyImageView(ctx.device, depthView, nullptr);
+		vkDestroyImageView(ctx.device, colorView, nullptr);
+		ctx.destroyImage(pyramidImage, pyramidMemory);
+		ctx.destroyImage(depthImage, depthMemory);
+		ctx.destroyImage(colorImage, colorMemory);
+	}
+};
+
+
+/*
+* Clustered forward lighting over the city (clusters.h), lights binned either by the three
+* bench_cluster.comp passes or on the CPU, shaded by bench_city_lit.frag. Draws into the
+* CityScene's target, every box at LOD 0 like its unculled baseline.
+*/
+
+struct ClusteredLights {
+	struct BinPush {
+		scene::Mat4 view;
+		clusters::Frustum frustum;
+		uint32_t lightCount;
+		uint32_t maxIndices;
+		uint32_t binPass;
+	};
+
+	struct ShadePush {
+		CityScene::DrawPush draw;
+		uint32_t pad;
+		clusters::Frustum frustum; // Offset 80, where bench_city_lit.frag expects it
+		float targetSize[2];
+	};
+	static_assert(offsetof(ShadePush, frustum) == 80, "push constant layout doesn't match the shader");
+
+	std::vector<scene::PointLight> lights;
+	clusters::Frustum frustum{};
+	uint32_t maxIndices = 0;
+	clusters::LightLists cpuLists;
+
+	VkBuffer lightBuffer = VK_NULL_HANDLE, rangeBuffer = VK_NULL_HANDLE, cursorBuffer = VK_NULL_HANDLE, indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory lightMemory = VK_NULL_HANDLE, rangeMemory = VK_NULL_HANDLE, cursorMemory = VK_NULL_HANDLE, indexMemory = VK_NULL_HANDLE;
+	// CPU binning writes straight into these, persistently mapped
+	VkBuffer cpuRangeBuffer = VK_NULL_HANDLE, cpuIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory cpuRangeMemory = VK_NULL_HANDLE, cpuIndexMemory = VK_NULL_HANDLE;
+	void* cpuRanges = nullptr;
+	void* cpuIndices = nullptr;
+
+	VkDescriptorSetLayout binSetLayout = VK_NULL_HANDLE, shadeSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet binSet = VK_NULL_HANDLE, gpuShadeSet = VK_NULL_HANDLE, cpuShadeSet = VK_NULL_HANDLE;
+	VkPipelineLayout binLayout = VK_NULL_HANDLE, shadeLayout = VK_NULL_HANDLE;
+	VkPipeline binPipeline = VK_NULL_HANDLE, shadePipeline = VK_NULL_HANDLE;
+
+	void create(BenchContext& ctx, CityScene& city, uint32_t lightCount) {
+		lights = scene::cityLights(lightCount);
+		frustum = clusters::frustum(scene::CAMERA_FOV_Y, static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT,
+			scene::CAMERA_NEAR, scene::CAMERA_FAR);
+		// Room for every light to touch 16 clusters, past that clusters are cut short
+		maxIndices = std::max(lightCount * 16, 1u << 16);
+
+		VkDeviceSize rangeSize = clusters::CLUSTER_COUNT * sizeof(clusters::Range);
+		VkDeviceSize indexSize = maxIndices * sizeof(uint32_t);
+
+		city.uploadBuffer(ctx, lights.data(), lights.size() * sizeof(scene::PointLight), lightBuffer, lightMemory);
+		ctx.createBuffer(rangeSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, rangeBuffer, rangeMemory);
+		ctx.createBuffer(clusters::CLUSTER_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cursorBuffer, cursorMemory);
+		ctx.createBuffer(indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexMemory);
+		ctx.createBuffer(rangeSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cpuRangeBuffer, cpuRangeMemory);
+		ctx.createBuffer(indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cpuIndexBuffer, cpuIndexMemory);
+		vkMapMemory(ctx.device, cpuRangeMemory, 0, rangeSize, 0, &cpuRanges);
+		vkMapMemory(ctx.device, cpuIndexMemory, 0, indexSize, 0, &cpuIndices);
+
+		const VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		binSetLayout = city.createSetLayout(ctx, {storage, storage, storage, storage}, VK_SHADER_STAGE_COMPUTE_BIT);
+		shadeSetLayout = city.createSetLayout(ctx, {storage, storage, storage}, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VkDescriptorPoolSize poolSize{storage, 10};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 3;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		VkDescriptorSetLayout layouts[] = {binSetLayout, shadeSetLayout, shadeSetLayout};
+		VkDescriptorSet sets[3];
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 3;
+		allocInfo.pSetLayouts = layouts;
+
+		if (vkAllocateDescriptorSets(ctx.device, &allocInfo, sets) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+		binSet = sets[0];
+		gpuShadeSet = sets[1];
+		cpuShadeSet = sets[2];
+
+		const VkBuffer bindings[3][4] = {
+			{lightBuffer, rangeBuffer, cursorBuffer, indexBuffer},
+			{lightBuffer, rangeBuffer, indexBuffer, VK_NULL_HANDLE},
+			{lightBuffer, cpuRangeBuffer, cpuIndexBuffer, VK_NULL_HANDLE}
+		};
+		VkDescriptorBufferInfo bufferInfos[10];
+		VkWriteDescriptorSet writes[10]{};
+		uint32_t writeCount = 0;
+		for (uint32_t set = 0; set < 3; set++) {
+			for (uint32_t binding = 0; binding < 4 && bindings[set][binding] != VK_NULL_HANDLE; binding++) {
+				bufferInfos[writeCount] = {bindings[set][binding], 0, VK_WHOLE_SIZE};
+				writes[writeCount].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[writeCount].dstSet = sets[set];
+				writes[writeCount].dstBinding = binding;
+				writes[writeCount].descriptorCount = 1;
+				writes[writeCount].descriptorType = storage;
+				writes[writeCount].pBufferInfo = &bufferInfos[writeCount];
+				writeCount++;
+			}
+		}
+		vkUpdateDescriptorSets(ctx.device, writeCount, writes, 0, nullptr);
+
+		city.createComputePipeline(ctx, "shaders/bench_cluster.comp.spv", binSetLayout, sizeof(BinPush), binLayout, binPipeline);
+
+		VkDescriptorSetLayout shadeLayouts[] = {city.drawSetLayout, shadeSetLayout};
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ShadePush)};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = shadeLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &shadeLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		shadePipeline = city.createDrawPipeline(ctx, city.clearPass, VK_SAMPLE_COUNT_1_BIT, shadeLayout,
+			"shaders/bench_city_lit.frag.spv");
+	}
+
+	// Count, prefix sum, fill, then shade with the lists they left
+	void recordGpuFrame(VkCommandBuffer cmd, CityScene& city, const scene::Camera& camera) {
+		vkCmdFillBuffer(cmd, rangeBuffer, 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(cmd, cursorBuffer, 0, VK_WHOLE_SIZE, 0);
+		CityScene::memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		BinPush push{camera.view, frustum, static_cast<uint32_t>(lights.size()), maxIndices, 0};
+		uint32_t lightGroups = (push.lightCount + 255) / 256;
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, binPipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, binLayout, 0, 1, &binSet, 0, nullptr);
+		for (uint32_t binPass = 0; binPass < 3; binPass++) {
+			push.binPass = binPass;
+			vkCmdPushConstants(cmd, binLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+			vkCmdDispatch(cmd, binPass == 1 ? 1 : lightGroups, 1, 1);
+
+			if (binPass < 2) {
+				CityScene::memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			}
+		}
+		CityScene::memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		recordShade(cmd, city, camera, gpuShadeSet);
+	}
+
+	// Bins on the calling thread into the mapped buffers. Submit recordCpuFrame() after.
+	void binOnCpu(const scene::Camera& camera) {
+		clusters::binLights(lights, camera.view, frustum, maxIndices, cpuLists);
+		memcpy(cpuRanges, cpuLists.ranges.data(), cpuLists.ranges.size() * sizeof(clusters::Range));
+		memcpy(cpuIndices, cpuLists.indices.data(), cpuLists.indices.size() * sizeof(uint32_t));
+	}
+
+	void recordCpuFrame(VkCommandBuffer cmd, CityScene& city, const scene::Camera& camera) {
+		recordShade(cmd, city, camera, cpuShadeSet);
+	}
+
+	void recordShade(VkCommandBuffer cmd, CityScene& city, const scene::Camera& camera, VkDescriptorSet lightSet) {
+		const scene::LodLevel& lod = city.meshes.lods[city.meshes.meshes[city.cityMesh].firstLod];
+		ShadePush push{{camera.viewProj, 0, 0, lod.segments}, 0, frustum, {(float) TARGET_WIDTH, (float) TARGET_HEIGHT}};
+		VkDescriptorSet sets[] = {city.drawSet, lightSet};
+
+		city.beginPass(cmd, city.clearPass, city.framebuffer, shadePipeline, true);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadeLayout, 0, 2, sets, 0, nullptr);
+		vkCmdPushConstants(cmd, shadeLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+		vkCmdDraw(cmd, lod.vertexCount, city.boxCount, 0, 0);
+		vkCmdEndRenderPass(cmd);
+	}
+
+	void destroy(BenchContext& ctx) {
+		vkDestroyPipeline(ctx.device, shadePipeline, nullptr);
+		vkDestroyPipeline(ctx.device, binPipeline, nullptr);
+		vkDestroyPipelineLayout(ctx.device, shadeLayout, nullptr);
+		vkDestroyPipelineLayout(ctx.device, binLayout, nullptr);
+		vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, shadeSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, binSetLayout, nullptr);
+
+		vkUnmapMemory(ctx.device, cpuIndexMemory);
+		vkUnmapMemory(ctx.device, cpuRangeMemory);
+		ctx.destroyBuffer(cpuIndexBuffer, cpuIndexMemory);
+		ctx.destroyBuffer(cpuRangeBuffer, cpuRangeMemory);
+		ctx.destroyBuffer(indexBuffer, indexMemory);
+		ctx.destroyBuffer(cursorBuffer, cursorMemory);
+		ctx.destroyBuffer(rangeBuffer, rangeMemory);
+		ctx.destroyBuffer(lightBuffer, lightMemory);
+	}
+};
+
+
+/*
+* Shadows of the city for 8 spot lights in an atlas (shadow_atlas.h) and 4 cascades of a
+* directional light. Static casters are the city's boxes, dynamic ones scene::traffic().
+* - Uncached, every frame clears the atlas and draws both for every light.
+* - Cached, stale static tiles are redrawn into the static atlas, all tiles are copied into
+*   the frame's atlas, and only the traffic is drawn on top.
+* - Cascades are one multiview pass when the device has VK_KHR_multiview, else one per layer.
+*/
+
+struct ShadowScene {
+	static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+	static const uint32_t LIGHT_COUNT = 8;
+	static const uint32_t TRAFFIC_COUNT = 256;
+	static const uint32_t CASCADE_MATRIX = shadows::MAX_LIGHTS; // First cascade's matrix
+
+	std::vector<shadows::SpotLight> lights;
+	shadows::StaticCache cache;
+	bool multiview = false;
+
+	VkImage staticAtlas = VK_NULL_HANDLE, frameAtlas = VK_NULL_HANDLE, cascadeImage = VK_NULL_HANDLE;
+	VkDeviceMemory staticAtlasMemory = VK_NULL_HANDLE, frameAtlasMemory = VK_NULL_HANDLE, cascadeMemory = VK_NULL_HANDLE;
+	VkImageView staticAtlasView = VK_NULL_HANDLE, frameAtlasView = VK_NULL_HANDLE;
+	std::vector<VkImageView> cascadeViews; // One array view with multiview, else one per layer
+
+	// Host visible and persistently mapped, written before each submit
+	VkBuffer matrixBuffer = VK_NULL_HANDLE, trafficBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory matrixMemory = VK_NULL_HANDLE, trafficMemory = VK_NULL_HANDLE;
+	scene::Mat4* matrices = nullptr;
+	scene::Box* traffic = nullptr;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet staticSet = VK_NULL_HANDLE, dynamicSet = VK_NULL_HANDLE;
+
+	VkRenderPass staticPass = VK_NULL_HANDLE; // Loads and keeps the static atlas
+	VkRenderPass dynamicPass = VK_NULL_HANDLE; // Draws on top of the copied static tiles
+	VkRenderPass fullPass = VK_NULL_HANDLE; // Uncached, clears everything
+	VkRenderPass cascadePass = VK_NULL_HANDLE;
+	VkFramebuffer staticFramebuffer = VK_NULL_HANDLE, frameFramebuffer = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> cascadeFramebuffers;
+
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline atlasPipeline = VK_NULL_HANDLE, cascadePipeline = VK_NULL_HANDLE;
+
+	void create(BenchContext& ctx, CityScene& city) {
+		multiview = ctx.multiview;
+
+		// Down the middle street from above, a little ahead of each other like street lamps
+		float street = (scene::CITY_BLOCKS / 2 - 0.5f) * scene::BLOCK_SIZE;
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+			float z = 20.0f + i * 25.0f;
+			lights.push_back(shadows::SpotLight{{street, 30.0f, z}, {street + 4.0f, 0.0f, z + 6.0f}, 1.2f, 80.0f});
+		}
+
+		VkImageUsageFlags atlasUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		ctx.createImage(DEPTH_FORMAT, shadows::ATLAS_SIZE, shadows::ATLAS_SIZE, 1,
+			atlasUsage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, staticAtlas, staticAtlasMemory);
+		ctx.createImage(DEPTH_FORMAT, shadows::ATLAS_SIZE, shadows::ATLAS_SIZE, 1,
+			atlasUsage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, frameAtlas, frameAtlasMemory);
+		ctx.createImage(DEPTH_FORMAT, shadows::CASCADE_SIZE, shadows::CASCADE_SIZE, 1,
+			atlasUsage, cascadeImage, cascadeMemory, shadows::CASCADE_COUNT);
+		staticAtlasView = ctx.createImageView(staticAtlas, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		frameAtlasView = ctx.createImageView(frameAtlas, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		if (multiview) {
+			cascadeViews.push_back(ctx.createImageView(cascadeImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT,
+				0, 1, 0, shadows::CASCADE_COUNT));
+		} else {
+			for (uint32_t layer = 0; layer < shadows::CASCADE_COUNT; layer++) {
+				cascadeViews.push_back(ctx.createImageView(cascadeImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, layer, 1));
+			}
+		}
+
+		const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkDeviceSize matrixSize = (shadows::MAX_LIGHTS + shadows::CASCADE_COUNT) * sizeof(scene::Mat4);
+		VkDeviceSize trafficSize = TRAFFIC_COUNT * sizeof(scene::Box);
+		ctx.createBuffer(matrixSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, matrixBuffer, matrixMemory);
+		ctx.createBuffer(trafficSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, trafficBuffer, trafficMemory);
+
+		void* mapped;
+		vkMapMemory(ctx.device, matrixMemory, 0, matrixSize, 0, &mapped);
+		matrices = static_cast<scene::Mat4*>(mapped);
+		vkMapMemory(ctx.device, trafficMemory, 0, trafficSize, 0, &mapped);
+		traffic = static_cast<scene::Box*>(mapped);
+
+		createDescriptors(ctx, city);
+
+		staticPass = createPass(ctx, VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0);
+		dynamicPass = createPass(ctx, VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0);
+		fullPass = createPass(ctx, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0);
+		cascadePass = createPass(ctx, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			multiview ? (1u << shadows::CASCADE_COUNT) - 1 : 0);
+
+		staticFramebuffer = createFramebuffer(ctx, staticPass, staticAtlasView, shadows::ATLAS_SIZE);
+		frameFramebuffer = createFramebuffer(ctx, fullPass, frameAtlasView, shadows::ATLAS_SIZE);
+		for (VkImageView view : cascadeViews) {
+			cascadeFramebuffers.push_back(createFramebuffer(ctx, cascadePass, view, shadows::CASCADE_SIZE));
+		}
+
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t)};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		atlasPipeline = createPipeline(ctx, fullPass, "shaders/bench_shadow.vert.spv");
+		cascadePipeline = createPipeline(ctx, cascadePass,
+			multiview ? "shaders/bench_shadow_multiview.vert.spv" : "shaders/bench_shadow.vert.spv");
+
+		// The static atlas rests in TRANSFER_SRC between frames. Nothing is cached yet, so
+		// every tile is drawn before it's first copied.
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = staticAtlas;
+			barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+		});
+	}
+
+	void createDescriptors(BenchContext& ctx, CityScene& city) {
+		const VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		setLayout = city.createSetLayout(ctx, {storage, storage}, VK_SHADER_STAGE_VERTEX_BIT);
+
+		VkDescriptorPoolSize poolSize{storage, 4};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 2;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		VkDescriptorSetLayout layouts[] = {setLayout, setLayout};
+		VkDescriptorSet sets[2];
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 2;
+		allocInfo.pSetLayouts = layouts;
+
+		if (vkAllocateDescriptorSets(ctx.device, &allocInfo, sets) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+		staticSet = sets[0];
+		dynamicSet = sets[1];
+
+		VkDescriptorBufferInfo bufferInfos[] = {
+			{city.boxBuffer, 0, VK_WHOLE_SIZE}, {matrixBuffer, 0, VK_WHOLE_SIZE},
+			{trafficBuffer, 0, VK_WHOLE_SIZE}, {matrixBuffer, 0, VK_WHOLE_SIZE}
+		};
+		VkWriteDescriptorSet writes[4]{};
+		for (uint32_t i = 0; i < 4; i++) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[i / 2];
+			writes[i].dstBinding = i % 2;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = storage;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(ctx.device, 4, writes, 0, nullptr);
+	}
+
+	// Depth only. All four are compatible, they differ in load op and layouts only.
+	VkRenderPass createPass(BenchContext& ctx, VkAttachmentLoadOp loadOp, VkImageLayout initialLayout,
+		VkImageLayout finalLayout, uint32_t viewMask) {
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = DEPTH_FORMAT;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = loadOp;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = initialLayout;
+		depthAttachment.finalLayout = finalLayout;
+
+		VkAttachmentReference depthAttachmentRef{0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// In: last frame's copy and readers, this frame's copy into the atlas. Out: the copy
+		// out of the static atlas and shading.
+		VkSubpassDependency dependencies[2]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		// One view per cascade layer, and a hint that the views see mostly the same geometry
+		VkRenderPassMultiviewCreateInfoKHR multiviewInfo{};
+		multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+		multiviewInfo.subpassCount = 1;
+		multiviewInfo.pViewMasks = &viewMask;
+		multiviewInfo.correlationMaskCount = 1;
+		multiviewInfo.pCorrelationMasks = &viewMask;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pNext = viewMask != 0 ? &multiviewInfo : nullptr;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &depthAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies;
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+		return renderPass;
+	}
+
+	VkFramebuffer createFramebuffer(BenchContext& ctx, VkRenderPass renderPass, VkImageView view, uint32_t size) {
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &view;
+		framebufferInfo.width = size;
+		framebufferInfo.height = size;
+		framebufferInfo.layers = 1; // Multiview takes its layers from the view mask
+
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+		return framebuffer;
+	}
+
+	// Depth only, no fragment shader. The viewport is dynamic, one tile at a time.
+	VkPipeline createPipeline(BenchContext& ctx, VkRenderPass renderPass, const std::string& vertexShader) {
+		VkShaderModule vertModule = ctx.createShaderModule(vertexShader);
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStage.module = vertModule;
+		shaderStage.pName = "main";
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		// Slope scaled bias against acne
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer.depthBiasEnable = VK_TRUE;
+		rasterizer.depthBiasConstantFactor = 1.25f;
+		rasterizer.depthBiasSlopeFactor = 1.75f;
+		rasterizer.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+		VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 1;
+		pipelineInfo.pStages = &shaderStage;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		vkDestroyShaderModule(ctx.device, vertModule, nullptr);
+		return pipeline;
+	}
+
+	// Traffic and light matrices for a frame. Every 15 frames one light swings a little,
+	// which is what makes its cached tile stale.
+	void update(const scene::Camera& camera, uint32_t frame) {
+		std::vector<scene::Box> cars = scene::traffic(TRAFFIC_COUNT, frame);
+		memcpy(traffic, cars.data(), cars.size() * sizeof(scene::Box));
+
+		if (frame > 0 && frame % 15 == 0) {
+			shadows::SpotLight& light = lights[(frame / 15) % LIGHT_COUNT];
+			light.target.x += (frame % 30 == 0) ? 1.0f : -1.0f;
+		}
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) matrices[i] = shadows::viewProj(lights[i]);
+
+		const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+		float splits[shadows::CASCADE_COUNT + 1];
+		shadows::cascadeSplits(scene::CAMERA_NEAR, 400.0f, 0.7f, splits);
+		for (uint32_t i = 0; i < shadows::CASCADE_COUNT; i++) {
+			matrices[CASCADE_MATRIX + i] = shadows::cascadeViewProj(camera, scene::CAMERA_FOV_Y, aspect,
+				splits[i], splits[i + 1], scene::Vec3{-0.4f, -1.0f, -0.3f}, 100.0f);
+		}
+	}
+
+	void beginPass(VkCommandBuffer cmd, VkRenderPass renderPass, VkFramebuffer framebuffer, uint32_t size, VkPipeline pipeline) {
+		VkClearValue clearValue{};
+		clearValue.depthStencil = {1.0f, 0};
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea = {{0, 0}, {size, size}};
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearValue;
+
+		vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	}
+
+	static void setRegion(VkCommandBuffer cmd, uint32_t x, uint32_t y, uint32_t size) {
+		VkViewport viewport{(float) x, (float) y, (float) size, (float) size, 0.0f, 1.0f};
+		VkRect2D scissor{{static_cast<int32_t>(x), static_cast<int32_t>(y)}, {size, size}};
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+	}
+
+	void drawBoxes(VkCommandBuffer cmd, VkDescriptorSet set, uint32_t count, uint32_t matrix) {
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 0, nullptr);
+		vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(matrix), &matrix);
+		vkCmdDraw(cmd, 36, count, 0, 0);
+	}
+
+	void recordUncached(VkCommandBuffer cmd, uint32_t boxCount) {
+		beginPass(cmd, fullPass, frameFramebuffer, shadows::ATLAS_SIZE, atlasPipeline);
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+			shadows::Tile tile = shadows::tile(i);
+			setRegion(cmd, tile.x, tile.y, shadows::TILE_SIZE);
+			drawBoxes(cmd, staticSet, boxCount, i);
+			drawBoxes(cmd, dynamicSet, TRAFFIC_COUNT, i);
+		}
+		vkCmdEndRenderPass(cmd);
+	}
+
+	// Returns how many static tiles had to be redrawn.
+	uint32_t recordCached(VkCommandBuffer cmd, uint32_t boxCount) {
+		std::vector<uint32_t> stale;
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+			if (cache.acquire(i, lights[i])) stale.push_back(i);
+		}
+
+		if (!stale.empty()) {
+			beginPass(cmd, staticPass, staticFramebuffer, shadows::ATLAS_SIZE, atlasPipeline);
+			for (uint32_t i : stale) {
+				shadows::Tile tile = shadows::tile(i);
+				setRegion(cmd, tile.x, tile.y, shadows::TILE_SIZE);
+
+				VkClearAttachment clear{VK_IMAGE_ASPECT_DEPTH_BIT, 0, {}};
+				clear.clearValue.depthStencil = {1.0f, 0};
+				VkClearRect rect{{{static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)}, {shadows::TILE_SIZE, shadows::TILE_SIZE}}, 0, 1};
+				vkCmdClearAttachments(cmd, 1, &clear, 1, &rect);
+				drawBoxes(cmd, staticSet, boxCount, i);
+			}
+			vkCmdEndRenderPass(cmd);
+		}
+
+		// Last frame's shading is done with the frame atlas, its contents can go
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = frameAtlas;
+		barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageCopy regions[LIGHT_COUNT]{};
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+			shadows::Tile tile = shadows::tile(i);
+			regions[i].srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+			regions[i].srcOffset = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y), 0};
+			regions[i].dstSubresource = regions[i].srcSubresource;
+			regions[i].dstOffset = regions[i].srcOffset;
+			regions[i].extent = {shadows::TILE_SIZE, shadows::TILE_SIZE, 1};
+		}
+		vkCmdCopyImage(cmd, staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameAtlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			LIGHT_COUNT, regions);
+
+		beginPass(cmd, dynamicPass, frameFramebuffer, shadows::ATLAS_SIZE, atlasPipeline);
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+			shadows::Tile tile = shadows::tile(i);
+			setRegion(cmd, tile.x, tile.y, shadows::TILE_SIZE);
+			drawBoxes(cmd, dynamicSet, TRAFFIC_COUNT, i);
+		}
+		vkCmdEndRenderPass(cmd);
+
+		return static_cast<uint32_t>(stale.size());
+	}
+
+	// Cascades follow the camera, so they're redrawn every frame, static casters and all.
+	void recordCascades(VkCommandBuffer cmd, uint32_t boxCount) {
+		for (uint32_t pass = 0; pass < cascadeFramebuffers.size(); pass++) {
+			beginPass(cmd, cascadePass, cascadeFramebuffers[pass], shadows::CASCADE_SIZE, cascadePipeline);
+			setRegion(cmd, 0, 0, shadows::CASCADE_SIZE);
+			drawBoxes(cmd, staticSet, boxCount, CASCADE_MATRIX + pass);
+			drawBoxes(cmd, dynamicSet, TRAFFIC_COUNT, CASCADE_MATRIX + pass);
+			vkCmdEndRenderPass(cmd);
+		}
+	}
+
+	void destroy(BenchContext& ctx) {
+		vkDestroyPipeline(ctx.device, cascadePipeline, nullptr);
+		vkDestroyPipeline(ctx.device, atlasPipeline, nullptr);
+		vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+		for (VkFramebuffer framebuffer : cascadeFramebuffers) vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+		vkDestroyFramebuffer(ctx.device, frameFramebuffer, nullptr);
+		vkDestroyFramebuffer(ctx.device, staticFramebuffer, nullptr);
+		vkDestroyRenderPass(ctx.device, cascadePass, nullptr);
+		vkDestroyRenderPass(ctx.device, fullPass, nullptr);
+		vkDestroyRenderPass(ctx.device, dynamicPass, nullptr);
+		vkDestroyRenderPass(ctx.device, staticPass, nullptr);
+		vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, setLayout, nullptr);
+
+		vkUnmapMemory(ctx.device, trafficMemory);
+		vkUnmapMemory(ctx.device, matrixMemory);
+		ctx.destroyBuffer(trafficBuffer, trafficMemory);
+		ctx.destroyBuffer(matrixBuffer, matrixMemory);
+
+		for (VkImageView view : cascadeViews) vkDestroyImageView(ctx.device, view, nullptr);
+		vkDestroyImageView(ctx.device, frameAtlasView, nullptr);
+		vkDestroyImageView(ctx.device, staticAtlasView, nullptr);
+		ctx.destroyImage(cascadeImage, cascadeMemory);
+		ctx.destroyImage(frameAtlas, frameAtlasMemory);
+		ctx.destroyImage(staticAtlas, staticAtlasMemory);
+	}
+};
+
+
+/*
+* Independent render sessions on the context's device, see render_server.h. The server owns
+* what sessions share: the render pass and the triangle pipeline, whose dynamic viewport lets
+* one pipeline serve every resolution. Each session has its own command pool, frames in
+* flight, timestamps, target and memory budget.
+*/
+
+struct RenderServer {
+	static const uint32_t FRAMES_IN_FLIGHT = 2;
+
+	struct Session {
+		uint32_t id = 0;
+		uint32_t width = 0, height = 0;
+		uint32_t drawsPerFrame = 0;
+		server::MemoryBudget budget;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize imageBytes = 0;
+		VkImageView view = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffers[FRAMES_IN_FLIGHT] = {};
+		VkFence fences[FRAMES_IN_FLIGHT] = {};
+		bool pending[FRAMES_IN_FLIGHT] = {}; // Submitted, fence not waited for yet
+		VkQueryPool queryPool = VK_NULL_HANDLE; // Begin and end timestamp per frame in flight
+
+		uint64_t framesSubmitted = 0;
+		uint64_t framesRemaining = 0;
+		double gpuMs = 0.0;
+	};
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	bool timestamps = false;
+	server::FairScheduler scheduler;
+	std::vector<Session> sessions;
+	double contendedFairness = 1.0; // When the first session ran out of frames
+
+	void create(BenchContext& ctx, VkPipelineCache cache = VK_NULL_HANDLE) {
+		renderPass = OffscreenTarget::createRenderPass(ctx);
+		pipelineLayout = OffscreenTarget::createPipelineLayout(ctx);
+		pipeline = OffscreenTarget::createPipeline(ctx, renderPass, pipelineLayout, true, cache);
+		timestamps = ctx.properties.limits.timestampComputeAndGraphics && ctx.properties.limits.timestampPeriod > 0.0f;
+	}
+
+	uint32_t addSession(BenchContext& ctx, uint32_t width, uint32_t height, uint32_t drawsPerFrame, uint32_t weight,
+		VkDeviceSize budgetBytes) {
+		Session session;
+		session.width = width;
+		session.height = height;
+		session.drawsPerFrame = drawsPerFrame;
+		session.budget = server::MemoryBudget(budgetBytes);
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = TARGET_FORMAT;
+		imageInfo.extent = {width, height, 1};
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(ctx.device, &imageInfo, nullptr, &session.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		// Checked against the budget before anything is allocated
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(ctx.device, session.image, &memRequirements);
+		if (!session.budget.reserve(memRequirements.size)) {
+			vkDestroyImage(ctx.device, session.image, nullptr);
+			throw std::runtime_error("session target over its memory budget!");
+		}
+		session.imageBytes = memRequirements.size;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = ctx.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(ctx.device, &allocInfo, nullptr, &session.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+		memstats::deviceMemory().onAllocate(session.memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize,
+			memstats::DeviceMemoryCategory::Image);
+		vkBindImageMemory(ctx.device, session.image, session.memory, 0);
+
+		session.view = ctx.createImageView(session.image, TARGET_FORMAT);
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &session.view;
+		framebufferInfo.width = width;
+		framebufferInfo.height = height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &session.framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+
+		// Own pool, so sessions never contend on command buffer allocation
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = ctx.queueFamily;
+		if (vkCreateCommandPool(ctx.device, &poolInfo, nullptr, &session.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+
+		VkCommandBufferAllocateInfo commandInfo{};
+		commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandInfo.commandPool = session.commandPool;
+		commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandInfo.commandBufferCount = FRAMES_IN_FLIGHT;
+		if (vkAllocateCommandBuffers(ctx.device, &commandInfo, session.commandBuffers) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+			if (vkCreateFence(ctx.device, &fenceInfo, nullptr, &session.fences[slot]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create fence!");
+			}
+		}
+
+		if (timestamps) {
+			VkQueryPoolCreateInfo queryInfo{};
+			queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryInfo.queryCount = 2 * FRAMES_IN_FLIGHT;
+			if (vkCreateQueryPool(ctx.device, &queryInfo, nullptr, &session.queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create query pool!");
+			}
+		}
+
+		// Ids are indices into sessions, only sessions that came up get one
+		session.id = scheduler.add(weight);
+		sessions.push_back(session);
+		return session.id;
+	}
+
+	void recordFrame(Session& session, VkCommandBuffer cmd, uint32_t slot) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(cmd, &beginInfo);
+
+		if (timestamps) {
+			vkCmdResetQueryPool(cmd, session.queryPool, 2 * slot, 2);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, session.queryPool, 2 * slot);
+		}
+
+		VkClearValue clearColor{};
+		clearColor.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = session.framebuffer;
+		renderPassInfo.renderArea = {{0, 0}, {session.width, session.height}};
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		VkViewport viewport{0.0f, 0.0f, static_cast<float>(session.width), static_cast<float>(session.height), 0.0f, 1.0f};
+		VkRect2D scissor{{0, 0}, {session.width, session.height}};
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+		for (uint32_t i = 0; i < session.drawsPerFrame; i++) {
+			vkCmdDraw(cmd, 3, 1, 0, i);
+		}
+
+		vkCmdEndRenderPass(cmd);
+
+		if (timestamps) {
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, session.queryPool, 2 * slot + 1);
+		}
+		vkEndCommandBuffer(cmd);
+	}
+
+	// Waits for the frame in the slot and charges the session for it. Without timestamps
+	// every frame costs the same, and the scheduler falls back to frame round robin.
+	void finishFrame(BenchContext& ctx, Session& session, uint32_t slot) {
+		vkWaitForFences(ctx.device, 1, &session.fences[slot], VK_TRUE, UINT64_MAX);
+		vkResetFences(ctx.device, 1, &session.fences[slot]);
+		session.pending[slot] = false;
+
+		double cost = 1.0;
+		if (timestamps) {
+			uint64_t ticks[2];
+			if (vkGetQueryPoolResults(ctx.device, session.queryPool, 2 * slot, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				cost = (ticks[1] - ticks[0]) * ctx.properties.limits.timestampPeriod / 1e6;
+				session.gpuMs += cost;
+			}
+		}
+		scheduler.charge(session.id, cost);
+	}
+
+	// Every session renders framesPerSession frames. Submissions interleave in the
+	// scheduler's order, each session keeping up to FRAMES_IN_FLIGHT of them queued.
+	void run(BenchContext& ctx, uint32_t framesPerSession) {
+		for (Session& session : sessions) session.framesRemaining = framesPerSession;
+
+		bool contended = true;
+		auto ready = [&](uint32_t id) { return sessions[id].framesRemaining > 0; };
+
+		int id;
+		while ((id = scheduler.next(ready)) >= 0) {
+			Session& session = sessions[id];
+			uint32_t slot = static_cast<uint32_t>(session.framesSubmitted % FRAMES_IN_FLIGHT);
+			if (session.pending[slot]) finishFrame(ctx, session, slot);
+
+			VkCommandBuffer cmd = session.commandBuffers[slot];
+			vkResetCommandBuffer(cmd, 0);
+			recordFrame(session, cmd, slot);
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &cmd;
+			if (vkQueueSubmit(ctx.queue, 1, &submitInfo, session.fences[slot]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit command buffer!");
+			}
+			session.pending[slot] = true;
+			session.framesSubmitted++;
+			session.framesRemaining--;
+
+			if (contended && session.framesRemaining == 0) {
+				contendedFairness = server::fairness(scheduler, static_cast<uint32_t>(sessions.size()));
+				contended = false;
+			}
+		}
+
+		for (Session& session : sessions) {
+			for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+				if (session.pending[slot]) finishFrame(ctx, session, slot);
+			}
+		}
+	}
+
+	// The session's last frame as tightly packed RGBA8, after run(). The staging buffer counts
+	// against the session's budget too.
+	void readback(BenchContext& ctx, uint32_t id, void* out) {
+		Session& session = sessions[id];
+		VkDeviceSize size = static_cast<VkDeviceSize>(session.width) * session.height * 4;
+		if (!session.budget.reserve(size)) {
+			throw std::runtime_error("session readback over its memory budget!");
+		}
+
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory,
+			memstats::DeviceMemoryCategory::Staging);
+
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkBufferImageCopy region{};
+			region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			region.imageExtent = {session.width, session.height, 1};
+			vkCmdCopyImageToBuffer(cmd, session.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+		});
+
+		void* data;
+		vkMapMemory(ctx.device, memory, 0, size, 0, &data);
+		memcpy(out, data, size);
+		vkUnmapMemory(ctx.device, memory);
+
+		ctx.destroyBuffer(buffer, memory);
+		session.budget.release(size);
+	}
+
+	void destroy(BenchContext& ctx) {
+		for (Session& session : sessions) {
+			if (session.queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(ctx.device, session.queryPool, nullptr);
+			for (VkFence fence : session.fences) vkDestroyFence(ctx.device, fence, nullptr);
+			vkDestroyCommandPool(ctx.device, session.commandPool, nullptr);
+			vkDestroyFramebuffer(ctx.device, session.framebuffer, nullptr);
+			vkDestroyImageView(ctx.device, session.view, nullptr);
+			ctx.destroyImage(session.image, session.memory);
+			session.budget.release(session.imageBytes);
+		}
+		sessions.clear();
+
+		vkDestroyPipeline(ctx.device, pipeline, nullptr);
+		vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+		vkDestroyRenderPass(ctx.device, renderPass, nullptr);
+	}
+};
+
+
+/*
+* Ray tracing acceleration structures on the context's device, see accel.h. One BLAS per mesh
+* with every mesh's vertices in one buffer, a TLAS over instances written straight into a
+* mapped buffer, and one pooled scratch buffer every build takes its range from.
+*/
+
+struct RayTracingScene {
+	struct Structure {
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		VkDeviceAddress address = 0;
+	};
+
+	struct Mesh {
+		VkDeviceSize firstVertex;
+		uint32_t vertexCount;
+	};
+
+	accel::Functions fn;
+	accel::ScratchArena arena;
+	accel::Compaction compaction;
+
+	std::vector<Mesh> meshes;
+	std::vector<Structure> blases;
+	Structure tlas;
+	VkDeviceSize tlasBuildScratch = 0;
+	VkDeviceSize tlasUpdateScratch = 0;
+	uint32_t maxInstances = 0;
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+	VkDeviceAddress vertexAddress = 0;
+
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+	VkDeviceAddress instanceAddress = 0;
+	VkAccelerationStructureInstanceKHR* instances = nullptr; // Stays mapped
+
+	VkBuffer scratchBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory scratchMemory = VK_NULL_HANDLE;
+	VkDeviceSize scratchCapacity = 0;
+	VkDeviceAddress scratchAddress = 0; // Aligned for the arena's offsets
+
+	VkQueryPool compactedSizes = VK_NULL_HANDLE;
+
+	void create(BenchContext& ctx, const std::vector<scene::LodLevel>& shapes, uint32_t instanceCount) {
+		fn.load(ctx.device);
+
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR structureProperties{};
+		structureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &structureProperties;
+		vkGetPhysicalDeviceProperties2(ctx.physicalDevice, &properties);
+		arena = accel::ScratchArena(structureProperties.minAccelerationStructureScratchOffsetAlignment);
+
+		std::vector<float> vertices;
+		for (const scene::LodLevel& shape : shapes) {
+			std::vector<float> mesh = accel::meshVertices(shape);
+			meshes.push_back(Mesh{vertices.size() / 3, static_cast<uint32_t>(mesh.size() / 3)});
+			vertices.insert(vertices.end(), mesh.begin(), mesh.end());
+		}
+
+		const VkBufferUsageFlags inputUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+		const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		VkDeviceSize vertexBytes = vertices.size() * sizeof(float);
+		ctx.createBuffer(vertexBytes, inputUsage, hostVisible, vertexBuffer, vertexMemory);
+		void* data;
+		vkMapMemory(ctx.device, vertexMemory, 0, vertexBytes, 0, &data);
+		memcpy(data, vertices.data(), vertexBytes);
+		vkUnmapMemory(ctx.device, vertexMemory);
+		vertexAddress = bufferAddress(ctx, vertexBuffer);
+
+		maxInstances = instanceCount;
+		VkDeviceSize instanceBytes = instanceCount * sizeof(VkAccelerationStructureInstanceKHR);
+		ctx.createBuffer(instanceBytes, inputUsage, hostVisible, instanceBuffer, instanceMemory);
+		vkMapMemory(ctx.device, instanceMemory, 0, instanceBytes, 0, &data);
+		instances = static_cast<VkAccelerationStructureInstanceKHR*>(data);
+		instanceAddress = bufferAddress(ctx, instanceBuffer);
+
+		VkQueryPoolCreateInfo queryInfo{};
+		queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+		queryInfo.queryCount = static_cast<uint32_t>(shapes.size());
+		if (vkCreateQueryPool(ctx.device, &queryInfo, nullptr, &compactedSizes) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compacted size query pool!");
+		}
+	}
+
+	// Builds a BLAS for every mesh, all in one vkCmdBuildAccelerationStructuresKHR or one submit
+	// per mesh. Returns the milliseconds spent in submits.
+	double buildBlases(BenchContext& ctx, bool batched) {
+		for (Structure& blas : blases) destroyStructure(ctx, blas);
+		blases.clear();
+
+		size_t count = meshes.size();
+		std::vector<VkAccelerationStructureGeometryKHR> geometries(count);
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> infos(count);
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> ranges(count);
+		std::vector<VkDeviceSize> scratchOffsets(count);
+
+		arena.reset();
+		for (size_t i = 0; i < count; i++) {
+			geometries[i] = triangles(meshes[i]);
+
+			infos[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+			infos[i].type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			infos[i].flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+			infos[i].mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			infos[i].geometryCount = 1;
+			infos[i].pGeometries = &geometries[i];
+
+			ranges[i] = VkAccelerationStructureBuildRangeInfoKHR{meshes[i].vertexCount / 3, 0, 0, 0};
+
+			VkAccelerationStructureBuildSizesInfoKHR sizes{};
+			sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			fn.getBuildSizes(ctx.device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &infos[i], &ranges[i].primitiveCount, &sizes);
+
+			blases.push_back(createStructure(ctx, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes.accelerationStructureSize));
+			infos[i].dstAccelerationStructure = blases[i].handle;
+
+			// A batch runs its builds together, so each needs its own range. Separate
+			// submits finish one build before the next starts and all start at 0.
+			if (!batched) arena.reset();
+			scratchOffsets[i] = arena.allocate(sizes.buildScratchSize);
+		}
+
+		reserveScratch(ctx);
+		for (size_t i = 0; i < count; i++) {
+			infos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+		}
+
+		auto record = [&](VkCommandBuffer commandBuffer, size_t first, size_t buildCount) {
+			std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangePointers(buildCount);
+			for (size_t i = 0; i < buildCount; i++) rangePointers[i] = &ranges[first + i];
+			fn.cmdBuild(commandBuffer, static_cast<uint32_t>(buildCount), &infos[first], rangePointers.data());
+		};
+
+		if (batched) {
+			return ctx.submitAndWait([&](VkCommandBuffer commandBuffer) { record(commandBuffer, 0, count); });
+		}
+		double elapsed = 0.0;
+		for (size_t i = 0; i < count; i++) {
+			elapsed += ctx.submitAndWait([&](VkCommandBuffer commandBuffer) { record(commandBuffer, i, 1); });
+		}
+		return elapsed;
+	}
+
+	// Queries every BLAS's compacted size and copies it into a structure of that size. Returns
+	// the milliseconds spent in the copy submit.
+	double compact(BenchContext& ctx) {
+		uint32_t count = static_cast<uint32_t>(blases.size());
+		std::vector<VkAccelerationStructureKHR> handles;
+		for (const Structure& blas : blases) handles.push_back(blas.handle);
+
+		ctx.submitAndWait([&](VkCommandBuffer commandBuffer) {
+			vkCmdResetQueryPool(commandBuffer, compactedSizes, 0, count);
+			buildBarrier(commandBuffer);
+			fn.cmdWriteProperties(commandBuffer, count, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizes, 0);
+		});
+
+		std::vector<VkDeviceSize> sizes(count);
+		vkGetQueryPoolResults(ctx.device, compactedSizes, 0, count, count * sizeof(VkDeviceSize), sizes.data(), sizeof(VkDeviceSize),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+		std::vector<Structure> compacted;
+		for (uint32_t i = 0; i < count; i++) {
+			compacted.push_back(createStructure(ctx, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes[i]));
+			compaction.builtBytes += blases[i].size;
+			compaction.compactedBytes += sizes[i];
+		}
+
+		double elapsed = ctx.submitAndWait([&](VkCommandBuffer commandBuffer) {
+			for (uint32_t i = 0; i < count; i++) {
+				VkCopyAccelerationStructureInfoKHR copy{};
+				copy.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+				copy.src = blases[i].handle;
+				copy.dst = compacted[i].handle;
+				copy.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+				fn.cmdCopy(commandBuffer, &copy);
+			}
+		});
+
+		for (Structure& blas : blases) destroyStructure(ctx, blas);
+		blases = std::move(compacted);
+		return elapsed;
+	}
+
+	// Instance i is meshes[meshOf[i]] placed by boxes[i]. An update refits the last build in
+	// place and needs the same instance count. Returns the milliseconds spent in the submit.
+	double buildTlas(BenchContext& ctx, const std::vector<scene::Box>& boxes, const std::vector<uint32_t>& meshOf, bool update) {
+		uint32_t count = static_cast<uint32_t>(boxes.size());
+		if (count > maxInstances) {
+			throw std::runtime_error("too many acceleration structure instances!");
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			instances[i] = accel::instance(boxes[i], blases[meshOf[i]].address, i);
+		}
+
+		VkAccelerationStructureGeometryKHR geometry{};
+		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		geometry.geometry.instances.data.deviceAddress = instanceAddress;
+
+		VkAccelerationStructureBuildGeometryInfoKHR info{};
+		info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+		info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		info.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		info.geometryCount = 1;
+		info.pGeometries = &geometry;
+
+		// Sized once for maxInstances, so neither rebuilds nor updates outgrow it
+		if (tlas.handle == VK_NULL_HANDLE) {
+			VkAccelerationStructureBuildSizesInfoKHR sizes{};
+			sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			fn.getBuildSizes(ctx.device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &info, &maxInstances, &sizes);
+			tlas = createStructure(ctx, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizes.accelerationStructureSize);
+			tlasBuildScratch = sizes.buildScratchSize;
+			tlasUpdateScratch = sizes.updateScratchSize;
+		}
+		info.srcAccelerationStructure = update ? tlas.handle : VK_NULL_HANDLE;
+		info.dstAccelerationStructure = tlas.handle;
+
+		arena.reset();
+		VkDeviceSize offset = arena.allocate(update ? tlasUpdateScratch : tlasBuildScratch);
+		reserveScratch(ctx);
+		info.scratchData.deviceAddress = scratchAddress + offset;
+
+		VkAccelerationStructureBuildRangeInfoKHR range{count, 0, 0, 0};
+		const VkAccelerationStructureBuildRangeInfoKHR* rangePointer = &range;
+		return ctx.submitAndWait([&](VkCommandBuffer commandBuffer) {
+			buildBarrier(commandBuffer);
+			fn.cmdBuild(commandBuffer, 1, &info, &rangePointer);
+		});
+	}
+
+	void destroy(BenchContext& ctx) {
+		for (Structure& blas : blases) destroyStructure(ctx, blas);
+		blases.clear();
+		destroyStructure(ctx, tlas);
+
+		vkDestroyQueryPool(ctx.device, compactedSizes, nullptr);
+		if (scratchBuffer != VK_NULL_HANDLE) ctx.destroyBuffer(scratchBuffer, scratchMemory);
+		vkUnmapMemory(ctx.device, instanceMemory);
+		ctx.destroyBuffer(instanceBuffer, instanceMemory);
+		ctx.destroyBuffer(vertexBuffer, vertexMemory);
+	}
+
+	VkDeviceAddress bufferAddress(BenchContext& ctx, VkBuffer buffer) {
+		VkBufferDeviceAddressInfo addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = buffer;
+		return fn.getBufferAddress(ctx.device, &addressInfo);
+	}
+
+	Structure createStructure(BenchContext& ctx, VkAccelerationStructureTypeKHR type, VkDeviceSize size) {
+		Structure structure;
+		structure.size = size;
+		ctx.createBuffer(size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, structure.buffer, structure.memory);
+
+		VkAccelerationStructureCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		createInfo.buffer = structure.buffer;
+		createInfo.size = size;
+		createInfo.type = type;
+		if (fn.create(ctx.device, &createInfo, nullptr, &structure.handle) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create acceleration structure!");
+		}
+
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = structure.handle;
+		structure.address = fn.getAddress(ctx.device, &addressInfo);
+		return structure;
+	}
+
+	void destroyStructure(BenchContext& ctx, Structure& structure) {
+		if (structure.handle == VK_NULL_HANDLE) return;
+		fn.destroy(ctx.device, structure.handle, nullptr);
+		ctx.destroyBuffer(structure.buffer, structure.memory);
+		structure = Structure{};
+	}
+
+	// Grows the pooled scratch buffer to the arena's peak. Only called between submits, when
+	// the GPU is done with the old one.
+	void reserveScratch(BenchContext& ctx) {
+		VkDeviceSize alignment = arena.offsetAlignment();
+		VkDeviceSize needed = arena.peak() + alignment; // Room to align the base address
+		if (needed <= scratchCapacity) return;
+
+		if (scratchBuffer != VK_NULL_HANDLE) ctx.destroyBuffer(scratchBuffer, scratchMemory);
+		scratchCapacity = std::max(needed, scratchCapacity * 2);
+		ctx.createBuffer(scratchCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratchBuffer, scratchMemory);
+		scratchAddress = accel::alignUp(bufferAddress(ctx, scratchBuffer), alignment);
+	}
+
+	VkAccelerationStructureGeometryKHR triangles(const Mesh& mesh) const {
+		VkAccelerationStructureGeometryKHR geometry{};
+		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+		VkAccelerationStructureGeometryTrianglesDataKHR& data = geometry.geometry.triangles;
+		data.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+		data.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		data.vertexData.deviceAddress = vertexAddress + mesh.firstVertex * 3 * sizeof(float);
+		data.vertexStride = 3 * sizeof(float);
+		data.maxVertex = mesh.vertexCount - 1;
+		data.indexType = VK_INDEX_TYPE_NONE_KHR;
+		return geometry;
+	}
+
+	// Earlier builds and copies finish before this command reads or writes their structures
+	static void buildBarrier(VkCommandBuffer commandBuffer) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+};
+
+
+/*
+* A crowd of skinned characters, see skinning.h, drawn into a shadow map and the color
+* target each frame. With the pre-pass, bench_skin.comp skins every vertex once into a
+* buffer both passes draw from. The baseline skins in the vertex shader of each pass.
+*/
+
+struct SkinnedCrowd {
+	static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+	static const uint32_t SHADOW_SIZE = 1024;
+
+	// Shared by the skinning dispatch and the draws
+	struct Push {
+		scene::Mat4 viewProj;
+		uint32_t vertexCount;
+		uint32_t characterCount;
+	};
+
+	skin::Skeleton skeleton;
+	std::vector<skin::Character> characters;
+	uint32_t vertexCount = 0; // Per character
+	uint32_t indexCount = 0;
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE, indexBuffer = VK_NULL_HANDLE;
+	VkBuffer paletteBuffer = VK_NULL_HANDLE, skinnedBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory vertexMemory = VK_NULL_HANDLE, indexMemory = VK_NULL_HANDLE;
+	VkDeviceMemory paletteMemory = VK_NULL_HANDLE, skinnedMemory = VK_NULL_HANDLE;
+	scene::Mat4* palettes = nullptr; // Host visible and persistently mapped, written before each submit
+
+	VkImage colorImage = VK_NULL_HANDLE, depthImage = VK_NULL_HANDLE, shadowImage = VK_NULL_HANDLE;
+	VkDeviceMemory colorMemory = VK_NULL_HANDLE, depthMemory = VK_NULL_HANDLE, shadowMemory = VK_NULL_HANDLE;
+	VkImageView colorView = VK_NULL_HANDLE, depthView = VK_NULL_HANDLE, shadowView = VK_NULL_HANDLE;
+	VkRenderPass mainPass = VK_NULL_HANDLE, shadowPass = VK_NULL_HANDLE;
+	VkFramebuffer mainFramebuffer = VK_NULL_HANDLE, shadowFramebuffer = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline skinPipeline = VK_NULL_HANDLE;
+	VkPipeline mainPipeline = VK_NULL_HANDLE, shadowPipeline = VK_NULL_HANDLE; // Draw the skinned buffer
+	VkPipeline inlineMainPipeline = VK_NULL_HANDLE, inlineShadowPipeline = VK_NULL_HANDLE; // Skin per pass
+
+	void create(BenchContext& ctx, uint32_t characterCount) {
+		skeleton = skin::humanoid();
+		characters = skin::crowd(characterCount);
+		skin::Mesh mesh = skin::characterMesh(skeleton);
+		vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+		upload(ctx, mesh.vertices.data(), mesh.vertices.size() * sizeof(skin::Vertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			vertexBuffer, vertexMemory);
+		upload(ctx, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			indexBuffer, indexMemory);
+
+		VkDeviceSize paletteSize = characterCount * skin::JOINT_COUNT * sizeof(scene::Mat4);
+		ctx.createBuffer(paletteSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, paletteBuffer, paletteMemory);
+		void* mapped;
+		vkMapMemory(ctx.device, paletteMemory, 0, paletteSize, 0, &mapped);
+		palettes = static_cast<scene::Mat4*>(mapped);
+
+		ctx.createBuffer(static_cast<VkDeviceSize>(vertexCount) * characterCount * 4 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, skinnedBuffer, skinnedMemory);
+
+		ctx.createImage(TARGET_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, colorImage, colorMemory);
+		ctx.createImage(DEPTH_FORMAT, TARGET_WIDTH, TARGET_HEIGHT, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImage, depthMemory);
+		ctx.createImage(DEPTH_FORMAT, SHADOW_SIZE, SHADOW_SIZE, 1,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, shadowImage, shadowMemory);
+		colorView = ctx.createImageView(colorImage, TARGET_FORMAT);
+		depthView = ctx.createImageView(depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		shadowView = ctx.createImageView(shadowImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+		mainPass = createPass(ctx, true);
+		shadowPass = createPass(ctx, false);
+		mainFramebuffer = createFramebuffer(ctx, mainPass, {colorView, depthView}, TARGET_WIDTH);
+		shadowFramebuffer = createFramebuffer(ctx, shadowPass, {shadowView}, SHADOW_SIZE);
+
+		createDescriptors(ctx);
+
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push)};
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+		if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkShaderModule computeModule = ctx.createShaderModule("shaders/bench_skin.comp.spv");
+		VkComputePipelineCreateInfo computeInfo{};
+		computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computeInfo.stage.module = computeModule;
+		computeInfo.stage.pName = "main";
+		computeInfo.layout = pipelineLayout;
+		if (vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &computeInfo, nullptr, &skinPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+		vkDestroyShaderModule(ctx.device, computeModule, nullptr);
+
+		mainPipeline = createPipeline(ctx, mainPass, "shaders/bench_skinned.vert.spv", TARGET_WIDTH);
+		shadowPipeline = createPipeline(ctx, shadowPass, "shaders/bench_skinned.vert.spv", SHADOW_SIZE);
+		inlineMainPipeline = createPipeline(ctx, mainPass, "shaders/bench_skinned_inline.vert.spv", TARGET_WIDTH);
+		inlineShadowPipeline = createPipeline(ctx, shadowPass, "shaders/bench_skinned_inline.vert.spv", SHADOW_SIZE);
+	}
+
+	// Device local, through a staging buffer
+	static void upload(BenchContext& ctx, const void* source, VkDeviceSize size, VkBufferUsageFlags usage,
+		VkBuffer& buffer, VkDeviceMemory& memory) {
+		ctx.createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+		VkBuffer staging;
+		VkDeviceMemory stagingMemory;
+		ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory,
+			memstats::DeviceMemoryCategory::Staging);
+
+		void* data;
+		vkMapMemory(ctx.device, stagingMemory, 0, size, 0, &data);
+		memcpy(data, source, size);
+		vkUnmapMemory(ctx.device, stagingMemory);
+
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkBufferCopy region{0, 0, size};
+			vkCmdCopyBuffer(cmd, staging, buffer, 1, &region);
+		});
+		ctx.destroyBuffer(staging, stagingMemory);
+	}
+
+	// Color and depth, or depth only for the shadow map
+	static VkRenderPass createPass(BenchContext& ctx, bool color) {
+		VkAttachmentDescription attachments[2]{};
+		attachments[0].format = TARGET_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		attachments[1] = attachments[0];
+		attachments[1].format = DEPTH_FORMAT;
+		attachments[1].storeOp = color ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].finalLayout = color ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		VkAttachmentReference depthAttachmentRef{color ? 1u : 0u, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = color ? 1 : 0;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// The previous frame's writes to the same attachments
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = color ? 2 : 1;
+		renderPassInfo.pAttachments = color ? attachments : &attachments[1];
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+		return renderPass;
+	}
+
+	static VkFramebuffer createFramebuffer(BenchContext& ctx, VkRenderPass renderPass, const std::vector<VkImageView>& views, uint32_t size) {
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = size;
+		framebufferInfo.height = size;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(ctx.device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+		return framebuffer;
+	}
+
+	// Vertices, palettes and skinned vertices, for the compute and vertex shaders alike
+	void createDescriptors(BenchContext& ctx) {
+		VkDescriptorSetLayoutBinding bindings[3]{};
+		for (uint32_t i = 0; i < 3; i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 3;
+		layoutInfo.pBindings = bindings;
+		if (vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+
+		VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+		if (vkAllocateDescriptorSets(ctx.device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		VkBuffer buffers[3] = {vertexBuffer, paletteBuffer, skinnedBuffer};
+		VkDescriptorBufferInfo bufferInfos[3];
+		VkWriteDescriptorSet writes[3]{};
+		for (uint32_t i = 0; i < 3; i++) {
+			bufferInfos[i] = VkDescriptorBufferInfo{buffers[i], 0, VK_WHOLE_SIZE};
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(ctx.device, 3, writes, 0, nullptr);
+	}
+
+	// Shaded with bench_city.frag in the main pass, depth only in the shadow pass
+	VkPipeline createPipeline(BenchContext& ctx, VkRenderPass renderPass, const std::string& vertexShader, uint32_t size) {
+		bool color = renderPass == mainPass;
+		VkShaderModule vertModule = ctx.createShaderModule(vertexShader);
+		VkShaderModule fragModule = color ? ctx.createShaderModule("shaders/bench_city.frag.spv") : VK_NULL_HANDLE;
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertModule;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragModule;
+		shaderStages[1].pName = "main";
+
+		// Vertices come from storage buffers by gl_VertexIndex, only the index buffer is bound
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkViewport viewport{0.0f, 0.0f, (float) size, (float) size, 0.0f, 1.0f};
+		VkRect2D scissor{{0, 0}, {size, size}};
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = &viewport;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = color ? 1 : 0;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = color ? 2 : 1;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		if (color) vkDestroyShaderModule(ctx.device, fragModule, nullptr);
+		vkDestroyShaderModule(ctx.device, vertModule, nullptr);
+		return pipeline;
+	}
+
+	// Every character's vertices into skinnedBuffer, once for both passes
+	void recordSkinning(VkCommandBuffer cmd) {
+		// Last frame's draws are done with the buffer before it's overwritten
+		CityScene::memoryBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+		Push push{scene::Mat4{}, vertexCount, static_cast<uint32_t>(characters.size())};
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, skinPipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(cmd, (vertexCount * push.characterCount + 63) / 64, 1, 1);
+
+		CityScene::memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void drawPass(VkCommandBuffer cmd, VkRenderPass renderPass, VkFramebuffer framebuffer, uint32_t size,
+		VkPipeline pipeline, const scene::Mat4& viewProj) {
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = {{0.45f, 0.6f, 0.8f, 1.0f}};
+		clearValues[1].depthStencil = {1.0f, 0};
+		bool color = renderPass == mainPass;
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea = {{0, 0}, {size, size}};
+		renderPassInfo.clearValueCount = color ? 2 : 1;
+		renderPassInfo.pClearValues = color ? clearValues : &clearValues[1];
+
+		Push push{viewProj, vertexCount, static_cast<uint32_t>(characters.size())};
+		vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDrawIndexed(cmd, indexCount, push.characterCount, 0, 0, 0);
+		vkCmdEndRenderPass(cmd);
+	}
+
+	// The shadow map, then the main pass. prepass skins once up front, otherwise both passes
+	// skin in their vertex shaders.
+	void recordFrame(VkCommandBuffer cmd, const scene::Mat4& cameraViewProj, const scene::Mat4& lightViewProj, bool prepass) {
+		if (prepass) recordSkinning(cmd);
+		drawPass(cmd, shadowPass, shadowFramebuffer, SHADOW_SIZE, prepass ? shadowPipeline : inlineShadowPipeline, lightViewProj);
+		drawPass(cmd, mainPass, mainFramebuffer, TARGET_WIDTH, prepass ? mainPipeline : inlineMainPipeline, cameraViewProj);
+	}
+
+	void destroy(BenchContext& ctx) {
+		for (VkPipeline pipeline : {skinPipeline, mainPipeline, shadowPipeline, inlineMainPipeline, inlineShadowPipeline}) {
+			vkDestroyPipeline(ctx.device, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(ctx.device, setLayout, nullptr);
+
+		vkDestroyFramebuffer(ctx.device, mainFramebuffer, nullptr);
+		vkDestroyFramebuffer(ctx.device, shadowFramebuffer, nullptr);
+		vkDestroyRenderPass(ctx.device, mainPass, nullptr);
+		vkDestroyRenderPass(ctx.device, shadowPass, nullptr);
+		for (VkImageView view : {colorView, depthView, shadowView}) vkDestroyImageView(ctx.device, view, nullptr);
+		ctx.destroyImage(colorImage, colorMemory);
+		ctx.destroyImage(depthImage, depthMemory);
+		ctx.destroyImage(shadowImage, shadowMemory);
+
+		vkUnmapMemory(ctx.device, paletteMemory);
+		ctx.destroyBuffer(skinnedBuffer, skinnedMemory);
+		ctx.destroyBuffer(paletteBuffer, paletteMemory);
+		ctx.destroyBuffer(indexBuffer, indexMemory);
+		ctx.destroyBuffer(vertexBuffer, vertexMemory);
+	}
+};
+
+
+/*
+* Scenarios
+*/
+
+struct Scenario {
+	std::string name;
+	std::function<void(BenchContext&, Measurements&)> run;
+};
+
+
+// Cold instance + device creation, the part of initVulkan that doesn't need a window.
+void benchStartup(BenchContext& ctx, Measurements& m) {
+	double begin = nowMs();
+
+	VkInstance instance;
+	BenchContext::createInstance(&instance);
+	double instanceDone = nowMs();
+
+	VkPhysicalDevice physicalDevice = BenchContext::pickPhysicalDevice(instance, ctx.deviceIndex);
+	VkDevice device;
+	BenchContext::createDevice(physicalDevice, BenchContext::findQueueFamily(physicalDevice), &device);
+	double deviceDone = nowMs();
+
+	vkDestroyDevice(device, nullptr);
+	vkDestroyInstance(instance, nullptr);
+
+	m.add("instance_ms", instanceDone - begin, "ms");
+	m.add("device_ms", deviceDone - instanceDone, "ms");
+	m.add("total_ms", deviceDone - begin, "ms");
+}
+
+
+// Host -> staging memcpy, then staging -> device local copy on the queue.
+void benchUpload(BenchContext& ctx, Measurements& m) {
+	const VkDeviceSize size = 64ull * 1024 * 1024;
+
+	VkBuffer staging, target;
+	VkDeviceMemory stagingMemory, targetMemory;
+	ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory,
+		memstats::DeviceMemoryCategory::Staging);
+	ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target, targetMemory);
+
+	std::vector<uint8_t> source(size, 0xAB);
+
+	double begin = nowMs();
+	void* data;
+	vkMapMemory(ctx.device, stagingMemory, 0, size, 0, &data);
+	memcpy(data, source.data(), size);
+	vkUnmapMemory(ctx.device, stagingMemory);
+	double memcpyMs = nowMs() - begin;
+
+	double copyMs = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+		VkBufferCopy region{0, 0, size};
+		vkCmdCopyBuffer(cmd, staging, target, 1, &region);
+	});
+
+	ctx.destroyBuffer(target, targetMemory);
+	ctx.destroyBuffer(staging, stagingMemory);
+
+	double gib = static_cast<double>(size) / (1024.0 * 1024.0 * 1024.0);
+	m.add("memcpy_gib_per_s", gib / (memcpyMs / 1000.0), "GiB/s", true);
+	m.add("copy_gib_per_s", gib / (copyMs / 1000.0), "GiB/s", true);
+	m.add("total_ms", memcpyMs + copyMs, "ms");
+}
+
+
+// Per-draw overhead: the same render pass with 1 to 10k separate draws.
+void benchDrawScaling(BenchContext& ctx, OffscreenTarget& target, Measurements& m) {
+	for (uint32_t drawCount : {1u, 100u, 1000u, 10000u}) {
+		double recordBegin = nowMs();
+		double gpuMs = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			target.recordDraws(cmd, drawCount);
+		});
+		double totalMs = nowMs() - recordBegin;
+
+		std::string prefix = "draws_" + std::to_string(drawCount);
+		m.add(prefix + "_record_ms", totalMs - gpuMs, "ms");
+		m.add(prefix + "_submit_ms", gpuMs, "ms");
+	}
+}
+
+
+// Back to back frames of 1000 draws each, the number we gate deployments on. Past the first
+// frame they must not allocate on the host, the run fails if one does.
+void benchFrames(BenchContext& ctx, OffscreenTarget& target, Measurements& m) {
+	const int frameCount = 60;
+
+	uint64_t frameAllocations = 0;
+
+	double begin = nowMs();
+	for (int i = 0; i < frameCount; i++) {
+		memstats::beginFrame();
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			target.recordDraws(cmd, 1000);
+		});
+		frameAllocations += memstats::endFrame();
+		if (i > 0) memstats::expectAllocationFreeFrame();
+	}
+	double elapsed = nowMs() - begin;
+
+	m.add("frame_ms", elapsed / frameCount, "ms");
+	m.add("frames_per_s", frameCount / (elapsed / 1000.0), "fps", true);
+	m.add("host_allocs_per_frame", static_cast<double>(frameAllocations) / frameCount, "allocs");
+}
+
+
+// The production workload, replayed as fast as the device allows.
+void benchReplay(BenchContext& ctx, const std::vector<uint8_t>& data, Measurements& m) {
+	replay::Replayer replayer(ctx.physicalDevice, ctx.device, ctx.queueFamily, ctx.queue);
+	replay::ReplayStats stats = replayer.run(data);
+
+	m.add("total_ms", stats.totalMs, "ms");
+	if (!stats.frameMs.empty()) {
+		double frameTotal = 0.0;
+		for (double ms : stats.frameMs) frameTotal += ms;
+
+		m.add("frame_ms", frameTotal / stats.frameMs.size(), "ms");
+		m.add("frames_per_s", stats.frameMs.size() / (frameTotal / 1000.0), "fps", true);
+	}
+	m.add("draws", static_cast<double>(stats.draws), "draws");
+	m.add("dispatches", static_cast<double>(stats.dispatches), "dispatches");
+}
+
+
+// Streams a float buffer through a trivial compute shader.
+void benchCompute(BenchContext& ctx, Measurements& m) {
+	const uint32_t count = 16 * 1024 * 1024;
+	const VkDeviceSize size = count * sizeof(float);
+
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	ctx.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	VkDescriptorSetLayout setLayout;
+	if (vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t)};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	VkShaderModule computeModule = ctx.createShaderModule("shaders/bench_compute.comp.spv");
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+	vkDestroyShaderModule(ctx.device, computeModule, nullptr);
+
+	VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	VkDescriptorPool descriptorPool;
+	if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	VkDescriptorSet descriptorSet;
+	vkAllocateDescriptorSets(ctx.device, &allocInfo, &descriptorSet);
+
+	VkDescriptorBufferInfo bufferInfo{buffer, 0, size};
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = descriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(ctx.device, 1, &write, 0, nullptr);
+
+	double ms = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &count);
+		vkCmdDispatch(cmd, (count + 63) / 64, 1, 1);
+	});
+
+	vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+	vkDestroyPipeline(ctx.device, pipeline, nullptr);
+	vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(ctx.device, setLayout, nullptr);
+	ctx.destroyBuffer(buffer, memory);
+
+	m.add("dispatch_ms", ms, "ms");
+	m.add("melements_per_s", count / 1e6 / (ms / 1000.0), "Melem/s", true);
+}
+
+
+// Dense city from street level, Hi-Z culled against drawing every box.
+void benchOcclusion(BenchContext& ctx, Measurements& m) {
+	const uint32_t frameCount = 60;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+
+	CityScene city;
+	city.create(ctx, scene::BOX_MESH);
+
+	double begin = nowMs();
+	for (uint32_t i = 0; i < frameCount; i++) {
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			city.recordUnculledFrame(cmd, scene::streetCamera(i, aspect, TARGET_HEIGHT));
+		});
+	}
+	double unculledMs = (nowMs() - begin) / frameCount;
+
+	uint64_t drawn = 0, disoccluded = 0;
+	begin = nowMs();
+	for (uint32_t i = 0; i < frameCount; i++) {
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			city.recordCulledFrame(cmd, scene::streetCamera(i, aspect, TARGET_HEIGHT), false, 0.0f);
+		});
+		drawn += city.drawnBoxes(0) + city.drawnBoxes(1);
+		disoccluded += city.drawnBoxes(1);
+	}
+	double culledMs = (nowMs() - begin) / frameCount;
+
+	double drawnPerFrame = static_cast<double>(drawn) / frameCount;
+	m.add("frame_ms", culledMs, "ms");
+	m.add("frames_per_s", 1000.0 / culledMs, "fps", true);
+	m.add("unculled_frame_ms", unculledMs, "ms");
+	m.add("speedup", unculledMs / culledMs, "x", true);
+	m.add("drawn_boxes", drawnPerFrame, "boxes");
+	m.add("disoccluded_boxes", static_cast<double>(disoccluded) / frameCount, "boxes");
+	m.add("culled_pct", 100.0 * (1.0 - drawnPerFrame / city.boxCount), "%", true);
+
+	city.destroy(ctx);
+}
+
+
+// The same walk through a city of round towers, LOD picked per tower against always LOD 0.
+// Both sides are occlusion culled, so the difference is LOD alone.
+void benchLod(BenchContext& ctx, Measurements& m) {
+	const uint32_t frameCount = 60;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+	const float errorThreshold = 1.0f; // Pixels
+
+	CityScene city;
+	city.create(ctx, scene::TOWER_MESH);
+
+	double frameMs[2] = {};
+	uint64_t triangles[2] = {};
+	uint64_t switches = 0;
+	for (bool selectLod : {false, true}) {
+		double begin = nowMs();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				city.recordCulledFrame(cmd, scene::streetCamera(i, aspect, TARGET_HEIGHT), selectLod, errorThreshold);
+			});
+			triangles[selectLod] += city.drawnTriangles();
+			if (selectLod && i > 0) switches += city.lodSwitches(); // Frame 0 moves everything off LOD 0
+		}
+		frameMs[selectLod] = (nowMs() - begin) / frameCount;
+	}
+
+	m.add("frame_ms", frameMs[1], "ms");
+	m.add("frames_per_s", 1000.0 / frameMs[1], "fps", true);
+	m.add("lod0_frame_ms", frameMs[0], "ms");
+	m.add("triangles", static_cast<double>(triangles[1]) / frameCount, "tris");
+	m.add("lod0_triangles", static_cast<double>(triangles[0]) / frameCount, "tris");
+	m.add("triangle_reduction_pct", 100.0 * (1.0 - static_cast<double>(triangles[1]) / triangles[0]), "%", true);
+	m.add("lod_switches", static_cast<double>(switches) / (frameCount - 1), "switches");
+
+	city.destroy(ctx);
+}
+
+
+// The unculled city at every sample count the device has for color and depth, into transient
+// attachments. Memory saved is what lazily allocated memory never had to commit.
+void benchMsaa(BenchContext& ctx, Measurements& m) {
+	const uint32_t frameCount = 30;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+	const double mb = 1024.0 * 1024.0;
+
+	CityScene city;
+	city.create(ctx, scene::BOX_MESH);
+
+	VkSampleCountFlags usable = msaa::usableSampleCounts(ctx.properties.limits, true);
+	bool lazy = false;
+	for (VkSampleCountFlagBits samples : {VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT}) {
+		if (!(usable & samples)) continue;
+
+		CityScene::MsaaTarget target = city.createMsaaTarget(ctx, samples);
+		double begin = nowMs();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				city.recordMsaaFrame(cmd, scene::streetCamera(i, aspect, TARGET_HEIGHT), target);
+			});
+		}
+		double frameMs = (nowMs() - begin) / frameCount;
+		VkDeviceSize committed = city.committedBytes(ctx, target);
+		lazy |= target.lazy;
+
+		std::string prefix = std::to_string(samples) + "x_";
+		m.add(prefix + "frame_ms", frameMs, "ms");
+		m.add(prefix + "attachment_mb", target.bytes / mb, "MB");
+		m.add(prefix + "committed_mb", committed / mb, "MB");
+		m.add(prefix + "saved_mb", (target.bytes - committed) / mb, "MB", true);
+
+		city.destroyMsaaTarget(ctx, target);
+	}
+	m.add("lazy_memory", lazy ? 1.0 : 0.0, "bool", true);
+
+	city.destroy(ctx);
+}
+
+
+// The city lit by 100 to 100k point lights, binned on the GPU and on the CPU. The CPU
+// frame includes binning and writing the lists, the GPU frame the three bin passes.
+void benchClustered(BenchContext& ctx, Measurements& m) {
+	const uint32_t frameCount = 20;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+
+	CityScene city;
+	city.create(ctx, scene::BOX_MESH);
+
+	for (uint32_t lightCount : {100u, 1000u, 10000u, 100000u}) {
+		ClusteredLights lighting;
+		lighting.create(ctx, city, lightCount);
+
+		double begin = nowMs();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				lighting.recordGpuFrame(cmd, city, scene::streetCamera(i, aspect, TARGET_HEIGHT));
+			});
+		}
+		double gpuMs = (nowMs() - begin) / frameCount;
+
+		double binMs = 0.0;
+		uint64_t references = 0;
+		begin = nowMs();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			scene::Camera camera = scene::streetCamera(i, aspect, TARGET_HEIGHT);
+			double binBegin = nowMs();
+			lighting.binOnCpu(camera);
+			binMs += nowMs() - binBegin;
+			references += lighting.cpuLists.indices.size();
+
+			ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				lighting.recordCpuFrame(cmd, city, camera);
+			});
+		}
+		double cpuMs = (nowMs() - begin) / frameCount;
+
+		std::string prefix = std::to_string(lightCount) + "_";
+		m.add(prefix + "gpu_frame_ms", gpuMs, "ms");
+		m.add(prefix + "cpu_frame_ms", cpuMs, "ms");
+		m.add(prefix + "cpu_bin_ms", binMs / frameCount, "ms");
+		m.add(prefix + "lights_per_cluster", static_cast<double>(references) / frameCount / clusters::CLUSTER_COUNT, "lights");
+
+		lighting.destroy(ctx);
+	}
+
+	city.destroy(ctx);
+}
+
+
+// Shadow pass time for the spot light atlas, uncached against cached static shadows, and
+// for the cascades.
+void benchShadows(BenchContext& ctx, Measurements& m) {
+	const uint32_t frameCount = 30;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+
+	CityScene city;
+	city.create(ctx, scene::BOX_MESH);
+
+	double frameMs[2] = {};
+	uint64_t refreshes = 0;
+	for (bool cached : {false, true}) {
+		ShadowScene shadow;
+		shadow.create(ctx, city);
+
+		double begin = nowMs();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			shadow.update(scene::streetCamera(i, aspect, TARGET_HEIGHT), i);
+			ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				if (cached) refreshes += shadow.recordCached(cmd, city.boxCount);
+				else shadow.recordUncached(cmd, city.boxCount);
+			});
+		}
+		frameMs[cached] = (nowMs() - begin) / frameCount;
+
+		if (cached) {
+			begin = nowMs();
+			for (uint32_t i = 0; i < frameCount; i++) {
+				shadow.update(scene::streetCamera(i, aspect, TARGET_HEIGHT), i);
+				ctx.submitAndWait([&](VkCommandBuffer cmd) {
+					shadow.recordCascades(cmd, city.boxCount);
+				});
+			}
+			m.add("cascades_ms", (nowMs() - begin) / frameCount, "ms");
+			m.add("multiview", shadow.multiview ? 1.0 : 0.0, "bool", true);
+		}
+
+		shadow.destroy(ctx);
+	}
+
+	m.add("cached_ms", frameMs[1], "ms");
+	m.add("uncached_ms", frameMs[0], "ms");
+	m.add("speedup", frameMs[0] / frameMs[1], "x", true);
+	// The first frame draws every tile, the rest only what moved
+	m.add("static_refreshes", static_cast<double>(refreshes) / frameCount, "tiles");
+
+	city.destroy(ctx);
+}
+
+
+// Rings and spokes: edges at every angle and spacing, the case the edge pass is for.
+std::vector<uint32_t> upscaleTestPattern(uint32_t width, uint32_t height) {
+	std::vector<uint32_t> pixels(width * height);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			float dx = x - width / 2.0f;
+			float dy = y - height / 2.0f;
+			int ring = static_cast<int>(std::sqrt(dx * dx + dy * dy) / 6.0f);
+			int spoke = static_cast<int>((std::atan2(dy, dx) + 3.14159265f) * 24.0f / 6.2831853f);
+			uint32_t level = ((ring + spoke) & 1) ? 0xE0 : 0x20;
+			pixels[y * width + x] = 0xFF000000 | (level << 16) | ((level * 3 / 4) << 8) | (x * 255 / width);
+		}
+	}
+	return pixels;
+}
+
+
+// Edge and sharpen passes from upscaler.h, each timed on its own, at common output
+// resolutions upscaled from 2/3 of the size.
+void benchUpscale(BenchContext& ctx, Measurements& m) {
+	struct Resolution {
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+	};
+	const Resolution resolutions[] = {{"720p", 1280, 720}, {"1080p", 1920, 1080}, {"1440p", 2560, 1440}};
+	const VkFormat sourceFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0] = {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	bindings[1] = {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout setLayout;
+	if (vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(upscale::EdgePush)};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	auto createPipeline = [&](const std::string& path) {
+		VkShaderModule module = ctx.createShaderModule(path);
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = module;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+		vkDestroyShaderModule(ctx.device, module, nullptr);
+		return pipeline;
+	};
+	VkPipeline edgePipeline = createPipeline("shaders/upscale_edge.comp.spv");
+	VkPipeline sharpenPipeline = createPipeline("shaders/sharpen.comp.spv");
+
+	// texelFetch ignores filtering, the sampler only has to exist
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	VkSampler sampler;
+	if (vkCreateSampler(ctx.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create sampler!");
+	}
+
+	VkDescriptorPoolSize poolSizes[2] = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2}, {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2}};
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 2;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkDescriptorPool descriptorPool;
+	if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	for (const Resolution& resolution : resolutions) {
+		uint32_t sourceWidth = resolution.width * 2 / 3;
+		uint32_t sourceHeight = resolution.height * 2 / 3;
+
+		// source -> edge -> upscaled -> sharpen -> output
+		VkImage images[3];
+		VkDeviceMemory memories[3];
+		VkImageView views[3];
+		ctx.createImage(sourceFormat, sourceWidth, sourceHeight, 1,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, images[0], memories[0]);
+		ctx.createImage(upscale::IMAGE_FORMAT, resolution.width, resolution.height, 1,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, images[1], memories[1]);
+		ctx.createImage(upscale::IMAGE_FORMAT, resolution.width, resolution.height, 1,
+			VK_IMAGE_USAGE_STORAGE_BIT, images[2], memories[2]);
+		views[0] = ctx.createImageView(images[0], sourceFormat);
+		views[1] = ctx.createImageView(images[1], upscale::IMAGE_FORMAT);
+		views[2] = ctx.createImageView(images[2], upscale::IMAGE_FORMAT);
+
+		std::vector<uint32_t> pixels = upscaleTestPattern(sourceWidth, sourceHeight);
+		VkDeviceSize stagingSize = pixels.size() * sizeof(uint32_t);
+
+		VkBuffer staging;
+		VkDeviceMemory stagingMemory;
+		ctx.createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory,
+			memstats::DeviceMemoryCategory::Staging);
+
+		void* data;
+		vkMapMemory(ctx.device, stagingMemory, 0, stagingSize, 0, &data);
+		memcpy(data, pixels.data(), stagingSize);
+		vkUnmapMemory(ctx.device, stagingMemory);
+
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkImageMemoryBarrier barriers[3]{};
+			for (uint32_t i = 0; i < 3; i++) {
+				barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barriers[i].dstAccessMask = i == 0 ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+				barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barriers[i].newLayout = i == 0 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+				barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barriers[i].image = images[i];
+				barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+			}
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 3, barriers);
+
+			VkBufferImageCopy region{};
+			region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			region.imageExtent = {sourceWidth, sourceHeight, 1};
+			vkCmdCopyBufferToImage(cmd, staging, images[0], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+			barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+		});
+		ctx.destroyBuffer(staging, stagingMemory);
+
+		VkDescriptorSetLayout setLayouts[2] = {setLayout, setLayout};
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 2;
+		allocInfo.pSetLayouts = setLayouts;
+
+		VkDescriptorSet sets[2];
+		vkAllocateDescriptorSets(ctx.device, &allocInfo, sets);
+
+		VkDescriptorImageInfo imageInfos[4] = {
+			{sampler, views[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{VK_NULL_HANDLE, views[1], VK_IMAGE_LAYOUT_GENERAL},
+			{sampler, views[1], VK_IMAGE_LAYOUT_GENERAL},
+			{VK_NULL_HANDLE, views[2], VK_IMAGE_LAYOUT_GENERAL}
+		};
+		VkWriteDescriptorSet writes[4]{};
+		for (uint32_t i = 0; i < 4; i++) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[i / 2];
+			writes[i].dstBinding = i % 2;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = bindings[i % 2].descriptorType;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+		vkUpdateDescriptorSets(ctx.device, 4, writes, 0, nullptr);
+
+		int32_t width = static_cast<int32_t>(resolution.width);
+		int32_t height = static_cast<int32_t>(resolution.height);
+		uint32_t groupsX = upscale::groupCount(resolution.width);
+		uint32_t groupsY = upscale::groupCount(resolution.height);
+
+		upscale::EdgePush edge{{static_cast<int32_t>(sourceWidth), static_cast<int32_t>(sourceHeight)}, {width, height}};
+		double edgeMs = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, edgePipeline);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[0], 0, nullptr);
+			vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(edge), &edge);
+			vkCmdDispatch(cmd, groupsX, groupsY, 1);
+		});
+
+		upscale::SharpenPush sharpen{{width, height}, upscale::settings(upscale::Preset::Quality).sharpness, 0.0f};
+		double sharpenMs = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, sharpenPipeline);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[1], 0, nullptr);
+			vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sharpen), &sharpen);
+			vkCmdDispatch(cmd, groupsX, groupsY, 1);
+		});
+
+		std::string name = resolution.name;
+		m.add(name + "_edge_ms", edgeMs, "ms");
+		m.add(name + "_sharpen_ms", sharpenMs, "ms");
+		m.add(name + "_mpixels_per_s", resolution.width * resolution.height / 1e6 / ((edgeMs + sharpenMs) / 1000.0), "Mpix/s", true);
+
+		vkResetDescriptorPool(ctx.device, descriptorPool, 0);
+		for (uint32_t i = 0; i < 3; i++) {
+			vkDestroyImageView(ctx.device, views[i], nullptr);
+			ctx.destroyImage(images[i], memories[i]);
+		}
+	}
+
+	vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+	vkDestroySampler(ctx.device, sampler, nullptr);
+	vkDestroyPipeline(ctx.device, sharpenPipeline, nullptr);
+	vkDestroyPipeline(ctx.device, edgePipeline, nullptr);
+	vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(ctx.device, setLayout, nullptr);
+}
+
+
+// BVH over a million props: the SAH build on every core against one thread, refitting after
+// 1% of the props move, and frustum culling, picking and proximity queries. CPU only.
+void benchBvh(BenchContext&, Measurements& m) {
+	const uint32_t primitiveCount = 1000000;
+	const uint32_t movedEvery = 100;
+	const uint32_t cullFrames = 20;
+	const uint32_t queryCount = 100000;
+	const float proximityRadius = 10.0f;
+	const float aspect = static_cast<float>(TARGET_WIDTH) / TARGET_HEIGHT;
+
+	std::vector<scene::Box> props = scene::props(primitiveCount);
+	std::vector<bvh::Aabb> bounds(props.size());
+	for (size_t i = 0; i < props.size(); i++) bounds[i] = bvh::bounds(props[i]);
+
+	jobs::JobSystem pool;
+	bvh::Tree tree;
+	double begin = nowMs();
+	tree.build(bounds, pool);
+	double buildMs = nowMs() - begin;
+
+	double serialMs;
+	{
+		jobs::JobSystem serial(1);
+		bvh::Tree serialTree;
+		begin = nowMs();
+		serialTree.build(bounds, serial);
+		serialMs = nowMs() - begin;
+	}
+
+	m.add("build_ms", buildMs, "ms");
+	m.add("build_1_thread_ms", serialMs, "ms");
+	m.add("build_speedup", serialMs / buildMs, "x", true);
+	m.add("build_mprims_per_s", primitiveCount / buildMs / 1000.0, "Mprims/s", true);
+	m.add("threads", pool.threadCount(), "threads");
+	m.add("sah_cost", tree.sahCost(), "tests");
+
+	// Every 100th prop drifts down its street, the rest stay where they were built
+	std::vector<uint32_t> moved;
+	for (uint32_t i = 0; i < primitiveCount; i += movedEvery) {
+		moved.push_back(i);
+		bounds[i].min[2] += 1.5f;
+		bounds[i].max[2] += 1.5f;
+	}
+
+	begin = nowMs();
+	tree.refit(bounds, moved);
+	m.add("refit_ms", nowMs() - begin, "ms");
+
+	begin = nowMs();
+	tree.refit(bounds);
+	m.add("full_refit_ms", nowMs() - begin, "ms");
+
+	// Queries are generated up front so only the traversal is timed
+	std::vector<scene::Mat4> views;
+	for (uint32_t i = 0; i < cullFrames; i++) views.push_back(scene::streetCamera(i, aspect, TARGET_HEIGHT).viewProj);
+
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> ground(0.0f, scene::CITY_BLOCKS * scene::BLOCK_SIZE);
+	std::uniform_real_distribution<float> height(0.0f, 40.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<scene::Vec3> points(queryCount), directions(queryCount);
+	for (uint32_t i = 0; i < queryCount; i++) {
+		points[i] = scene::Vec3{ground(rng), height(rng), ground(rng)};
+		directions[i] = scene::normalize(scene::Vec3{unit(rng), unit(rng), unit(rng)});
+	}
+
+	std::vector<uint32_t> found;
+	uint64_t visible = 0;
+	begin = nowMs();
+	for (const scene::Mat4& viewProj : views) {
+		tree.cull(viewProj, found);
+		visible += found.size();
+	}
+	m.add("cull_ms", (nowMs() - begin) / cullFrames, "ms");
+	m.add("visible", static_cast<double>(visible) / cullFrames, "props");
+
+	uint32_t hits = 0;
+	begin = nowMs();
+	for (uint32_t i = 0; i < queryCount; i++) {
+		bvh::Tree::Hit hit;
+		hits += tree.pick(points[i], directions[i], std::numeric_limits<float>::max(), hit);
+	}
+	m.add("pick_mrays_per_s", queryCount / (nowMs() - begin) / 1000.0, "Mrays/s", true);
+	m.add("pick_hit_rate", static_cast<double>(hits) / queryCount, "ratio");
+
+	uint64_t neighbours = 0;
+	begin = nowMs();
+	for (uint32_t i = 0; i < queryCount; i++) {
+		tree.within(points[i], proximityRadius, found);
+		neighbours += found.size();
+	}
+	m.add("proximity_mqueries_per_s", queryCount / (nowMs() - begin) / 1000.0, "Mqueries/s", true);
+	m.add("neighbours", static_cast<double>(neighbours) / queryCount, "props");
+}
+
+
+// Acceleration structures where the device has them: a BLAS per mesh variant built in one
+// batch against a submit each, compaction, and the city's TLAS rebuilt every
+// TLAS_REBUILD_INTERVAL frames and updated in place in between as traffic moves.
+void benchRayTracing(BenchContext& ctx, Measurements& m) {
+	m.add("supported", ctx.accelerationStructures ? 1.0 : 0.0, "bool", true);
+	if (!ctx.accelerationStructures) return;
+
+	const uint32_t meshVariants = 64;
+	const uint32_t carCount = 2000;
+	const uint32_t frameCount = 2 * accel::TLAS_REBUILD_INTERVAL;
+
+	// The box for cars, then towers of 4 to 66 sides for buildings
+	std::vector<scene::LodLevel> shapes = {scene::cityMeshes().lods[0]};
+	for (uint32_t segments = 4; shapes.size() < meshVariants; segments++) {
+		shapes.push_back(scene::LodLevel{segments * 9, segments, 0.0f, 0});
+	}
+
+	std::vector<scene::Box> boxes = scene::city(scene::TOWER_MESH);
+	uint32_t buildingCount = static_cast<uint32_t>(boxes.size());
+	std::vector<uint32_t> meshOf(buildingCount + carCount, 0);
+	for (uint32_t i = 0; i < buildingCount; i++) meshOf[i] = 1 + i % (meshVariants - 1);
+	boxes.resize(buildingCount + carCount);
+
+	RayTracingScene rt;
+	rt.create(ctx, shapes, buildingCount + carCount);
+
+	double separateMs = rt.buildBlases(ctx, false);
+	VkDeviceSize separateScratch = rt.arena.peak();
+	// The total scratch one batch would take with its own scratch buffer per build, against the pool
+	VkDeviceSize requestedBefore = rt.arena.requested();
+	double batchedMs = rt.buildBlases(ctx, true);
+	VkDeviceSize batchedScratch = rt.arena.peak();
+	VkDeviceSize batchRequested = rt.arena.requested() - requestedBefore;
+	double compactMs = rt.compact(ctx);
+
+	double buildMs = 0.0, updateMs = 0.0;
+	uint32_t builds = 0, updates = 0;
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		std::vector<scene::Box> cars = scene::traffic(carCount, frame);
+		std::copy(cars.begin(), cars.end(), boxes.begin() + buildingCount);
+
+		bool rebuild = accel::rebuildTlas(frame);
+		double elapsed = rt.buildTlas(ctx, boxes, meshOf, !rebuild);
+		if (rebuild) {
+			buildMs += elapsed;
+			builds++;
+		} else {
+			updateMs += elapsed;
+			updates++;
+		}
+	}
+
+	double kib = 1024.0;
+	m.add("blas_count", static_cast<double>(shapes.size()), "meshes");
+	m.add("blas_separate_ms", separateMs, "ms");
+	m.add("blas_batched_ms", batchedMs, "ms");
+	m.add("blas_batch_speedup", separateMs / batchedMs, "x", true);
+	m.add("blas_separate_scratch_kib", separateScratch / kib, "KiB");
+	m.add("blas_batched_scratch_kib", batchedScratch / kib, "KiB");
+	m.add("compact_ms", compactMs, "ms");
+	m.add("blas_kib", rt.compaction.builtBytes / kib, "KiB");
+	m.add("blas_compacted_kib", rt.compaction.compactedBytes / kib, "KiB");
+	m.add("compaction_savings_pct", 100.0 * rt.compaction.savings(), "%", true);
+	m.add("tlas_instances", static_cast<double>(boxes.size()), "instances");
+	m.add("tlas_build_ms", buildMs / builds, "ms");
+	m.add("tlas_update_ms", updateMs / updates, "ms");
+	m.add("tlas_update_speedup", (buildMs / builds) / (updateMs / updates), "x", true);
+	m.add("scratch_pool_kib", rt.arena.peak() / kib, "KiB");
+	m.add("scratch_unpooled_kib", batchRequested / kib, "KiB");
+
+	rt.destroy(ctx);
+}
+
+
+// The primitives of compute_primitives.h, each checked against the CPU: reduce, exclusive
+// scan and compaction of 4M elements, and a radix sort of 1M key-value pairs.
+void benchPrimitives(BenchContext& ctx, Measurements& m) {
+	const uint32_t count = 4 * 1024 * 1024;
+	const uint32_t sortCount = 1024 * 1024;
+	const VkDeviceSize bytes = count * sizeof(uint32_t);
+	const VkDeviceSize sortBytes = sortCount * sizeof(uint32_t);
+
+	prims::Config config = prims::chooseConfig(ctx.physicalDevice, accel::instanceApiVersion());
+	prims::Primitives primitives;
+	primitives.create(ctx.device, config, readFile(prims::shaderPath(config)));
+
+	// Small values so the sums mean something, about half of them zero for compaction
+	std::mt19937 rng(7);
+	std::vector<uint32_t> values(count);
+	for (uint32_t& value : values) value = rng() % 2 == 0 ? 0 : rng() % 256;
+	std::vector<uint32_t> keys(sortCount);
+	for (uint32_t& key : keys) key = rng();
+	std::vector<uint32_t> indices(sortCount);
+	std::iota(indices.begin(), indices.end(), 0u);
+
+	VkDeviceSize scratchBytes = std::max({
+		primitives.reduceScratchBytes(count),
+		primitives.scanScratchBytes(count),
+		primitives.compactScratchBytes(count),
+		primitives.sortScratchBytes(sortCount)
+	});
+
+	const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkBuffer input, output, sortValues, result, scratch, staging;
+	VkDeviceMemory inputMemory, outputMemory, sortValuesMemory, resultMemory, scratchMemory, stagingMemory;
+	ctx.createBuffer(bytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, input, inputMemory);
+	ctx.createBuffer(bytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, output, outputMemory);
+	ctx.createBuffer(sortBytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sortValues, sortValuesMemory);
+	ctx.createBuffer(sizeof(uint32_t), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result, resultMemory);
+	ctx.createBuffer(scratchBytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratch, scratchMemory);
+	ctx.createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory,
+		memstats::DeviceMemoryCategory::Staging);
+
+	void* data;
+	vkMapMemory(ctx.device, stagingMemory, 0, bytes, 0, &data);
+	uint32_t* mapped = static_cast<uint32_t*>(data);
+
+	// Through staging, so the primitives run on device local memory
+	auto upload = [&](const std::vector<uint32_t>& source, VkBuffer buffer) {
+		memcpy(mapped, source.data(), source.size() * sizeof(uint32_t));
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkBufferCopy region{0, 0, source.size() * sizeof(uint32_t)};
+			vkCmdCopyBuffer(cmd, staging, buffer, 1, &region);
+		});
+	};
+	auto download = [&](VkBuffer buffer, uint32_t elements) {
+		ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			VkBufferCopy region{0, 0, elements * sizeof(uint32_t)};
+			vkCmdCopyBuffer(cmd, buffer, staging, 1, &region);
+		});
+		return std::vector<uint32_t>(mapped, mapped + elements);
+	};
+	// The barriers order the op after the upload and before the download
+	auto run = [&](const std::function<void(VkCommandBuffer)>& record) {
+		primitives.reset();
+		return ctx.submitAndWait([&](VkCommandBuffer cmd) {
+			prims::Primitives::barrier(cmd);
+			record(cmd);
+			prims::Primitives::barrier(cmd);
+		});
+	};
+
+	prims::Span inputSpan{input, 0, bytes};
+	prims::Span outputSpan{output, 0, bytes};
+	prims::Span resultSpan{result, 0, sizeof(uint32_t)};
+	prims::Span scratchSpan{scratch, 0, scratchBytes};
+
+	upload(values, input);
+	double reduceMs = run([&](VkCommandBuffer cmd) { primitives.reduce(cmd, inputSpan, resultSpan, count, scratchSpan); });
+	uint32_t sum = 0;
+	for (uint32_t value : values) sum += value;
+	if (download(result, 1)[0] != sum) {
+		throw std::runtime_error("compute primitives reduce mismatch!");
+	}
+
+	double scanMs = run([&](VkCommandBuffer cmd) { primitives.exclusiveScan(cmd, inputSpan, outputSpan, count, scratchSpan); });
+	std::vector<uint32_t> scanned = download(output, count);
+	for (uint32_t i = 0, prefix = 0; i < count; prefix += values[i], i++) {
+		if (scanned[i] != prefix) throw std::runtime_error("compute primitives scan mismatch!");
+	}
+
+	double compactMs = run([&](VkCommandBuffer cmd) { primitives.compact(cmd, inputSpan, outputSpan, resultSpan, count, scratchSpan); });
+	std::vector<uint32_t> kept;
+	std::copy_if(values.begin(), values.end(), std::back_inserter(kept), [](uint32_t value) { return value != 0; });
+	uint32_t keptCount = download(result, 1)[0];
+	if (keptCount != kept.size() || download(output, keptCount) != kept) {
+		throw std::runtime_error("compute primitives compaction mismatch!");
+	}
+
+	upload(keys, input);
+	upload(indices, sortValues);
+	double sortMs = run([&](VkCommandBuffer cmd) {
+		primitives.sortPairs(cmd, prims::Span{input, 0, sortBytes}, prims::Span{sortValues, 0, sortBytes}, sortCount, scratchSpan);
+	});
+	std::vector<uint32_t> order = indices;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+	std::vector<uint32_t> sortedKeys = download(input, sortCount);
+	if (download(sortValues, sortCount) != order) {
+		throw std::runtime_error("compute primitives sort mismatch!");
+	}
+	for (uint32_t i = 0; i < sortCount; i++) {
+		if (sortedKeys[i] != keys[order[i]]) throw std::runtime_error("compute primitives sort mismatch!");
+	}
+
+	vkUnmapMemory(ctx.device, stagingMemory);
+	ctx.destroyBuffer(staging, stagingMemory);
+	ctx.destroyBuffer(scratch, scratchMemory);
+	ctx.destroyBuffer(result, resultMemory);
+	ctx.destroyBuffer(sortValues, sortValuesMemory);
+	ctx.destroyBuffer(output, outputMemory);
+	ctx.destroyBuffer(input, inputMemory);
+	primitives.destroy();
+
+	auto rate = [](uint32_t elements, double ms) { return elements / 1e6 / (ms / 1000.0); };
+	m.add("workgroup_size", config.workgroupSize, "invocations");
+	m.add("subgroups", config.subgroups ? 1.0 : 0.0, "bool", true);
+	m.add("reduce_ms", reduceMs, "ms");
+	m.add("reduce_melements_per_s", rate(count, reduceMs), "Melem/s", true);
+	m.add("scan_ms", scanMs, "ms");
+	m.add("scan_melements_per_s", rate(count, scanMs), "Melem/s", true);
+	m.add("compact_ms", compactMs, "ms");
+	m.add("compact_melements_per_s", rate(count, compactMs), "Melem/s", true);
+	m.add("sort_ms", sortMs, "ms");
+	m.add("sort_melements_per_s", rate(sortCount, sortMs), "Melem/s", true);
+	m.add("scratch_mb", scratchBytes / (1024.0 * 1024.0), "MB");
+}
+
+
+// A crowd of 2048 walking characters: joint palettes on the job system against one thread,
+// the compute skinning pass alone, and shadow plus main pass frames with the pre-pass against
+// skinning in each pass's vertex shader.
+void benchSkinning(BenchContext& ctx, Measurements& m) {
+	const uint32_t characterCount = 2048;
+	const uint32_t frames = 20;
+	const float dt = 1.0f / 60.0f;
+
+	SkinnedCrowd crowd;
+	crowd.create(ctx, characterCount);
+
+	// Joint palettes straight into the mapped buffer, on every thread and on one
+	jobs::JobSystem pool;
+	double begin = nowMs();
+	for (uint32_t frame = 0; frame < frames; frame++) {
+		skin::animate(pool, crowd.skeleton, crowd.characters, frame * dt, crowd.palettes);
+	}
+	double animateMs = (nowMs() - begin) / frames;
+	double serialMs;
+	{
+		jobs::JobSystem serial(1);
+		begin = nowMs();
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			skin::animate(serial, crowd.skeleton, crowd.characters, frame * dt, crowd.palettes);
+		}
+		serialMs = (nowMs() - begin) / frames;
+	}
+
+	// The camera looks over the crowd from a corner, the light from high up the other side
+	float extent = crowd.characters.back().position.x + 1.0f;
+	scene::Vec3 center{extent * 0.5f, 0.0f, extent * 0.5f};
+	scene::Vec3 up{0.0f, 1.0f, 0.0f};
+	scene::Mat4 cameraViewProj = scene::perspective(1.0f, 1.0f, 0.5f, 500.0f) *
+		scene::lookAt(scene::Vec3{-10.0f, 25.0f, -10.0f}, center, up);
+	float radius = extent;
+	scene::Mat4 lightViewProj = scene::orthographic(-radius, radius, -radius, radius, 1.0f, 200.0f) *
+		scene::lookAt(center + scene::Vec3{30.0f, 60.0f, 20.0f}, center, up);
+
+	// Each frame poses the crowd on the CPU, then draws the shadow map and the main pass
+	auto run = [&](bool prepass) {
+		double total = 0.0;
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			skin::animate(pool, crowd.skeleton, crowd.characters, frame * dt, crowd.palettes);
+			total += ctx.submitAndWait([&](VkCommandBuffer cmd) {
+				crowd.recordFrame(cmd, cameraViewProj, lightViewProj, prepass);
+			});
+		}
+		return total / frames;
+	};
+	double prepassMs = run(true);
+	double inlineMs = run(false);
+
+	double skinMs = 0.0;
+	for (uint32_t frame = 0; frame < frames; frame++) {
+		skinMs += ctx.submitAndWait([&](VkCommandBuffer cmd) { crowd.recordSkinning(cmd); });
+	}
+	skinMs /= frames;
+
+	uint64_t skinnedVertices = static_cast<uint64_t>(crowd.vertexCount) * characterCount;
+	crowd.destroy(ctx);
+
+	m.add("characters", characterCount, "count", true);
+	m.add("skinned_vertices", static_cast<double>(skinnedVertices), "count");
+	m.add("animate_ms", animateMs, "ms");
+	m.add("animate_1_thread_ms", serialMs, "ms");
+	m.add("animate_speedup", serialMs / animateMs, "x", true);
+	m.add("animate_threads", pool.threadCount(), "threads");
+	m.add("skin_pass_ms", skinMs, "ms");
+	m.add("skin_mvertices_per_s", skinnedVertices / 1e6 / (skinMs / 1000.0), "Mvert/s", true);
+	m.add("prepass_frame_ms", prepassMs, "ms");
+	m.add("inline_frame_ms", inlineMs, "ms");
+	m.add("prepass_speedup", inlineMs / prepassMs, "x", true);
+	m.add("frames_per_s", 1000.0 / (animateMs + prepassMs), "fps", true);
+}
+
+
+// Tenants of the sessions scenario: different resolutions and scene sizes, one with double weight
+struct SessionSpec {
+	uint32_t width;
+	uint32_t height;
+	uint32_t drawsPerFrame;
+	uint32_t weight;
+};
+
+const SessionSpec SESSION_MIX[] = {
+	{1280, 720, 1000, 1},
+	{640, 480, 500, 1},
+	{1920, 1080, 200, 2},
+	{256, 256, 2000, 1},
+};
+const uint32_t SESSION_MIX_SIZE = sizeof(SESSION_MIX) / sizeof(SESSION_MIX[0]);
+const uint32_t SESSION_FRAMES = 30;
+const VkDeviceSize SESSION_BUDGET = 64ull * 1024 * 1024;
+
+
+std::string benchExecutable() {
+	char path[4096];
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if (length <= 0) {
+		throw std::runtime_error("failed to find the bench executable!");
+	}
+	path[length] = '\0';
+	return path;
+}
+
+
+// One tenant as its own process, the way sessions run without a render server: its own
+// instance and device. Prints when rendering started and ended, and how long init took.
+int runSessionWorker(int deviceIndex, uint32_t specIndex) {
+	const SessionSpec& spec = SESSION_MIX[specIndex % SESSION_MIX_SIZE];
+
+	try {
+		BenchContext ctx;
+		double initBegin = nowMs();
+		ctx.init(deviceIndex);
+		RenderServer renderServer;
+		renderServer.create(ctx);
+		renderServer.addSession(ctx, spec.width, spec.height, spec.drawsPerFrame, spec.weight, SESSION_BUDGET);
+		double initMs = nowMs() - initBegin;
+
+		double begin = nowMs();
+		renderServer.run(ctx, SESSION_FRAMES);
+		double end = nowMs();
+
+		renderServer.destroy(ctx);
+		ctx.cleanup();
+
+		// steady_clock is system wide, the parent lines the workers up on it
+		printf("%.6f %.6f %.6f\n", begin, end, initMs);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+// 1 to 8 mixed sessions on this process's device through the render server, against the
+// same sessions as one process each. Process throughput counts from the first worker
+// starting to render to the last one finishing, so their instance and device creation is
+// left out and reported on its own.
+void benchSessions(BenchContext& ctx, Measurements& m) {
+	std::string executable = benchExecutable();
+
+	for (uint32_t sessionCount : {1u, 2u, 4u, 8u}) {
+		RenderServer renderServer;
+		renderServer.create(ctx);
+		for (uint32_t i = 0; i < sessionCount; i++) {
+			const SessionSpec& spec = SESSION_MIX[i % SESSION_MIX_SIZE];
+			renderServer.addSession(ctx, spec.width, spec.height, spec.drawsPerFrame, spec.weight, SESSION_BUDGET);
+		}
+
+		double begin = nowMs();
+		renderServer.run(ctx, SESSION_FRAMES);
+		double sharedMs = nowMs() - begin;
+		double fairness = renderServer.contendedFairness;
+		renderServer.destroy(ctx);
+
+		std::vector<FILE*> workers;
+		for (uint32_t i = 0; i < sessionCount; i++) {
+			std::string command = "'" + executable + "' --device " + std::to_string(ctx.deviceIndex) +
+				" --session-worker " + std::to_string(i);
+			FILE* worker = popen(command.c_str(), "r");
+			if (worker == nullptr) {
+				throw std::runtime_error("failed to start session worker!");
+			}
+			workers.push_back(worker);
+		}
+
+		double firstBegin = 0.0, lastEnd = 0.0, initTotal = 0.0;
+		bool failed = false;
+		for (uint32_t i = 0; i < sessionCount; i++) {
+			double workerBegin = 0.0, workerEnd = 0.0, initMs = 0.0;
+			failed |= fscanf(workers[i], "%lf %lf %lf", &workerBegin, &workerEnd, &initMs) != 3;
+			failed |= pclose(workers[i]) != 0;
+
+			firstBegin = i == 0 ? workerBegin : std::min(firstBegin, workerBegin);
+			lastEnd = std::max(lastEnd, workerEnd);
+			initTotal += initMs;
+		}
+		if (failed) {
+			throw std::runtime_error("session worker failed!");
+		}
+
+		double frames = static_cast<double>(sessionCount) * SESSION_FRAMES;
+		double sharedFps = frames / (sharedMs / 1000.0);
+		double processFps = frames / ((lastEnd - firstBegin) / 1000.0);
+
+		std::string prefix = std::to_string(sessionCount);
+		m.add(prefix + "_shared_fps", sharedFps, "fps", true);
+		m.add(prefix + "_process_fps", processFps, "fps", true);
+		m.add(prefix + "_scaling", sharedFps / processFps, "x", true);
+		m.add(prefix + "_process_init_ms", initTotal / sessionCount, "ms");
+		m.add(prefix + "_fairness", fairness, "index", true);
+	}
+}
+
+
+// What a warm start client asks for, see warm_daemon.h
+const warm::Job WARM_JOB = {1280, 720, 1000, 1};
+const uint32_t WARM_JOBS = 5;
+
+
+// The job as one render session, its last frame read back into out. Returns the time taken.
+float renderJob(BenchContext& ctx, VkPipelineCache cache, const warm::Job& job, void* out) {
+	double begin = nowMs();
+
+	RenderServer renderServer;
+	renderServer.create(ctx, cache);
+
+	// A job over its budget throws from addSession() or readback(). The daemon lives on, so
+	// the server goes on every path.
+	try {
+		uint32_t id = renderServer.addSession(ctx, job.width, job.height, job.drawsPerFrame, 1, SESSION_BUDGET);
+		renderServer.run(ctx, job.frames);
+		renderServer.readback(ctx, id, out);
+	} catch (...) {
+		vkDeviceWaitIdle(ctx.device);
+		renderServer.destroy(ctx);
+		throw;
+	}
+	renderServer.destroy(ctx);
+
+	return static_cast<float>(nowMs() - begin);
+}
+
+
+// Keeps the context and a pipeline cache warm and renders jobs from clients until one asks
+// it to shut down. Prints "ready <init ms>" once it accepts jobs.
+int runDaemon(int deviceIndex, const std::string& socketPath) {
+	try {
+		double initBegin = nowMs();
+		BenchContext ctx;
+		ctx.init(deviceIndex);
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		VkPipelineCache cache;
+		if (vkCreatePipelineCache(ctx.device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		// Fills the cache with the job pipeline before the first client shows up
+		RenderServer warmup;
+		warmup.create(ctx, cache);
+		warmup.destroy(ctx);
+
+		int listenFd = warm::listenOn(socketPath);
+		printf("ready %.6f\n", nowMs() - initBegin);
+		fflush(stdout);
+
+		bool running = true;
+		while (running) {
+			int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client < 0) continue;
+			warm::setReceiveTimeout(client, warm::CLIENT_TIMEOUT_MS);
+
+			warm::Job job;
+			int frameFd = -1;
+			warm::Reply reply{1, 0.0f};
+			if (warm::receiveJob(client, job, frameFd)) {
+				if (job.frames == 0) {
+					running = false;
+					reply.status = 0;
+				} else if (frameFd >= 0) {
+					size_t bytes = warm::frameBytes(job);
+					void* frame = warm::mapFrameMemory(frameFd, bytes);
+					if (frame != nullptr) {
+						// A bad job fails alone, the daemon keeps serving
+						try {
+							reply.renderMs = renderJob(ctx, cache, job, frame);
+							reply.status = 0;
+						} catch (const std::exception& e) {
+							std::cerr << "job failed: " << e.what() << std::endl;
+						}
+						munmap(frame, bytes);
+					}
+				}
+			}
+
+			if (frameFd >= 0) close(frameFd);
+			warm::sendReply(client, reply);
+			close(client);
+		}
+
+		close(listenFd);
+		unlink(socketPath.c_str());
+		vkDestroyPipelineCache(ctx.device, cache, nullptr);
+		ctx.cleanup();
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+// Short lived client: one job through the daemon. Prints the socket round trip and the
+// daemon's render time.
+int runDaemonJob(const std::string& socketPath) {
+	try {
+		int frameFd = warm::createFrameMemory(warm::frameBytes(WARM_JOB));
+
+		double begin = nowMs();
+		int socketFd = warm::connectTo(socketPath);
+		warm::Reply reply{};
+		bool replied = warm::sendJob(socketFd, WARM_JOB, frameFd) && warm::receiveReply(socketFd, reply);
+		double roundTripMs = nowMs() - begin;
+
+		close(socketFd);
+		close(frameFd);
+		if (!replied || reply.status != 0) {
+			throw std::runtime_error("daemon job failed!");
+		}
+
+		printf("%.6f %.6f\n", roundTripMs, reply.renderMs);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+// The same job the cold way, instance and device included.
+int runColdJob(int deviceIndex) {
+	try {
+		std::vector<uint8_t> frame(warm::frameBytes(WARM_JOB));
+
+		BenchContext ctx;
+		ctx.init(deviceIndex);
+		renderJob(ctx, VK_NULL_HANDLE, WARM_JOB, frame.data());
+		ctx.cleanup();
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+// A daemon process started by the warm_start scenario. Shut down and waited for however the
+// scenario ends, so a failed run doesn't leave it holding the socket path.
+struct DaemonProcess {
+	FILE* process = nullptr;
+	std::string socketPath;
+
+	DaemonProcess(const std::string& command, const std::string& socketPath) : socketPath(socketPath) {
+		process = popen(command.c_str(), "r");
+		if (process == nullptr) {
+			throw std::runtime_error("failed to start daemon!");
+		}
+	}
+
+	~DaemonProcess() {
+		// A job with no frames shuts it down. If it isn't listening it has exited already.
+		try {
+			int shutdownFd = warm::connectTo(socketPath);
+			warm::Reply reply{};
+			warm::sendJob(shutdownFd, warm::Job{0, 0, 0, 0}, -1);
+			warm::receiveReply(shutdownFd, reply);
+			close(shutdownFd);
+		} catch (const std::exception&) {
+		}
+		pclose(process);
+	}
+
+	DaemonProcess(const DaemonProcess&) = delete;
+	DaemonProcess& operator=(const DaemonProcess&) = delete;
+};
+
+
+// Latency of a job as a client process sees it, launch to exit: through a warm daemon,
+// against a cold launch that initializes Vulkan itself.
+void benchWarmStart(BenchContext& ctx, Measurements& m) {
+	std::string executable = "'" + benchExecutable() + "' --device " + std::to_string(ctx.deviceIndex);
+	std::string socketPath = "/tmp/vulkan_bench_" + std::to_string(getpid()) + ".sock";
+
+	DaemonProcess daemon(executable + " --daemon " + socketPath, socketPath);
+
+	double daemonInitMs = 0.0;
+	if (fscanf(daemon.process, "ready %lf", &daemonInitMs) != 1) {
+		throw std::runtime_error("daemon failed to start!");
+	}
+
+	// A job over SESSION_BUDGET fails alone: the daemon replies with an error and serves the
+	// next job as before
+	auto sendToDaemon = [&](const warm::Job& job) {
+		int frameFd = warm::createFrameMemory(warm::frameBytes(job));
+		int socketFd = warm::connectTo(socketPath);
+		warm::Reply reply{1, 0.0f};
+		bool replied = warm::sendJob(socketFd, job, frameFd) && warm::receiveReply(socketFd, reply);
+		close(socketFd);
+		close(frameFd);
+		return replied && reply.status == 0;
+	};
+	if (sendToDaemon(warm::Job{4096, 4096, 1, 1})) {
+		throw std::runtime_error("daemon accepted a job over its memory budget!");
+	}
+	if (!sendToDaemon(WARM_JOB)) {
+		throw std::runtime_error("daemon failed a job after an over budget one!");
+	}
+
+	double warmMs = 0.0, roundTripMs = 0.0, renderMs = 0.0;
+	for (uint32_t i = 0; i < WARM_JOBS; i++) {
+		double begin = nowMs();
+		FILE* client = popen((executable + " --daemon-job " + socketPath).c_str(), "r");
+		double jobRoundTripMs = 0.0, jobRenderMs = 0.0;
+		bool ok = client != nullptr && fscanf(client, "%lf %lf", &jobRoundTripMs, &jobRenderMs) == 2;
+		ok = client != nullptr && pclose(client) == 0 && ok;
+		warmMs += nowMs() - begin;
+
+		if (!ok) {
+			throw std::runtime_error("daemon client failed!");
+		}
+		roundTripMs += jobRoundTripMs;
+		renderMs += jobRenderMs;
+	}
+
+	double coldMs = 0.0;
+	for (uint32_t i = 0; i < WARM_JOBS; i++) {
+		double begin = nowMs();
+		if (system((executable + " --cold-job").c_str()) != 0) {
+			throw std::runtime_error("cold job failed!");
+		}
+		coldMs += nowMs() - begin;
+	}
+
+	m.add("warm_job_ms", warmMs / WARM_JOBS, "ms");
+	m.add("cold_job_ms", coldMs / WARM_JOBS, "ms");
+	m.add("speedup", coldMs / warmMs, "x", true);
+	m.add("warm_round_trip_ms", roundTripMs / WARM_JOBS, "ms");
+	m.add("warm_render_ms", renderMs / WARM_JOBS, "ms");
+	m.add("daemon_init_ms", daemonInitMs, "ms");
+}
+
+
+// Render one frame, copy it into host memory and read it on the CPU.
+void benchReadback(BenchContext& ctx, OffscreenTarget& target, Measurements& m) {
+	const VkDeviceSize size = TARGET_WIDTH * TARGET_HEIGHT * 4;
+
+	VkBuffer readback;
+	VkDeviceMemory readbackMemory;
+	ctx.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readback, readbackMemory,
+		memstats::DeviceMemoryCategory::Readback);
+
+	double gpuMs = ctx.submitAndWait([&](VkCommandBuffer cmd) {
+		target.recordDraws(cmd, 100);
+
+		VkBufferImageCopy region{};
+		region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+		region.imageExtent = {TARGET_WIDTH, TARGET_HEIGHT, 1};
+		vkCmdCopyImageToBuffer(cmd, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1, &region);
+
+		// Host reads after the copy
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = readback;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+	});
+
+	std::vector<uint8_t> pixels(size);
+	double begin = nowMs();
+	void* data;
+	vkMapMemory(ctx.device, readbackMemory, 0, size, 0, &data);
+	memcpy(pixels.data(), data, size);
+	vkUnmapMemory(ctx.device, readbackMemory);
+	double mapMs = nowMs() - begin;
+
+	ctx.destroyBuffer(readback, readbackMemory);
+
+	m.add("render_copy_ms", gpuMs, "ms");
+	m.add("map_read_ms", mapMs, "ms");
+	m.add("total_ms", gpuMs + mapMs, "ms");
+}
+
+
+/*
+* Output
+*/
+
+struct ScenarioResult {
+	std::string name;
+	Measurements measurements;
+};
+
+
+// Quoted, with quotes, backslashes and control characters escaped
+std::string jsonString(const std::string& value) {
+	std::string quoted = "\"";
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			quoted += escaped;
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+
+void writeJson(
+	const std::string& path,
+	const BenchContext& ctx,
+	int warmup,
+	int repetitions,
+	const std::vector<ScenarioResult>& results
+) {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		throw std::runtime_error("failed to open " + path + " for writing!");
+	}
+	out.precision(9);
+
+	out << "{\n";
+	out << "  \"schema\": 1,\n";
+	out << "  \"device\": " << jsonString(ctx.properties.deviceName) << ",\n";
+	out << "  \"driver_version\": " << ctx.properties.driverVersion << ",\n";
+	out << "  \"timestamp\": " << std::time(nullptr) << ",\n";
+	out << "  \"warmup\": " << warmup << ",\n";
+	out << "  \"repetitions\": " << repetitions << ",\n";
+	out << "  \"scenarios\": [\n";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const ScenarioResult& result = results[i];
+		out << "    {\n";
+		out << "      \"name\": " << jsonString(result.name) << ",\n";
+		out << "      \"metrics\": [\n";
+
+		const auto& order = result.measurements.order;
+		for (size_t j = 0; j < order.size(); j++) {
+			const Metric& metric = result.measurements.metrics.at(order[j]);
+			Summary s = summarize(metric.samples);
+
+			out << "        {\"name\": " << jsonString(order[j]) << ", \"unit\": " << jsonString(metric.unit)
+				<< ", \"better\": \"" << (metric.higherIsBetter ? "higher" : "lower") << "\""
+				<< ", \"mean\": " << s.mean << ", \"median\": " << s.median << ", \"stddev\": " << s.stddev
+				<< ", \"min\": " << s.min << ", \"max\": " << s.max << ", \"p95\": " << s.p95
+				<< ", \"samples\": [";
+			for (size_t k = 0; k < metric.samples.size(); k++) {
+				out << (k ? ", " : "") << metric.samples[k];
+			}
+			out << "]}" << (j + 1 < order.size() ? "," : "") << "\n";
+		}
+
+		out << "      ]\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+
+void printSummary(const ScenarioResult& result) {
+	std::cout << result.name << std::endl;
+
+	for (const auto& name : result.measurements.order) {
+		const Metric& metric = result.measurements.metrics.at(name);
+		Summary s = summarize(metric.samples);
+
+		char line[256];
+		snprintf(line, sizeof(line), "\t%-28s median %10.3f %-8s (mean %.3f, stddev %.3f, min %.3f, max %.3f)",
+			name.c_str(), s.median, metric.unit.c_str(), s.mean, s.stddev, s.min, s.max);
+		std::cout << line << std::endl;
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string outPath = "bench_results.json";
+	std::string filter;
+	int warmup = 2;
+	int repetitions = 10;
+	int deviceIndex = -1;
+	std::string capturePath;
+	int sessionWorker = -1; // Internal, see benchSessions()
+	std::string daemonPath;
+	std::string daemonJobPath; // Internal, see benchWarmStart()
+	bool coldJob = false; // Internal, see benchWarmStart()
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--out" && hasValue) outPath = argv[++i];
+		else if (arg == "--filter" && hasValue) filter = argv[++i];
+		else if (arg == "--warmup" && hasValue) warmup = std::atoi(argv[++i]);
+		else if (arg == "--reps" && hasValue) repetitions = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--device" && hasValue) deviceIndex = std::atoi(argv[++i]);
+		else if (arg == "--capture" && hasValue) capturePath = argv[++i];
+		else if (arg == "--session-worker" && hasValue) sessionWorker = std::atoi(argv[++i]);
+		else if (arg == "--daemon" && hasValue) daemonPath = argv[++i];
+		else if (arg == "--daemon-job" && hasValue) daemonJobPath = argv[++i];
+		else if (arg == "--cold-job") coldJob = true;
+		else {
+			std::cerr << "usage: " << argv[0]
+				<< " [--out file.json] [--filter name] [--warmup n] [--reps n] [--device index] [--capture file]"
+				<< " [--daemon socket]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (sessionWorker >= 0) {
+		return runSessionWorker(deviceIndex, static_cast<uint32_t>(sessionWorker));
+	}
+	if (!daemonPath.empty()) {
+		return runDaemon(deviceIndex, daemonPath);
+	}
+	if (!daemonJobPath.empty()) {
+		return runDaemonJob(daemonJobPath);
+	}
+	if (coldJob) {
+		return runColdJob(deviceIndex);
+	}
+
+	BenchContext ctx;
+	OffscreenTarget target;
+	std::vector<ScenarioResult> results;
+	std::vector<uint8_t> captureData;
+
+	std::vector<Scenario> scenarios = {
+		{"startup", benchStartup},
+		{"upload", benchUpload},
+		{"draw_scaling", [&](BenchContext& c, Measurements& m) { benchDrawScaling(c, target, m); }},
+		{"frames", [&](BenchContext& c, Measurements& m) { benchFrames(c, target, m); }},
+		{"compute", benchCompute},
+		{"readback", [&](BenchContext& c, Measurements& m) { benchReadback(c, target, m); }},
+		{"occlusion", benchOcclusion},
+		{"lod", benchLod},
+		{"msaa", benchMsaa},
+		{"clustered", benchClustered},
+		{"shadows", benchShadows},
+		{"upscale", benchUpscale},
+		{"bvh", benchBvh},
+		{"raytracing", benchRayTracing},
+		{"primitives", benchPrimitives},
+		{"skinning", benchSkinning},
+		{"sessions", benchSessions},
+		{"warm_start", benchWarmStart},
+	};
+
+	try {
+		ctx.init(deviceIndex);
+		target.create(ctx);
+		std::cout << "Device: " << ctx.properties.deviceName << std::endl;
+
+		if (!capturePath.empty()) {
+			captureData = replay::loadCapture(capturePath);
+			scenarios.push_back({"replay", [&](BenchContext& c, Measurements& m) { benchReplay(c, captureData, m); }});
+		}
+
+		for (const auto& scenario : scenarios) {
+			if (!filter.empty() && scenario.name.find(filter) == std::string::npos) continue;
+
+			ScenarioResult result{scenario.name, {}};
+
+			result.measurements.discard = true;
+			for (int i = 0; i < warmup; i++) scenario.run(ctx, result.measurements);
+
+			result.measurements.discard = false;
+			for (int i = 0; i < repetitions; i++) scenario.run(ctx, result.measurements);
+
+			printSummary(result);
+			results.push_back(std::move(result));
+		}
+
+		writeJson(outPath, ctx, warmup, repetitions, results);
+		std::cout << "Wrote " << outPath << std::endl;
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	target.destroy(ctx);
+	ctx.cleanup();
+
+	memstats::deviceMemory().printReport(std::cout);
+	bool leaked = memstats::deviceMemory().reportLeaks(std::cerr);
+
+	return leaked ? EXIT_FAILURE : EXIT_SUCCESS;
+}
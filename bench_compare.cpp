@@ -0,0 +1,310 @@
+/*
+* Compares two bench.cpp result files and fails when a metric regressed.
+* - Usage: BenchCompare.out baseline.json current.json [--threshold pct] [--sigma k]
+*     [--metric-threshold scenario.metric=pct] [--only scenario.metric]
+* - A metric regresses when its mean moved in the bad direction by more than
+*   max(threshold, sigma * noise), noise being the standard error of the difference
+*   of the two means taken from the repetition variance.
+* - Exit code 0 = no regression, 1 = regression, 2 = bad input.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/*
+* Just enough JSON to read our own result files.
+*/
+
+struct JsonValue {
+	enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	const JsonValue& operator[](const std::string& key) const {
+		static const JsonValue null;
+		auto it = object.find(key);
+		return it == object.end() ? null : it->second;
+	}
+};
+
+
+class JsonParser {
+public:
+	explicit JsonParser(const std::string& text) : text(text) {}
+
+	JsonValue parse() {
+		JsonValue value = parseValue();
+		skipWhitespace();
+		if (pos != text.size()) fail("trailing characters");
+		return value;
+	}
+
+private:
+	std::string text;
+	size_t pos = 0;
+
+	[[noreturn]] void fail(const std::string& what) {
+		throw std::runtime_error("json: " + what + " at offset " + std::to_string(pos));
+	}
+
+	void skipWhitespace() {
+		while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) pos++;
+	}
+
+	bool consume(char c) {
+		skipWhitespace();
+		if (pos < text.size() && text[pos] == c) {
+			pos++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c) {
+		if (!consume(c)) fail(std::string("expected '") + c + "'");
+	}
+
+	JsonValue parseValue() {
+		skipWhitespace();
+		if (pos >= text.size()) fail("unexpected end");
+
+		JsonValue value;
+		char c = text[pos];
+
+		if (c == '{') {
+			pos++;
+			value.type = JsonValue::Object;
+			if (consume('}')) return value;
+			do {
+				skipWhitespace();
+				std::string key = parseString();
+				expect(':');
+				value.object[key] = parseValue();
+			} while (consume(','));
+			expect('}');
+		} else if (c == '[') {
+			pos++;
+			value.type = JsonValue::Array;
+			if (consume(']')) return value;
+			do {
+				value.array.push_back(parseValue());
+			} while (consume(','));
+			expect(']');
+		} else if (c == '"') {
+			value.type = JsonValue::String;
+			value.string = parseString();
+		} else if (text.compare(pos, 4, "true") == 0) {
+			pos += 4;
+			value.type = JsonValue::Bool;
+			value.boolean = true;
+		} else if (text.compare(pos, 5, "false") == 0) {
+			pos += 5;
+			value.type = JsonValue::Bool;
+		} else if (text.compare(pos, 4, "null") == 0) {
+			pos += 4;
+		} else {
+			char* end = nullptr;
+			value.type = JsonValue::Number;
+			value.number = strtod(text.c_str() + pos, &end);
+			if (end == text.c_str() + pos) fail("bad value");
+			pos = end - text.c_str();
+		}
+
+		return value;
+	}
+
+	std::string parseString() {
+		if (pos >= text.size() || text[pos] != '"') fail("expected string");
+		pos++;
+
+		std::string out;
+		while (pos < text.size() && text[pos] != '"') {
+			char c = text[pos++];
+			if (c == '\\' && pos < text.size()) {
+				char escaped = text[pos++];
+				switch (escaped) {
+					case 'n': out += '\n'; break;
+					case 't': out += '\t'; break;
+					case 'u': pos += 4; out += '?'; break; // Not needed for our files
+					default: out += escaped; break;
+				}
+			} else {
+				out += c;
+			}
+		}
+
+		if (pos >= text.size()) fail("unterminated string");
+		pos++;
+		return out;
+	}
+};
+
+
+JsonValue loadJson(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path);
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	return JsonParser(buffer.str()).parse();
+}
+
+
+/*
+* Comparison
+*/
+
+struct MetricStats {
+	std::string unit;
+	bool higherIsBetter = false;
+	double mean = 0.0;
+	double stddev = 0.0;
+	size_t count = 0;
+};
+
+
+// "scenario.metric" -> stats
+std::map<std::string, MetricStats> flattenResults(const JsonValue& root) {
+	std::map<std::string, MetricStats> out;
+
+	for (const auto& scenario : root["scenarios"].array) {
+		for (const auto& metric : scenario["metrics"].array) {
+			MetricStats stats;
+			stats.unit = metric["unit"].string;
+			stats.higherIsBetter = metric["better"].string == "higher";
+			stats.mean = metric["mean"].number;
+			stats.stddev = metric["stddev"].number;
+			stats.count = std::max<size_t>(1, metric["samples"].array.size());
+
+			out[scenario["name"].string + "." + metric["name"].string] = stats;
+		}
+	}
+
+	return out;
+}
+
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> paths;
+	double thresholdPct = 5.0;
+	double sigma = 3.0;
+	std::map<std::string, double> metricThresholds;
+	std::vector<std::string> only;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--threshold" && hasValue) {
+			thresholdPct = atof(argv[++i]);
+		} else if (arg == "--sigma" && hasValue) {
+			sigma = atof(argv[++i]);
+		} else if (arg == "--metric-threshold" && hasValue) {
+			std::string spec = argv[++i];
+			size_t eq = spec.find('=');
+			if (eq == std::string::npos) {
+				std::cerr << "bad --metric-threshold " << spec << ", expected scenario.metric=pct" << std::endl;
+				return 2;
+			}
+			metricThresholds[spec.substr(0, eq)] = atof(spec.c_str() + eq + 1);
+		} else if (arg == "--only" && hasValue) {
+			only.push_back(argv[++i]);
+		} else if (arg.rfind("--", 0) != 0) {
+			paths.push_back(arg);
+		} else {
+			paths.clear();
+			break;
+		}
+	}
+
+	if (paths.size() != 2) {
+		std::cerr << "usage: " << argv[0] << " baseline.json current.json [--threshold pct] [--sigma k]"
+			<< " [--metric-threshold scenario.metric=pct] [--only scenario.metric]" << std::endl;
+		return 2;
+	}
+
+	std::map<std::string, MetricStats> baseline, current;
+	try {
+		baseline = flattenResults(loadJson(paths[0]));
+		current = flattenResults(loadJson(paths[1]));
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	std::vector<std::string> names;
+	if (only.empty()) {
+		for (const auto& entry : baseline) names.push_back(entry.first);
+	} else {
+		names = only;
+	}
+
+	int regressions = 0;
+	int missing = 0;
+
+	printf("%-36s %12s %12s %9s %9s  %s\n", "metric", "baseline", "current", "change", "allowed", "status");
+
+	for (const auto& name : names) {
+		auto base = baseline.find(name);
+		auto cur = current.find(name);
+
+		if (base == baseline.end() || cur == current.end()) {
+			printf("%-36s %12s %12s %9s %9s  MISSING\n", name.c_str(),
+				base == baseline.end() ? "-" : "", cur == current.end() ? "-" : "", "", "");
+			missing++;
+			continue;
+		}
+
+		const MetricStats& b = base->second;
+		const MetricStats& c = cur->second;
+
+		// Signed so that positive always means "got worse"
+		// A zero baseline (e.g. allocations per frame) makes any increase infinitely worse
+		double changePct = b.mean != 0.0 ? (c.mean - b.mean) / std::fabs(b.mean) * 100.0
+			: (c.mean == 0.0 ? 0.0 : std::copysign(INFINITY, c.mean));
+		double worsePct = b.higherIsBetter ? -changePct : changePct;
+
+		double stderrDiff = std::sqrt(b.stddev * b.stddev / b.count + c.stddev * c.stddev / c.count);
+		double noisePct = b.mean != 0.0 ? sigma * stderrDiff / std::fabs(b.mean) * 100.0 : 0.0;
+
+		auto custom = metricThresholds.find(name);
+		double allowedPct = std::max(custom != metricThresholds.end() ? custom->second : thresholdPct, noisePct);
+
+		const char* status = "ok";
+		if (worsePct > allowedPct) {
+			status = "REGRESSED";
+			regressions++;
+		} else if (-worsePct > allowedPct) {
+			status = "improved";
+		}
+
+		printf("%-36s %12.4g %12.4g %+8.2f%% %8.2f%%  %s\n",
+			name.c_str(), b.mean, c.mean, changePct, allowedPct, status);
+	}
+
+	if (missing > 0) {
+		printf("\n%d metric(s) missing from one of the files\n", missing);
+	}
+
+	if (regressions > 0) {
+		printf("\n%d metric(s) regressed\n", regressions);
+		return 1;
+	}
+
+	return missing > 0 ? 2 : 0;
+}
@@ -0,0 +1,541 @@
+/*
+* Bounding volume hierarchy over scene instances, for culling, picking and proximity queries.
+* - Built top down with binned SAH: centroids go into BIN_COUNT bins per axis and the split
+*   with the lowest surface area cost wins, or no split when a leaf is cheaper.
+* - Large subtrees are built as jobs on a jobs::JobSystem, and the top levels, where there
+*   are few subtrees, bin their primitives in parallel instead.
+* - Flattened layout: 32 byte nodes in one array, the two children of a node side by side,
+*   and each leaf's primitives contiguous, with a copy of their bounds in the same order so
+*   a leaf test reads memory front to back.
+* - Moving primitives are refit, not rebuilt: the leaf and its ancestors grow or shrink,
+*   and the walk up stops at the first node whose bounds didn't change. The tree's quality
+*   drops as things move further from where they were built, rebuild now and then.
+*/
+
+#pragma once
+
+#include "jobs.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+
+namespace bvh {
+
+struct Aabb {
+	float min[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+	float max[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+
+	void grow(const Aabb& b) {
+		for (int i = 0; i < 3; i++) {
+			min[i] = std::min(min[i], b.min[i]);
+			max[i] = std::max(max[i], b.max[i]);
+		}
+	}
+
+	void grow(const float p[3]) {
+		for (int i = 0; i < 3; i++) {
+			min[i] = std::min(min[i], p[i]);
+			max[i] = std::max(max[i], p[i]);
+		}
+	}
+
+	// Half the surface area, SAH only compares ratios. 0 for an empty box.
+	float area() const {
+		float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+		return dx < 0.0f ? 0.0f : dx * dy + dy * dz + dz * dx;
+	}
+
+	bool operator==(const Aabb& b) const {
+		for (int i = 0; i < 3; i++) {
+			if (min[i] != b.min[i] || max[i] != b.max[i]) return false;
+		}
+		return true;
+	}
+};
+
+inline Aabb bounds(const scene::Box& box) {
+	Aabb b;
+	for (int i = 0; i < 3; i++) {
+		b.min[i] = box.center[i] - box.extent[i];
+		b.max[i] = box.center[i] + box.extent[i];
+	}
+	return b;
+}
+
+
+struct Node {
+	float min[3];
+	uint32_t leftOrFirst; // Leaf: first slot in the primitive order. Otherwise the left child, the right one follows it.
+	float max[3];
+	uint32_t count; // Primitives in a leaf, 0 for the others
+
+	bool leaf() const { return count > 0; }
+};
+static_assert(sizeof(Node) == 32, "two nodes per cache line");
+
+const uint32_t BIN_COUNT = 16;
+const uint32_t MAX_LEAF_SIZE = 4; // Always a leaf at this size or smaller
+const uint32_t MAX_DEPTH = 64; // And past this depth, so the queries' stacks have a bound
+const float TRAVERSAL_COST = 1.0f; // Visiting a node, relative to testing one primitive
+const uint32_t SPAWN_SIZE = 4096; // Subtrees this big are built as their own job
+const uint32_t PARALLEL_BIN_SIZE = 65536; // Nodes this big bin their primitives in parallel
+
+const uint32_t NO_PARENT = ~0u;
+
+
+class Tree {
+public:
+	void build(const std::vector<Aabb>& primitives, jobs::JobSystem& jobs) {
+		uint32_t count = static_cast<uint32_t>(primitives.size());
+
+		// Built in place: the partitions reorder order and ordered together, so the deeper
+		// levels read memory in sequence instead of jumping around primitives
+		order.resize(count);
+		ordered.resize(count);
+		leafOf.resize(count);
+		nodes.assign(count > 0 ? 2 * count - 1 : 1, Node{});
+		parents.assign(nodes.size(), NO_PARENT);
+		nodesUsed = 1;
+
+		Aabb rootBounds, rootCentroids;
+		std::mutex merge;
+		jobs.parallelFor(count, 4096, [&](uint32_t begin, uint32_t end) {
+			Aabb chunkBounds, chunkCentroids;
+			for (uint32_t i = begin; i < end; i++) {
+				order[i] = i;
+				ordered[i] = primitives[i];
+				chunkBounds.grow(primitives[i]);
+				chunkCentroids.grow(centroidOf(primitives[i]).c);
+			}
+			std::lock_guard<std::mutex> lock(merge);
+			rootBounds.grow(chunkBounds);
+			rootCentroids.grow(chunkCentroids);
+		});
+
+		setBounds(nodes[0], rootBounds);
+		nodes[0].count = 0;
+		if (count > 0) {
+			jobs::Counter group;
+			buildNode(0, 0, count, rootCentroids, 0, jobs, group);
+			jobs.wait(group);
+		}
+		nodes.resize(nodesUsed.load());
+
+		// Where each primitive ended up
+		slots.resize(count);
+		jobs.parallelFor(count, 4096, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) slots[order[i]] = i;
+		});
+	}
+
+	// After the primitives in moved changed their bounds in primitives
+	void refit(const std::vector<Aabb>& primitives, const std::vector<uint32_t>& moved) {
+		for (uint32_t primitive : moved) {
+			ordered[slots[primitive]] = primitives[primitive];
+
+			uint32_t node = leafOf[primitive];
+			Aabb b = leafBounds(nodes[node]);
+			while (true) {
+				if (toAabb(nodes[node]) == b) break;
+				setBounds(nodes[node], b);
+
+				node = parents[node];
+				if (node == NO_PARENT) break;
+				b = toAabb(nodes[nodes[node].leftOrFirst]);
+				b.grow(toAabb(nodes[nodes[node].leftOrFirst + 1]));
+			}
+		}
+	}
+
+	// After everything moved. Children always come after their parent in the array.
+	void refit(const std::vector<Aabb>& primitives) {
+		for (size_t i = 0; i < ordered.size(); i++) ordered[i] = primitives[order[i]];
+
+		for (size_t i = nodes.size(); i-- > 0;) {
+			Node& node = nodes[i];
+			if (node.leaf()) {
+				setBounds(node, leafBounds(node));
+			} else {
+				Aabb b = toAabb(nodes[node.leftOrFirst]);
+				b.grow(toAabb(nodes[node.leftOrFirst + 1]));
+				setBounds(node, b);
+			}
+		}
+	}
+
+
+	// Primitives whose bounds are at least partly inside the view frustum, clip space as in
+	// scene.h. Subtrees entirely inside are taken whole without testing them.
+	void cull(const scene::Mat4& viewProj, std::vector<uint32_t>& visible) const {
+		visible.clear();
+		if (order.empty()) return;
+
+		// Gribb-Hartmann: -w <= x, y <= w and 0 <= z <= w, each as a plane
+		float planes[6][4];
+		const float* m = viewProj.m;
+		for (int i = 0; i < 4; i++) {
+			float x = m[i * 4 + 0], y = m[i * 4 + 1], z = m[i * 4 + 2], w = m[i * 4 + 3];
+			planes[0][i] = w + x;
+			planes[1][i] = w - x;
+			planes[2][i] = w + y;
+			planes[3][i] = w - y;
+			planes[4][i] = z;
+			planes[5][i] = w - z;
+		}
+
+		// 0 outside, 1 crossing, 2 entirely inside
+		auto classify = [&](const float* mn, const float* mx) {
+			int result = 2;
+			for (const auto& p : planes) {
+				float far = p[3], near = p[3];
+				for (int axis = 0; axis < 3; axis++) {
+					far += p[axis] * (p[axis] > 0.0f ? mx[axis] : mn[axis]);
+					near += p[axis] * (p[axis] > 0.0f ? mn[axis] : mx[axis]);
+				}
+				if (far < 0.0f) return 0;
+				if (near < 0.0f) result = 1;
+			}
+			return result;
+		};
+
+		struct Entry {
+			uint32_t node;
+			bool inside;
+		};
+		Entry stack[MAX_DEPTH * 2];
+		uint32_t size = 0;
+		stack[size++] = Entry{0, false};
+
+		while (size > 0) {
+			Entry entry = stack[--size];
+			const Node& node = nodes[entry.node];
+
+			bool inside = entry.inside;
+			if (!inside) {
+				int c = classify(node.min, node.max);
+				if (c == 0) continue;
+				inside = c == 2;
+			}
+
+			if (node.leaf()) {
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+					if (inside || classify(ordered[i].min, ordered[i].max) != 0) visible.push_back(order[i]);
+				}
+			} else {
+				stack[size++] = Entry{node.leftOrFirst + 1, inside};
+				stack[size++] = Entry{node.leftOrFirst, inside};
+			}
+		}
+	}
+
+	struct Hit {
+		uint32_t primitive;
+		float t; // Along direction, in its units
+	};
+
+	// Closest primitive box the ray hits before maxT. Near children are visited first, so
+	// far ones usually get skipped.
+	bool pick(scene::Vec3 origin, scene::Vec3 direction, float maxT, Hit& hit) const {
+		if (order.empty()) return false;
+
+		float o[3] = {origin.x, origin.y, origin.z};
+		float inv[3] = {1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z};
+
+		// Entry distance, or infinity when the ray misses or the box is past closest
+		auto slab = [&](const float* mn, const float* mx, float closest) {
+			float enter = 0.0f, exit = closest;
+			for (int axis = 0; axis < 3; axis++) {
+				float t0 = (mn[axis] - o[axis]) * inv[axis];
+				float t1 = (mx[axis] - o[axis]) * inv[axis];
+				enter = std::max(enter, std::min(t0, t1));
+				exit = std::min(exit, std::max(t0, t1));
+			}
+			return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+		};
+
+		hit.t = maxT;
+		bool found = false;
+
+		uint32_t stack[MAX_DEPTH * 2];
+		uint32_t size = 0;
+		if (slab(nodes[0].min, nodes[0].max, hit.t) < hit.t) stack[size++] = 0;
+
+		while (size > 0) {
+			const Node& node = nodes[stack[--size]];
+
+			if (node.leaf()) {
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+					float t = slab(ordered[i].min, ordered[i].max, hit.t);
+					if (t < hit.t) {
+						hit = Hit{order[i], t};
+						found = true;
+					}
+				}
+				continue;
+			}
+
+			uint32_t near = node.leftOrFirst, far = node.leftOrFirst + 1;
+			float tNear = slab(nodes[near].min, nodes[near].max, hit.t);
+			float tFar = slab(nodes[far].min, nodes[far].max, hit.t);
+			if (tFar < tNear) {
+				std::swap(near, far);
+				std::swap(tNear, tFar);
+			}
+			// Popped again later, when hit.t may have shrunk past it
+			if (tFar < hit.t) stack[size++] = far;
+			if (tNear < hit.t) stack[size++] = near;
+		}
+		return found;
+	}
+
+	// Primitives whose bounds come within radius of center
+	void within(scene::Vec3 center, float radius, std::vector<uint32_t>& found) const {
+		found.clear();
+		if (order.empty()) return;
+
+		float c[3] = {center.x, center.y, center.z};
+		float radiusSquared = radius * radius;
+		auto touches = [&](const float* mn, const float* mx) {
+			float distanceSquared = 0.0f;
+			for (int axis = 0; axis < 3; axis++) {
+				float d = std::max(mn[axis] - c[axis], 0.0f) + std::max(c[axis] - mx[axis], 0.0f);
+				distanceSquared += d * d;
+			}
+			return distanceSquared <= radiusSquared;
+		};
+
+		uint32_t stack[MAX_DEPTH * 2];
+		uint32_t size = 0;
+		stack[size++] = 0;
+
+		while (size > 0) {
+			const Node& node = nodes[stack[--size]];
+			if (!touches(node.min, node.max)) continue;
+
+			if (node.leaf()) {
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+					if (touches(ordered[i].min, ordered[i].max)) found.push_back(order[i]);
+				}
+			} else {
+				stack[size++] = node.leftOrFirst + 1;
+				stack[size++] = node.leftOrFirst;
+			}
+		}
+	}
+
+
+	size_t nodeCount() const { return nodes.size(); }
+
+	// Expected cost of a random ray through the root, in primitive tests. Lower is a better tree.
+	float sahCost() const {
+		float rootArea = toAabb(nodes[0]).area();
+		if (rootArea <= 0.0f) return 0.0f;
+
+		float cost = 0.0f;
+		for (const Node& node : nodes) {
+			float area = toAabb(node).area();
+			cost += node.leaf() ? area * node.count : area * TRAVERSAL_COST;
+		}
+		return cost / rootArea;
+	}
+
+private:
+	struct Centroid {
+		float c[3];
+	};
+
+	struct Bin {
+		Aabb bounds;
+		uint32_t count = 0;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> parents; // Per node
+	std::vector<uint32_t> order; // Primitive in each slot, leaves' slots are contiguous
+	std::vector<Aabb> ordered; // Its bounds, in the same order
+	std::vector<uint32_t> slots; // Per primitive, its slot
+	std::vector<uint32_t> leafOf; // Per primitive, its leaf
+
+	std::atomic<uint32_t> nodesUsed{0}; // During build()
+
+	static Centroid centroidOf(const Aabb& b) {
+		return Centroid{{(b.min[0] + b.max[0]) * 0.5f, (b.min[1] + b.max[1]) * 0.5f, (b.min[2] + b.max[2]) * 0.5f}};
+	}
+
+	static void setBounds(Node& node, const Aabb& b) {
+		for (int i = 0; i < 3; i++) {
+			node.min[i] = b.min[i];
+			node.max[i] = b.max[i];
+		}
+	}
+
+	static Aabb toAabb(const Node& node) {
+		Aabb b;
+		for (int i = 0; i < 3; i++) {
+			b.min[i] = node.min[i];
+			b.max[i] = node.max[i];
+		}
+		return b;
+	}
+
+	Aabb leafBounds(const Node& node) const {
+		Aabb b;
+		for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) b.grow(ordered[i]);
+		return b;
+	}
+
+	void makeLeaf(uint32_t node, uint32_t first, uint32_t count) {
+		nodes[node].leftOrFirst = first;
+		nodes[node].count = count;
+		for (uint32_t i = first; i < first + count; i++) leafOf[order[i]] = node;
+	}
+
+	// node's bounds are already set, centroidBounds bound its primitives' centroids
+	void buildNode(uint32_t node, uint32_t first, uint32_t count, const Aabb& centroidBounds, uint32_t depth,
+		jobs::JobSystem& jobs, jobs::Counter& group) {
+		if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH) {
+			makeLeaf(node, first, count);
+			return;
+		}
+
+		// An axis where every centroid is in the same place can't be split
+		float scale[3];
+		bool splittable = false;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			scale[axis] = extent > 0.0f ? BIN_COUNT / extent : 0.0f;
+			splittable |= extent > 0.0f;
+		}
+		if (!splittable) {
+			makeLeaf(node, first, count);
+			return;
+		}
+
+		auto binOf = [&](const Centroid& centroid, int axis) {
+			float position = (centroid.c[axis] - centroidBounds.min[axis]) * scale[axis];
+			return std::min(BIN_COUNT - 1, static_cast<uint32_t>(position));
+		};
+
+		Bin bins[3][BIN_COUNT];
+		auto binRange = [&](uint32_t begin, uint32_t end, Bin (&into)[3][BIN_COUNT]) {
+			for (uint32_t i = begin; i < end; i++) {
+				Centroid centroid = centroidOf(ordered[i]);
+				for (int axis = 0; axis < 3; axis++) {
+					if (scale[axis] == 0.0f) continue;
+					Bin& bin = into[axis][binOf(centroid, axis)];
+					bin.bounds.grow(ordered[i]);
+					bin.count++;
+				}
+			}
+		};
+
+		if (count >= PARALLEL_BIN_SIZE) {
+			std::mutex merge;
+			jobs.parallelFor(count, PARALLEL_BIN_SIZE / 4, [&](uint32_t begin, uint32_t end) {
+				Bin local[3][BIN_COUNT];
+				binRange(first + begin, first + end, local);
+
+				std::lock_guard<std::mutex> lock(merge);
+				for (int axis = 0; axis < 3; axis++) {
+					for (uint32_t b = 0; b < BIN_COUNT; b++) {
+						bins[axis][b].bounds.grow(local[axis][b].bounds);
+						bins[axis][b].count += local[axis][b].count;
+					}
+				}
+			});
+		} else {
+			binRange(first, first + count, bins);
+		}
+
+		// Sweep each axis from both ends. Splitting before bin s puts bins [0, s) on the left.
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			if (scale[axis] == 0.0f) continue;
+
+			float leftArea[BIN_COUNT];
+			uint32_t leftCount[BIN_COUNT];
+			Aabb sweep;
+			uint32_t swept = 0;
+			for (uint32_t b = 0; b < BIN_COUNT - 1; b++) {
+				sweep.grow(bins[axis][b].bounds);
+				swept += bins[axis][b].count;
+				leftArea[b + 1] = sweep.area();
+				leftCount[b + 1] = swept;
+			}
+
+			sweep = Aabb{};
+			swept = 0;
+			for (uint32_t split = BIN_COUNT - 1; split > 0; split--) {
+				sweep.grow(bins[axis][split].bounds);
+				swept += bins[axis][split].count;
+				if (leftCount[split] == 0 || swept == 0) continue;
+
+				float cost = leftArea[split] * leftCount[split] + sweep.area() * swept;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		float nodeArea = toAabb(nodes[node]).area();
+		float splitCost = TRAVERSAL_COST + (nodeArea > 0.0f ? bestCost / nodeArea : 0.0f);
+		if (bestAxis < 0 || splitCost >= static_cast<float>(count)) {
+			makeLeaf(node, first, count);
+			return;
+		}
+
+		Aabb leftBounds, rightBounds;
+		for (uint32_t b = 0; b < BIN_COUNT; b++) {
+			(b < bestSplit ? leftBounds : rightBounds).grow(bins[bestAxis][b].bounds);
+		}
+
+		// The children's centroid bounds come out of the partition, it looks at every centroid anyway
+		Aabb leftCentroids, rightCentroids;
+		uint32_t middle = first, end = first + count;
+		while (middle < end) {
+			Centroid centroid = centroidOf(ordered[middle]);
+			if (binOf(centroid, bestAxis) < bestSplit) {
+				leftCentroids.grow(centroid.c);
+				middle++;
+			} else {
+				rightCentroids.grow(centroid.c);
+				end--;
+				std::swap(ordered[middle], ordered[end]);
+				std::swap(order[middle], order[end]);
+			}
+		}
+		uint32_t leftCount = middle - first;
+
+		uint32_t left = nodesUsed.fetch_add(2);
+		nodes[node].leftOrFirst = left;
+		nodes[node].count = 0;
+		setBounds(nodes[left], leftBounds);
+		setBounds(nodes[left + 1], rightBounds);
+		parents[left] = node;
+		parents[left + 1] = node;
+
+		uint32_t rightFirst = first + leftCount;
+		uint32_t rightCount = count - leftCount;
+		if (rightCount >= SPAWN_SIZE) {
+			jobs.spawn(group, [this, left, rightFirst, rightCount, rightCentroids, depth, &jobs, &group] {
+				buildNode(left + 1, rightFirst, rightCount, rightCentroids, depth + 1, jobs, group);
+			});
+		} else {
+			buildNode(left + 1, rightFirst, rightCount, rightCentroids, depth + 1, jobs, group);
+		}
+		buildNode(left, first, leftCount, leftCentroids, depth + 1, jobs, group);
+	}
+};
+
+} // namespace bvh
@@ -0,0 +1,1551 @@
+/*
+* Vulkan API capture, played back by replay.h (`VulkanBench.out --capture <file>`).
+* - capture::vkXxx wrap the real calls the renderer makes after device creation. While
+*   recorder() is active each call is appended to a compact binary file: object creation,
+*   command recording, submits and presents, with handles turned into small sequential ids.
+* - Host writes to mapped memory are captured by diffing each mapped range against a
+*   shadow copy at every submit and unmap, so only changed bytes land in the file.
+* - Memory is recorded by property flags, not type index, so a capture replays on any
+*   device. Struct layouts are written raw, so captures don't move between architectures.
+* - Only the subset of Vulkan this app uses is covered. Anything else (pNext chains,
+*   specialization constants, concurrent sharing...) throws while capturing.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+namespace capture {
+
+const uint32_t MAGIC = 0x50414356; // "VCAP"
+const uint32_t VERSION = 2;
+
+enum class Op : uint16_t {
+	// Objects
+	CreateSwapchain,
+	GetSwapchainImages,
+	CreateImageView,
+	CreateRenderPass,
+	CreateShaderModule,
+	CreatePipelineLayout,
+	CreateGraphicsPipeline,
+	CreateComputePipeline,
+	CreateFramebuffer,
+	CreateCommandPool,
+	AllocateCommandBuffers,
+	FreeCommandBuffers,
+	CreateSemaphore,
+	CreateFence,
+	CreateQueryPool,
+	CreateBuffer,
+	CreateImage,
+	CreateSampler,
+	CreateDescriptorSetLayout,
+	CreateDescriptorPool,
+	AllocateDescriptorSets,
+	UpdateDescriptorSets,
+	Destroy,
+
+	// Memory
+	AllocateMemory,
+	BindBufferMemory,
+	BindImageMemory,
+	MapMemory,
+	UnmapMemory,
+	MemoryWrite,
+
+	// Command buffers
+	BeginCommandBuffer,
+	EndCommandBuffer,
+	ResetCommandBuffer,
+	CmdResetQueryPool,
+	CmdBeginRenderPass,
+	CmdEndRenderPass,
+	CmdSetViewport,
+	CmdSetScissor,
+	CmdBindPipeline,
+	CmdDraw,
+	CmdBindDescriptorSets,
+	CmdPushConstants,
+	CmdBindVertexBuffers,
+	CmdWriteTimestamp,
+	CmdPipelineBarrier,
+	CmdCopyBufferToImage,
+	CmdDispatch,
+	CmdBlitImage,
+
+	// Queue and sync
+	QueueSubmit,
+	QueueWaitIdle,
+	DeviceWaitIdle,
+	WaitForFences,
+	ResetFences,
+	AcquireNextImage,
+	QueuePresent,
+
+	Count
+};
+
+
+template<typename T>
+uint64_t handleKey(T handle) {
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+}
+
+
+// Builds one record's payload.
+class Encoder {
+public:
+	std::vector<uint8_t> bytes;
+
+	void raw(const void* data, size_t size) {
+		const uint8_t* begin = static_cast<const uint8_t*>(data);
+		bytes.insert(bytes.end(), begin, begin + size);
+	}
+
+	template<typename T>
+	void put(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "raw encoding needs trivially copyable types");
+		raw(&value, sizeof(T));
+	}
+
+	template<typename T>
+	void putArray(const T* items, uint32_t count) {
+		put(count);
+		if (count > 0) raw(items, sizeof(T) * count);
+	}
+
+	void putString(const char* string) {
+		uint32_t length = static_cast<uint32_t>(strlen(string));
+		put(length);
+		raw(string, length);
+	}
+};
+
+
+// Reads one record's payload. Throws on truncated records.
+class Decoder {
+public:
+	Decoder(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+	const uint8_t* raw(size_t count) {
+		if (pos + count > size) {
+			throw std::runtime_error("capture: truncated record!");
+		}
+		const uint8_t* out = data + pos;
+		pos += count;
+		return out;
+	}
+
+	template<typename T>
+	T get() {
+		T value;
+		memcpy(&value, raw(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	template<typename T>
+	std::vector<T> getArray() {
+		uint32_t count = get<uint32_t>();
+		std::vector<T> items(count);
+		if (count > 0) memcpy(items.data(), raw(sizeof(T) * count), sizeof(T) * count);
+		return items;
+	}
+
+	std::string getString() {
+		uint32_t length = get<uint32_t>();
+		const uint8_t* chars = raw(length);
+		return std::string(reinterpret_cast<const char*>(chars), length);
+	}
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+};
+
+
+class Recorder {
+public:
+	bool active() const { return file != nullptr; }
+
+	// Starts a capture. Everything created before this isn't known to the file.
+	void begin(const std::string& path, VkPhysicalDevice physicalDevice) {
+		file = fopen(path.c_str(), "wb");
+		if (!file) {
+			throw std::runtime_error("failed to open capture file " + path + "!");
+		}
+
+		fwrite(&MAGIC, sizeof(MAGIC), 1, file);
+		fwrite(&VERSION, sizeof(VERSION), 1, file);
+
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	}
+
+	void end() {
+		if (!file) return;
+
+		fclose(file);
+		file = nullptr;
+		ids.clear();
+		mapped.clear();
+		allocationSizes.clear();
+	}
+
+	// Assigns an id to a newly created object.
+	template<typename T>
+	uint32_t create(T handle) {
+		uint32_t newId = nextId++;
+		ids[handleKey(handle)] = newId;
+		return newId;
+	}
+
+	// Id of a known object, 0 for VK_NULL_HANDLE.
+	template<typename T>
+	uint32_t id(T handle) const {
+		if (handle == VK_NULL_HANDLE) return 0;
+
+		auto it = ids.find(handleKey(handle));
+		if (it == ids.end()) {
+			throw std::runtime_error("capture: object used that was created before the capture started!");
+		}
+		return it->second;
+	}
+
+	// Records a Destroy for a known object, ignores objects created before the capture.
+	template<typename T>
+	void destroy(T handle) {
+		if (handle == VK_NULL_HANDLE) return;
+
+		auto it = ids.find(handleKey(handle));
+		if (it == ids.end()) return;
+
+		start(Op::Destroy).put(it->second);
+		finish();
+		ids.erase(it);
+	}
+
+	Encoder& start(Op op) {
+		currentOp = op;
+		encoder.bytes.clear();
+		return encoder;
+	}
+
+	void finish() {
+		uint16_t op = static_cast<uint16_t>(currentOp);
+		uint32_t size = static_cast<uint32_t>(encoder.bytes.size());
+		fwrite(&op, sizeof(op), 1, file);
+		fwrite(&size, sizeof(size), 1, file);
+		fwrite(encoder.bytes.data(), 1, size, file);
+	}
+
+	VkMemoryPropertyFlags memoryTypeFlags(uint32_t memoryTypeIndex) const {
+		return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+	}
+
+	void onAllocate(VkDeviceMemory memory, VkDeviceSize size) {
+		allocationSizes[handleKey(memory)] = size;
+	}
+
+	void onFree(VkDeviceMemory memory) {
+		mapped.erase(handleKey(memory));
+		allocationSizes.erase(handleKey(memory));
+	}
+
+	VkDeviceSize allocationSize(VkDeviceMemory memory) const {
+		auto it = allocationSizes.find(handleKey(memory));
+		return it == allocationSizes.end() ? 0 : it->second;
+	}
+
+	void onMap(VkDeviceMemory memory, void* data, VkDeviceSize offset, VkDeviceSize size) {
+		// Replay zero fills on map, so the shadow starts out zeroed too
+		MappedRange& range = mapped[handleKey(memory)];
+		range.memory = memory;
+		range.data = static_cast<const uint8_t*>(data);
+		range.offset = offset;
+		range.shadow.assign(size, 0);
+	}
+
+	void onUnmap(VkDeviceMemory memory) {
+		auto it = mapped.find(handleKey(memory));
+		if (it == mapped.end()) return;
+
+		flush(it->second);
+		mapped.erase(it);
+	}
+
+	// Emits MemoryWrite records for everything the host changed since the last flush.
+	void flushMappedMemory() {
+		for (auto& entry : mapped) {
+			flush(entry.second);
+		}
+	}
+
+private:
+	// Diff granularity. Smaller finds tighter ranges, larger means fewer records.
+	static const size_t PAGE_SIZE = 256;
+
+	struct MappedRange {
+		VkDeviceMemory memory;
+		const uint8_t* data;
+		VkDeviceSize offset;
+		std::vector<uint8_t> shadow;
+	};
+
+	FILE* file = nullptr;
+	Encoder encoder;
+	Op currentOp = Op::Count;
+
+	std::unordered_map<uint64_t, uint32_t> ids;
+	uint32_t nextId = 1;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	std::unordered_map<uint64_t, VkDeviceSize> allocationSizes;
+	std::unordered_map<uint64_t, MappedRange> mapped;
+
+	void flush(MappedRange& range) {
+		size_t size = range.shadow.size();
+		size_t page = 0;
+
+		while (page < size) {
+			size_t pageEnd = std::min(page + PAGE_SIZE, size);
+			if (memcmp(range.data + page, range.shadow.data() + page, pageEnd - page) == 0) {
+				page = pageEnd;
+				continue;
+			}
+
+			// Coalesce consecutive dirty pages into one write
+			size_t runBegin = page;
+			while (page < size) {
+				pageEnd = std::min(page + PAGE_SIZE, size);
+				if (memcmp(range.data + page, range.shadow.data() + page, pageEnd - page) == 0) break;
+				page = pageEnd;
+			}
+
+			memcpy(range.shadow.data() + runBegin, range.data + runBegin, page - runBegin);
+
+			Encoder& e = start(Op::MemoryWrite);
+			e.put(id(range.memory));
+			e.put<VkDeviceSize>(range.offset + runBegin);
+			e.put<uint32_t>(static_cast<uint32_t>(page - runBegin));
+			e.raw(range.data + runBegin, page - runBegin);
+			finish();
+		}
+	}
+};
+
+
+inline Recorder& recorder() {
+	static Recorder instance;
+	return instance;
+}
+
+
+inline void requireNoNext(const void* pNext) {
+	if (pNext != nullptr) {
+		throw std::runtime_error("capture: pNext chains are not supported!");
+	}
+}
+
+
+/*
+* Wrappers. Same signatures as the Vulkan entry points they wrap.
+*/
+
+inline VkResult vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkSwapchainKHR* pSwapchain) {
+	VkResult result = ::vkCreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapchain);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		// Replay has no surface, it renders into plain images of the same format and size
+		Encoder& e = r.start(Op::CreateSwapchain);
+		e.put(r.create(*pSwapchain));
+		e.put(pCreateInfo->imageFormat);
+		e.put(pCreateInfo->imageExtent);
+		e.put(pCreateInfo->imageUsage);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline VkResult vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t* pCount, VkImage* pImages) {
+	VkResult result = ::vkGetSwapchainImagesKHR(device, swapchain, pCount, pImages);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS && pImages != nullptr) {
+		Encoder& e = r.start(Op::GetSwapchainImages);
+		e.put(r.id(swapchain));
+		e.put(*pCount);
+		for (uint32_t i = 0; i < *pCount; i++) {
+			e.put(r.create(pImages[i]));
+		}
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(swapchain);
+	::vkDestroySwapchainKHR(device, swapchain, pAllocator);
+}
+
+
+inline VkResult vkCreateImageView(VkDevice device, const VkImageViewCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkImageView* pView) {
+	VkResult result = ::vkCreateImageView(device, pCreateInfo, pAllocator, pView);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateImageView);
+		e.put(r.create(*pView));
+		e.put(r.id(pCreateInfo->image));
+		e.put(*pCreateInfo);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(imageView);
+	::vkDestroyImageView(device, imageView, pAllocator);
+}
+
+
+inline void putAttachmentReferences(Encoder& e, const VkAttachmentReference* references, uint32_t count) {
+	e.putArray(references, references ? count : 0);
+}
+
+
+inline VkResult vkCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkRenderPass* pRenderPass) {
+	VkResult result = ::vkCreateRenderPass(device, pCreateInfo, pAllocator, pRenderPass);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateRenderPass);
+		e.put(r.create(*pRenderPass));
+		e.put(pCreateInfo->flags);
+		e.putArray(pCreateInfo->pAttachments, pCreateInfo->attachmentCount);
+
+		e.put(pCreateInfo->subpassCount);
+		for (uint32_t i = 0; i < pCreateInfo->subpassCount; i++) {
+			const VkSubpassDescription& subpass = pCreateInfo->pSubpasses[i];
+			e.put(subpass.flags);
+			e.put(subpass.pipelineBindPoint);
+			putAttachmentReferences(e, subpass.pInputAttachments, subpass.inputAttachmentCount);
+			putAttachmentReferences(e, subpass.pColorAttachments, subpass.colorAttachmentCount);
+			putAttachmentReferences(e, subpass.pResolveAttachments, subpass.colorAttachmentCount);
+			putAttachmentReferences(e, subpass.pDepthStencilAttachment, 1);
+			e.putArray(subpass.pPreserveAttachments, subpass.preserveAttachmentCount);
+		}
+
+		e.putArray(pCreateInfo->pDependencies, pCreateInfo->dependencyCount);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(renderPass);
+	::vkDestroyRenderPass(device, renderPass, pAllocator);
+}
+
+
+inline VkResult vkCreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule) {
+	VkResult result = ::vkCreateShaderModule(device, pCreateInfo, pAllocator, pShaderModule);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateShaderModule);
+		e.put(r.create(*pShaderModule));
+		e.putArray(reinterpret_cast<const uint8_t*>(pCreateInfo->pCode), static_cast<uint32_t>(pCreateInfo->codeSize));
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyShaderModule(VkDevice device, VkShaderModule shaderModule, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(shaderModule);
+	::vkDestroyShaderModule(device, shaderModule, pAllocator);
+}
+
+
+inline VkResult vkCreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout) {
+	VkResult result = ::vkCreatePipelineLayout(device, pCreateInfo, pAllocator, pPipelineLayout);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreatePipelineLayout);
+		e.put(r.create(*pPipelineLayout));
+		e.put(pCreateInfo->setLayoutCount);
+		for (uint32_t i = 0; i < pCreateInfo->setLayoutCount; i++) {
+			e.put(r.id(pCreateInfo->pSetLayouts[i]));
+		}
+		e.putArray(pCreateInfo->pPushConstantRanges, pCreateInfo->pushConstantRangeCount);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(pipelineLayout);
+	::vkDestroyPipelineLayout(device, pipelineLayout, pAllocator);
+}
+
+
+// Optional sub-structs are written as a presence flag followed by the raw struct.
+template<typename T>
+void putOptional(Encoder& e, const T* value) {
+	e.put<uint8_t>(value != nullptr);
+	if (value) {
+		requireNoNext(value->pNext);
+		e.put(*value);
+	}
+}
+
+
+inline void putGraphicsPipeline(Recorder& r, Encoder& e, const VkGraphicsPipelineCreateInfo& info) {
+	requireNoNext(info.pNext);
+	if (info.pTessellationState) {
+		throw std::runtime_error("capture: tessellation is not supported!");
+	}
+
+	e.put(info.flags);
+
+	e.put(info.stageCount);
+	for (uint32_t i = 0; i < info.stageCount; i++) {
+		const VkPipelineShaderStageCreateInfo& stage = info.pStages[i];
+		requireNoNext(stage.pNext);
+		if (stage.pSpecializationInfo) {
+			throw std::runtime_error("capture: specialization constants are not supported!");
+		}
+
+		e.put(stage.flags);
+		e.put(stage.stage);
+		e.put(r.id(stage.module));
+		e.putString(stage.pName);
+	}
+
+	const VkPipelineVertexInputStateCreateInfo& vertexInput = *info.pVertexInputState;
+	requireNoNext(vertexInput.pNext);
+	e.putArray(vertexInput.pVertexBindingDescriptions, vertexInput.vertexBindingDescriptionCount);
+	e.putArray(vertexInput.pVertexAttributeDescriptions, vertexInput.vertexAttributeDescriptionCount);
+
+	putOptional(e, info.pInputAssemblyState);
+
+	e.put<uint8_t>(info.pViewportState != nullptr);
+	if (info.pViewportState) {
+		const VkPipelineViewportStateCreateInfo& viewport = *info.pViewportState;
+		requireNoNext(viewport.pNext);
+		e.put(viewport.viewportCount);
+		e.put(viewport.scissorCount);
+		e.putArray(viewport.pViewports, viewport.pViewports ? viewport.viewportCount : 0);
+		e.putArray(viewport.pScissors, viewport.pScissors ? viewport.scissorCount : 0);
+	}
+
+	putOptional(e, info.pRasterizationState);
+
+	if (info.pMultisampleState && info.pMultisampleState->pSampleMask) {
+		throw std::runtime_error("capture: sample masks are not supported!");
+	}
+	putOptional(e, info.pMultisampleState);
+	putOptional(e, info.pDepthStencilState);
+
+	e.put<uint8_t>(info.pColorBlendState != nullptr);
+	if (info.pColorBlendState) {
+		const VkPipelineColorBlendStateCreateInfo& blend = *info.pColorBlendState;
+		requireNoNext(blend.pNext);
+		e.put(blend.flags);
+		e.put(blend.logicOpEnable);
+		e.put(blend.logicOp);
+		e.putArray(blend.pAttachments, blend.attachmentCount);
+		e.put(blend.blendConstants);
+	}
+
+	uint32_t dynamicCount = info.pDynamicState ? info.pDynamicState->dynamicStateCount : 0;
+	e.putArray(info.pDynamicState ? info.pDynamicState->pDynamicStates : nullptr, dynamicCount);
+
+	e.put(r.id(info.layout));
+	e.put(r.id(info.renderPass));
+	e.put(info.subpass);
+}
+
+
+inline VkResult vkCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+	const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+	VkResult result = ::vkCreateGraphicsPipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		// One record per pipeline, replay doesn't use a pipeline cache
+		for (uint32_t i = 0; i < createInfoCount; i++) {
+			Encoder& e = r.start(Op::CreateGraphicsPipeline);
+			e.put(r.create(pPipelines[i]));
+			putGraphicsPipeline(r, e, pCreateInfos[i]);
+			r.finish();
+		}
+	}
+
+	return result;
+}
+
+
+inline VkResult vkCreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+	const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+	VkResult result = ::vkCreateComputePipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		for (uint32_t i = 0; i < createInfoCount; i++) {
+			const VkComputePipelineCreateInfo& info = pCreateInfos[i];
+			requireNoNext(info.pNext);
+			requireNoNext(info.stage.pNext);
+			if (info.stage.pSpecializationInfo) {
+				throw std::runtime_error("capture: specialization constants are not supported!");
+			}
+
+			Encoder& e = r.start(Op::CreateComputePipeline);
+			e.put(r.create(pPipelines[i]));
+			e.put(info.flags);
+			e.put(info.stage.flags);
+			e.put(r.id(info.stage.module));
+			e.putString(info.stage.pName);
+			e.put(r.id(info.layout));
+			r.finish();
+		}
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(pipeline);
+	::vkDestroyPipeline(device, pipeline, pAllocator);
+}
+
+
+inline VkResult vkCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkFramebuffer* pFramebuffer) {
+	VkResult result = ::vkCreateFramebuffer(device, pCreateInfo, pAllocator, pFramebuffer);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateFramebuffer);
+		e.put(r.create(*pFramebuffer));
+		e.put(pCreateInfo->flags);
+		e.put(r.id(pCreateInfo->renderPass));
+		e.put(pCreateInfo->attachmentCount);
+		for (uint32_t i = 0; i < pCreateInfo->attachmentCount; i++) {
+			e.put(r.id(pCreateInfo->pAttachments[i]));
+		}
+		e.put(pCreateInfo->width);
+		e.put(pCreateInfo->height);
+		e.put(pCreateInfo->layers);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(framebuffer);
+	::vkDestroyFramebuffer(device, framebuffer, pAllocator);
+}
+
+
+inline VkResult vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool) {
+	VkResult result = ::vkCreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		// Replay uses its own graphics queue family
+		Encoder& e = r.start(Op::CreateCommandPool);
+		e.put(r.create(*pCommandPool));
+		e.put(pCreateInfo->flags);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(commandPool);
+	::vkDestroyCommandPool(device, commandPool, pAllocator);
+}
+
+
+inline VkResult vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+	VkCommandBuffer* pCommandBuffers) {
+	VkResult result = ::vkAllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::AllocateCommandBuffers);
+		e.put(r.id(pAllocateInfo->commandPool));
+		e.put(pAllocateInfo->level);
+		e.put(pAllocateInfo->commandBufferCount);
+		for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+			e.put(r.create(pCommandBuffers[i]));
+		}
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool, uint32_t commandBufferCount,
+	const VkCommandBuffer* pCommandBuffers) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::FreeCommandBuffers);
+		e.put(r.id(commandPool));
+		e.put(commandBufferCount);
+		for (uint32_t i = 0; i < commandBufferCount; i++) {
+			e.put(r.id(pCommandBuffers[i]));
+		}
+		r.finish();
+	}
+
+	::vkFreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+
+inline VkResult vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore) {
+	VkResult result = ::vkCreateSemaphore(device, pCreateInfo, pAllocator, pSemaphore);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		r.start(Op::CreateSemaphore).put(r.create(*pSemaphore));
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(semaphore);
+	::vkDestroySemaphore(device, semaphore, pAllocator);
+}
+
+
+inline VkResult vkCreateFence(VkDevice device, const VkFenceCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkFence* pFence) {
+	VkResult result = ::vkCreateFence(device, pCreateInfo, pAllocator, pFence);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::CreateFence);
+		e.put(r.create(*pFence));
+		e.put(pCreateInfo->flags);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(fence);
+	::vkDestroyFence(device, fence, pAllocator);
+}
+
+
+inline VkResult vkCreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool) {
+	VkResult result = ::vkCreateQueryPool(device, pCreateInfo, pAllocator, pQueryPool);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::CreateQueryPool);
+		e.put(r.create(*pQueryPool));
+		e.put(pCreateInfo->queryType);
+		e.put(pCreateInfo->queryCount);
+		e.put(pCreateInfo->pipelineStatistics);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(queryPool);
+	::vkDestroyQueryPool(device, queryPool, pAllocator);
+}
+
+
+inline VkResult vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer) {
+	VkResult result = ::vkCreateBuffer(device, pCreateInfo, pAllocator, pBuffer);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateBuffer);
+		e.put(r.create(*pBuffer));
+		e.put(pCreateInfo->flags);
+		e.put(pCreateInfo->size);
+		e.put(pCreateInfo->usage);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(buffer);
+	::vkDestroyBuffer(device, buffer, pAllocator);
+}
+
+
+inline VkResult vkCreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkImage* pImage) {
+	VkResult result = ::vkCreateImage(device, pCreateInfo, pAllocator, pImage);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+		if (pCreateInfo->sharingMode != VK_SHARING_MODE_EXCLUSIVE) {
+			throw std::runtime_error("capture: concurrent sharing is not supported!");
+		}
+
+		Encoder& e = r.start(Op::CreateImage);
+		e.put(r.create(*pImage));
+		e.put(*pCreateInfo);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(image);
+	::vkDestroyImage(device, image, pAllocator);
+}
+
+
+inline VkResult vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+	const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+	VkResult result = ::vkAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pAllocateInfo->pNext);
+		r.onAllocate(*pMemory, pAllocateInfo->allocationSize);
+
+		// Property flags instead of the type index, replay picks a matching type on its device
+		Encoder& e = r.start(Op::AllocateMemory);
+		e.put(r.create(*pMemory));
+		e.put(pAllocateInfo->allocationSize);
+		e.put(r.memoryTypeFlags(pAllocateInfo->memoryTypeIndex));
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.onFree(memory);
+		r.destroy(memory);
+	}
+
+	::vkFreeMemory(device, memory, pAllocator);
+}
+
+
+inline VkResult vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+	VkResult result = ::vkBindBufferMemory(device, buffer, memory, memoryOffset);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::BindBufferMemory);
+		e.put(r.id(buffer));
+		e.put(r.id(memory));
+		e.put(memoryOffset);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline VkResult vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+	VkResult result = ::vkBindImageMemory(device, image, memory, memoryOffset);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::BindImageMemory);
+		e.put(r.id(image));
+		e.put(r.id(memory));
+		e.put(memoryOffset);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline VkResult vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+	VkFlags flags, void** ppData) {
+	VkResult result = ::vkMapMemory(device, memory, offset, size, flags, ppData);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		if (size == VK_WHOLE_SIZE) {
+			size = r.allocationSize(memory) - offset;
+		}
+
+		Encoder& e = r.start(Op::MapMemory);
+		e.put(r.id(memory));
+		e.put(offset);
+		e.put(size);
+		r.finish();
+
+		r.onMap(memory, *ppData, offset, size);
+	}
+
+	return result;
+}
+
+
+inline void vkUnmapMemory(VkDevice device, VkDeviceMemory memory) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.onUnmap(memory);
+		r.start(Op::UnmapMemory).put(r.id(memory));
+		r.finish();
+	}
+
+	::vkUnmapMemory(device, memory);
+}
+
+
+inline VkResult vkCreateSampler(VkDevice device, const VkSamplerCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkSampler* pSampler) {
+	VkResult result = ::vkCreateSampler(device, pCreateInfo, pAllocator, pSampler);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateSampler);
+		e.put(r.create(*pSampler));
+		e.put(*pCreateInfo);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(sampler);
+	::vkDestroySampler(device, sampler, pAllocator);
+}
+
+
+inline VkResult vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout) {
+	VkResult result = ::vkCreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+		for (uint32_t i = 0; i < pCreateInfo->bindingCount; i++) {
+			if (pCreateInfo->pBindings[i].pImmutableSamplers) {
+				throw std::runtime_error("capture: immutable samplers are not supported!");
+			}
+		}
+
+		Encoder& e = r.start(Op::CreateDescriptorSetLayout);
+		e.put(r.create(*pSetLayout));
+		e.put(pCreateInfo->flags);
+		e.putArray(pCreateInfo->pBindings, pCreateInfo->bindingCount);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout setLayout, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(setLayout);
+	::vkDestroyDescriptorSetLayout(device, setLayout, pAllocator);
+}
+
+
+inline VkResult vkCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkDescriptorPool* pDescriptorPool) {
+	VkResult result = ::vkCreateDescriptorPool(device, pCreateInfo, pAllocator, pDescriptorPool);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		requireNoNext(pCreateInfo->pNext);
+
+		Encoder& e = r.start(Op::CreateDescriptorPool);
+		e.put(r.create(*pDescriptorPool));
+		e.put(pCreateInfo->flags);
+		e.put(pCreateInfo->maxSets);
+		e.putArray(pCreateInfo->pPoolSizes, pCreateInfo->poolSizeCount);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks* pAllocator) {
+	recorder().destroy(descriptorPool);
+	::vkDestroyDescriptorPool(device, descriptorPool, pAllocator);
+}
+
+
+inline VkResult vkAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo,
+	VkDescriptorSet* pDescriptorSets) {
+	VkResult result = ::vkAllocateDescriptorSets(device, pAllocateInfo, pDescriptorSets);
+
+	Recorder& r = recorder();
+	if (r.active() && result == VK_SUCCESS) {
+		Encoder& e = r.start(Op::AllocateDescriptorSets);
+		e.put(r.id(pAllocateInfo->descriptorPool));
+		e.put(pAllocateInfo->descriptorSetCount);
+		for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+			e.put(r.id(pAllocateInfo->pSetLayouts[i]));
+			e.put(r.create(pDescriptorSets[i]));
+		}
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline void vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites,
+	uint32_t descriptorCopyCount, const VkCopyDescriptorSet* pDescriptorCopies) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		if (descriptorCopyCount > 0) {
+			throw std::runtime_error("capture: descriptor copies are not supported!");
+		}
+
+		Encoder& e = r.start(Op::UpdateDescriptorSets);
+		e.put(descriptorWriteCount);
+		for (uint32_t i = 0; i < descriptorWriteCount; i++) {
+			const VkWriteDescriptorSet& write = pDescriptorWrites[i];
+			requireNoNext(write.pNext);
+
+			e.put(r.id(write.dstSet));
+			e.put(write.dstBinding);
+			e.put(write.dstArrayElement);
+			e.put(write.descriptorType);
+			e.put(write.descriptorCount);
+
+			// Exactly one of the info arrays is used, depending on the descriptor type
+			e.put<uint8_t>(write.pImageInfo != nullptr);
+			for (uint32_t j = 0; write.pImageInfo && j < write.descriptorCount; j++) {
+				e.put(r.id(write.pImageInfo[j].sampler));
+				e.put(r.id(write.pImageInfo[j].imageView));
+				e.put(write.pImageInfo[j].imageLayout);
+			}
+
+			e.put<uint8_t>(write.pBufferInfo != nullptr);
+			for (uint32_t j = 0; write.pBufferInfo && j < write.descriptorCount; j++) {
+				e.put(r.id(write.pBufferInfo[j].buffer));
+				e.put(write.pBufferInfo[j].offset);
+				e.put(write.pBufferInfo[j].range);
+			}
+
+			if (write.pTexelBufferView) {
+				throw std::runtime_error("capture: texel buffer views are not supported!");
+			}
+		}
+		r.finish();
+	}
+
+	::vkUpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount, pDescriptorCopies);
+}
+
+
+inline VkResult vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		if (pBeginInfo->pInheritanceInfo) {
+			throw std::runtime_error("capture: secondary command buffers are not supported!");
+		}
+
+		Encoder& e = r.start(Op::BeginCommandBuffer);
+		e.put(r.id(commandBuffer));
+		e.put(pBeginInfo->flags);
+		r.finish();
+	}
+
+	return ::vkBeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+
+inline VkResult vkEndCommandBuffer(VkCommandBuffer commandBuffer) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.start(Op::EndCommandBuffer).put(r.id(commandBuffer));
+		r.finish();
+	}
+
+	return ::vkEndCommandBuffer(commandBuffer);
+}
+
+
+inline VkResult vkResetCommandBuffer(VkCommandBuffer commandBuffer, VkFlags flags) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::ResetCommandBuffer);
+		e.put(r.id(commandBuffer));
+		e.put(flags);
+		r.finish();
+	}
+
+	return ::vkResetCommandBuffer(commandBuffer, flags);
+}
+
+
+inline void vkCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdResetQueryPool);
+		e.put(r.id(commandBuffer));
+		e.put(r.id(queryPool));
+		e.put(firstQuery);
+		e.put(queryCount);
+		r.finish();
+	}
+
+	::vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, queryCount);
+}
+
+
+inline void vkCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin,
+	VkSubpassContents contents) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		requireNoNext(pRenderPassBegin->pNext);
+
+		Encoder& e = r.start(Op::CmdBeginRenderPass);
+		e.put(r.id(commandBuffer));
+		e.put(r.id(pRenderPassBegin->renderPass));
+		e.put(r.id(pRenderPassBegin->framebuffer));
+		e.put(pRenderPassBegin->renderArea);
+		e.putArray(pRenderPassBegin->pClearValues, pRenderPassBegin->clearValueCount);
+		e.put(contents);
+		r.finish();
+	}
+
+	::vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+}
+
+
+inline void vkCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.start(Op::CmdEndRenderPass).put(r.id(commandBuffer));
+		r.finish();
+	}
+
+	::vkCmdEndRenderPass(commandBuffer);
+}
+
+
+inline void vkCmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount,
+	const VkViewport* pViewports) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdSetViewport);
+		e.put(r.id(commandBuffer));
+		e.put(firstViewport);
+		e.putArray(pViewports, viewportCount);
+		r.finish();
+	}
+
+	::vkCmdSetViewport(commandBuffer, firstViewport, viewportCount, pViewports);
+}
+
+
+inline void vkCmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount,
+	const VkRect2D* pScissors) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdSetScissor);
+		e.put(r.id(commandBuffer));
+		e.put(firstScissor);
+		e.putArray(pScissors, scissorCount);
+		r.finish();
+	}
+
+	::vkCmdSetScissor(commandBuffer, firstScissor, scissorCount, pScissors);
+}
+
+
+inline void vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdBindPipeline);
+		e.put(r.id(commandBuffer));
+		e.put(pipelineBindPoint);
+		e.put(r.id(pipeline));
+		r.finish();
+	}
+
+	::vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+}
+
+
+inline void vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
+	uint32_t firstVertex, uint32_t firstInstance) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdDraw);
+		e.put(r.id(commandBuffer));
+		e.put(vertexCount);
+		e.put(instanceCount);
+		e.put(firstVertex);
+		e.put(firstInstance);
+		r.finish();
+	}
+
+	::vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+
+inline void vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+	VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets,
+	uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdBindDescriptorSets);
+		e.put(r.id(commandBuffer));
+		e.put(pipelineBindPoint);
+		e.put(r.id(layout));
+		e.put(firstSet);
+		e.put(descriptorSetCount);
+		for (uint32_t i = 0; i < descriptorSetCount; i++) {
+			e.put(r.id(pDescriptorSets[i]));
+		}
+		e.putArray(pDynamicOffsets, dynamicOffsetCount);
+		r.finish();
+	}
+
+	::vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets,
+		dynamicOffsetCount, pDynamicOffsets);
+}
+
+
+inline void vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+	uint32_t offset, uint32_t size, const void* pValues) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdPushConstants);
+		e.put(r.id(commandBuffer));
+		e.put(r.id(layout));
+		e.put(stageFlags);
+		e.put(offset);
+		e.putArray(static_cast<const uint8_t*>(pValues), size);
+		r.finish();
+	}
+
+	::vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+}
+
+
+inline void vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+	const VkBuffer* pBuffers, const VkDeviceSize* pOffsets) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdBindVertexBuffers);
+		e.put(r.id(commandBuffer));
+		e.put(firstBinding);
+		e.put(bindingCount);
+		for (uint32_t i = 0; i < bindingCount; i++) {
+			e.put(r.id(pBuffers[i]));
+			e.put(pOffsets[i]);
+		}
+		r.finish();
+	}
+
+	::vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+}
+
+
+inline void vkCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage,
+	VkQueryPool queryPool, uint32_t query) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdWriteTimestamp);
+		e.put(r.id(commandBuffer));
+		e.put(pipelineStage);
+		e.put(r.id(queryPool));
+		e.put(query);
+		r.finish();
+	}
+
+	::vkCmdWriteTimestamp(commandBuffer, pipelineStage, queryPool, query);
+}
+
+
+inline void vkCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdPipelineBarrier);
+		e.put(r.id(commandBuffer));
+		e.put(srcStageMask);
+		e.put(dstStageMask);
+		e.put(dependencyFlags);
+		e.putArray(pMemoryBarriers, memoryBarrierCount);
+
+		// Barriers are written raw with their handle replaced by an id next to them
+		e.put(bufferMemoryBarrierCount);
+		for (uint32_t i = 0; i < bufferMemoryBarrierCount; i++) {
+			requireNoNext(pBufferMemoryBarriers[i].pNext);
+			e.put(r.id(pBufferMemoryBarriers[i].buffer));
+			e.put(pBufferMemoryBarriers[i]);
+		}
+
+		e.put(imageMemoryBarrierCount);
+		for (uint32_t i = 0; i < imageMemoryBarrierCount; i++) {
+			requireNoNext(pImageMemoryBarriers[i].pNext);
+			e.put(r.id(pImageMemoryBarriers[i].image));
+			e.put(pImageMemoryBarriers[i]);
+		}
+		r.finish();
+	}
+
+	::vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+		memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers,
+		imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+
+inline void vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage,
+	VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy* pRegions) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdCopyBufferToImage);
+		e.put(r.id(commandBuffer));
+		e.put(r.id(srcBuffer));
+		e.put(r.id(dstImage));
+		e.put(dstImageLayout);
+		e.putArray(pRegions, regionCount);
+		r.finish();
+	}
+
+	::vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
+}
+
+
+inline void vkCmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdDispatch);
+		e.put(r.id(commandBuffer));
+		e.put(groupCountX);
+		e.put(groupCountY);
+		e.put(groupCountZ);
+		r.finish();
+	}
+
+	::vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+
+inline void vkCmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout,
+	VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageBlit* pRegions, VkFilter filter) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::CmdBlitImage);
+		e.put(r.id(commandBuffer));
+		e.put(r.id(srcImage));
+		e.put(srcImageLayout);
+		e.put(r.id(dstImage));
+		e.put(dstImageLayout);
+		e.putArray(pRegions, regionCount);
+		e.put(filter);
+		r.finish();
+	}
+
+	::vkCmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount, pRegions, filter);
+}
+
+
+inline VkResult vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		// Host writes have to reach the replay before the GPU work that reads them
+		r.flushMappedMemory();
+
+		Encoder& e = r.start(Op::QueueSubmit);
+		e.put(submitCount);
+		for (uint32_t i = 0; i < submitCount; i++) {
+			const VkSubmitInfo& submit = pSubmits[i];
+			requireNoNext(submit.pNext);
+
+			e.put(submit.waitSemaphoreCount);
+			for (uint32_t j = 0; j < submit.waitSemaphoreCount; j++) {
+				e.put(r.id(submit.pWaitSemaphores[j]));
+				e.put(submit.pWaitDstStageMask[j]);
+			}
+
+			e.put(submit.commandBufferCount);
+			for (uint32_t j = 0; j < submit.commandBufferCount; j++) {
+				e.put(r.id(submit.pCommandBuffers[j]));
+			}
+
+			e.put(submit.signalSemaphoreCount);
+			for (uint32_t j = 0; j < submit.signalSemaphoreCount; j++) {
+				e.put(r.id(submit.pSignalSemaphores[j]));
+			}
+		}
+		e.put(r.id(fence));
+		r.finish();
+	}
+
+	return ::vkQueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+
+inline VkResult vkQueueWaitIdle(VkQueue queue) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.start(Op::QueueWaitIdle);
+		r.finish();
+	}
+
+	return ::vkQueueWaitIdle(queue);
+}
+
+
+inline VkResult vkDeviceWaitIdle(VkDevice device) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		r.start(Op::DeviceWaitIdle);
+		r.finish();
+	}
+
+	return ::vkDeviceWaitIdle(device);
+}
+
+
+inline VkResult vkWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::WaitForFences);
+		e.put(fenceCount);
+		for (uint32_t i = 0; i < fenceCount; i++) {
+			e.put(r.id(pFences[i]));
+		}
+		e.put(waitAll);
+		r.finish();
+	}
+
+	return ::vkWaitForFences(device, fenceCount, pFences, waitAll, timeout);
+}
+
+
+inline VkResult vkResetFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::ResetFences);
+		e.put(fenceCount);
+		for (uint32_t i = 0; i < fenceCount; i++) {
+			e.put(r.id(pFences[i]));
+		}
+		r.finish();
+	}
+
+	return ::vkResetFences(device, fenceCount, pFences);
+}
+
+
+inline VkResult vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout,
+	VkSemaphore semaphore, VkFence fence, uint32_t* pImageIndex) {
+	VkResult result = ::vkAcquireNextImageKHR(device, swapchain, timeout, semaphore, fence, pImageIndex);
+
+	Recorder& r = recorder();
+	if (r.active() && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+		Encoder& e = r.start(Op::AcquireNextImage);
+		e.put(r.id(swapchain));
+		e.put(r.id(semaphore));
+		e.put(r.id(fence));
+		e.put(*pImageIndex);
+		r.finish();
+	}
+
+	return result;
+}
+
+
+inline VkResult vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
+	Recorder& r = recorder();
+	if (r.active()) {
+		Encoder& e = r.start(Op::QueuePresent);
+		e.put(pPresentInfo->swapchainCount);
+		for (uint32_t i = 0; i < pPresentInfo->swapchainCount; i++) {
+			e.put(r.id(pPresentInfo->pSwapchains[i]));
+			e.put(pPresentInfo->pImageIndices[i]);
+		}
+		r.finish();
+	}
+
+	return ::vkQueuePresentKHR(queue, pPresentInfo);
+}
+
+} // namespace capture
@@ -0,0 +1,213 @@
+/*
+* Clustered forward lighting: point lights binned into a froxel grid, screen tiles times
+* exponential depth slices, so a pixel only loops over the lights touching its cluster.
+* - Cluster x + GRID_X * (y + GRID_Y * slice) owns an (offset, count) range in one compact
+*   index list. shaders/bench_cluster.comp builds the same lists on the GPU, in the same
+*   three steps as binLights(): count, prefix sum, fill.
+* - Bounds are conservative: the sphere's view space box, divided by whichever end of its
+*   depth range makes it widest.
+* - binLights() is the CPU fallback. With SSE2 it transforms and bounds four lights at a time,
+*   the per cluster work is scalar either way.
+*/
+
+#pragma once
+
+#include "scene.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+namespace clusters {
+
+const uint32_t GRID_X = 16;
+const uint32_t GRID_Y = 16;
+const uint32_t GRID_Z = 24;
+const uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+// Laid out as the vec4 the shaders read
+struct Frustum {
+	float scaleX; // Projection m[0]
+	float scaleY; // Projection m[5] negated, positive
+	float nearPlane;
+	float farPlane;
+};
+
+inline Frustum frustum(float fovY, float aspect, float nearPlane, float farPlane) {
+	float f = 1.0f / std::tan(fovY / 2.0f);
+	return Frustum{f / aspect, f, nearPlane, farPlane};
+}
+
+struct Range {
+	uint32_t offset;
+	uint32_t count;
+};
+
+// Inclusive cluster box of one light
+struct Bounds {
+	uint32_t min[3];
+	uint32_t max[3];
+};
+
+inline uint32_t tile(float ndc, uint32_t size) {
+	float t = std::floor((ndc * 0.5f + 0.5f) * size);
+	return static_cast<uint32_t>(std::clamp(t, 0.0f, size - 1.0f));
+}
+
+inline uint32_t slice(float depth, const Frustum& f) {
+	float s = std::floor(std::log(depth / f.nearPlane) / std::log(f.farPlane / f.nearPlane) * GRID_Z);
+	return static_cast<uint32_t>(std::clamp(s, 0.0f, GRID_Z - 1.0f));
+}
+
+// From the sphere's NDC box and depth range, false when it misses the frustum.
+inline bool toBounds(float minX, float maxX, float minY, float maxY, float nearDepth, float farDepth,
+	const Frustum& f, Bounds& bounds) {
+	if (farDepth < f.nearPlane || nearDepth > f.farPlane) return false;
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) return false;
+
+	bounds = Bounds{
+		{tile(minX, GRID_X), tile(minY, GRID_Y), slice(std::max(nearDepth, f.nearPlane), f)},
+		{tile(maxX, GRID_X), tile(maxY, GRID_Y), slice(std::min(farDepth, f.farPlane), f)}
+	};
+	return true;
+}
+
+// x / depth over the sphere's depth range: negative ends are widest up close, positive ones too
+inline float widestLow(float v, float nearDepth, float farDepth) { return v < 0.0f ? v / nearDepth : v / farDepth; }
+inline float widestHigh(float v, float nearDepth, float farDepth) { return v > 0.0f ? v / nearDepth : v / farDepth; }
+
+inline bool lightBounds(const scene::PointLight& light, const scene::Mat4& view, const Frustum& f, Bounds& bounds) {
+	const float* m = view.m;
+	const float* p = light.position;
+	float x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+	float y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+	float depth = -(m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]);
+
+	float nearDepth = std::max(depth - light.radius, f.nearPlane);
+	float farDepth = depth + light.radius;
+	if (farDepth < f.nearPlane) return false;
+
+	// Clip space y points down
+	return toBounds(
+		widestLow(x - light.radius, nearDepth, farDepth) * f.scaleX,
+		widestHigh(x + light.radius, nearDepth, farDepth) * f.scaleX,
+		-widestHigh(y + light.radius, nearDepth, farDepth) * f.scaleY,
+		-widestLow(y - light.radius, nearDepth, farDepth) * f.scaleY,
+		nearDepth, farDepth, f, bounds);
+}
+
+
+struct LightLists {
+	std::vector<Range> ranges;
+	std::vector<uint32_t> indices;
+	uint32_t dropped = 0; // References past maxIndices, 0 unless the list is too small
+
+	// Scratch, kept between frames
+	std::vector<Bounds> bounds;
+	std::vector<uint8_t> visible;
+	std::vector<uint32_t> cursors;
+};
+
+#if defined(__SSE2__)
+// Four lights' bounds: the view transform and NDC box in SIMD, tiles and slices per light.
+inline void lightBounds4(const scene::PointLight* lights, const scene::Mat4& view, const Frustum& f,
+	Bounds* bounds, uint8_t* visible) {
+	const float* m = view.m;
+	__m128 px = _mm_setr_ps(lights[0].position[0], lights[1].position[0], lights[2].position[0], lights[3].position[0]);
+	__m128 py = _mm_setr_ps(lights[0].position[1], lights[1].position[1], lights[2].position[1], lights[3].position[1]);
+	__m128 pz = _mm_setr_ps(lights[0].position[2], lights[1].position[2], lights[2].position[2], lights[3].position[2]);
+	__m128 r = _mm_setr_ps(lights[0].radius, lights[1].radius, lights[2].radius, lights[3].radius);
+
+	auto row = [&](int i) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[i]), px), _mm_mul_ps(_mm_set1_ps(m[4 + i]), py)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[8 + i]), pz), _mm_set1_ps(m[12 + i])));
+	};
+	__m128 x = row(0);
+	__m128 y = row(1);
+	__m128 depth = _mm_sub_ps(_mm_setzero_ps(), row(2));
+
+	__m128 nearDepth = _mm_max_ps(_mm_sub_ps(depth, r), _mm_set1_ps(f.nearPlane));
+	__m128 farDepth = _mm_add_ps(depth, r);
+	// Lights behind the camera get a far depth that can't divide by zero, they're rejected below
+	__m128 safeFar = _mm_max_ps(farDepth, _mm_set1_ps(f.nearPlane));
+
+	auto widest = [&](__m128 v, bool high) {
+		__m128 zero = _mm_setzero_ps();
+		__m128 useNear = high ? _mm_cmpgt_ps(v, zero) : _mm_cmplt_ps(v, zero);
+		return _mm_or_ps(_mm_and_ps(useNear, _mm_div_ps(v, nearDepth)), _mm_andnot_ps(useNear, _mm_div_ps(v, safeFar)));
+	};
+	__m128 scaleX = _mm_set1_ps(f.scaleX);
+	__m128 scaleY = _mm_set1_ps(-f.scaleY);
+
+	alignas(16) float minX[4], maxX[4], minY[4], maxY[4], nearOut[4], farOut[4];
+	_mm_store_ps(minX, _mm_mul_ps(widest(_mm_sub_ps(x, r), false), scaleX));
+	_mm_store_ps(maxX, _mm_mul_ps(widest(_mm_add_ps(x, r), true), scaleX));
+	_mm_store_ps(minY, _mm_mul_ps(widest(_mm_add_ps(y, r), true), scaleY));
+	_mm_store_ps(maxY, _mm_mul_ps(widest(_mm_sub_ps(y, r), false), scaleY));
+	_mm_store_ps(nearOut, nearDepth);
+	_mm_store_ps(farOut, farDepth);
+
+	for (int i = 0; i < 4; i++) {
+		visible[i] = toBounds(minX[i], maxX[i], minY[i], maxY[i], nearOut[i], farOut[i], f, bounds[i]);
+	}
+}
+#endif
+
+// CPU binning, same lists as the GPU passes. Clusters past maxIndices get cut short.
+inline void binLights(const std::vector<scene::PointLight>& lights, const scene::Mat4& view, const Frustum& f,
+	uint32_t maxIndices, LightLists& lists) {
+	size_t count = lights.size();
+	lists.bounds.resize(count);
+	lists.visible.resize(count);
+	lists.ranges.assign(CLUSTER_COUNT, Range{0, 0});
+	lists.cursors.assign(CLUSTER_COUNT, 0);
+
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		lightBounds4(&lights[i], view, f, &lists.bounds[i], &lists.visible[i]);
+	}
+#endif
+	for (; i < count; i++) {
+		lists.visible[i] = lightBounds(lights[i], view, f, lists.bounds[i]);
+	}
+
+	auto forEachCluster = [&](const Bounds& b, auto&& visit) {
+		for (uint32_t z = b.min[2]; z <= b.max[2]; z++) {
+			for (uint32_t y = b.min[1]; y <= b.max[1]; y++) {
+				for (uint32_t x = b.min[0]; x <= b.max[0]; x++) visit(x + GRID_X * (y + GRID_Y * z));
+			}
+		}
+	};
+
+	for (i = 0; i < count; i++) {
+		if (lists.visible[i]) forEachCluster(lists.bounds[i], [&](uint32_t cluster) { lists.ranges[cluster].count++; });
+	}
+
+	uint32_t offset = 0;
+	lists.dropped = 0;
+	for (Range& range : lists.ranges) {
+		uint32_t wanted = range.count;
+		range.offset = offset;
+		range.count = std::min(wanted, maxIndices - std::min(offset, maxIndices));
+		lists.dropped += wanted - range.count;
+		offset += wanted;
+	}
+
+	lists.indices.resize(std::min(offset, maxIndices));
+	for (i = 0; i < count; i++) {
+		if (!lists.visible[i]) continue;
+		forEachCluster(lists.bounds[i], [&](uint32_t cluster) {
+			uint32_t slot = lists.cursors[cluster]++;
+			if (slot < lists.ranges[cluster].count) lists.indices[lists.ranges[cluster].offset + slot] = static_cast<uint32_t>(i);
+		});
+	}
+}
+
+} // namespace clusters
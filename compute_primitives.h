@@ -0,0 +1,422 @@
+/*
+* Parallel GPU primitives over uint32 storage buffers: reduction, exclusive prefix sum,
+* stream compaction and key-value radix sort. Recorded into the caller's command buffer.
+* - One compute pipeline, shaders/prims.comp, with the pass in a push constant. The
+*   workgroup size is a specialization constant, the largest of 256, 128 and 64 the device's
+*   limits and shared memory allow. Each workgroup owns a block of ITEMS_PER_THREAD elements
+*   per invocation.
+* - Devices with subgroup arithmetic in compute get the SUBGROUPS build of the shader, whose
+*   workgroup scan runs on subgroupInclusiveAdd instead of a shared memory ladder.
+* - Scans scan each block, scan the block totals the same way and add them back. Radix sort
+*   is 4 bits per pass: count digits per block, scan the digit-major counts, then scatter
+*   stably.
+* - Temporary memory comes from a scratch span the caller provides, sized by the
+*   *ScratchBytes() functions. Descriptor sets come from a pool that reset() empties once the
+*   GPU is done with the previous recording.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+
+namespace prims {
+
+// Must match prims.comp
+const uint32_t ITEMS_PER_THREAD = 4;
+const uint32_t RADIX_BITS = 4;
+const uint32_t RADIX = 1 << RADIX_BITS;
+
+enum Pass : uint32_t {
+	PASS_REDUCE,
+	PASS_SCAN,
+	PASS_ADD_BLOCK_OFFSETS,
+	PASS_COMPACT,
+	PASS_RADIX_COUNT,
+	PASS_RADIX_SCATTER
+};
+
+struct Push {
+	uint32_t pass;
+	uint32_t count;
+	uint32_t flags;
+	uint32_t shift;
+	uint32_t blockCount;
+};
+
+// A range of a storage buffer, in bytes
+struct Span {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+struct Config {
+	uint32_t workgroupSize = 64;
+	bool subgroups = false;
+	uint32_t subgroupSize = 1;
+	VkDeviceSize offsetAlignment = 256; // minStorageBufferOffsetAlignment
+};
+
+// Shared memory prims.comp declares for a workgroup size
+inline uint32_t sharedBytes(uint32_t workgroupSize) {
+	return ((RADIX + 1) * workgroupSize + RADIX + 1) * sizeof(uint32_t);
+}
+
+// The instance must be 1.1 or newer for subgroups
+inline Config chooseConfig(VkPhysicalDevice device, uint32_t instanceVersion) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	const VkPhysicalDeviceLimits& limits = properties.limits;
+
+	Config config;
+	config.offsetAlignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 4);
+	for (uint32_t size : {256u, 128u, 64u}) {
+		if (size <= limits.maxComputeWorkGroupSize[0] && size <= limits.maxComputeWorkGroupInvocations &&
+			sharedBytes(size) <= limits.maxComputeSharedMemorySize) {
+			config.workgroupSize = size;
+			break;
+		}
+	}
+
+	if (instanceVersion < VK_API_VERSION_1_1 || properties.apiVersion < VK_API_VERSION_1_1) return config;
+
+	VkPhysicalDeviceSubgroupProperties subgroup{};
+	subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &subgroup;
+	vkGetPhysicalDeviceProperties2(device, &properties2);
+
+	// Whole subgroups only, the scan takes each subgroup's last invocation as its total
+	VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+	config.subgroups = (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		(subgroup.supportedOperations & needed) == needed &&
+		subgroup.subgroupSize > 0 && config.workgroupSize % subgroup.subgroupSize == 0;
+	config.subgroupSize = config.subgroups ? subgroup.subgroupSize : 1;
+	return config;
+}
+
+inline const char* shaderPath(const Config& config) {
+	return config.subgroups ? "shaders/prims.comp.subgroup.spv" : "shaders/prims.comp.spv";
+}
+
+inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+
+class Primitives {
+public:
+	// code is the SPIR-V at shaderPath(config)
+	void create(VkDevice device, const Config& config, const std::vector<char>& code) {
+		this->device = device;
+		this->config = config;
+
+		VkDescriptorSetLayoutBinding bindings[BINDING_COUNT]{};
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = BINDING_COUNT;
+		layoutInfo.pBindings = bindings;
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+
+		VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push)};
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		VkShaderModule module;
+		if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+
+		VkSpecializationMapEntry workgroupSizeEntry{0, 0, sizeof(uint32_t)};
+		VkSpecializationInfo specialization{};
+		specialization.mapEntryCount = 1;
+		specialization.pMapEntries = &workgroupSizeEntry;
+		specialization.dataSize = sizeof(uint32_t);
+		specialization.pData = &this->config.workgroupSize;
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = module;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = &specialization;
+		pipelineInfo.layout = pipelineLayout;
+
+		VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		vkDestroyShaderModule(device, module, nullptr);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute primitives pipeline!");
+		}
+
+		VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_SETS * BINDING_COUNT};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = MAX_SETS;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+	}
+
+	void destroy() {
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	}
+
+	// Frees the descriptor sets of everything recorded so far. The GPU must be done with it.
+	void reset() {
+		vkResetDescriptorPool(device, descriptorPool, 0);
+	}
+
+	const Config& configuration() const { return config; }
+
+	uint32_t blockSize() const { return config.workgroupSize * ITEMS_PER_THREAD; }
+	uint32_t blockCount(uint32_t count) const { return (count + blockSize() - 1) / blockSize(); }
+
+	VkDeviceSize reduceScratchBytes(uint32_t count) const {
+		Scratch scratch = Scratch::measure(config.offsetAlignment);
+		reduceLevels(VK_NULL_HANDLE, Span{}, Span{}, count, scratch);
+		return scratch.used;
+	}
+
+	VkDeviceSize scanScratchBytes(uint32_t count) const {
+		Scratch scratch = Scratch::measure(config.offsetAlignment);
+		scanLevels(VK_NULL_HANDLE, Span{}, Span{}, count, 0, scratch);
+		return scratch.used;
+	}
+
+	VkDeviceSize compactScratchBytes(uint32_t count) const {
+		Scratch scratch = Scratch::measure(config.offsetAlignment);
+		compactPasses(VK_NULL_HANDLE, Span{}, Span{}, Span{}, count, scratch);
+		return scratch.used;
+	}
+
+	VkDeviceSize sortScratchBytes(uint32_t count, uint32_t keyBits = 32) const {
+		Scratch scratch = Scratch::measure(config.offsetAlignment);
+		sortPasses(VK_NULL_HANDLE, Span{}, Span{}, count, keyBits, scratch);
+		return scratch.used;
+	}
+
+	// out[0] = the sum of in's count elements, modulo 2^32
+	void reduce(VkCommandBuffer commandBuffer, Span in, Span out, uint32_t count, Span scratch) {
+		if (count == 0) {
+			vkCmdFillBuffer(commandBuffer, out.buffer, out.offset, sizeof(uint32_t), 0);
+			return;
+		}
+		Scratch allocator = Scratch::from(scratch, config.offsetAlignment);
+		reduceLevels(commandBuffer, in, out, count, allocator);
+	}
+
+	// out[i] = in[0] + ... + in[i - 1]. in and out may be the same span.
+	void exclusiveScan(VkCommandBuffer commandBuffer, Span in, Span out, uint32_t count, Span scratch) {
+		if (count == 0) return;
+		Scratch allocator = Scratch::from(scratch, config.offsetAlignment);
+		scanLevels(commandBuffer, in, out, count, 0, allocator);
+	}
+
+	// The nonzero elements of in, in order, to out, and how many there were to countOut[0]
+	void compact(VkCommandBuffer commandBuffer, Span in, Span out, Span countOut, uint32_t count, Span scratch) {
+		if (count == 0) {
+			vkCmdFillBuffer(commandBuffer, countOut.buffer, countOut.offset, sizeof(uint32_t), 0);
+			return;
+		}
+		Scratch allocator = Scratch::from(scratch, config.offsetAlignment);
+		compactPasses(commandBuffer, in, out, countOut, count, allocator);
+	}
+
+	// Sorts keys and carries values along, stable, in place. Only the low keyBits of the keys
+	// are sorted on.
+	void sortPairs(VkCommandBuffer commandBuffer, Span keys, Span values, uint32_t count, Span scratch, uint32_t keyBits = 32) {
+		if (count == 0) return;
+		Scratch allocator = Scratch::from(scratch, config.offsetAlignment);
+		sortPasses(commandBuffer, keys, values, count, keyBits, allocator);
+	}
+
+	// Shader writes before shader reads and writes, between passes and after the last one
+	static void barrier(VkCommandBuffer commandBuffer) {
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+private:
+	static const uint32_t BINDING_COUNT = 5;
+	static const uint32_t MAX_SETS = 512;
+
+	// Carves aligned ranges out of the scratch span. With no buffer it only adds up sizes,
+	// which is how the *ScratchBytes() functions get theirs.
+	struct Scratch {
+		Span span;
+		VkDeviceSize alignment;
+		VkDeviceSize used;
+
+		static Scratch measure(VkDeviceSize alignment) { return Scratch{Span{VK_NULL_HANDLE, 0, 0}, alignment, 0}; }
+		static Scratch from(Span span, VkDeviceSize alignment) { return Scratch{span, alignment, 0}; }
+
+		Span take(VkDeviceSize bytes) {
+			VkDeviceSize offset = alignUp(used, alignment);
+			used = offset + bytes;
+			if (span.buffer != VK_NULL_HANDLE && used > span.size) {
+				throw std::runtime_error("compute primitives scratch span is too small!");
+			}
+			return Span{span.buffer, span.offset + offset, bytes};
+		}
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	Config config;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+	// Bindings: source, destination, aux, source values, destination values. Unused ones
+	// repeat the source. Does nothing without a command buffer.
+	void dispatch(VkCommandBuffer commandBuffer, Push push, uint32_t groups, Span source, Span destination,
+		Span aux, Span sourceValues = Span{}, Span destinationValues = Span{}) const {
+		if (commandBuffer == VK_NULL_HANDLE) return;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+
+		VkDescriptorSet descriptorSet;
+		if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("compute primitives ran out of descriptor sets, reset() between submits!");
+		}
+
+		Span spans[BINDING_COUNT] = {source, destination, aux, sourceValues, destinationValues};
+		VkDescriptorBufferInfo bufferInfos[BINDING_COUNT];
+		VkWriteDescriptorSet writes[BINDING_COUNT]{};
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			Span span = spans[i].buffer != VK_NULL_HANDLE ? spans[i] : source;
+			bufferInfos[i] = VkDescriptorBufferInfo{span.buffer, span.offset, span.size};
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, BINDING_COUNT, writes, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &push);
+		vkCmdDispatch(commandBuffer, groups, 1, 1);
+	}
+
+	void reduceLevels(VkCommandBuffer commandBuffer, Span in, Span out, uint32_t count, Scratch& scratch) const {
+		while (true) {
+			uint32_t blocks = blockCount(count);
+			Span sums = blocks == 1 ? out : scratch.take(blocks * sizeof(uint32_t));
+			dispatch(commandBuffer, Push{PASS_REDUCE, count, 0, 0, blocks}, blocks, in, sums, in);
+			if (blocks == 1) return;
+
+			if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+			in = sums;
+			count = blocks;
+		}
+	}
+
+	// flags 1 scans (in != 0) instead of in
+	void scanLevels(VkCommandBuffer commandBuffer, Span in, Span out, uint32_t count, uint32_t flags, Scratch& scratch) const {
+		uint32_t blocks = blockCount(count);
+		Span totals = scratch.take(blocks * sizeof(uint32_t));
+		dispatch(commandBuffer, Push{PASS_SCAN, count, flags, 0, blocks}, blocks, in, out, totals);
+		if (blocks == 1) return;
+
+		if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+		scanLevels(commandBuffer, totals, totals, blocks, 0, scratch);
+		if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+		dispatch(commandBuffer, Push{PASS_ADD_BLOCK_OFFSETS, count, 0, 0, blocks}, blocks, out, out, totals);
+	}
+
+	void compactPasses(VkCommandBuffer commandBuffer, Span in, Span out, Span countOut, uint32_t count, Scratch& scratch) const {
+		Span offsets = scratch.take(count * sizeof(uint32_t));
+		scanLevels(commandBuffer, in, offsets, count, 1, scratch);
+		if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+
+		uint32_t blocks = blockCount(count);
+		dispatch(commandBuffer, Push{PASS_COMPACT, count, 0, 0, blocks}, blocks, in, out, offsets, in, countOut);
+	}
+
+	void sortPasses(VkCommandBuffer commandBuffer, Span keys, Span values, uint32_t count, uint32_t keyBits, Scratch& scratch) const {
+		uint32_t blocks = blockCount(count);
+		VkDeviceSize bytes = count * sizeof(uint32_t);
+		Span keysTemp = scratch.take(bytes);
+		Span valuesTemp = scratch.take(bytes);
+		Span histograms = scratch.take(RADIX * blocks * sizeof(uint32_t));
+
+		// Every pass scans the histograms with the same scratch after them
+		Scratch scanScratch = scratch;
+		uint32_t passes = (std::min(keyBits, 32u) + RADIX_BITS - 1) / RADIX_BITS;
+		for (uint32_t pass = 0; pass < passes; pass++) {
+			Span sourceKeys = pass % 2 == 0 ? keys : keysTemp;
+			Span sourceValues = pass % 2 == 0 ? values : valuesTemp;
+			Span destinationKeys = pass % 2 == 0 ? keysTemp : keys;
+			Span destinationValues = pass % 2 == 0 ? valuesTemp : values;
+			Push push{PASS_RADIX_COUNT, count, 0, pass * RADIX_BITS, blocks};
+
+			dispatch(commandBuffer, push, blocks, sourceKeys, sourceKeys, histograms);
+			if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+
+			scanScratch = scratch;
+			scanLevels(commandBuffer, histograms, histograms, RADIX * blocks, 0, scanScratch);
+			if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+
+			push.pass = PASS_RADIX_SCATTER;
+			dispatch(commandBuffer, push, blocks, sourceKeys, destinationKeys, histograms, sourceValues, destinationValues);
+			if (commandBuffer != VK_NULL_HANDLE) barrier(commandBuffer);
+		}
+		scratch = scanScratch;
+
+		// An odd pass count leaves the result in the temporaries
+		if (passes % 2 == 1 && commandBuffer != VK_NULL_HANDLE) {
+			VkBufferCopy keyCopy{keysTemp.offset, keys.offset, bytes};
+			VkBufferCopy valueCopy{valuesTemp.offset, values.offset, bytes};
+			vkCmdCopyBuffer(commandBuffer, keysTemp.buffer, keys.buffer, 1, &keyCopy);
+			vkCmdCopyBuffer(commandBuffer, valuesTemp.buffer, values.buffer, 1, &valueCopy);
+			barrier(commandBuffer);
+		}
+	}
+};
+
+} // namespace prims
@@ -0,0 +1,130 @@
+/*
+* Dynamic resolution: picks the scene's render scale each frame from measured GPU time.
+* - GPU time is assumed to grow with pixel count (scale squared). Each timing is turned into
+*   an estimated full resolution cost, smoothed, and the controller aims for the scale that
+*   lands just under the budget. Steps are rate limited, dropping faster than climbing.
+* - Render targets are allocated at full size once, a lower scale only shrinks the viewport.
+* - Trajectory keeps a decimated history of scale, resolution and GPU time for the report.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+
+namespace dynres {
+
+const float MIN_SCALE = 0.5f;
+const float MAX_SCALE = 1.0f;
+
+// 60 Hz with room for the CPU side and presentation
+const double DEFAULT_BUDGET_MS = 14.0;
+
+
+// Largest extent with the same aspect ratio at scale, at least one pixel.
+inline VkExtent2D scaledExtent(VkExtent2D full, float scale) {
+	return {
+		std::max(1u, static_cast<uint32_t>(full.width * scale + 0.5f)),
+		std::max(1u, static_cast<uint32_t>(full.height * scale + 0.5f))
+	};
+}
+
+
+class Controller {
+public:
+	explicit Controller(double budgetMs = DEFAULT_BUDGET_MS) : budgetMs(budgetMs) {}
+
+	// Feed one GPU frame time and the scale that frame was rendered at (timings arrive a few
+	// frames late, the scale may have moved since). Returns the scale for the next frame.
+	float update(double gpuMs, float renderedScale) {
+		if (gpuMs <= 0.0 || renderedScale <= 0.0f) return currentScale;
+
+		// Estimated cost of a full resolution frame, smoothed
+		double fullMs = gpuMs / (static_cast<double>(renderedScale) * renderedScale);
+		smoothed = hasSample ? smoothed + SMOOTHING * (fullMs - smoothed) : fullMs;
+		hasSample = true;
+
+		// Hold inside the band, so noise doesn't make the resolution hunt
+		double target = budgetMs * HEADROOM;
+		double predicted = smoothed * currentScale * currentScale;
+		if (predicted <= budgetMs && predicted >= target * (1.0 - DEADBAND)) return currentScale;
+
+		float wanted = static_cast<float>(std::sqrt(target / smoothed));
+		float step = std::clamp(wanted - currentScale, -MAX_STEP_DOWN, MAX_STEP_UP);
+		currentScale = std::clamp(currentScale + step, MIN_SCALE, MAX_SCALE);
+
+		return currentScale;
+	}
+
+	float scale() const { return currentScale; }
+	double fullResolutionGpuMs() const { return smoothed; }
+	double budget() const { return budgetMs; }
+
+private:
+	static constexpr double SMOOTHING = 0.2;
+	static constexpr double HEADROOM = 0.9;
+	static constexpr double DEADBAND = 0.1;
+	static constexpr float MAX_STEP_DOWN = 0.1f;
+	static constexpr float MAX_STEP_UP = 0.02f;
+
+	double budgetMs;
+	double smoothed = 0.0;
+	bool hasSample = false;
+	float currentScale = MAX_SCALE;
+};
+
+
+class Trajectory {
+public:
+	struct Sample {
+		uint64_t frame;
+		float scale;
+		VkExtent2D extent;
+		float gpuMs;
+	};
+
+	// Keeps every interval-th frame. When full, drops every other sample and doubles
+	// the interval, so a run of any length fits in fixed storage.
+	void record(uint64_t frame, float scale, VkExtent2D extent, double gpuMs) {
+		if (frame % interval != 0) return;
+
+		if (count == CAPACITY) {
+			for (uint32_t i = 0; i < CAPACITY / 2; i++) samples[i] = samples[i * 2];
+			count = CAPACITY / 2;
+			interval *= 2;
+			if (frame % interval != 0) return;
+		}
+
+		samples[count++] = Sample{frame, scale, extent, static_cast<float>(gpuMs)};
+	}
+
+	uint32_t size() const { return count; }
+
+	void print(std::ostream& out) const {
+		if (count == 0) return;
+
+		out << "Dynamic resolution (every " << interval << " frames):" << std::endl;
+		for (uint32_t i = 0; i < count; i++) {
+			char line[96];
+			snprintf(line, sizeof(line), "\tframe %6llu  %4ux%-4u  %5.1f%%  gpu %.3f ms",
+				static_cast<unsigned long long>(samples[i].frame), samples[i].extent.width, samples[i].extent.height,
+				samples[i].scale * 100.0f, samples[i].gpuMs);
+			out << line << std::endl;
+		}
+	}
+
+private:
+	static const uint32_t CAPACITY = 64;
+
+	Sample samples[CAPACITY];
+	uint32_t count = 0;
+	uint64_t interval = 1;
+};
+
+} // namespace dynres
@@ -0,0 +1,207 @@
+/*
+* Move-only owners for Vulkan objects, and a queue that defers destroying them until the
+* GPU is done with them.
+* - vkh::Unique holds the handle, its parent and the allocation callbacks. The destroy
+*   function is a template argument, so destruction is a direct call and nothing extra
+*   is allocated or dispatched.
+* - Objects that in-flight command buffers may still use go to DeletionQueue::retire()
+*   instead of being destroyed. collect() destroys them in one batch once the frame's
+*   fence has signaled, so swapping resources mid-run never needs vkDeviceWaitIdle.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "capture.h"
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace vkh {
+
+template<typename Parent, typename T>
+using DestroyFn = void (*)(Parent, T, const VkAllocationCallbacks*);
+
+
+template<typename Parent, typename T, DestroyFn<Parent, T> Destroy>
+class Unique {
+public:
+	Unique() = default;
+
+	// Takes ownership of a handle that was created successfully
+	Unique(Parent parent, T handle, const VkAllocationCallbacks* allocator)
+		: parent(parent), handle(handle), allocator(allocator) {}
+
+	~Unique() {
+		reset();
+	}
+
+	Unique(const Unique&) = delete;
+	Unique& operator=(const Unique&) = delete;
+
+	Unique(Unique&& other) noexcept
+		: parent(other.parent), handle(other.release()), allocator(other.allocator) {}
+
+	Unique& operator=(Unique&& other) noexcept {
+		if (this != &other) {
+			reset();
+			parent = other.parent;
+			allocator = other.allocator;
+			handle = other.release();
+		}
+		return *this;
+	}
+
+	operator T() const { return handle; }
+	T get() const { return handle; }
+	explicit operator bool() const { return handle != VK_NULL_HANDLE; }
+
+	// For info structs that take a pointer to a single handle
+	const T* address() const { return &handle; }
+
+	Parent owner() const { return parent; }
+	const VkAllocationCallbacks* callbacks() const { return allocator; }
+
+	// Gives up ownership without destroying
+	T release() {
+		T released = handle;
+		handle = VK_NULL_HANDLE;
+		return released;
+	}
+
+	void reset() {
+		if (handle != VK_NULL_HANDLE) {
+			Destroy(parent, handle, allocator);
+			handle = VK_NULL_HANDLE;
+		}
+	}
+
+private:
+	Parent parent{};
+	T handle = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+};
+
+
+/*
+* Destroy functions that don't match the (parent, handle, allocator) shape
+*/
+
+inline void destroyInstance(std::nullptr_t, VkInstance instance, const VkAllocationCallbacks* allocator) {
+	vkDestroyInstance(instance, allocator);
+}
+
+inline void destroyDevice(std::nullptr_t, VkDevice device, const VkAllocationCallbacks* allocator) {
+	vkDestroyDevice(device, allocator);
+}
+
+// Keeps device memory accounting in step, see memory_stats.h
+inline void freeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* allocator) {
+	memstats::deviceMemory().onFree(memory);
+	capture::vkFreeMemory(device, memory, allocator);
+}
+
+
+// Device children go through the capture wrappers, so captures see them destroyed.
+using Instance = Unique<std::nullptr_t, VkInstance, destroyInstance>;
+using Surface = Unique<VkInstance, VkSurfaceKHR, vkDestroySurfaceKHR>;
+using Device = Unique<std::nullptr_t, VkDevice, destroyDevice>;
+using Swapchain = Unique<VkDevice, VkSwapchainKHR, capture::vkDestroySwapchainKHR>;
+using Image = Unique<VkDevice, VkImage, capture::vkDestroyImage>;
+using ImageView = Unique<VkDevice, VkImageView, capture::vkDestroyImageView>;
+using Buffer = Unique<VkDevice, VkBuffer, capture::vkDestroyBuffer>;
+using DeviceMemory = Unique<VkDevice, VkDeviceMemory, freeMemory>;
+using Sampler = Unique<VkDevice, VkSampler, capture::vkDestroySampler>;
+using RenderPass = Unique<VkDevice, VkRenderPass, capture::vkDestroyRenderPass>;
+using Framebuffer = Unique<VkDevice, VkFramebuffer, capture::vkDestroyFramebuffer>;
+using ShaderModule = Unique<VkDevice, VkShaderModule, capture::vkDestroyShaderModule>;
+using PipelineLayout = Unique<VkDevice, VkPipelineLayout, capture::vkDestroyPipelineLayout>;
+using Pipeline = Unique<VkDevice, VkPipeline, capture::vkDestroyPipeline>;
+using DescriptorSetLayout = Unique<VkDevice, VkDescriptorSetLayout, capture::vkDestroyDescriptorSetLayout>;
+using DescriptorPool = Unique<VkDevice, VkDescriptorPool, capture::vkDestroyDescriptorPool>;
+using CommandPool = Unique<VkDevice, VkCommandPool, capture::vkDestroyCommandPool>;
+using Semaphore = Unique<VkDevice, VkSemaphore, capture::vkDestroySemaphore>;
+using Fence = Unique<VkDevice, VkFence, capture::vkDestroyFence>;
+using QueryPool = Unique<VkDevice, VkQueryPool, capture::vkDestroyQueryPool>;
+
+
+class DeletionQueue {
+public:
+	DeletionQueue() = default;
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	~DeletionQueue() {
+		flush();
+	}
+
+	// Destroys object once `frame` has completed on the GPU. Frames must not go backwards.
+	template<typename Parent, typename T, DestroyFn<Parent, T> Destroy>
+	void retire(Unique<Parent, T, Destroy>&& object, uint64_t frame) {
+		if (!object) return;
+
+		Parent parent = object.owner();
+		const VkAllocationCallbacks* allocator = object.callbacks();
+		T handle = object.release();
+
+		pending.push_back(Entry{frame, destroyEntry<Parent, T, Destroy>, toBits(parent), toBits(handle), allocator});
+	}
+
+	// The safe point: call once completedFrame's fence has signaled.
+	void collect(uint64_t completedFrame) {
+		size_t count = 0;
+		while (count < pending.size() && pending[count].frame <= completedFrame) {
+			const Entry& entry = pending[count++];
+			entry.destroy(entry.parent, entry.handle, entry.allocator);
+		}
+
+		// One erase per batch, the vector keeps its capacity
+		pending.erase(pending.begin(), pending.begin() + count);
+	}
+
+	// Everything, once the device is idle
+	void flush() {
+		collect(UINT64_MAX);
+	}
+
+	size_t size() const { return pending.size(); }
+
+private:
+	struct Entry {
+		uint64_t frame;
+		void (*destroy)(uint64_t parent, uint64_t handle, const VkAllocationCallbacks* allocator);
+		uint64_t parent;
+		uint64_t handle;
+		const VkAllocationCallbacks* allocator;
+	};
+
+	std::vector<Entry> pending;
+
+	// Non-dispatchable handles are pointers on 64-bit and uint64_t on 32-bit
+	template<typename T>
+	static uint64_t toBits(T value) {
+		if constexpr (std::is_pointer_v<T>) return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+		else if constexpr (std::is_same_v<T, std::nullptr_t>) return 0;
+		else return static_cast<uint64_t>(value);
+	}
+
+	template<typename T>
+	static T fromBits(uint64_t bits) {
+		if constexpr (std::is_pointer_v<T>) return reinterpret_cast<T>(static_cast<uintptr_t>(bits));
+		else if constexpr (std::is_same_v<T, std::nullptr_t>) return nullptr;
+		else return static_cast<T>(bits);
+	}
+
+	template<typename Parent, typename T, DestroyFn<Parent, T> Destroy>
+	static void destroyEntry(uint64_t parent, uint64_t handle, const VkAllocationCallbacks* allocator) {
+		Destroy(fromBits<Parent>(parent), fromBits<T>(handle), allocator);
+	}
+};
+
+} // namespace vkh
@@ -0,0 +1,102 @@
+/*
+* Checks for handles.h that need no device.
+* - Build and run with `make test`.
+* - Objects are fake fences with a destroy function that records what it destroyed.
+*/
+
+#include "handles.h"
+
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+
+std::vector<uint64_t> destroyed;
+
+// Non-dispatchable handles are pointers on 64-bit and uint64_t on 32-bit
+template<typename T = VkFence>
+T fakeFence(uint64_t id) {
+	if constexpr (std::is_pointer_v<T>) return reinterpret_cast<T>(static_cast<uintptr_t>(id));
+	else return static_cast<T>(id);
+}
+
+template<typename T>
+uint64_t fenceId(T fence) {
+	if constexpr (std::is_pointer_v<T>) return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(fence));
+	else return static_cast<uint64_t>(fence);
+}
+
+void destroyFakeFence(VkDevice, VkFence fence, const VkAllocationCallbacks*) {
+	destroyed.push_back(fenceId(fence));
+}
+
+using FakeFence = vkh::Unique<VkDevice, VkFence, destroyFakeFence>;
+
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+
+void testUniqueDestroysOnce() {
+	destroyed.clear();
+	{
+		FakeFence a(VK_NULL_HANDLE, fakeFence(1), nullptr);
+		FakeFence b = std::move(a);
+		check(!a && b, "move leaves the source empty");
+	}
+	check(destroyed == std::vector<uint64_t>{1}, "a moved object is destroyed once");
+}
+
+
+void testRetiredSurvivesUntilItsFrame() {
+	destroyed.clear();
+	vkh::DeletionQueue queue;
+
+	const uint64_t frame = 5;
+	queue.retire(FakeFence(VK_NULL_HANDLE, fakeFence(7), nullptr), frame);
+	check(destroyed.empty(), "retire doesn't destroy");
+
+	queue.collect(frame - 1);
+	check(destroyed.empty() && queue.size() == 1, "an object retired at frame N survives collect(N - 1)");
+
+	queue.collect(frame);
+	check(destroyed == std::vector<uint64_t>{7} && queue.size() == 0, "an object retired at frame N is destroyed by collect(N)");
+}
+
+
+void testCollectKeepsLaterFrames() {
+	destroyed.clear();
+	vkh::DeletionQueue queue;
+
+	queue.retire(FakeFence(VK_NULL_HANDLE, fakeFence(1), nullptr), 1);
+	queue.retire(FakeFence(VK_NULL_HANDLE, fakeFence(2), nullptr), 1);
+	queue.retire(FakeFence(VK_NULL_HANDLE, fakeFence(3), nullptr), 2);
+	queue.retire(FakeFence(), 2);
+	check(queue.size() == 3, "empty objects aren't queued");
+
+	queue.collect(1);
+	check(destroyed == (std::vector<uint64_t>{1, 2}), "collect destroys in retire order, up to its frame");
+
+	queue.flush();
+	check(destroyed == (std::vector<uint64_t>{1, 2, 3}) && queue.size() == 0, "flush destroys the rest");
+}
+
+
+int main() {
+	testUniqueDestroysOnce();
+	testRetiredSurvivesUntilItsFrame();
+	testCollectKeepsLaterFrames();
+
+	if (failures > 0) {
+		fprintf(stderr, "%d handles checks failed\n", failures);
+		return 1;
+	}
+	printf("handles checks passed\n");
+	return 0;
+}
@@ -0,0 +1,303 @@
+/*
+* Performance HUD, CPU side.
+* - Glyphs are a prebaked 3x5 pixel font, packed into a small R8 atlas at startup.
+* - Every frame Overlay::build() turns HudStats into one flat list of textured quads
+*   (6 vertices each) in a fixed size array, so the renderer can draw it with a single
+*   vkCmdDraw and building it never allocates.
+* - Overlay measures its own build time, shown on the HUD and reported at exit.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace hud {
+
+const uint32_t GLYPH_WIDTH = 3;
+const uint32_t GLYPH_HEIGHT = 5;
+const uint32_t CELL_WIDTH = GLYPH_WIDTH + 1; // 1 pixel padding so nearest sampling never bleeds
+const uint32_t CELL_HEIGHT = GLYPH_HEIGHT + 1;
+const uint32_t ATLAS_COLUMNS = 16;
+
+const uint32_t MAX_QUADS = 4096;
+const uint32_t MAX_VERTICES = MAX_QUADS * 6;
+const uint32_t HISTORY_SIZE = 120; // Frames shown in the frame time graph
+
+// CPU budget for building the HUD each frame.
+const double CPU_BUDGET_MS = 0.1;
+
+
+struct Glyph {
+	char character;
+	const char* rows; // GLYPH_HEIGHT rows of GLYPH_WIDTH pixels, '#' is set
+};
+
+// Lower case letters are drawn with the upper case glyphs. Index 0 is a solid block used for rectangles.
+const Glyph FONT[] = {
+	{'\0', "###" "###" "###" "###" "###"},
+	{' ', "..." "..." "..." "..." "..."},
+	{'0', "###" "#.#" "#.#" "#.#" "###"},
+	{'1', ".#." "##." ".#." ".#." "###"},
+	{'2', "###" "..#" "###" "#.." "###"},
+	{'3', "###" "..#" ".##" "..#" "###"},
+	{'4', "#.#" "#.#" "###" "..#" "..#"},
+	{'5', "###" "#.." "###" "..#" "###"},
+	{'6', "###" "#.." "###" "#.#" "###"},
+	{'7', "###" "..#" "..#" ".#." ".#."},
+	{'8', "###" "#.#" "###" "#.#" "###"},
+	{'9', "###" "#.#" "###" "..#" "###"},
+	{'A', ".#." "#.#" "###" "#.#" "#.#"},
+	{'B', "##." "#.#" "##." "#.#" "##."},
+	{'C', ".##" "#.." "#.." "#.." ".##"},
+	{'D', "##." "#.#" "#.#" "#.#" "##."},
+	{'E', "###" "#.." "##." "#.." "###"},
+	{'F', "###" "#.." "##." "#.." "#.."},
+	{'G', ".##" "#.." "#.#" "#.#" ".##"},
+	{'H', "#.#" "#.#" "###" "#.#" "#.#"},
+	{'I', "###" ".#." ".#." ".#." "###"},
+	{'J', "..#" "..#" "..#" "#.#" ".#."},
+	{'K', "#.#" "#.#" "##." "#.#" "#.#"},
+	{'L', "#.." "#.." "#.." "#.." "###"},
+	{'M', "#.#" "###" "###" "#.#" "#.#"},
+	{'N', "##." "#.#" "#.#" "#.#" "#.#"},
+	{'O', ".#." "#.#" "#.#" "#.#" ".#."},
+	{'P', "##." "#.#" "##." "#.." "#.."},
+	{'Q', ".#." "#.#" "#.#" "###" ".##"},
+	{'R', "##." "#.#" "##." "#.#" "#.#"},
+	{'S', ".##" "#.." ".#." "..#" "##."},
+	{'T', "###" ".#." ".#." ".#." ".#."},
+	{'U', "#.#" "#.#" "#.#" "#.#" "###"},
+	{'V', "#.#" "#.#" "#.#" "#.#" ".#."},
+	{'W', "#.#" "#.#" "###" "###" "#.#"},
+	{'X', "#.#" "#.#" ".#." "#.#" "#.#"},
+	{'Y', "#.#" "#.#" ".#." ".#." ".#."},
+	{'Z', "###" "..#" ".#." "#.." "###"},
+	{'.', "..." "..." "..." "..." ".#."},
+	{':', "..." ".#." "..." ".#." "..."},
+	{'/', "..#" "..#" ".#." "#.." "#.."},
+	{'%', "#.#" "..#" ".#." "#.." "#.#"},
+	{'-', "..." "..." "###" "..." "..."},
+	{'(', "..#" ".#." ".#." ".#." "..#"},
+	{')', "#.." ".#." ".#." ".#." "#.."},
+	{'_', "..." "..." "..." "..." "###"},
+};
+
+const uint32_t GLYPH_COUNT = sizeof(FONT) / sizeof(FONT[0]);
+const uint32_t ATLAS_WIDTH = ATLAS_COLUMNS * CELL_WIDTH;
+const uint32_t ATLAS_HEIGHT = (GLYPH_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS * CELL_HEIGHT;
+
+
+// R8 coverage, ATLAS_WIDTH x ATLAS_HEIGHT. Upload once as the HUD texture.
+inline std::vector<uint8_t> buildAtlas() {
+	std::vector<uint8_t> pixels(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+
+	for (uint32_t g = 0; g < GLYPH_COUNT; g++) {
+		uint32_t cellX = (g % ATLAS_COLUMNS) * CELL_WIDTH;
+		uint32_t cellY = (g / ATLAS_COLUMNS) * CELL_HEIGHT;
+
+		for (uint32_t y = 0; y < GLYPH_HEIGHT; y++) {
+			for (uint32_t x = 0; x < GLYPH_WIDTH; x++) {
+				if (FONT[g].rows[y * GLYPH_WIDTH + x] == '#') {
+					pixels[(cellY + y) * ATLAS_WIDTH + cellX + x] = 255;
+				}
+			}
+		}
+	}
+
+	return pixels;
+}
+
+
+// Matches the HUD pipeline's vertex input: position in pixels, atlas uv, RGBA8 color.
+struct Vertex {
+	float pos[2];
+	float uv[2];
+	uint32_t color;
+};
+
+
+inline uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+	return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) |
+		(static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+
+// Everything the HUD shows. Filled by the renderer each frame.
+struct HudStats {
+	double cpuFrameMs = 0.0;
+	double gpuScenePassMs = 0.0;
+	double gpuOutputPassMs = 0.0; // Upscale + HUD
+	bool gpuTimingsValid = false;
+	uint32_t renderWidth = 0;
+	uint32_t renderHeight = 0;
+	float renderScale = 1.0f;
+	uint32_t drawCount = 0;
+	int64_t hostBytes = 0;
+	uint64_t deviceBytes = 0;
+	uint64_t frameAllocations = 0;
+	uint64_t droppedZones = 0; // Profiler zones lost to full buffers, see profiler.h
+};
+
+
+class Overlay {
+public:
+	Overlay() {
+		// ASCII -> glyph index lookup, built once
+		for (uint32_t g = 1; g < GLYPH_COUNT; g++) {
+			glyphIndex[static_cast<unsigned char>(FONT[g].character)] = static_cast<uint8_t>(g);
+		}
+		for (char c = 'a'; c <= 'z'; c++) {
+			glyphIndex[static_cast<unsigned char>(c)] = glyphIndex[static_cast<unsigned char>(c - 'a' + 'A')];
+		}
+	}
+
+	// Builds this frame's quads. Call once per frame while visible, then upload vertices()/vertexCount().
+	void build(const HudStats& stats, float scale = 2.0f) {
+		auto begin = std::chrono::steady_clock::now();
+
+		history[historyNext] = static_cast<float>(stats.cpuFrameMs);
+		historyNext = (historyNext + 1) % HISTORY_SIZE;
+		historyCount = std::min(historyCount + 1, HISTORY_SIZE);
+
+		count = 0;
+		const float lineHeight = (CELL_HEIGHT + 1) * scale;
+		const float x = 8.0f;
+		float y = 8.0f;
+
+		uint32_t lines = stats.droppedZones > 0 ? 7 : 6;
+		rect(4.0f, 4.0f, 300.0f * scale / 2.0f + 8.0f, lineHeight * lines + 70.0f, rgba(0, 0, 0, 160));
+
+		char line[96];
+		double fps = stats.cpuFrameMs > 0.0 ? 1000.0 / stats.cpuFrameMs : 0.0;
+		snprintf(line, sizeof(line), "FPS %.1f  CPU %.2f MS", fps, stats.cpuFrameMs);
+		text(x, y, line, rgba(255, 255, 255), scale);
+		y += lineHeight;
+
+		if (stats.gpuTimingsValid) {
+			snprintf(line, sizeof(line), "GPU SCENE %.3f MS  OUT %.3f MS", stats.gpuScenePassMs, stats.gpuOutputPassMs);
+		} else {
+			snprintf(line, sizeof(line), "GPU TIMINGS N/A");
+		}
+		text(x, y, line, rgba(160, 220, 255), scale);
+		y += lineHeight;
+
+		snprintf(line, sizeof(line), "RES %uX%u  %.0f%%", stats.renderWidth, stats.renderHeight, stats.renderScale * 100.0f);
+		text(x, y, line, rgba(160, 220, 255), scale);
+		y += lineHeight;
+
+		snprintf(line, sizeof(line), "DRAWS %u  ALLOCS/FRAME %llu", stats.drawCount,
+			static_cast<unsigned long long>(stats.frameAllocations));
+		text(x, y, line, rgba(255, 255, 255), scale);
+		y += lineHeight;
+
+		snprintf(line, sizeof(line), "HOST %lld KB  DEVICE %llu KB",
+			static_cast<long long>(stats.hostBytes / 1024), static_cast<unsigned long long>(stats.deviceBytes / 1024));
+		text(x, y, line, rgba(255, 255, 255), scale);
+		y += lineHeight;
+
+		snprintf(line, sizeof(line), "HUD CPU %.4f MS", lastBuildMs);
+		text(x, y, line, lastBuildMs > CPU_BUDGET_MS ? rgba(255, 80, 80) : rgba(140, 255, 140), scale);
+		y += lineHeight;
+
+		if (stats.droppedZones > 0) {
+			snprintf(line, sizeof(line), "PROFILER DROPPED %llu ZONES", static_cast<unsigned long long>(stats.droppedZones));
+			text(x, y, line, rgba(255, 80, 80), scale);
+			y += lineHeight;
+		}
+		y += 4.0f;
+
+		frameGraph(x, y, HISTORY_SIZE * 2.0f, 60.0f);
+
+		auto end = std::chrono::steady_clock::now();
+		lastBuildMs = std::chrono::duration<double, std::milli>(end - begin).count();
+		totalBuildMs += lastBuildMs;
+		maxBuildMs = std::max(maxBuildMs, lastBuildMs);
+		builds++;
+	}
+
+	const Vertex* vertices() const { return vertexData; }
+	uint32_t vertexCount() const { return count; }
+
+	double lastBuildCpuMs() const { return lastBuildMs; }
+	double averageBuildCpuMs() const { return builds ? totalBuildMs / builds : 0.0; }
+	double maxBuildCpuMs() const { return maxBuildMs; }
+	uint64_t buildCount() const { return builds; }
+
+private:
+	Vertex vertexData[MAX_VERTICES];
+	uint32_t count = 0;
+	uint8_t glyphIndex[256] = {}; // 0 (solid block) for characters the font doesn't have
+
+	float history[HISTORY_SIZE] = {};
+	uint32_t historyNext = 0;
+	uint32_t historyCount = 0;
+
+	double lastBuildMs = 0.0;
+	double totalBuildMs = 0.0;
+	double maxBuildMs = 0.0;
+	uint64_t builds = 0;
+
+	void quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color) {
+		if (count + 6 > MAX_VERTICES) return;
+
+		Vertex* v = vertexData + count;
+		v[0] = {{x0, y0}, {u0, v0}, color};
+		v[1] = {{x1, y0}, {u1, v0}, color};
+		v[2] = {{x1, y1}, {u1, v1}, color};
+		v[3] = {{x0, y0}, {u0, v0}, color};
+		v[4] = {{x1, y1}, {u1, v1}, color};
+		v[5] = {{x0, y1}, {u0, v1}, color};
+		count += 6;
+	}
+
+	void glyphQuad(uint32_t glyph, float x, float y, float w, float h, uint32_t color) {
+		float u0 = static_cast<float>((glyph % ATLAS_COLUMNS) * CELL_WIDTH) / ATLAS_WIDTH;
+		float v0 = static_cast<float>((glyph / ATLAS_COLUMNS) * CELL_HEIGHT) / ATLAS_HEIGHT;
+		float u1 = u0 + static_cast<float>(GLYPH_WIDTH) / ATLAS_WIDTH;
+		float v1 = v0 + static_cast<float>(GLYPH_HEIGHT) / ATLAS_HEIGHT;
+
+		quad(x, y, x + w, y + h, u0, v0, u1, v1, color);
+	}
+
+	void rect(float x, float y, float w, float h, uint32_t color) {
+		glyphQuad(0, x, y, w, h, color);
+	}
+
+	void text(float x, float y, const char* str, uint32_t color, float scale) {
+		for (const char* c = str; *c != '\0'; c++) {
+			uint8_t glyph = glyphIndex[static_cast<unsigned char>(*c)];
+			if (*c != ' ') {
+				glyphQuad(glyph, x, y, GLYPH_WIDTH * scale, GLYPH_HEIGHT * scale, color);
+			}
+			x += CELL_WIDTH * scale;
+		}
+	}
+
+	// Bars of recent frame times, 0 to 33.3 ms, with a line at 16.7 ms.
+	void frameGraph(float x, float y, float w, float h) {
+		const float maxMs = 1000.0f / 30.0f;
+		const float barWidth = w / HISTORY_SIZE;
+
+		rect(x, y, w, h, rgba(40, 40, 40, 200));
+
+		for (uint32_t i = 0; i < historyCount; i++) {
+			// Oldest on the left
+			uint32_t index = (historyNext + HISTORY_SIZE - historyCount + i) % HISTORY_SIZE;
+			float ms = std::min(history[index], maxMs);
+			float barHeight = h * ms / maxMs;
+
+			uint32_t color = history[index] > 1000.0f / 60.0f ? rgba(255, 90, 60) : rgba(90, 220, 90);
+			rect(x + i * barWidth, y + h - barHeight, std::max(barWidth - 0.5f, 0.5f), barHeight, color);
+		}
+
+		rect(x, y + h - h * (1000.0f / 60.0f) / maxMs, w, 1.0f, rgba(255, 255, 255, 180));
+	}
+};
+
+} // namespace hud
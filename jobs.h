@@ -0,0 +1,162 @@
+/*
+* A small job system for CPU work split across cores.
+* - Worker threads take jobs from one shared queue. Jobs are coarse (thousands of items
+*   each), so one lock is not the bottleneck.
+* - spawn() adds a job to a Counter and wait() blocks until the counter drains. A waiting
+*   thread runs queued jobs in the meantime, so jobs can spawn and wait on their own
+*   children without running out of threads.
+* - The thread that calls wait() or parallelFor() works too. A JobSystem of 1 thread has no
+*   workers and runs everything on the caller, in the same order.
+* - A job that throws still counts as finished. The first exception of a group is kept on its
+*   Counter and rethrown by wait(), once the rest of the group is done.
+* - Every job is a "job" profiling zone on the thread that ran it, see profiler.h.
+*/
+
+#pragma once
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace jobs {
+
+// Jobs still pending in a group
+struct Counter {
+	std::atomic<uint32_t> pending{0};
+	std::mutex errorMutex;
+	std::exception_ptr error; // The first job that threw, see wait()
+
+	void fail(std::exception_ptr exception) {
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if (!error) error = exception;
+	}
+};
+
+class JobSystem {
+public:
+	// Threads including the caller, the machine's core count by default
+	explicit JobSystem(uint32_t threads = 0) {
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t i = 1; i < threads; i++) {
+			workers.emplace_back([this] { work(); });
+		}
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	void spawn(Counter& counter, std::function<void()> job) {
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(Job{std::move(job), &counter});
+		}
+		wake.notify_one();
+	}
+
+	// Runs other jobs until every job spawned on counter has finished, then rethrows the
+	// first exception one of them threw
+	void wait(Counter& counter) {
+		while (counter.pending.load(std::memory_order_acquire) > 0) {
+			if (!runOne()) std::this_thread::yield();
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(counter.errorMutex);
+			error = std::exchange(counter.error, nullptr);
+		}
+		if (error) std::rethrow_exception(error);
+	}
+
+	// body(begin, end) over [0, count) in chunks of at least grain items, about a few per thread
+	template <typename Body>
+	void parallelFor(uint32_t count, uint32_t grain, Body&& body) {
+		uint32_t chunk = std::max(grain, (count + threadCount() * 4 - 1) / (threadCount() * 4));
+		if (count <= chunk) {
+			if (count > 0) body(0u, count);
+			return;
+		}
+
+		Counter counter;
+		for (uint32_t begin = chunk; begin < count; begin += chunk) {
+			uint32_t end = std::min(count, begin + chunk);
+			spawn(counter, [&body, begin, end] { body(begin, end); });
+		}
+
+		// The spawned chunks use body and counter, so they finish even if this one throws
+		try {
+			PROFILE_ZONE("job");
+			body(0u, chunk);
+		} catch (...) {
+			counter.fail(std::current_exception());
+		}
+		wait(counter);
+	}
+
+private:
+	struct Job {
+		std::function<void()> run;
+		Counter* counter;
+	};
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Job> queue;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+
+	// False if there was nothing to run
+	bool runOne() {
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.empty()) return false;
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+		try {
+			PROFILE_ZONE("job");
+			job.run();
+		} catch (...) {
+			job.counter->fail(std::current_exception());
+		}
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void work() {
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (stopping && queue.empty()) return;
+			}
+			runOne();
+		}
+	}
+};
+
+} // namespace jobs
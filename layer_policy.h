@@ -0,0 +1,419 @@
+/*
+* Implicit layers: vkCreateInstance loads every implicit layer installed on the machine
+* (overlays, capture tools, device selectors) without the application asking for them.
+* - findImplicitLayers reads the manifests from the directories the Linux loader searches.
+* - audit times instance creation with no implicit layers, with each one alone and with
+*   everything as installed, so the cost of each layer is visible at startup.
+* - allowOnly filters the rest out through the loader's environment before the instance is
+*   created: VK_LOADER_LAYERS_DISABLE/ENABLE (loader 1.3.234+), and each manifest's own
+*   disable_environment variable for older loaders.
+* Explicit layers the application enables, like validation, aren't affected.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace layers {
+
+struct ImplicitLayer {
+	std::string name;
+	std::string manifest;
+	// Set to disableValue it turns the layer off, empty if the manifest has none
+	std::string disableVariable;
+	std::string disableValue;
+	// The layer only loads while this is set, empty if it always loads
+	std::string enableVariable;
+	std::string enableValue;
+};
+
+// A layer that waits for an enable variable, or was turned off with its disable variable,
+// doesn't load even when installed
+inline bool loadsByDefault(const ImplicitLayer& layer) {
+	if (!layer.disableVariable.empty() && getenv(layer.disableVariable.c_str()) != nullptr) return false;
+	return layer.enableVariable.empty() || getenv(layer.enableVariable.c_str()) != nullptr;
+}
+
+
+namespace detail {
+
+// Just enough JSON for layer manifests: objects, arrays and strings, anything else is
+// kept as its raw text.
+struct Json {
+	std::string text;
+	std::vector<std::pair<std::string, Json>> members;
+	std::vector<Json> elements;
+
+	const Json* find(const std::string& key) const {
+		for (const auto& member : members) {
+			if (member.first == key) return &member.second;
+		}
+		return nullptr;
+	}
+};
+
+class JsonReader {
+public:
+	explicit JsonReader(const std::string& source) : source(source) {}
+
+	Json value() {
+		skipSpace();
+		if (position >= source.size()) fail();
+
+		Json result;
+		char c = source[position];
+		if (c == '{') {
+			position++;
+			while (!consume('}')) {
+				if (!result.members.empty() && !consume(',')) fail();
+				skipSpace();
+				std::string key = string();
+				if (!consume(':')) fail();
+				result.members.emplace_back(std::move(key), value());
+			}
+		} else if (c == '[') {
+			position++;
+			while (!consume(']')) {
+				if (!result.elements.empty() && !consume(',')) fail();
+				result.elements.push_back(value());
+			}
+		} else if (c == '"') {
+			result.text = string();
+		} else {
+			size_t end = source.find_first_of(",}] \t\r\n", position);
+			end = end == std::string::npos ? source.size() : end;
+			result.text = source.substr(position, end - position);
+			position = end;
+		}
+		return result;
+	}
+
+private:
+	const std::string& source;
+	size_t position = 0;
+
+	[[noreturn]] void fail() {
+		throw std::runtime_error("malformed layer manifest!");
+	}
+
+	void skipSpace() {
+		while (position < source.size() && isspace(static_cast<unsigned char>(source[position]))) position++;
+	}
+
+	bool consume(char c) {
+		skipSpace();
+		if (position < source.size() && source[position] == c) {
+			position++;
+			return true;
+		}
+		return false;
+	}
+
+	// Escapes are kept as written, layer names and variables don't use them
+	std::string string() {
+		if (position >= source.size() || source[position] != '"') fail();
+		size_t start = ++position;
+		while (position < source.size() && source[position] != '"') {
+			position += source[position] == '\\' ? 2 : 1;
+		}
+		if (position >= source.size()) fail();
+		return source.substr(start, position++ - start);
+	}
+};
+
+// First member of an object like "disable_environment": { "DISABLE_MY_LAYER": "1" }
+inline void readVariable(const Json* object, std::string& variable, std::string& value) {
+	if (object == nullptr || object->members.empty()) return;
+	variable = object->members[0].first;
+	value = object->members[0].second.text;
+}
+
+inline void readManifest(const std::filesystem::path& path, std::vector<ImplicitLayer>& found) {
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string source = contents.str();
+
+	Json root = JsonReader(source).value();
+
+	// Manifests hold one "layer" or, since format 1.0.1, a "layers" array
+	std::vector<const Json*> entries;
+	if (const Json* layer = root.find("layer")) entries.push_back(layer);
+	if (const Json* list = root.find("layers")) {
+		for (const Json& layer : list->elements) entries.push_back(&layer);
+	}
+
+	for (const Json* entry : entries) {
+		const Json* name = entry->find("name");
+		if (name == nullptr || name->text.empty()) continue;
+
+		// The first manifest found wins, as in the loader
+		bool seen = std::any_of(found.begin(), found.end(),
+			[&](const ImplicitLayer& layer) { return layer.name == name->text; });
+		if (seen) continue;
+
+		ImplicitLayer layer{};
+		layer.name = name->text;
+		layer.manifest = path.string();
+		readVariable(entry->find("disable_environment"), layer.disableVariable, layer.disableValue);
+		readVariable(entry->find("enable_environment"), layer.enableVariable, layer.enableValue);
+		found.push_back(layer);
+	}
+}
+
+inline std::vector<std::string> splitList(const std::string& list, char separator) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, separator)) {
+		if (!item.empty()) items.push_back(item);
+	}
+	return items;
+}
+
+inline std::string joinList(const std::vector<std::string>& items) {
+	std::string list;
+	for (const std::string& item : items) {
+		list += (list.empty() ? "" : ",") + item;
+	}
+	return list;
+}
+
+inline std::string environment(const char* name, const std::string& fallback) {
+	const char* value = getenv(name);
+	return value != nullptr && *value != '\0' ? value : fallback;
+}
+
+} // namespace detail
+
+
+// Where the Linux loader looks for implicit layer manifests, in its search order
+inline std::vector<std::string> manifestDirectories() {
+	std::string home = detail::environment("HOME", "");
+	std::vector<std::string> roots;
+
+	roots.push_back(detail::environment("XDG_CONFIG_HOME", home + "/.config"));
+	for (const std::string& dir : detail::splitList(detail::environment("XDG_CONFIG_DIRS", "/etc/xdg"), ':')) {
+		roots.push_back(dir);
+	}
+	roots.push_back("/etc");
+	roots.push_back(detail::environment("XDG_DATA_HOME", home + "/.local/share"));
+	for (const std::string& dir : detail::splitList(detail::environment("XDG_DATA_DIRS", "/usr/local/share:/usr/share"), ':')) {
+		roots.push_back(dir);
+	}
+
+	std::vector<std::string> directories = detail::splitList(detail::environment("VK_ADD_IMPLICIT_LAYER_PATH", ""), ':');
+	for (const std::string& root : roots) {
+		directories.push_back(root + "/vulkan/implicit_layer.d");
+	}
+	return directories;
+}
+
+// Manifests that can't be read are skipped with a warning, a broken overlay shouldn't
+// stop the application from starting
+inline std::vector<ImplicitLayer> findImplicitLayers() {
+	std::vector<ImplicitLayer> found;
+	for (const std::string& directory : manifestDirectories()) {
+		std::error_code error;
+		if (!std::filesystem::is_directory(directory, error)) continue;
+
+		// The loader reads a directory in no particular order, sorting keeps runs comparable
+		std::vector<std::filesystem::path> manifests;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (entry.path().extension() == ".json") manifests.push_back(entry.path());
+		}
+		std::sort(manifests.begin(), manifests.end());
+
+		for (const auto& manifest : manifests) {
+			try {
+				detail::readManifest(manifest, found);
+			} catch (const std::exception& e) {
+				std::cerr << "skipping " << manifest.string() << ": " << e.what() << std::endl;
+			}
+		}
+	}
+	return found;
+}
+
+
+// Sets variables and puts the previous values back when it goes out of scope
+class ScopedEnvironment {
+public:
+	ScopedEnvironment() = default;
+	ScopedEnvironment(const ScopedEnvironment&) = delete;
+	ScopedEnvironment& operator=(const ScopedEnvironment&) = delete;
+
+	~ScopedEnvironment() {
+		for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+			if (it->second) setenv(it->first.c_str(), it->second->c_str(), 1);
+			else unsetenv(it->first.c_str());
+		}
+	}
+
+	void set(const std::string& name, const std::string& value) {
+		save(name);
+		setenv(name.c_str(), value.c_str(), 1);
+	}
+
+	void unset(const std::string& name) {
+		save(name);
+		unsetenv(name.c_str());
+	}
+
+private:
+	std::vector<std::pair<std::string, std::optional<std::string>>> saved;
+
+	void save(const std::string& name) {
+		const char* value = getenv(name.c_str());
+		saved.emplace_back(name, value != nullptr ? std::optional<std::string>(value) : std::nullopt);
+	}
+};
+
+
+// Only the allowed implicit layers load into instances created after this, and only if
+// they would have loaded anyway. Returns the layers that were filtered out. Lasts for the
+// process, the loader reads the environment on every vkCreateInstance.
+inline std::vector<std::string> allowOnly(const std::vector<std::string>& allowed, const std::vector<ImplicitLayer>& installed) {
+	std::vector<std::string> enabled = detail::splitList(detail::environment("VK_LOADER_LAYERS_ENABLE", ""), ',');
+	std::vector<std::string> filtered;
+
+	for (const ImplicitLayer& layer : installed) {
+		bool allow = std::find(allowed.begin(), allowed.end(), layer.name) != allowed.end();
+		if (allow) {
+			if (loadsByDefault(layer)) enabled.push_back(layer.name);
+			continue;
+		}
+
+		if (!layer.disableVariable.empty()) {
+			setenv(layer.disableVariable.c_str(), layer.disableValue.empty() ? "1" : layer.disableValue.c_str(), 1);
+		}
+		filtered.push_back(layer.name);
+	}
+
+	setenv("VK_LOADER_LAYERS_DISABLE", "~implicit~", 1);
+	if (!enabled.empty()) {
+		setenv("VK_LOADER_LAYERS_ENABLE", detail::joinList(enabled).c_str(), 1);
+	}
+	return filtered;
+}
+
+
+// Median time of creating and destroying a bare instance, in milliseconds
+inline double timeInstanceCreation(uint32_t repetitions) {
+	VkApplicationInfo appInfo{};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Layer Audit";
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+
+	std::vector<double> times;
+	for (uint32_t i = 0; i < std::max(repetitions, 1u); i++) {
+		auto start = std::chrono::steady_clock::now();
+
+		VkInstance instance;
+		if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create instance for the layer audit!");
+		}
+		vkDestroyInstance(instance, nullptr);
+
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+
+struct LayerCost {
+	ImplicitLayer layer;
+	bool loadsByDefault;
+	double instanceMs; // Instance creation with only this implicit layer
+	double overheadMs; // What the layer adds to instance creation with none
+};
+
+struct Audit {
+	double withoutLayersMs;
+	double asInstalledMs;
+	std::vector<LayerCost> layers;
+};
+
+// Leaves the environment as it found it
+inline Audit audit(const std::vector<ImplicitLayer>& installed, uint32_t repetitions = 5) {
+	Audit result{};
+	result.asInstalledMs = timeInstanceCreation(repetitions);
+
+	// Both ways of turning layers off, whichever the installed loader understands
+	auto disableAll = [&](ScopedEnvironment& environment) {
+		environment.set("VK_LOADER_LAYERS_DISABLE", "~implicit~");
+		environment.unset("VK_LOADER_LAYERS_ENABLE");
+		for (const ImplicitLayer& layer : installed) {
+			if (layer.disableVariable.empty()) continue;
+			environment.set(layer.disableVariable, layer.disableValue.empty() ? "1" : layer.disableValue);
+		}
+	};
+
+	{
+		ScopedEnvironment environment;
+		disableAll(environment);
+		result.withoutLayersMs = timeInstanceCreation(repetitions);
+	}
+
+	for (const ImplicitLayer& layer : installed) {
+		ScopedEnvironment environment;
+		disableAll(environment);
+		environment.set("VK_LOADER_LAYERS_ENABLE", layer.name);
+		if (!layer.disableVariable.empty()) environment.unset(layer.disableVariable);
+		if (!layer.enableVariable.empty()) {
+			environment.set(layer.enableVariable, layer.enableValue.empty() ? "1" : layer.enableValue);
+		}
+
+		LayerCost cost{};
+		cost.layer = layer;
+		cost.loadsByDefault = loadsByDefault(layer);
+		cost.instanceMs = timeInstanceCreation(repetitions);
+		cost.overheadMs = cost.instanceMs - result.withoutLayersMs;
+		result.layers.push_back(cost);
+	}
+
+	// Most expensive first
+	std::sort(result.layers.begin(), result.layers.end(),
+		[](const LayerCost& a, const LayerCost& b) { return a.overheadMs > b.overheadMs; });
+	return result;
+}
+
+inline void printAudit(const Audit& audit, std::ostream& out) {
+	out << "Implicit layers: " << audit.layers.size()
+		<< ", instance creation " << audit.withoutLayersMs << " ms without them, "
+		<< audit.asInstalledMs << " ms as installed" << std::endl;
+
+	for (const LayerCost& cost : audit.layers) {
+		out << "\t" << cost.layer.name << ": " << (cost.overheadMs >= 0.0 ? "+" : "") << cost.overheadMs << " ms";
+		if (!cost.loadsByDefault) {
+			out << " (not loaded";
+			if (!cost.layer.enableVariable.empty()) out << ", waits for " << cost.layer.enableVariable;
+			out << ")";
+		}
+		out << "\n\t\t" << cost.layer.manifest << std::endl;
+	}
+}
+
+} // namespace layers
@@ -10,17 +10,47 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#define MEMORY_STATS_HOOK_NEW
+#include "memory_stats.h"
+#include "accel.h"
+#include "capture.h"
+#include "dynamic_resolution.h"
+#include "handles.h"
+#include "hud.h"
+#include "layer_policy.h"
+#include "metrics_exporter.h"
+#include "msaa.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "upscaler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// Scene begin/end, output (upscale + HUD) begin/end
+const uint32_t TIMESTAMPS_PER_FRAME = 4;
+
+const int HUD_TOGGLE_KEY = GLFW_KEY_F1;
+// Switches between the balanced and quality upscale presets while running
+const int UPSCALE_PRESET_KEY = GLFW_KEY_F2;
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -29,13 +59,27 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Validation and instrumentation are fixed at compile time. The application is a template
+// on one of these, so what a policy turns off compiles out of the frame loop.
+struct DebugPolicy {
+	static constexpr const char* name = "debug";
+	static constexpr bool validation = true; // Validation layer and debug messenger
+	static constexpr bool logExtensions = true; // Print the instance extensions at startup
+	static constexpr bool debugLabels = true; // Named command buffer regions for capture tools
+};
+
+struct ReleasePolicy {
+	static constexpr const char* name = "release";
+	static constexpr bool validation = false;
+	static constexpr bool logExtensions = false;
+	static constexpr bool debugLabels = false;
+};
+
 //#define NDEBUG
 #ifdef NDEBUG
-	const bool log_extensions = false;
-	const bool enableValidationLayers = false;
-#else 
-	const bool log_extensions = true;
-	const bool enableValidationLayers = true;
+	using DefaultPolicy = ReleasePolicy;
+#else
+	using DefaultPolicy = DebugPolicy;
 #endif
 
 
@@ -70,20 +114,74 @@ void DestroyDebugUtilsMessengerEXT(
 	}
 }
 
+using UniqueDebugMessenger = vkh::Unique<VkInstance, VkDebugUtilsMessengerEXT, DestroyDebugUtilsMessengerEXT>;
+
 
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
 
 	bool isComplete() {
-		return graphicsFamily.has_value();
+		return graphicsFamily.has_value() && presentFamily.has_value();
 	}
 };
 
 
+struct SwapChainSupportDetails {
+	VkSurfaceCapabilitiesKHR capabilities;
+	std::vector<VkSurfaceFormatKHR> formats;
+	std::vector<VkPresentModeKHR> presentModes;
+};
+
+
+// One window and everything that presents to it. Every output shares the device, the
+// render passes and the scene, and has the same swap chain format and extent.
+struct Output {
+	GLFWwindow* window = nullptr;
+	vkh::Surface surface;
+
+	vkh::Swapchain swapChain;
+	std::vector<VkImage> images;
+	std::vector<vkh::ImageView> imageViews;
+	std::vector<vkh::Framebuffer> framebuffers;
+
+	// Per frame in flight
+	std::vector<vkh::Semaphore> imageAvailableSemaphores;
+	std::vector<vkh::Semaphore> renderFinishedSemaphores;
+
+	// This frame's image, if acquiring one succeeded
+	uint32_t imageIndex = 0;
+	bool acquired = false;
+};
+
+
+static std::vector<char> readFile(const std::string& filename) {
+	// Start at the end so tellg() gives the file size
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open file " + filename + "!");
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+
+	return buffer;
+}
+
+
+template <typename Policy>
 class HelloTriangleApplication {
+	// Labels come from VK_EXT_debug_utils, which is only enabled along with validation
+	static_assert(Policy::validation || !Policy::debugLabels, "debug labels need validation enabled!");
+
 public:
 	void run() {
+		PROFILE_ZONE("run");
+
 		initWindow();
 		initVulkan();
 		mainLoop();
@@ -91,63 +189,412 @@ public:
 	}
 
 
+	// Serve Prometheus metrics on a Unix socket at path, see metrics_exporter.h
+	void enableMetrics(const std::string& path) {
+		metricsSocketPath = path;
+	}
+
+	// GPU frame time the dynamic resolution controller aims for, see dynamic_resolution.h
+	void setGpuBudget(double ms) {
+		resolutionController = dynres::Controller(ms);
+	}
+
+	// Record every Vulkan call after device creation to path, see capture.h
+	void enableCapture(const std::string& path) {
+		capturePath = path;
+	}
+
+	// Most samples per pixel for the scene, the device may support fewer. 1 turns MSAA off.
+	void setMsaaSamples(uint32_t samples) {
+		requestedMsaaSamples = samples;
+	}
+
+	// How the scene is upscaled to the swap chain, see upscaler.h
+	void setUpscalePreset(upscale::Preset preset) {
+		upscalePreset = preset;
+		upscaleSettings = upscale::settings(preset);
+	}
+
+	// Windows rendered by the one device, one per monitor while there are enough of them
+	void setWindowCount(uint32_t count) {
+		if (count == 0) {
+			throw std::runtime_error("need at least one window!");
+		}
+		windowCount = count;
+	}
+
+	// Stop after this many frames and print the average frame time, 0 runs until closed
+	void setFrameLimit(uint32_t frames) {
+		frameLimit = frames;
+	}
+
+	// Only these implicit layers load into the instance, see layer_policy.h
+	void allowImplicitLayers(const std::vector<std::string>& names) {
+		implicitLayerAllowList = names;
+		restrictImplicitLayers = true;
+	}
+
+
 private:
-	GLFWwindow* window;
+	uint32_t windowCount = 1;
+	uint32_t frameLimit = 0;
+
+	std::vector<std::string> implicitLayerAllowList;
+	bool restrictImplicitLayers = false;
 
-	VkInstance instance;
-	VkDebugUtilsMessengerEXT debugMessenger;
-	VkSurfaceKHR surface;
+	// Owned handles are destroyed by their wrappers, see handles.h
+	vkh::Instance instance;
+	UniqueDebugMessenger debugMessenger;
+	PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginDebugLabel = nullptr;
+	PFN_vkCmdEndDebugUtilsLabelEXT cmdEndDebugLabel = nullptr;
 
-	VkDevice device;
+	vkh::Device device;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	uint32_t instanceVersion = VK_API_VERSION_1_0;
+	bool accelerationStructures = false; // Optional, see accel.h
 
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
 
+	// Window, surface and swap chain per window, see Output
+	std::vector<Output> outputs;
+	VkFormat swapChainImageFormat;
+	VkExtent2D swapChainExtent;
+
+	// Draws to the swap chain: the upscaled scene, then the HUD
+	vkh::RenderPass renderPass;
+
+	// The scene renders into its own target at a dynamic resolution, see dynamic_resolution.h.
+	// The target is swap chain sized, lower resolutions only use its top left corner.
+	vkh::RenderPass sceneRenderPass;
+	vkh::PipelineLayout pipelineLayout;
+	vkh::Pipeline graphicsPipeline;
+	vkh::Image sceneColorImage;
+	vkh::DeviceMemory sceneColorMemory;
+	vkh::ImageView sceneColorView;
+	vkh::Framebuffer sceneFramebuffer;
+
+	// With MSAA the scene draws into a multisampled transient target, resolved into
+	// sceneColorImage at the end of the subpass, see msaa.h
+	uint32_t requestedMsaaSamples = 4;
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	vkh::Image msaaColorImage;
+	vkh::DeviceMemory msaaColorMemory;
+	vkh::ImageView msaaColorView;
+
+	dynres::Controller resolutionController;
+	dynres::Trajectory resolutionTrajectory;
+	VkExtent2D renderExtent;
+	float renderScales[MAX_FRAMES_IN_FLIGHT] = {}; // Scale each frame slot was last rendered at
+	double lastGpuFrameMs = 0.0;
+
+	// Bilinear upscale of the scene to the swap chain
+	vkh::Sampler upscaleSampler;
+	vkh::DescriptorSetLayout upscaleDescriptorSetLayout;
+	vkh::DescriptorPool upscaleDescriptorPool;
+	VkDescriptorSet upscaleDescriptorSet;
+	vkh::PipelineLayout upscalePipelineLayout;
+	vkh::Pipeline upscalePipeline;
+
+	// Compute presets instead: edge pass, optional sharpen pass, then a blit of exportImage
+	// into the swap chain before the HUD is drawn, see upscaler.h
+	upscale::Preset upscalePreset = upscale::Preset::Performance;
+	upscale::Settings upscaleSettings = upscale::settings(upscale::Preset::Performance);
+	vkh::Image upscaleImage; // Edge pass output, only when sharpening follows
+	vkh::DeviceMemory upscaleMemory;
+	vkh::ImageView upscaleView;
+	vkh::Image exportImage;
+	vkh::DeviceMemory exportMemory;
+	vkh::ImageView exportView;
+	vkh::DescriptorSetLayout computeUpscaleSetLayout;
+	vkh::DescriptorPool computeUpscalePool;
+	VkDescriptorSet edgeDescriptorSet;
+	VkDescriptorSet sharpenDescriptorSet;
+	vkh::PipelineLayout computeUpscaleLayout;
+	vkh::Pipeline edgePipeline;
+	vkh::Pipeline sharpenPipeline;
+	bool upscalePresetSwitchRequested = false; // Applied at the start of the next frame
+
+	vkh::CommandPool commandPool;
+	std::vector<VkCommandBuffer> commandBuffers;
+
+	std::vector<vkh::Fence> inFlightFences;
+	uint32_t currentFrame = 0;
+
+	// One entry per acquired window, rebuilt every frame. Reserved for every window in
+	// createSyncObjects(), so a steady state frame doesn't allocate.
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	std::vector<VkSemaphore> signalSemaphores;
+	std::vector<VkSwapchainKHR> presentSwapChains;
+	std::vector<uint32_t> imageIndices;
+	std::vector<VkResult> presentResults;
+
+	// Submitted frames, counts up forever. Objects retired during frame N are
+	// destroyed once its fence has signaled, see drawFrame().
+	uint64_t frameNumber = 0;
+	vkh::DeletionQueue deletionQueue;
+
+	// GPU pass timings, see createTimestampQueries()
+	vkh::QueryPool timestampPool;
+	bool timestampsSupported = false;
+	bool timestampsWritten[MAX_FRAMES_IN_FLIGHT] = {};
+	float timestampPeriod = 0.0f;
+
+	// Performance HUD, see hud.h. Toggled with F1.
+	bool hudVisible = true;
+	std::unique_ptr<hud::Overlay> hudOverlay;
+	hud::HudStats hudStats;
+	std::chrono::steady_clock::time_point lastFrameStart = std::chrono::steady_clock::now();
+
+	vkh::Image hudAtlasImage;
+	vkh::DeviceMemory hudAtlasMemory;
+	vkh::ImageView hudAtlasView;
+	vkh::Sampler hudSampler;
+	vkh::DescriptorSetLayout hudDescriptorSetLayout;
+	vkh::DescriptorPool hudDescriptorPool;
+	VkDescriptorSet hudDescriptorSet;
+	vkh::PipelineLayout hudPipelineLayout;
+	vkh::Pipeline hudPipeline;
+	std::vector<vkh::Buffer> hudVertexBuffers;
+	std::vector<vkh::DeviceMemory> hudVertexBuffersMemory;
+	std::vector<void*> hudVertexBuffersMapped;
+
+	// Metrics export, off unless a socket path is given
+	std::string metricsSocketPath;
+	metrics::Exporter metricsExporter;
+	metrics::Snapshot metricsSnapshot;
+
+	// API capture for replay benchmarks, off unless a file is given
+	std::string capturePath;
+
+	// Counts every host allocation Vulkan makes, see memory_stats.h
+	const VkAllocationCallbacks* allocator = memstats::vulkanAllocator();
+
 	void initWindow() {
+		PROFILE_FUNCTION();
+
 		glfwInit();
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Not using OpenGL
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Don't allow resizing
 
-		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+		int monitorCount = 0;
+		GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+
+		outputs.resize(windowCount);
+		for (uint32_t i = 0; i < windowCount; i++) {
+			std::string title = windowCount == 1 ? "Vulkan" : "Vulkan " + std::to_string(i + 1);
+			GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, title.c_str(), nullptr, nullptr);
+			if (window == nullptr) {
+				throw std::runtime_error("failed to create window!");
+			}
+
+			// Spread over the monitors, the rest stack up on the last one
+			if (monitorCount > 1) {
+				int x, y;
+				glfwGetMonitorPos(monitors[std::min<int>(i, monitorCount - 1)], &x, &y);
+				glfwSetWindowPos(window, x + 40, y + 40);
+			}
+
+			// Lets the static key callback find us
+			glfwSetWindowUserPointer(window, this);
+			glfwSetKeyCallback(window, keyCallback);
+			outputs[i].window = window;
+		}
+	}
+
+
+	bool anyWindowClosing() {
+		for (const Output& output : outputs) {
+			if (glfwWindowShouldClose(output.window)) return true;
+		}
+		return false;
 	}
 
 
 	void initVulkan() {
+		PROFILE_FUNCTION();
+
 		createInstance();
 		setupDebugMessenger();
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		if (!capturePath.empty()) {
+			capture::recorder().begin(capturePath, physicalDevice);
+			std::cout << "Capturing to " << capturePath << std::endl;
+		}
+		createSwapChain();
+		createImageViews();
+		createRenderPass();
+		createSceneRenderPass();
+		createGraphicsPipeline();
+		createFramebuffers();
+		createSceneTarget();
+		createUpscalePass();
+		createCommandPool();
+		createCommandBuffers();
+		createSyncObjects();
+		createTimestampQueries();
+		createHud();
+
+		if (!metricsSocketPath.empty()) {
+			metricsExporter.start(metricsSocketPath);
+			std::cout << "Serving metrics on " << metricsSocketPath << std::endl;
+		}
 	}
 
 
 	void mainLoop() {
-		while (!glfwWindowShouldClose(window)) {
+		auto start = std::chrono::steady_clock::now();
+		uint32_t framesDrawn = 0;
+
+		// Closing any window ends the run, the others show the same scene
+		while (!anyWindowClosing() && (frameLimit == 0 || framesDrawn < frameLimit)) {
+			PROFILE_ZONE_COUNTERS("frame");
+			memstats::beginFrame();
+
 			glfwPollEvents();
+			drawFrame();
+			framesDrawn++;
+
+			memstats::endFrame();
+		}
+
+		// Let in flight frames finish before cleanup destroys their resources
+		capture::vkDeviceWaitIdle(device);
+
+		if (frameLimit > 0 && framesDrawn > 0) {
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << Policy::name << " policy: " << framesDrawn << " frames, "
+				<< ms / framesDrawn << " ms per frame" << std::endl;
 		}
 	}
 
 
 	void cleanup() {
-		vkDestroyDevice(device, nullptr);
+		PROFILE_FUNCTION();
+
+		metricsExporter.stop();
 
-		if (enableValidationLayers) {
-			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+		// mainLoop() waited for the device, nothing retired is still in use
+		deletionQueue.flush();
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			capture::vkUnmapMemory(device, hudVertexBuffersMemory[i]);
+		}
+
+		// Reverse creation order, the wrappers know how to destroy each one
+		hudVertexBuffers.clear();
+		hudVertexBuffersMemory.clear();
+		hudPipeline.reset();
+		hudPipelineLayout.reset();
+		hudDescriptorPool.reset();
+		hudDescriptorSetLayout.reset();
+		hudSampler.reset();
+		hudAtlasView.reset();
+		hudAtlasImage.reset();
+		hudAtlasMemory.reset();
+
+		sharpenPipeline.reset();
+		edgePipeline.reset();
+		computeUpscaleLayout.reset();
+		computeUpscalePool.reset();
+		computeUpscaleSetLayout.reset();
+		exportView.reset();
+		exportImage.reset();
+		exportMemory.reset();
+		upscaleView.reset();
+		upscaleImage.reset();
+		upscaleMemory.reset();
+
+		upscalePipeline.reset();
+		upscalePipelineLayout.reset();
+		upscaleDescriptorPool.reset();
+		upscaleDescriptorSetLayout.reset();
+		upscaleSampler.reset();
+
+		timestampPool.reset();
+		for (Output& output : outputs) {
+			output.renderFinishedSemaphores.clear();
+			output.imageAvailableSemaphores.clear();
+		}
+		inFlightFences.clear();
+		commandPool.reset();
+
+		sceneFramebuffer.reset();
+		msaaColorView.reset();
+		msaaColorImage.reset();
+		msaaColorMemory.reset();
+		sceneColorView.reset();
+		sceneColorImage.reset();
+		sceneColorMemory.reset();
+		for (Output& output : outputs) {
+			output.framebuffers.clear();
 		}
+		graphicsPipeline.reset();
+		pipelineLayout.reset();
+		sceneRenderPass.reset();
+		renderPass.reset();
+		for (Output& output : outputs) {
+			output.imageViews.clear();
+			output.swapChain.reset();
+		}
+
+		capture::recorder().end();
+		device.reset();
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
-		vkDestroyInstance(instance, nullptr);
+		debugMessenger.reset();
+		for (Output& output : outputs) {
+			output.surface.reset();
+		}
+		instance.reset();
 
-		glfwDestroyWindow(window);
+		for (Output& output : outputs) {
+			glfwDestroyWindow(output.window);
+		}
+		outputs.clear();
 		glfwTerminate();
+
+		// The HUD has to stay cheap enough to leave on while profiling
+		if (hudOverlay->buildCount() > 0) {
+			std::cout << "HUD build: " << hudOverlay->averageBuildCpuMs() << " ms avg, "
+				<< hudOverlay->maxBuildCpuMs() << " ms max over " << hudOverlay->buildCount() << " frames (budget "
+				<< hud::CPU_BUDGET_MS << " ms)" << std::endl;
+
+			if (hudOverlay->averageBuildCpuMs() > hud::CPU_BUDGET_MS) {
+				std::cerr << "warning: HUD build averaged over its CPU budget" << std::endl;
+			}
+		}
+		hudOverlay.reset();
+
+		resolutionTrajectory.print(std::cout);
+
+		// Everything Vulkan is gone, anything still counted is a leak
+		memstats::printHostReport(std::cout);
+		memstats::deviceMemory().printReport(std::cout);
+		memstats::reportHostLeaks(std::cerr);
+		memstats::deviceMemory().reportLeaks(std::cerr);
 	}
 
 
 	void createInstance() {
-		if (enableValidationLayers && !checkValidationLayerSupport()) {
-			throw std::runtime_error("validation layers requested, but not available!");
+		PROFILE_FUNCTION();
+
+		if constexpr (Policy::validation) {
+			if (!checkValidationLayerSupport()) {
+				throw std::runtime_error("validation layers requested, but not available!");
+			}
+		}
+
+		// The loader reads its layer filters when the instance is created
+		if (restrictImplicitLayers) {
+			std::vector<std::string> filtered = layers::allowOnly(implicitLayerAllowList, layers::findImplicitLayers());
+			std::cout << "Implicit layers filtered out: " << filtered.size() << std::endl;
+			for (const std::string& name : filtered) {
+				std::cout << "\t" << name << std::endl;
+			}
 		}
 
 		// Optional struct but helpful
@@ -157,7 +604,9 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// Up to 1.2, so devices with acceleration structures can enable them
+		instanceVersion = accel::instanceApiVersion();
+		appInfo.apiVersion = instanceVersion;
 
 		// Required struct. Needs required extension(s) info from GLFW
 		VkInstanceCreateInfo createInfo{};
@@ -171,7 +620,7 @@ private:
 
 		// Setup console debug messages
 		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-		if (enableValidationLayers) {
+		if constexpr (Policy::validation) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
 			createInfo.ppEnabledLayerNames = validationLayers.data();
 
@@ -193,10 +642,12 @@ private:
 		}
 
 		// Create the instance.
-		/* VkResult result = vkCreateInstance(&createInfo, nullptr, &instance); */
-		if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+		/* VkResult result = vkCreateInstance(&createInfo, allocator, &instance); */
+		VkInstance createdInstance;
+		if (vkCreateInstance(&createInfo, allocator, &createdInstance) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create instance!");
 		}
+		instance = vkh::Instance(nullptr, createdInstance, allocator);
 	}
 
 
@@ -207,7 +658,7 @@ private:
 
 		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
-		if (enableValidationLayers)
+		if constexpr (Policy::validation)
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
 		return extensions;
@@ -234,7 +685,7 @@ private:
 		// Now get the names of each extension then print it out to std::out
 		vkEnumerateInstanceExtensionProperties(nullptr, &vk_extension_count, vk_extensions.data());
 
-		if (log_extensions) {
+		if constexpr (Policy::logExtensions) {
 			std::cout << "Available Vulkan Extensions:" << std::endl;
 
 			for (const auto& extension : vk_extensions) {
@@ -249,7 +700,7 @@ private:
 			for (const auto& vk_extension : vk_extensions) {
 
 				if (strcmp(glfw_extension, vk_extension.extensionName) == 0) {
-					if (log_extensions)
+					if constexpr (Policy::logExtensions)
 						std::cout << '\t' << glfw_extension << std::endl;
 					
 					extension_found = true;
@@ -265,13 +716,42 @@ private:
 
 
 	void setupDebugMessenger() {
-		if (!enableValidationLayers) return;
+		PROFILE_FUNCTION();
+
+		if constexpr (Policy::validation) {
+			VkDebugUtilsMessengerCreateInfoEXT createInfo;
+			populateDebugMessengerCreateInfo(createInfo);
 
-		VkDebugUtilsMessengerCreateInfoEXT createInfo;
-		populateDebugMessengerCreateInfo(createInfo);
+			VkDebugUtilsMessengerEXT messenger;
+			if (CreateDebugUtilsMessengerEXT(instance, &createInfo, allocator, &messenger) != VK_SUCCESS)
+				throw std::runtime_error("failed to set up debug messenger!");
+			debugMessenger = UniqueDebugMessenger(instance, messenger, allocator);
+
+			if constexpr (Policy::debugLabels) {
+				cmdBeginDebugLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+				cmdEndDebugLabel = (PFN_vkCmdEndDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+			}
+		}
+	}
+
+
+	// Named regions show up in capture tools. Nothing is recorded without debug labels, or
+	// when the loader doesn't have the functions.
+	void beginDebugLabel(VkCommandBuffer commandBuffer, const char* name) {
+		if constexpr (Policy::debugLabels) {
+			if (cmdBeginDebugLabel == nullptr) return;
+
+			VkDebugUtilsLabelEXT label{};
+			label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			label.pLabelName = name;
+			cmdBeginDebugLabel(commandBuffer, &label);
+		}
+	}
 
-		if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
-			throw std::runtime_error("failed to set up debug messenger!");
+	void endDebugLabel(VkCommandBuffer commandBuffer) {
+		if constexpr (Policy::debugLabels) {
+			if (cmdEndDebugLabel != nullptr) cmdEndDebugLabel(commandBuffer);
+		}
 	}
 
 	
@@ -318,13 +798,21 @@ private:
 
 
 	void createSurface() {
-		if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create window surface!");
+		PROFILE_FUNCTION();
+
+		for (Output& output : outputs) {
+			VkSurfaceKHR createdSurface;
+			if (glfwCreateWindowSurface(instance, output.window, allocator, &createdSurface) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create window surface!");
+			}
+			output.surface = vkh::Surface(instance, createdSurface, allocator);
 		}
 	}
 
 
 	void pickPhysicalDevice() {
+		PROFILE_FUNCTION();
+
 		// List available GPUs with Vulkan compatability.
 		uint32_t deviceCount = 0;	
 		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -348,6 +836,24 @@ private:
 		if (physicalDevice == VK_NULL_HANDLE) {
 			throw std::runtime_error("failed to find a suitable GPU!");
 		}
+
+		// Lets device memory accounting attribute allocations to heaps
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		memstats::deviceMemory().init(memoryProperties);
+
+		metricsSnapshot.heapCount = memoryProperties.memoryHeapCount;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			metricsSnapshot.heaps[i].sizeBytes = memoryProperties.memoryHeaps[i].size;
+			metricsSnapshot.heaps[i].deviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		}
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		msaaSamples = msaa::chooseSampleCount(msaa::usableSampleCounts(properties.limits, false), requestedMsaaSamples);
+
+		checkDeviceExtensionSupport(physicalDevice, &accelerationStructures);
+		std::cout << "Ray tracing: " << (accelerationStructures ? "acceleration structures enabled" : "not supported") << std::endl;
 	}
 
 
@@ -357,11 +863,22 @@ private:
 		// Check to make sure the device has the extensions we want.
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		return indices.isComplete() && extensionsSupported;
+		// Only query swap chain support once we know the extension is there. Every window needs it.
+		bool swapChainAdequate = extensionsSupported;
+		if (extensionsSupported) {
+			for (const Output& output : outputs) {
+				SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, output.surface);
+				swapChainAdequate = swapChainAdequate && !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+			}
+		}
+
+		return indices.isComplete() && extensionsSupported && swapChainAdequate;
 	}
 
 
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+	// Whether the required extensions are there. If optional is set, also whether the optional
+	// acceleration structure set is.
+	bool checkDeviceExtensionSupport(VkPhysicalDevice device, bool* optional = nullptr) {
 		// Get available device extensions
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -369,6 +886,10 @@ private:
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
+		if (optional != nullptr) {
+			*optional = accel::supported(device, instanceVersion, availableExtensions);
+		}
+
 		// Store the extensions we want in a local variable, makes cross-checking easier
 		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
@@ -398,11 +919,16 @@ private:
 				indices.graphicsFamily = i;
 			}
 
-			// Check if there's a queue family that supports presenting images to the screen
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+			// Check if there's a queue family that can present to every window's surface, so
+			// one vkQueuePresentKHR covers them all
+			bool presentSupport = true;
+			for (const Output& output : outputs) {
+				VkBool32 surfaceSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, output.surface, &surfaceSupport);
+				presentSupport = presentSupport && surfaceSupport;
+			}
 
-			if (presentSupport) 
+			if (presentSupport)
 				indices.presentFamily = i;
 
 			if (indices.isComplete()) 
@@ -416,6 +942,8 @@ private:
 
 
 	void createLogicalDevice() {
+		PROFILE_FUNCTION();
+
 		// Begin setup to create our logical device to interface with the GPU.
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
@@ -448,58 +976,1851 @@ private:
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
-		// Logical Device Extensions
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		// Logical Device Extensions, plus acceleration structures and their features when supported
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		accel::Features accelFeatures = accel::Features::enabled();
+		if (accelerationStructures) {
+			std::vector<const char*> optional = accel::deviceExtensions();
+			enabledExtensions.insert(enabledExtensions.end(), optional.begin(), optional.end());
+			createInfo.pNext = accelFeatures.chain(nullptr);
+		}
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// Logical Device Layers
-		if (enableValidationLayers) {
+		if constexpr (Policy::validation) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
 			createInfo.ppEnabledLayerNames = validationLayers.data();
 		} else {
 			createInfo.enabledLayerCount = 0;
 		}
 
-		if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+		VkDevice createdDevice;
+		if (vkCreateDevice(physicalDevice, &createInfo, allocator, &createdDevice) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create logical device!");
 		}
+		device = vkh::Device(nullptr, createdDevice, allocator);
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 	}
 
 
-	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-		VkDebugUtilsMessageTypeFlagsEXT messageType,
-		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-		void* pUserData
+	void createSwapChain() {
+		PROFILE_FUNCTION();
+
+		// Every window gets the first one's format and extent, so they can share the scene
+		// target, the render passes and the pipelines.
+		SwapChainSupportDetails firstSupport = querySwapChainSupport(physicalDevice, outputs[0].surface);
+		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(firstSupport.formats);
+		VkExtent2D extent = chooseSwapExtent(firstSupport.capabilities, outputs[0].window);
+
+		// Compute upscale presets blit into the swap chain images
+		VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		if (upscaleSettings.compute) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &formatProperties);
+
+			bool blittable = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT;
+			for (const Output& output : outputs) {
+				SwapChainSupportDetails support = querySwapChainSupport(physicalDevice, output.surface);
+				blittable = blittable && (support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+			}
+
+			if (blittable) {
+				imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			} else {
+				std::cerr << "swap chain can't be blitted to, using the performance upscale preset" << std::endl;
+				setUpscalePreset(upscale::Preset::Performance);
+			}
+		}
+
+		// Share images between queue families only if graphics and present are different families.
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+		uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+
+		for (Output& output : outputs) {
+			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, output.surface);
+
+			bool formatSupported = false;
+			for (const auto& availableFormat : swapChainSupport.formats) {
+				formatSupported = formatSupported || (availableFormat.format == surfaceFormat.format &&
+					availableFormat.colorSpace == surfaceFormat.colorSpace);
+			}
+			if (!formatSupported) {
+				throw std::runtime_error("windows need a common swap chain format!");
+			}
+
+			VkExtent2D outputExtent = chooseSwapExtent(swapChainSupport.capabilities, output.window);
+			if (outputExtent.width != extent.width || outputExtent.height != extent.height) {
+				throw std::runtime_error("windows need the same swap chain extent!");
+			}
+
+			// One more than the minimum so we don't wait on the driver to release an image.
+			uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+			if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
+				imageCount = swapChainSupport.capabilities.maxImageCount;
+			}
+
+			VkSwapchainCreateInfoKHR createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+			createInfo.surface = output.surface;
+			createInfo.minImageCount = imageCount;
+			createInfo.imageFormat = surfaceFormat.format;
+			createInfo.imageColorSpace = surfaceFormat.colorSpace;
+			createInfo.imageExtent = extent;
+			createInfo.imageArrayLayers = 1;
+			createInfo.imageUsage = imageUsage;
+
+			if (indices.graphicsFamily != indices.presentFamily) {
+				createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+				createInfo.queueFamilyIndexCount = 2;
+				createInfo.pQueueFamilyIndices = queueFamilyIndices;
+			} else {
+				createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			}
+
+			createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+			createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+			createInfo.presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+			createInfo.clipped = VK_TRUE;
+			createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+			VkSwapchainKHR createdSwapChain;
+			if (capture::vkCreateSwapchainKHR(device, &createInfo, allocator, &createdSwapChain) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create swap chain!");
+			}
+			output.swapChain = vkh::Swapchain(device, createdSwapChain, allocator);
+
+			capture::vkGetSwapchainImagesKHR(device, output.swapChain, &imageCount, nullptr);
+			output.images.resize(imageCount);
+			capture::vkGetSwapchainImagesKHR(device, output.swapChain, &imageCount, output.images.data());
+		}
+
+		swapChainImageFormat = surfaceFormat.format;
+		swapChainExtent = extent;
+	}
+
+
+	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+		SwapChainSupportDetails details;
+
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+
+		uint32_t formatCount;
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+		if (formatCount != 0) {
+			details.formats.resize(formatCount);
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+		}
+
+		uint32_t presentModeCount;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+		if (presentModeCount != 0) {
+			details.presentModes.resize(presentModeCount);
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+		}
+
+		return details;
+	}
+
+
+	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+		// Prefer 8 bit sRGB, otherwise take whatever comes first.
+		for (const auto& availableFormat : availableFormats) {
+			if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
+				availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+				return availableFormat;
+			}
+		}
+
+		return availableFormats[0];
+	}
+
+
+	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+		// Mailbox (triple buffering) if we can, FIFO (vsync) is always available.
+		for (const auto& availablePresentMode : availablePresentModes) {
+			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+				return availablePresentMode;
+			}
+		}
+
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+
+	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window) {
+		// Window managers set currentExtent to UINT32_MAX when they let us pick.
+		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+			return capabilities.currentExtent;
+		}
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+
+		VkExtent2D actualExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+		actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+		actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+
+		return actualExtent;
+	}
+
+
+	void createImageViews() {
+		PROFILE_FUNCTION();
+
+		for (Output& output : outputs) {
+			output.imageViews.clear();
+
+			for (VkImage image : output.images) {
+				output.imageViews.push_back(createImageView(image, swapChainImageFormat));
+			}
+		}
+	}
+
+
+	vkh::ImageView createImageView(VkImage image, VkFormat format) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView imageView;
+		if (capture::vkCreateImageView(device, &viewInfo, allocator, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image view!");
+		}
+
+		return vkh::ImageView(device, imageView, allocator);
+	}
+
+
+	void createRenderPass() {
+		PROFILE_FUNCTION();
+
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = swapChainImageFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		// Compute upscale presets have already blitted the scene in, keep it
+		if (upscaleSettings.compute) {
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		}
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		// Upscaled scene and HUD share one subpass, the HUD is just drawn last.
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+
+		// Wait for the swap chain image to be released before writing to it.
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = 0;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		// Or for the blit, which already waited for the image
+		if (upscaleSettings.compute) {
+			dependency.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependency.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		}
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+
+		VkRenderPass createdRenderPass;
+		if (capture::vkCreateRenderPass(device, &renderPassInfo, allocator, &createdRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+		renderPass = vkh::RenderPass(device, createdRenderPass, allocator);
+	}
+
+
+	void createSceneRenderPass() {
+		PROFILE_FUNCTION();
+
+		// Cleared every frame and read by the upscale pass afterwards.
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = swapChainImageFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// With MSAA the samples are cleared and resolved on chip, only the resolve is stored
+		bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+		VkAttachmentDescription msaaAttachment = colorAttachment;
+		msaaAttachment.samples = msaaSamples;
+		msaaAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		msaaAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		if (multisampled) colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		VkAttachmentDescription attachments[] = {msaaAttachment, colorAttachment};
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference resolveAttachmentRef{};
+		resolveAttachmentRef.attachment = 1;
+		resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pResolveAttachments = multisampled ? &resolveAttachmentRef : nullptr;
+
+		// Frames in flight share the target and the multisampled attachment: wait for the previous
+		// frame's upscale to finish reading the target and for its attachment writes (a write after
+		// write on the one transient image), then make this frame's writes visible to the upscale
+		// (fragment or compute). The depth stages and access cover a shared depth attachment the same way.
+		VkSubpassDependency dependencies[2]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = multisampled ? 2 : 1;
+		renderPassInfo.pAttachments = multisampled ? attachments : &colorAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies;
+
+		VkRenderPass createdRenderPass;
+		if (capture::vkCreateRenderPass(device, &renderPassInfo, allocator, &createdRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create scene render pass!");
+		}
+		sceneRenderPass = vkh::RenderPass(device, createdRenderPass, allocator);
+	}
+
+
+	void createGraphicsPipeline() {
+		PROFILE_FUNCTION();
+
+		vkh::ShaderModule vertShaderModule = createShaderModule(readFile("shaders/triangle.vert.spv"));
+		vkh::ShaderModule fragShaderModule = createShaderModule(readFile("shaders/triangle.frag.spv"));
+
+		VkPipelineShaderStageCreateInfo shaderStages[] = {
+			shaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule),
+			shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule)
+		};
+
+		// Triangle vertices are hardcoded in the vertex shader.
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = 0;
+		vertexInputInfo.vertexAttributeDescriptionCount = 0;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+		VkPipelineLayout createdLayout;
+		if (capture::vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &createdLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		pipelineLayout = vkh::PipelineLayout(device, createdLayout, allocator);
+
+		graphicsPipeline = createPipeline(shaderStages, vertexInputInfo, colorBlendAttachment, pipelineLayout, sceneRenderPass, msaaSamples);
+	}
+
+
+	// Fixed function state shared by the scene and HUD pipelines. Viewport and scissor are dynamic.
+	vkh::Pipeline createPipeline(
+		const VkPipelineShaderStageCreateInfo* shaderStages,
+		const VkPipelineVertexInputStateCreateInfo& vertexInputInfo,
+		const VkPipelineColorBlendAttachmentState& colorBlendAttachment,
+		VkPipelineLayout layout,
+		VkRenderPass pass,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT
 	) {
-		
-		std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.depthClampEnable = VK_FALSE;
+		rasterizer.rasterizerDiscardEnable = VK_FALSE;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer.depthBiasEnable = VK_FALSE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.rasterizationSamples = samples;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		std::vector<VkDynamicState> dynamicStates = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
 
-		return VK_FALSE;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = layout;
+		pipelineInfo.renderPass = pass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (capture::vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		return vkh::Pipeline(device, pipeline, allocator);
 	}
 
 
-};
+	VkPipelineShaderStageCreateInfo shaderStageInfo(VkShaderStageFlagBits stage, VkShaderModule module) {
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = stage;
+		stageInfo.module = module;
+		stageInfo.pName = "main";
 
+		return stageInfo;
+	}
 
-int main(int argc, char* argv[]) {
-	if (enableValidationLayers) {
-		std::cout << "VALIDATION LAYERS ENABLED!" << std::endl;
+
+	vkh::ShaderModule createShaderModule(const std::vector<char>& code) {
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (capture::vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+
+		return vkh::ShaderModule(device, shaderModule, allocator);
 	}
-	else {	
-		std::cout << "VALIDATION LAYERS DISABLED!" << std::endl;
+
+
+	void createFramebuffers() {
+		PROFILE_FUNCTION();
+
+		for (Output& output : outputs) {
+			output.framebuffers.clear();
+
+			for (size_t i = 0; i < output.imageViews.size(); i++) {
+				VkImageView attachments[] = {output.imageViews[i]};
+
+				VkFramebufferCreateInfo framebufferInfo{};
+				framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+				framebufferInfo.renderPass = renderPass;
+				framebufferInfo.attachmentCount = 1;
+				framebufferInfo.pAttachments = attachments;
+				framebufferInfo.width = swapChainExtent.width;
+				framebufferInfo.height = swapChainExtent.height;
+				framebufferInfo.layers = 1;
+
+				VkFramebuffer framebuffer;
+				if (capture::vkCreateFramebuffer(device, &framebufferInfo, allocator, &framebuffer) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create framebuffer!");
+				}
+				output.framebuffers.emplace_back(device, framebuffer, allocator);
+			}
+		}
 	}
 
-	HelloTriangleApplication app;
 
-	try {
-		app.run();
-	} catch (const std::exception& e) {
-		std::cerr << e.what() << std::endl;
-		return EXIT_FAILURE;
+	void createSceneTarget() {
+		PROFILE_FUNCTION();
+
+		// Full size, so resolution changes never reallocate
+		createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, sceneColorImage, sceneColorMemory);
+		sceneColorView = createImageView(sceneColorImage, swapChainImageFormat);
+
+		VkImageView attachments[] = {sceneColorView, VK_NULL_HANDLE};
+		uint32_t attachmentCount = 1;
+
+		// Samples first, the resolve target second, see createSceneRenderPass()
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, msaaColorImage, msaaColorMemory,
+				msaaSamples);
+			msaaColorView = createImageView(msaaColorImage, swapChainImageFormat);
+			attachments[0] = msaaColorView;
+			attachments[1] = sceneColorView;
+			attachmentCount = 2;
+
+			VkMemoryRequirements memRequirements;
+			vkGetImageMemoryRequirements(device, msaaColorImage, &memRequirements);
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+			bool lazy = msaa::transientMemoryType(memProperties, memRequirements.memoryTypeBits).lazy;
+
+			std::cout << "MSAA " << msaaSamples << "x, " << memRequirements.size / 1024 << " KB transient color target";
+			if (lazy) {
+				std::cout << ", " << msaa::committedBytes(device, msaaColorMemory, memRequirements.size, lazy) / 1024 << " KB committed";
+			}
+			std::cout << std::endl;
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = sceneRenderPass;
+		framebufferInfo.attachmentCount = attachmentCount;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		if (capture::vkCreateFramebuffer(device, &framebufferInfo, allocator, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create scene framebuffer!");
+		}
+		sceneFramebuffer = vkh::Framebuffer(device, framebuffer, allocator);
+
+		renderExtent = swapChainExtent;
+	}
+
+
+	void createUpscalePass() {
+		PROFILE_FUNCTION();
+
+		// Bilinear, the shader clamps to the rendered region so the edge doesn't bleed
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+		VkSampler sampler;
+		if (capture::vkCreateSampler(device, &samplerInfo, allocator, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upscale sampler!");
+		}
+		upscaleSampler = vkh::Sampler(device, sampler, allocator);
+
+		std::cout << "Upscale preset: " << upscale::presetName(upscalePreset) << std::endl;
+		if (upscaleSettings.compute) {
+			createComputeUpscale();
+			return;
+		}
+
+		createImageDescriptor(sceneColorView, upscaleSampler, upscaleDescriptorSetLayout, upscaleDescriptorPool, upscaleDescriptorSet);
+
+		vkh::ShaderModule vertShaderModule = createShaderModule(readFile("shaders/upscale.vert.spv"));
+		vkh::ShaderModule fragShaderModule = createShaderModule(readFile("shaders/upscale.frag.spv"));
+
+		VkPipelineShaderStageCreateInfo shaderStages[] = {
+			shaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule),
+			shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule)
+		};
+
+		// Fullscreen triangle generated in the vertex shader.
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		// UV scale and clamp for the rendered region, see upscale.frag.
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(float) * 4;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = upscaleDescriptorSetLayout.address();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout createdLayout;
+		if (capture::vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &createdLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upscale pipeline layout!");
+		}
+		upscalePipelineLayout = vkh::PipelineLayout(device, createdLayout, allocator);
+
+		upscalePipeline = createPipeline(shaderStages, vertexInputInfo, colorBlendAttachment, upscalePipelineLayout, renderPass);
+	}
+
+
+	// Storage images for the compute presets, both passes read binding 0 and write binding 1.
+	void createComputeUpscale() {
+		createImage(swapChainExtent.width, swapChainExtent.height, upscale::IMAGE_FORMAT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, exportImage, exportMemory);
+		exportView = createImageView(exportImage, upscale::IMAGE_FORMAT);
+
+		if (upscaleSettings.sharpen) {
+			createImage(swapChainExtent.width, swapChainExtent.height, upscale::IMAGE_FORMAT,
+				VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, upscaleImage, upscaleMemory);
+			upscaleView = createImageView(upscaleImage, upscale::IMAGE_FORMAT);
+		}
+
+		VkDescriptorSetLayoutBinding bindings[2]{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorCount = 1;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorCount = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 2;
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout createdSetLayout;
+		if (capture::vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &createdSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute upscale descriptor set layout!");
+		}
+		computeUpscaleSetLayout = vkh::DescriptorSetLayout(device, createdSetLayout, allocator);
+
+		uint32_t setCount = upscaleSettings.sharpen ? 2 : 1;
+
+		VkDescriptorPoolSize poolSizes[2]{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = setCount;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount = setCount;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = setCount;
+
+		VkDescriptorPool descriptorPool;
+		if (capture::vkCreateDescriptorPool(device, &poolInfo, allocator, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute upscale descriptor pool!");
+		}
+		computeUpscalePool = vkh::DescriptorPool(device, descriptorPool, allocator);
+
+		VkDescriptorSetLayout setLayouts[2] = {computeUpscaleSetLayout, computeUpscaleSetLayout};
+		VkDescriptorSet sets[2];
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = computeUpscalePool;
+		allocInfo.descriptorSetCount = setCount;
+		allocInfo.pSetLayouts = setLayouts;
+
+		if (capture::vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute upscale descriptor sets!");
+		}
+		edgeDescriptorSet = sets[0];
+		sharpenDescriptorSet = upscaleSettings.sharpen ? sets[1] : VK_NULL_HANDLE;
+
+		// Edge: scene -> export, or scene -> upscale -> export with sharpening
+		VkDescriptorImageInfo imageInfos[4]{};
+		imageInfos[0] = {upscaleSampler, sceneColorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		imageInfos[1] = {VK_NULL_HANDLE, upscaleSettings.sharpen ? upscaleView.get() : exportView.get(), VK_IMAGE_LAYOUT_GENERAL};
+		imageInfos[2] = {upscaleSampler, upscaleView, VK_IMAGE_LAYOUT_GENERAL};
+		imageInfos[3] = {VK_NULL_HANDLE, exportView, VK_IMAGE_LAYOUT_GENERAL};
+
+		VkWriteDescriptorSet writes[4]{};
+		for (uint32_t i = 0; i < 2 * setCount; i++) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[i / 2];
+			writes[i].dstBinding = i % 2;
+			writes[i].descriptorType = bindings[i % 2].descriptorType;
+			writes[i].descriptorCount = 1;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+
+		capture::vkUpdateDescriptorSets(device, 2 * setCount, writes, 0, nullptr);
+
+		static_assert(sizeof(upscale::EdgePush) == sizeof(upscale::SharpenPush), "both passes share a push range");
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(upscale::EdgePush);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = computeUpscaleSetLayout.address();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout createdLayout;
+		if (capture::vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &createdLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute upscale pipeline layout!");
+		}
+		computeUpscaleLayout = vkh::PipelineLayout(device, createdLayout, allocator);
+
+		edgePipeline = createComputePipeline("shaders/upscale_edge.comp.spv", computeUpscaleLayout);
+		if (upscaleSettings.sharpen) {
+			sharpenPipeline = createComputePipeline("shaders/sharpen.comp.spv", computeUpscaleLayout);
+		}
+	}
+
+
+	// Balanced <-> quality. Frames still in flight use the old images, descriptors and
+	// pipelines, so they are retired rather than destroyed, and the new ones are used from
+	// this frame on. The performance preset changes the swap chain, so it stays as started.
+	void switchComputeUpscalePreset() {
+		if (!upscaleSettings.compute) {
+			std::cout << "Upscale preset: performance can only be changed at startup" << std::endl;
+			return;
+		}
+
+		deletionQueue.retire(std::move(sharpenPipeline), frameNumber);
+		deletionQueue.retire(std::move(edgePipeline), frameNumber);
+		deletionQueue.retire(std::move(computeUpscaleLayout), frameNumber);
+		deletionQueue.retire(std::move(computeUpscalePool), frameNumber);
+		deletionQueue.retire(std::move(computeUpscaleSetLayout), frameNumber);
+		deletionQueue.retire(std::move(exportView), frameNumber);
+		deletionQueue.retire(std::move(exportImage), frameNumber);
+		deletionQueue.retire(std::move(exportMemory), frameNumber);
+		deletionQueue.retire(std::move(upscaleView), frameNumber);
+		deletionQueue.retire(std::move(upscaleImage), frameNumber);
+		deletionQueue.retire(std::move(upscaleMemory), frameNumber);
+
+		setUpscalePreset(upscalePreset == upscale::Preset::Quality ? upscale::Preset::Balanced : upscale::Preset::Quality);
+		createComputeUpscale();
+		std::cout << "Upscale preset: " << upscale::presetName(upscalePreset) << std::endl;
+	}
+
+
+	vkh::Pipeline createComputePipeline(const std::string& path, VkPipelineLayout layout) {
+		vkh::ShaderModule shaderModule = createShaderModule(readFile(path));
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		if (capture::vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+
+		return vkh::Pipeline(device, pipeline, allocator);
+	}
+
+
+	void createCommandPool() {
+		PROFILE_FUNCTION();
+
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+		// Command buffers are re-recorded every frame.
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+		VkCommandPool createdPool;
+		if (capture::vkCreateCommandPool(device, &poolInfo, allocator, &createdPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+		commandPool = vkh::CommandPool(device, createdPool, allocator);
+	}
+
+
+	void createCommandBuffers() {
+		PROFILE_FUNCTION();
+
+		commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+		if (capture::vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+	}
+
+
+	void createSyncObjects() {
+		PROFILE_FUNCTION();
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		// Signaled so the first wait in drawFrame() doesn't block forever.
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			// Each window acquires and presents on its own semaphores
+			for (Output& output : outputs) {
+				VkSemaphore imageAvailable, renderFinished;
+				if (capture::vkCreateSemaphore(device, &semaphoreInfo, allocator, &imageAvailable) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create synchronization objects for a frame!");
+				}
+				output.imageAvailableSemaphores.emplace_back(device, imageAvailable, allocator);
+
+				if (capture::vkCreateSemaphore(device, &semaphoreInfo, allocator, &renderFinished) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create synchronization objects for a frame!");
+				}
+				output.renderFinishedSemaphores.emplace_back(device, renderFinished, allocator);
+			}
+
+			VkFence inFlight;
+			if (capture::vkCreateFence(device, &fenceInfo, allocator, &inFlight) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
+			}
+			inFlightFences.emplace_back(device, inFlight, allocator);
+		}
+
+		waitSemaphores.reserve(outputs.size());
+		waitStages.reserve(outputs.size());
+		signalSemaphores.reserve(outputs.size());
+		presentSwapChains.reserve(outputs.size());
+		imageIndices.reserve(outputs.size());
+		presentResults.reserve(outputs.size());
+	}
+
+
+	void createTimestampQueries() {
+		PROFILE_FUNCTION();
+
+		// Timestamps need a non-zero valid bit count on the graphics queue.
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		timestampPeriod = properties.limits.timestampPeriod;
+		timestampsSupported = queueFamilies[indices.graphicsFamily.value()].timestampValidBits > 0 && timestampPeriod > 0.0f;
+		if (!timestampsSupported) return;
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * TIMESTAMPS_PER_FRAME;
+
+		VkQueryPool queryPool;
+		if (capture::vkCreateQueryPool(device, &queryPoolInfo, allocator, &queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+		timestampPool = vkh::QueryPool(device, queryPool, allocator);
+	}
+
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+
+	void createBuffer(
+		VkDeviceSize size,
+		VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties,
+		memstats::DeviceMemoryCategory category,
+		vkh::Buffer& buffer,
+		vkh::DeviceMemory& bufferMemory
+	) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer createdBuffer;
+		if (capture::vkCreateBuffer(device, &bufferInfo, allocator, &createdBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+		buffer = vkh::Buffer(device, createdBuffer, allocator);
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+		VkDeviceMemory memory;
+		if (capture::vkAllocateMemory(device, &allocInfo, allocator, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize, category);
+		bufferMemory = vkh::DeviceMemory(device, memory, allocator);
+
+		capture::vkBindBufferMemory(device, buffer, bufferMemory, 0);
+	}
+
+
+	void createImage(
+		uint32_t width,
+		uint32_t height,
+		VkFormat format,
+		VkImageUsageFlags usage,
+		vkh::Image& image,
+		vkh::DeviceMemory& imageMemory,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT
+	) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = samples;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImage createdImage;
+		if (capture::vkCreateImage(device, &imageInfo, allocator, &createdImage) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+		image = vkh::Image(device, createdImage, allocator);
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// Transient attachments never leave the render pass, a tiler can leave them unbacked
+		bool transient = usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		if (transient) {
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+			allocInfo.memoryTypeIndex = msaa::transientMemoryType(memProperties, memRequirements.memoryTypeBits).index;
+		}
+
+		VkDeviceMemory memory;
+		if (capture::vkAllocateMemory(device, &allocInfo, allocator, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+		memstats::deviceMemory().onAllocate(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize,
+			transient ? memstats::DeviceMemoryCategory::Transient : memstats::DeviceMemoryCategory::Image);
+		imageMemory = vkh::DeviceMemory(device, memory, allocator);
+
+		capture::vkBindImageMemory(device, image, imageMemory, 0);
+	}
+
+
+	// For one-off uploads at init, blocks until the GPU is done.
+	VkCommandBuffer beginSingleTimeCommands() {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		capture::vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		capture::vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		return commandBuffer;
+	}
+
+
+	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+		capture::vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		capture::vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		metricsSnapshot.queueSubmits++;
+		capture::vkQueueWaitIdle(graphicsQueue);
+
+		capture::vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	}
+
+
+	void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout) {
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		VkPipelineStageFlags sourceStage;
+		VkPipelineStageFlags destinationStage;
+
+		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		} else {
+			throw std::invalid_argument("unsupported layout transition!");
+		}
+
+		capture::vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		endSingleTimeCommands(commandBuffer);
+	}
+
+
+	void createHud() {
+		PROFILE_FUNCTION();
+
+		hudOverlay = std::make_unique<hud::Overlay>(); // ~500 KB of vertices, keep it off the stack
+
+		// Upload the prebaked glyph atlas.
+		std::vector<uint8_t> atlasPixels = hud::buildAtlas();
+		VkDeviceSize atlasSize = atlasPixels.size();
+
+		// Destroyed on return, endSingleTimeCommands() waits for the copy
+		vkh::Buffer stagingBuffer;
+		vkh::DeviceMemory stagingBufferMemory;
+		createBuffer(atlasSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			memstats::DeviceMemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		capture::vkMapMemory(device, stagingBufferMemory, 0, atlasSize, 0, &data);
+		memcpy(data, atlasPixels.data(), static_cast<size_t>(atlasSize));
+		capture::vkUnmapMemory(device, stagingBufferMemory);
+
+		createImage(hud::ATLAS_WIDTH, hud::ATLAS_HEIGHT, VK_FORMAT_R8_UNORM,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, hudAtlasImage, hudAtlasMemory);
+
+		transitionImageLayout(hudAtlasImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = {hud::ATLAS_WIDTH, hud::ATLAS_HEIGHT, 1};
+		capture::vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, hudAtlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		endSingleTimeCommands(commandBuffer);
+
+		transitionImageLayout(hudAtlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		hudAtlasView = createImageView(hudAtlasImage, VK_FORMAT_R8_UNORM);
+
+		// Nearest keeps the pixel font crisp.
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+		VkSampler sampler;
+		if (capture::vkCreateSampler(device, &samplerInfo, allocator, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create HUD sampler!");
+		}
+		hudSampler = vkh::Sampler(device, sampler, allocator);
+
+		createImageDescriptor(hudAtlasView, hudSampler, hudDescriptorSetLayout, hudDescriptorPool, hudDescriptorSet);
+		createHudPipeline();
+
+		// One persistently mapped vertex buffer per frame in flight, written every frame.
+		hudVertexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		hudVertexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		hudVertexBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+		VkDeviceSize vertexBufferSize = sizeof(hud::Vertex) * hud::MAX_VERTICES;
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			createBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				memstats::DeviceMemoryCategory::Buffer, hudVertexBuffers[i], hudVertexBuffersMemory[i]);
+
+			capture::vkMapMemory(device, hudVertexBuffersMemory[i], 0, vertexBufferSize, 0, &hudVertexBuffersMapped[i]);
+		}
+	}
+
+
+	// One combined image sampler at binding 0, read by the fragment shader.
+	void createImageDescriptor(
+		VkImageView view,
+		VkSampler sampler,
+		vkh::DescriptorSetLayout& setLayout,
+		vkh::DescriptorPool& pool,
+		VkDescriptorSet& set
+	) {
+		VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+		samplerLayoutBinding.binding = 0;
+		samplerLayoutBinding.descriptorCount = 1;
+		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &samplerLayoutBinding;
+
+		VkDescriptorSetLayout createdSetLayout;
+		if (capture::vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &createdSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		setLayout = vkh::DescriptorSetLayout(device, createdSetLayout, allocator);
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+
+		VkDescriptorPool descriptorPool;
+		if (capture::vkCreateDescriptorPool(device, &poolInfo, allocator, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		pool = vkh::DescriptorPool(device, descriptorPool, allocator);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = setLayout.address();
+
+		if (capture::vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = view;
+		imageInfo.sampler = sampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		capture::vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+
+	void createHudPipeline() {
+		vkh::ShaderModule vertShaderModule = createShaderModule(readFile("shaders/hud.vert.spv"));
+		vkh::ShaderModule fragShaderModule = createShaderModule(readFile("shaders/hud.frag.spv"));
+
+		VkPipelineShaderStageCreateInfo shaderStages[] = {
+			shaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule),
+			shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule)
+		};
+
+		// Matches hud::Vertex
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(hud::Vertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		VkVertexInputAttributeDescription attributeDescriptions[3]{};
+		attributeDescriptions[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(hud::Vertex, pos))};
+		attributeDescriptions[1] = {1, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(hud::Vertex, uv))};
+		attributeDescriptions[2] = {2, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(hud::Vertex, color))};
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.vertexAttributeDescriptionCount = 3;
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+		// Regular alpha blending over the scene.
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+		// Screen size in pixels, the vertex shader maps pixels to clip space.
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(float) * 2;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = hudDescriptorSetLayout.address();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout createdLayout;
+		if (capture::vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &createdLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create HUD pipeline layout!");
+		}
+		hudPipelineLayout = vkh::PipelineLayout(device, createdLayout, allocator);
+
+		hudPipeline = createPipeline(shaderStages, vertexInputInfo, colorBlendAttachment, hudPipelineLayout, renderPass);
+	}
+
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t hudVertexCount) {
+		PROFILE_FUNCTION();
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		if (capture::vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+
+		uint32_t queryBase = currentFrame * TIMESTAMPS_PER_FRAME;
+		if (timestampsSupported) {
+			capture::vkCmdResetQueryPool(commandBuffer, timestampPool, queryBase, TIMESTAMPS_PER_FRAME);
+		}
+
+		VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+		// Scene, at the dynamic resolution in the top left of its target
+		if (timestampsSupported) {
+			capture::vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, queryBase + 0);
+		}
+
+		VkRenderPassBeginInfo sceneInfo{};
+		sceneInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		sceneInfo.renderPass = sceneRenderPass;
+		sceneInfo.framebuffer = sceneFramebuffer;
+		sceneInfo.renderArea.offset = {0, 0};
+		sceneInfo.renderArea.extent = renderExtent;
+		sceneInfo.clearValueCount = 1;
+		sceneInfo.pClearValues = &clearColor;
+
+		beginDebugLabel(commandBuffer, "scene");
+		capture::vkCmdBeginRenderPass(commandBuffer, &sceneInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport sceneViewport{};
+		sceneViewport.width = static_cast<float>(renderExtent.width);
+		sceneViewport.height = static_cast<float>(renderExtent.height);
+		sceneViewport.maxDepth = 1.0f;
+		capture::vkCmdSetViewport(commandBuffer, 0, 1, &sceneViewport);
+
+		VkRect2D sceneScissor{};
+		sceneScissor.extent = renderExtent;
+		capture::vkCmdSetScissor(commandBuffer, 0, 1, &sceneScissor);
+
+		capture::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		capture::vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		capture::vkCmdEndRenderPass(commandBuffer);
+		endDebugLabel(commandBuffer);
+
+		if (timestampsSupported) {
+			capture::vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, queryBase + 1);
+		}
+
+		// Output: scene upscaled to every acquired swap chain image, HUD on top at native resolution.
+		// The scene and the compute upscale run once however many windows there are.
+		if (timestampsSupported) {
+			capture::vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, queryBase + 2);
+		}
+
+		if (upscaleSettings.compute) {
+			beginDebugLabel(commandBuffer, "upscale");
+			recordComputeUpscale(commandBuffer);
+			endDebugLabel(commandBuffer);
+		}
+
+		beginDebugLabel(commandBuffer, "output");
+		for (const Output& output : outputs) {
+			if (output.acquired) {
+				recordOutputPass(commandBuffer, output.framebuffers[output.imageIndex], hudVertexCount);
+			}
+		}
+		endDebugLabel(commandBuffer);
+
+		if (timestampsSupported) {
+			capture::vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, queryBase + 3);
+		}
+
+		if (capture::vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+
+
+	void recordOutputPass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, uint32_t hudVertexCount) {
+		VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = swapChainExtent;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		capture::vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(swapChainExtent.width);
+		viewport.height = static_cast<float>(swapChainExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		capture::vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = {0, 0};
+		scissor.extent = swapChainExtent;
+		capture::vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		if (!upscaleSettings.compute) {
+			float upscale[4] = {
+				static_cast<float>(renderExtent.width) / swapChainExtent.width,
+				static_cast<float>(renderExtent.height) / swapChainExtent.height,
+				(renderExtent.width - 0.5f) / swapChainExtent.width,
+				(renderExtent.height - 0.5f) / swapChainExtent.height
+			};
+
+			capture::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipeline);
+			capture::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout,
+				0, 1, &upscaleDescriptorSet, 0, nullptr);
+			capture::vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(upscale), upscale);
+			capture::vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		}
+
+		if (hudVertexCount > 0) {
+			float screenSize[2] = {viewport.width, viewport.height};
+			VkDeviceSize offset = 0;
+
+			capture::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, hudPipeline);
+			capture::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, hudPipelineLayout,
+				0, 1, &hudDescriptorSet, 0, nullptr);
+			capture::vkCmdPushConstants(commandBuffer, hudPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(screenSize), screenSize);
+			capture::vkCmdBindVertexBuffers(commandBuffer, 0, 1, hudVertexBuffers[currentFrame].address(), &offset);
+			capture::vkCmdDraw(commandBuffer, hudVertexCount, 1, 0, 0);
+		}
+
+		capture::vkCmdEndRenderPass(commandBuffer);
+	}
+
+
+	static VkImageMemoryBarrier colorBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		return barrier;
+	}
+
+
+	// Compute presets: scene -> edge pass -> (sharpen pass) -> export image, blitted into each
+	// acquired swap chain image. The blit does the format conversion and the sRGB encode.
+	void recordComputeUpscale(VkCommandBuffer commandBuffer) {
+		int32_t width = static_cast<int32_t>(swapChainExtent.width);
+		int32_t height = static_cast<int32_t>(swapChainExtent.height);
+
+		// Every pixel gets rewritten, old contents can go. The previous frame's sharpen pass
+		// and blit may still be reading these images.
+		VkImageMemoryBarrier storageBarriers[2] = {
+			colorBarrier(exportImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT),
+			colorBarrier(upscaleImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT)
+		};
+		capture::vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, upscaleSettings.sharpen ? 2 : 1, storageBarriers);
+
+		upscale::EdgePush edge{
+			{static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height)},
+			{width, height}
+		};
+
+		capture::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, edgePipeline);
+		capture::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeUpscaleLayout,
+			0, 1, &edgeDescriptorSet, 0, nullptr);
+		capture::vkCmdPushConstants(commandBuffer, computeUpscaleLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(edge), &edge);
+		capture::vkCmdDispatch(commandBuffer, upscale::groupCount(swapChainExtent.width), upscale::groupCount(swapChainExtent.height), 1);
+
+		if (upscaleSettings.sharpen) {
+			VkImageMemoryBarrier readBarrier = colorBarrier(upscaleImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			capture::vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &readBarrier);
+
+			upscale::SharpenPush sharpen{{width, height}, upscaleSettings.sharpness, 0.0f};
+
+			capture::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sharpenPipeline);
+			capture::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeUpscaleLayout,
+				0, 1, &sharpenDescriptorSet, 0, nullptr);
+			capture::vkCmdPushConstants(commandBuffer, computeUpscaleLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sharpen), &sharpen);
+			capture::vkCmdDispatch(commandBuffer, upscale::groupCount(swapChainExtent.width), upscale::groupCount(swapChainExtent.height), 1);
+		}
+
+		// The swap chain images' source stage chains onto the acquire semaphore waits in drawFrame()
+		std::vector<VkImageMemoryBarrier> blitBarriers = {
+			colorBarrier(exportImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT)
+		};
+		for (const Output& output : outputs) {
+			if (!output.acquired) continue;
+			blitBarriers.push_back(colorBarrier(output.images[output.imageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+		}
+		capture::vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(blitBarriers.size()), blitBarriers.data());
+
+		VkImageBlit region{};
+		region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+		region.srcOffsets[1] = {width, height, 1};
+		region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+		region.dstOffsets[1] = {width, height, 1};
+
+		for (const Output& output : outputs) {
+			if (!output.acquired) continue;
+			capture::vkCmdBlitImage(commandBuffer, exportImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				output.images[output.imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+		}
+	}
+
+
+	// Called once this frame slot's fence has signaled, so its queries are finished.
+	void readGpuTimings(uint32_t frame) {
+		if (!timestampsSupported || !timestampsWritten[frame]) return;
+
+		uint64_t timestamps[TIMESTAMPS_PER_FRAME];
+		VkResult result = vkGetQueryPoolResults(device, timestampPool, frame * TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) return;
+
+		double nsToMs = timestampPeriod / 1e6;
+		hudStats.gpuScenePassMs = (timestamps[1] - timestamps[0]) * nsToMs;
+		hudStats.gpuOutputPassMs = (timestamps[3] - timestamps[2]) * nsToMs;
+		hudStats.gpuTimingsValid = true;
+
+		lastGpuFrameMs = (timestamps[3] - timestamps[0]) * nsToMs;
+		resolutionController.update(lastGpuFrameMs, renderScales[frame]);
+	}
+
+
+	void drawFrame() {
+		PROFILE_FUNCTION();
+
+		{
+			PROFILE_ZONE("wait for frame fence");
+			capture::vkWaitForFences(device, 1, inFlightFences[currentFrame].address(), VK_TRUE, UINT64_MAX);
+		}
+
+		// This slot's last frame is done, and every frame before it
+		if (frameNumber >= MAX_FRAMES_IN_FLIGHT) {
+			deletionQueue.collect(frameNumber - MAX_FRAMES_IN_FLIGHT);
+		}
+
+		if (upscalePresetSwitchRequested) {
+			upscalePresetSwitchRequested = false;
+			switchComputeUpscalePreset();
+		}
+
+		readGpuTimings(currentFrame);
+
+		renderScales[currentFrame] = resolutionController.scale();
+		renderExtent = dynres::scaledExtent(swapChainExtent, renderScales[currentFrame]);
+
+		// Windows can't be resized, so an out of date swap chain only happens while minimized.
+		// Minimized windows sit the frame out, the others still get it.
+		waitSemaphores.clear();
+		waitStages.clear();
+		signalSemaphores.clear();
+		presentSwapChains.clear();
+		imageIndices.clear();
+		for (Output& output : outputs) {
+			VkResult result = capture::vkAcquireNextImageKHR(device, output.swapChain, UINT64_MAX,
+				output.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &output.imageIndex);
+
+			output.acquired = result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+			if (!output.acquired && result != VK_ERROR_OUT_OF_DATE_KHR) {
+				throw std::runtime_error("failed to acquire swap chain image!");
+			}
+
+			if (output.acquired) {
+				waitSemaphores.push_back(output.imageAvailableSemaphores[currentFrame]);
+				waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+				signalSemaphores.push_back(output.renderFinishedSemaphores[currentFrame]);
+				presentSwapChains.push_back(output.swapChain);
+				imageIndices.push_back(output.imageIndex);
+			}
+		}
+
+		if (presentSwapChains.empty()) {
+			return;
+		}
+
+		capture::vkResetFences(device, 1, inFlightFences[currentFrame].address());
+
+		// CPU frame time is measured start to start
+		auto frameStart = std::chrono::steady_clock::now();
+		hudStats.cpuFrameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+		lastFrameStart = frameStart;
+
+		uint32_t hudVertexCount = 0;
+		if (hudVisible) {
+			PROFILE_ZONE("hud build");
+
+			hudStats.drawCount = 1 + 2 * static_cast<uint32_t>(presentSwapChains.size()); // Scene triangle, then upscale and batched HUD per window
+			hudStats.renderWidth = renderExtent.width;
+			hudStats.renderHeight = renderExtent.height;
+			hudStats.renderScale = resolutionController.scale();
+			hudStats.hostBytes = memstats::cppCounters.currentBytes.load(std::memory_order_relaxed) +
+				memstats::vulkanCounters.currentBytes.load(std::memory_order_relaxed);
+			hudStats.deviceBytes = memstats::deviceMemory().totalUsage().currentBytes;
+			hudStats.frameAllocations = memstats::frameCounter.lastFrame;
+			hudStats.droppedZones = profiler::droppedZones();
+
+			hudOverlay->build(hudStats);
+			hudVertexCount = hudOverlay->vertexCount();
+			memcpy(hudVertexBuffersMapped[currentFrame], hudOverlay->vertices(), sizeof(hud::Vertex) * hudVertexCount);
+		}
+
+		capture::vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+		recordCommandBuffer(commandBuffers[currentFrame], hudVertexCount);
+		timestampsWritten[currentFrame] = true;
+
+		// One submit for every window: waits on all the acquires, signals one semaphore per present
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		if (capture::vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+		metricsSnapshot.queueSubmits++;
+
+		// All windows in one batched present, each with its own result. Within the reserved size.
+		presentResults.resize(presentSwapChains.size());
+
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		presentInfo.pWaitSemaphores = signalSemaphores.data();
+		presentInfo.swapchainCount = static_cast<uint32_t>(presentSwapChains.size());
+		presentInfo.pSwapchains = presentSwapChains.data();
+		presentInfo.pImageIndices = imageIndices.data();
+		presentInfo.pResults = presentResults.data();
+
+		capture::vkQueuePresentKHR(presentQueue, &presentInfo);
+		metricsSnapshot.presents++;
+
+		for (VkResult result : presentResults) {
+			if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+				throw std::runtime_error("failed to present swap chain image!");
+			}
+		}
+
+		resolutionTrajectory.record(frameNumber, resolutionController.scale(), renderExtent, lastGpuFrameMs);
+
+		if (metricsExporter.isRunning()) {
+			publishMetrics();
+		}
+
+		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		frameNumber++;
+	}
+
+
+	void publishMetrics() {
+		PROFILE_FUNCTION();
+
+		metricsSnapshot.addFrameTime(hudStats.cpuFrameMs);
+
+		for (uint32_t i = 0; i < metricsSnapshot.heapCount; i++) {
+			memstats::DeviceUsage usage = memstats::deviceMemory().heapUsage(i);
+			metricsSnapshot.heaps[i].currentBytes = usage.currentBytes;
+			metricsSnapshot.heaps[i].peakBytes = usage.peakBytes;
+		}
+
+		metricsSnapshot.hostCppBytes = memstats::cppCounters.currentBytes.load(std::memory_order_relaxed);
+		metricsSnapshot.hostVulkanBytes = memstats::vulkanCounters.currentBytes.load(std::memory_order_relaxed);
+
+		metricsSnapshot.renderScale = resolutionController.scale();
+		metricsSnapshot.renderWidth = renderExtent.width;
+		metricsSnapshot.renderHeight = renderExtent.height;
+		metricsSnapshot.gpuFrameMs = lastGpuFrameMs;
+
+		metricsExporter.publish(metricsSnapshot);
+	}
+
+
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+
+		if (key == HUD_TOGGLE_KEY && action == GLFW_PRESS) {
+			app->hudVisible = !app->hudVisible;
+		}
+		if (key == UPSCALE_PRESET_KEY && action == GLFW_PRESS) {
+			app->upscalePresetSwitchRequested = true;
+		}
+	}
+
+
+	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
+		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+		VkDebugUtilsMessageTypeFlagsEXT messageType,
+		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+		void* pUserData
+	) {
+		metrics::countValidationMessage(messageSeverity);
+
+		std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+
+		return VK_FALSE;
+	}
+
+
+};
+
+
+int main(int argc, char* argv[]) {
+	profiler::init();
+
+	// `--trace <file>` writes profiling zones as Chrome trace JSON on exit
+	// `--perf-counters` adds hardware counters (cycles, IPC, misses) to the frame zones
+	// `--metrics-socket <path>` serves Prometheus metrics on a Unix domain socket
+	// `--capture <file>` records the Vulkan calls for `VulkanBench.out --capture <file>`
+	// `--gpu-budget <ms>` sets the GPU frame time dynamic resolution aims for
+	// `--upscale-preset <performance|balanced|quality>` picks the scene upscaler, see upscaler.h
+	// `--msaa <samples>` caps the scene's samples per pixel, 1 turns MSAA off
+	// `--windows <n>` opens n windows rendered by one device, one per monitor
+	// `--layer-audit` times instance creation with each installed implicit layer before starting
+	// `--allow-layers <name,...|none>` keeps only these implicit layers out of those installed
+	// `--policy <debug|release>` picks the compiled validation policy, the build's by default
+	// `--frames <n>` exits after n frames with the average frame time
+	std::string tracePath;
+	std::string metricsSocketPath;
+	std::string capturePath;
+	double gpuBudgetMs = dynres::DEFAULT_BUDGET_MS;
+	std::string upscalePreset;
+	int msaaSamples = 0;
+	int windowCount = 0;
+	bool layerAudit = false;
+	std::optional<std::string> allowedLayers;
+	std::string policyName = DefaultPolicy::name;
+	int frameLimit = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[i + 1];
+		if (strcmp(argv[i], "--perf-counters") == 0) perfcounters::enable();
+		if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc) metricsSocketPath = argv[i + 1];
+		if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capturePath = argv[i + 1];
+		if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc) gpuBudgetMs = atof(argv[i + 1]);
+		if (strcmp(argv[i], "--upscale-preset") == 0 && i + 1 < argc) upscalePreset = argv[i + 1];
+		if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) msaaSamples = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) windowCount = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--layer-audit") == 0) layerAudit = true;
+		if (strcmp(argv[i], "--allow-layers") == 0 && i + 1 < argc) allowedLayers = argv[i + 1];
+		if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) policyName = argv[i + 1];
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frameLimit = atoi(argv[i + 1]);
+	}
+
+	// Both policies are compiled in, so they can be compared in one binary
+	auto launch = [&](auto policy) {
+		using Policy = decltype(policy);
+
+		if constexpr (Policy::validation) {
+			std::cout << "VALIDATION LAYERS ENABLED!" << std::endl;
+		}
+		else {
+			std::cout << "VALIDATION LAYERS DISABLED!" << std::endl;
+		}
+
+		HelloTriangleApplication<Policy> app;
+		if (!metricsSocketPath.empty()) {
+			app.enableMetrics(metricsSocketPath);
+		}
+		if (!capturePath.empty()) {
+			app.enableCapture(capturePath);
+		}
+		if (gpuBudgetMs > 0.0) {
+			app.setGpuBudget(gpuBudgetMs);
+		}
+		if (msaaSamples > 0) {
+			app.setMsaaSamples(static_cast<uint32_t>(msaaSamples));
+		}
+		if (windowCount > 0) {
+			app.setWindowCount(static_cast<uint32_t>(windowCount));
+		}
+		if (frameLimit > 0) {
+			app.setFrameLimit(static_cast<uint32_t>(frameLimit));
+		}
+		if (allowedLayers) {
+			app.allowImplicitLayers(*allowedLayers == "none" ? std::vector<std::string>{} : layers::detail::splitList(*allowedLayers, ','));
+		}
+
+		try {
+			// Before the allow list is applied, so the audit sees every installed layer
+			if (layerAudit) {
+				layers::printAudit(layers::audit(layers::findImplicitLayers()), std::cout);
+			}
+			if (!upscalePreset.empty()) {
+				app.setUpscalePreset(upscale::parsePreset(upscalePreset));
+			}
+			app.run();
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	};
+
+	int result;
+	if (policyName == DebugPolicy::name) {
+		result = launch(DebugPolicy{});
+	} else if (policyName == ReleasePolicy::name) {
+		result = launch(ReleasePolicy{});
+	} else {
+		std::cerr << "unknown policy " << policyName << ", expected debug or release" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (result != EXIT_SUCCESS) {
+		return result;
+	}
+
+	if (PROFILING_ENABLED && !tracePath.empty()) {
+		if (profiler::writeChromeTrace(tracePath)) {
+			std::cout << "Wrote profiler trace to " << tracePath << std::endl;
+		} else {
+			std::cerr << "failed to write profiler trace to " << tracePath << std::endl;
+		}
 	}
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,413 @@
+/*
+* Host and device memory accounting.
+* - Host: Vulkan allocations go through memstats::vulkanAllocator(), C++ allocations
+*   are counted by replacing operator new/delete. Define MEMORY_STATS_HOOK_NEW before
+*   including this header in exactly one translation unit to install the hook.
+* - Device: call memstats::deviceMemory().onAllocate()/onFree() next to
+*   vkAllocateMemory()/vkFreeMemory(), tagged with a category.
+* - Per frame: beginFrame()/endFrame() count host allocations made in between, so
+*   steady state frames can be checked with expectAllocationFreeFrame().
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+
+namespace memstats {
+
+struct HostCounters {
+	std::atomic<int64_t> currentBytes{0};
+	std::atomic<int64_t> peakBytes{0};
+	std::atomic<uint64_t> allocations{0};
+	std::atomic<uint64_t> frees{0};
+
+	void onAllocate(size_t size) {
+		int64_t current = currentBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + size;
+		allocations.fetch_add(1, std::memory_order_relaxed);
+
+		int64_t peak = peakBytes.load(std::memory_order_relaxed);
+		while (current > peak && !peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+	}
+
+	void onFree(size_t size) {
+		currentBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+		frees.fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+// Plain globals, operator new can run before any function local static is constructed.
+inline HostCounters cppCounters;     // operator new/delete
+inline HostCounters vulkanCounters;  // VkAllocationCallbacks
+inline HostCounters driverInternal;  // pfnInternalAllocation notifications
+
+
+/*
+* VkAllocationCallbacks
+*/
+
+// Stored right before the pointer handed to Vulkan.
+struct AllocationHeader {
+	size_t size;
+	size_t offset; // From the start of the raw block to the user pointer
+};
+
+
+inline void* VKAPI_CALL vulkanAllocate(void*, size_t size, size_t alignment, VkSystemAllocationScope) {
+	if (size == 0) return nullptr;
+
+	alignment = std::max(alignment, alignof(AllocationHeader));
+	size_t headerSpace = (sizeof(AllocationHeader) + alignment - 1) / alignment * alignment;
+	size_t total = (headerSpace + size + alignment - 1) / alignment * alignment;
+
+	char* raw = static_cast<char*>(aligned_alloc(alignment, total));
+	if (raw == nullptr) return nullptr;
+
+	char* user = raw + headerSpace;
+	AllocationHeader* header = reinterpret_cast<AllocationHeader*>(user) - 1;
+	header->size = size;
+	header->offset = headerSpace;
+
+	vulkanCounters.onAllocate(size);
+	return user;
+}
+
+
+inline void VKAPI_CALL vulkanFree(void*, void* memory) {
+	if (memory == nullptr) return;
+
+	AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+	vulkanCounters.onFree(header->size);
+	free(static_cast<char*>(memory) - header->offset);
+}
+
+
+inline void* VKAPI_CALL vulkanReallocate(
+	void* userData,
+	void* original,
+	size_t size,
+	size_t alignment,
+	VkSystemAllocationScope scope
+) {
+	if (original == nullptr) return vulkanAllocate(userData, size, alignment, scope);
+
+	if (size == 0) {
+		vulkanFree(userData, original);
+		return nullptr;
+	}
+
+	void* memory = vulkanAllocate(userData, size, alignment, scope);
+	if (memory == nullptr) return nullptr; // Original stays valid, as the spec requires
+
+	size_t originalSize = (static_cast<AllocationHeader*>(original) - 1)->size;
+	memcpy(memory, original, std::min(size, originalSize));
+	vulkanFree(userData, original);
+
+	return memory;
+}
+
+
+inline void VKAPI_CALL vulkanInternalAllocate(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+	driverInternal.onAllocate(size);
+}
+
+
+inline void VKAPI_CALL vulkanInternalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+	driverInternal.onFree(size);
+}
+
+
+// Pass this wherever Vulkan takes a pAllocator. Create and destroy must use the same one.
+inline const VkAllocationCallbacks* vulkanAllocator() {
+	static const VkAllocationCallbacks callbacks = {
+		nullptr,
+		vulkanAllocate,
+		vulkanReallocate,
+		vulkanFree,
+		vulkanInternalAllocate,
+		vulkanInternalFree
+	};
+
+	return &callbacks;
+}
+
+
+/*
+* Device memory
+*/
+
+enum class DeviceMemoryCategory {
+	Buffer,
+	Image,
+	Staging,
+	Readback,
+	Transient, // Multisampled attachments, see msaa.h
+	Other,
+	Count
+};
+
+inline const char* categoryName(DeviceMemoryCategory category) {
+	switch (category) {
+		case DeviceMemoryCategory::Buffer: return "buffer";
+		case DeviceMemoryCategory::Image: return "image";
+		case DeviceMemoryCategory::Staging: return "staging";
+		case DeviceMemoryCategory::Readback: return "readback";
+		case DeviceMemoryCategory::Transient: return "transient";
+		default: return "other";
+	}
+}
+
+
+struct DeviceUsage {
+	VkDeviceSize currentBytes = 0;
+	VkDeviceSize peakBytes = 0;
+	uint64_t allocations = 0;
+
+	void add(VkDeviceSize size) {
+		currentBytes += size;
+		peakBytes = std::max(peakBytes, currentBytes);
+		allocations++;
+	}
+
+	void remove(VkDeviceSize size) {
+		currentBytes -= size;
+	}
+};
+
+
+class DeviceMemoryTracker {
+public:
+	// Call once the physical device is picked, so allocations can be attributed to heaps.
+	void init(const VkPhysicalDeviceMemoryProperties& properties) {
+		std::lock_guard<std::mutex> lock(mutex);
+		memoryProperties = properties;
+	}
+
+	void onAllocate(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size, DeviceMemoryCategory category) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		live[memory] = Allocation{memoryTypeIndex, heapIndex, size, category};
+
+		total.add(size);
+		byHeap[heapIndex].add(size);
+		byType[memoryTypeIndex].add(size);
+		byCategory[static_cast<size_t>(category)].add(size);
+	}
+
+	void onFree(VkDeviceMemory memory) {
+		if (memory == VK_NULL_HANDLE) return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = live.find(memory);
+		if (it == live.end()) return;
+
+		const Allocation& allocation = it->second;
+		total.remove(allocation.size);
+		byHeap[allocation.heapIndex].remove(allocation.size);
+		byType[allocation.memoryTypeIndex].remove(allocation.size);
+		byCategory[static_cast<size_t>(allocation.category)].remove(allocation.size);
+
+		live.erase(it);
+	}
+
+	DeviceUsage heapUsage(uint32_t heapIndex) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return byHeap[heapIndex];
+	}
+
+	DeviceUsage totalUsage() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return total;
+	}
+
+	void printReport(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		out << "Device memory: " << toKiB(total.currentBytes) << " KiB live, "
+			<< toKiB(total.peakBytes) << " KiB peak, " << total.allocations << " allocations" << std::endl;
+
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			out << "\theap " << i << " (" << toKiB(memoryProperties.memoryHeaps[i].size) << " KiB"
+				<< (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? ", device local" : "")
+				<< "): " << toKiB(byHeap[i].currentBytes) << " KiB live, "
+				<< toKiB(byHeap[i].peakBytes) << " KiB peak" << std::endl;
+		}
+
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if (byType[i].allocations == 0) continue;
+			out << "\ttype " << i << ": " << toKiB(byType[i].currentBytes) << " KiB live, "
+				<< toKiB(byType[i].peakBytes) << " KiB peak" << std::endl;
+		}
+
+		for (size_t i = 0; i < static_cast<size_t>(DeviceMemoryCategory::Count); i++) {
+			if (byCategory[i].allocations == 0) continue;
+			out << "\t" << categoryName(static_cast<DeviceMemoryCategory>(i)) << ": "
+				<< toKiB(byCategory[i].currentBytes) << " KiB live, "
+				<< toKiB(byCategory[i].peakBytes) << " KiB peak" << std::endl;
+		}
+	}
+
+	// Lists every allocation still alive. Returns true if there were any.
+	bool reportLeaks(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto& entry : live) {
+			out << "leaked device memory: " << entry.second.size << " bytes, type " << entry.second.memoryTypeIndex
+				<< ", " << categoryName(entry.second.category) << std::endl;
+		}
+
+		return !live.empty();
+	}
+
+private:
+	struct Allocation {
+		uint32_t memoryTypeIndex;
+		uint32_t heapIndex;
+		VkDeviceSize size;
+		DeviceMemoryCategory category;
+	};
+
+	static VkDeviceSize toKiB(VkDeviceSize bytes) { return bytes / 1024; }
+
+	std::mutex mutex; // Allocations are rare, a lock is fine here
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	std::map<VkDeviceMemory, Allocation> live;
+
+	DeviceUsage total;
+	DeviceUsage byHeap[VK_MAX_MEMORY_HEAPS];
+	DeviceUsage byType[VK_MAX_MEMORY_TYPES];
+	DeviceUsage byCategory[static_cast<size_t>(DeviceMemoryCategory::Count)];
+};
+
+
+inline DeviceMemoryTracker& deviceMemory() {
+	static DeviceMemoryTracker tracker;
+	return tracker;
+}
+
+
+/*
+* Per frame host allocation counter
+*/
+
+struct FrameCounter {
+	uint64_t allocationsAtBegin = 0;
+	uint64_t lastFrame = 0;
+	uint64_t maxFrame = 0;
+	uint64_t frames = 0;
+};
+
+inline FrameCounter frameCounter;
+
+
+inline uint64_t hostAllocationCount() {
+	return cppCounters.allocations.load(std::memory_order_relaxed) +
+		vulkanCounters.allocations.load(std::memory_order_relaxed);
+}
+
+
+inline void beginFrame() {
+	frameCounter.allocationsAtBegin = hostAllocationCount();
+}
+
+
+// Returns how many host allocations happened since beginFrame().
+inline uint64_t endFrame() {
+	frameCounter.lastFrame = hostAllocationCount() - frameCounter.allocationsAtBegin;
+	frameCounter.maxFrame = std::max(frameCounter.maxFrame, frameCounter.lastFrame);
+	frameCounter.frames++;
+	return frameCounter.lastFrame;
+}
+
+
+// Throws if the last finished frame allocated on the host. For steady state checks.
+inline void expectAllocationFreeFrame() {
+	if (frameCounter.lastFrame != 0) {
+		throw std::runtime_error("frame " + std::to_string(frameCounter.frames) + " made " +
+			std::to_string(frameCounter.lastFrame) + " host allocations, expected none!");
+	}
+}
+
+
+inline void printHostReport(std::ostream& out) {
+	auto line = [&](const char* name, const HostCounters& counters) {
+		out << "\t" << std::left << std::setw(16) << name << std::right
+			<< counters.currentBytes.load() << " bytes live, "
+			<< counters.peakBytes.load() << " bytes peak, "
+			<< counters.allocations.load() << " allocs, "
+			<< counters.frees.load() << " frees" << std::endl;
+	};
+
+	out << "Host memory:" << std::endl;
+	line("c++", cppCounters);
+	line("vulkan", vulkanCounters);
+	line("driver internal", driverInternal);
+	out << "\tframes: " << frameCounter.frames << ", max host allocations in a frame: "
+		<< frameCounter.maxFrame << std::endl;
+}
+
+
+// Vulkan host memory still alive after everything was destroyed is a leak.
+inline bool reportHostLeaks(std::ostream& out) {
+	int64_t live = vulkanCounters.currentBytes.load();
+	if (live != 0) {
+		out << "leaked vulkan host memory: " << live << " bytes in "
+			<< (vulkanCounters.allocations.load() - vulkanCounters.frees.load()) << " allocations" << std::endl;
+	}
+	return live != 0;
+}
+
+} // namespace memstats
+
+
+#ifdef MEMORY_STATS_HOOK_NEW
+
+void* operator new(size_t size) {
+	void* memory = malloc(size == 0 ? 1 : size);
+	if (memory == nullptr) throw std::bad_alloc();
+
+	memstats::cppCounters.onAllocate(malloc_usable_size(memory));
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+	if (memory == nullptr) return;
+
+	memstats::cppCounters.onFree(malloc_usable_size(memory));
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+#endif
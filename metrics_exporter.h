@@ -0,0 +1,329 @@
+/*
+* Prometheus text format metrics on a Unix domain socket, for local scraping.
+* - The render thread fills a Snapshot and calls publish() once per frame. Snapshots go
+*   through a lock-free triple buffer, so publishing never waits on a scrape and a scrape
+*   never sees a half written snapshot.
+* - A background thread accepts connections and answers each one with the latest snapshot.
+*   HTTP requests (curl --unix-socket) get an HTTP response, anything else gets the raw text.
+* - Validation messages can arrive on any thread, so they're counted with plain atomics.
+* - Nothing on either side allocates after start(), so scrapes don't show up in the
+*   per frame host allocation counts (memory_stats.h).
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+namespace metrics {
+
+// Frame time percentiles are taken over this many most recent frames.
+const uint32_t FRAME_WINDOW = 512;
+
+const char* const PREFIX = "vulkan_triangle";
+
+
+enum Severity {
+	Verbose,
+	Info,
+	Warning,
+	Error,
+	SeverityCount
+};
+
+inline const char* const severityNames[SeverityCount] = {
+	"verbose",
+	"info",
+	"warning",
+	"error"
+};
+
+inline std::atomic<uint64_t> validationMessages[SeverityCount];
+
+
+// Safe to call from the debug messenger callback on any thread.
+inline void countValidationMessage(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+	Severity bucket = Verbose;
+	if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) bucket = Error;
+	else if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) bucket = Warning;
+	else if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) bucket = Info;
+
+	validationMessages[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+struct HeapSample {
+	VkDeviceSize sizeBytes = 0;
+	bool deviceLocal = false;
+	VkDeviceSize currentBytes = 0;
+	VkDeviceSize peakBytes = 0;
+};
+
+
+// Everything one scrape reports. Plain data, copied whole into the triple buffer.
+struct Snapshot {
+	// Ring of recent frame times, newest at (frameTimesNext - 1)
+	float frameTimesMs[FRAME_WINDOW] = {};
+	uint32_t frameTimesNext = 0;
+	uint32_t frameTimesCount = 0;
+
+	uint64_t frames = 0;
+	double frameTimeSumMs = 0.0;
+
+	uint64_t queueSubmits = 0;
+	uint64_t presents = 0;
+
+	uint32_t heapCount = 0;
+	HeapSample heaps[VK_MAX_MEMORY_HEAPS];
+
+	int64_t hostCppBytes = 0;
+	int64_t hostVulkanBytes = 0;
+
+	// Dynamic resolution
+	float renderScale = 1.0f;
+	uint32_t renderWidth = 0;
+	uint32_t renderHeight = 0;
+	double gpuFrameMs = 0.0;
+
+	void addFrameTime(double ms) {
+		frameTimesMs[frameTimesNext] = static_cast<float>(ms);
+		frameTimesNext = (frameTimesNext + 1) % FRAME_WINDOW;
+		frameTimesCount = std::min(frameTimesCount + 1, FRAME_WINDOW);
+		frames++;
+		frameTimeSumMs += ms;
+	}
+};
+
+
+class Exporter {
+public:
+	Exporter() = default;
+	~Exporter() { stop(); }
+
+	Exporter(const Exporter&) = delete;
+	Exporter& operator=(const Exporter&) = delete;
+
+	// Binds the socket and starts the server thread. Replaces a stale socket file at path.
+	void start(const std::string& path) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			throw std::runtime_error("metrics socket path too long!");
+		}
+		strcpy(address.sun_path, path.c_str());
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (listenFd < 0) {
+			throw std::runtime_error("failed to create metrics socket!");
+		}
+
+		unlink(path.c_str());
+		if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 8) < 0) {
+			close(listenFd);
+			listenFd = -1;
+			throw std::runtime_error("failed to bind metrics socket " + path + "!");
+		}
+
+		socketPath = path;
+		running.store(true, std::memory_order_relaxed);
+		server = std::thread(&Exporter::serve, this);
+	}
+
+	void stop() {
+		if (!running.exchange(false)) return;
+
+		server.join();
+		close(listenFd);
+		listenFd = -1;
+		unlink(socketPath.c_str());
+	}
+
+	bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+	// Render thread only. Copies the snapshot and hands it to the server thread without waiting.
+	void publish(const Snapshot& snapshot) {
+		buffers[writeIndex] = snapshot;
+		writeIndex = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+private:
+	static const uint32_t FRESH_BIT = 4;
+	static const uint32_t INDEX_MASK = 3;
+
+	// Triple buffer: writer owns writeIndex, reader owns readIndex, middle is swapped atomically
+	Snapshot buffers[3];
+	uint32_t writeIndex = 0;
+	std::atomic<uint32_t> middle{1};
+	uint32_t readIndex = 2;
+
+	int listenFd = -1;
+	std::string socketPath;
+	std::atomic<bool> running{false};
+	std::thread server;
+
+	char request[1024];
+	char body[16 * 1024];
+	char response[17 * 1024];
+
+	// Server thread only. Returns the newest published snapshot.
+	const Snapshot& latest() {
+		if (middle.load(std::memory_order_relaxed) & FRESH_BIT) {
+			readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+		return buffers[readIndex];
+	}
+
+	void serve() {
+		while (running.load(std::memory_order_relaxed)) {
+			// Wake up regularly to notice stop()
+			pollfd pfd{listenFd, POLLIN, 0};
+			if (poll(&pfd, 1, 100) <= 0) continue;
+
+			int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client < 0) continue;
+
+			handle(client);
+			close(client);
+		}
+	}
+
+	void handle(int client) {
+		// Raw clients may not send anything, so only wait briefly for a request line
+		ssize_t received = 0;
+		pollfd pfd{client, POLLIN, 0};
+		if (poll(&pfd, 1, 50) > 0) {
+			received = recv(client, request, sizeof(request) - 1, 0);
+		}
+		bool http = received >= 4 && strncmp(request, "GET ", 4) == 0;
+
+		size_t bodyLength = format(latest(), body, sizeof(body));
+
+		const char* out = body;
+		size_t outLength = bodyLength;
+		if (http) {
+			int headerLength = snprintf(response, sizeof(response),
+				"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", bodyLength);
+			memcpy(response + headerLength, body, bodyLength);
+			out = response;
+			outLength = headerLength + bodyLength;
+		}
+
+		while (outLength > 0) {
+			ssize_t sent = send(client, out, outLength, MSG_NOSIGNAL);
+			if (sent <= 0) break;
+			out += sent;
+			outLength -= sent;
+		}
+	}
+
+	// Appends printf style text, silently truncating at the end of the buffer.
+	__attribute__((format(printf, 4, 5)))
+	static void append(char* buffer, size_t capacity, size_t& length, const char* format, ...) {
+		if (length >= capacity) return;
+
+		va_list args;
+		va_start(args, format);
+		int written = vsnprintf(buffer + length, capacity - length, format, args);
+		va_end(args);
+
+		if (written > 0) length = std::min(capacity - 1, length + written);
+	}
+
+	static size_t format(const Snapshot& s, char* out, size_t capacity) {
+		size_t length = 0;
+
+		// Percentiles over the recent window, sorted in a scratch copy
+		float sorted[FRAME_WINDOW];
+		std::copy(s.frameTimesMs, s.frameTimesMs + s.frameTimesCount, sorted);
+		std::sort(sorted, sorted + s.frameTimesCount);
+
+		const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+
+		append(out, capacity, length, "# HELP %s_frame_time_ms Frame time over the last %u frames.\n", PREFIX, FRAME_WINDOW);
+		append(out, capacity, length, "# TYPE %s_frame_time_ms summary\n", PREFIX);
+		for (double q : quantiles) {
+			double value = 0.0;
+			if (s.frameTimesCount > 0) {
+				uint32_t index = std::min(s.frameTimesCount - 1, static_cast<uint32_t>(q * s.frameTimesCount));
+				value = sorted[index];
+			}
+			append(out, capacity, length, "%s_frame_time_ms{quantile=\"%g\"} %.4f\n", PREFIX, q, value);
+		}
+		append(out, capacity, length, "%s_frame_time_ms_sum %.4f\n", PREFIX, s.frameTimeSumMs);
+		append(out, capacity, length, "%s_frame_time_ms_count %llu\n", PREFIX, static_cast<unsigned long long>(s.frames));
+
+		append(out, capacity, length, "# HELP %s_queue_submits_total vkQueueSubmit calls.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_queue_submits_total counter\n", PREFIX);
+		append(out, capacity, length, "%s_queue_submits_total %llu\n", PREFIX, static_cast<unsigned long long>(s.queueSubmits));
+
+		append(out, capacity, length, "# HELP %s_presents_total vkQueuePresentKHR calls.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_presents_total counter\n", PREFIX);
+		append(out, capacity, length, "%s_presents_total %llu\n", PREFIX, static_cast<unsigned long long>(s.presents));
+
+		append(out, capacity, length, "# HELP %s_device_memory_bytes Live device memory per heap.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_device_memory_bytes gauge\n", PREFIX);
+		for (uint32_t i = 0; i < s.heapCount; i++) {
+			append(out, capacity, length, "%s_device_memory_bytes{heap=\"%u\",device_local=\"%d\"} %llu\n",
+				PREFIX, i, s.heaps[i].deviceLocal, static_cast<unsigned long long>(s.heaps[i].currentBytes));
+		}
+
+		append(out, capacity, length, "# HELP %s_device_memory_peak_bytes Peak device memory per heap.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_device_memory_peak_bytes gauge\n", PREFIX);
+		for (uint32_t i = 0; i < s.heapCount; i++) {
+			append(out, capacity, length, "%s_device_memory_peak_bytes{heap=\"%u\",device_local=\"%d\"} %llu\n",
+				PREFIX, i, s.heaps[i].deviceLocal, static_cast<unsigned long long>(s.heaps[i].peakBytes));
+		}
+
+		append(out, capacity, length, "# HELP %s_device_heap_size_bytes Size of each memory heap.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_device_heap_size_bytes gauge\n", PREFIX);
+		for (uint32_t i = 0; i < s.heapCount; i++) {
+			append(out, capacity, length, "%s_device_heap_size_bytes{heap=\"%u\",device_local=\"%d\"} %llu\n",
+				PREFIX, i, s.heaps[i].deviceLocal, static_cast<unsigned long long>(s.heaps[i].sizeBytes));
+		}
+
+		append(out, capacity, length, "# HELP %s_host_memory_bytes Live host memory by allocator.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_host_memory_bytes gauge\n", PREFIX);
+		append(out, capacity, length, "%s_host_memory_bytes{source=\"cpp\"} %lld\n", PREFIX, static_cast<long long>(s.hostCppBytes));
+		append(out, capacity, length, "%s_host_memory_bytes{source=\"vulkan\"} %lld\n", PREFIX, static_cast<long long>(s.hostVulkanBytes));
+
+		append(out, capacity, length, "# HELP %s_render_scale Dynamic resolution scale of the scene.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_render_scale gauge\n", PREFIX);
+		append(out, capacity, length, "%s_render_scale %.4f\n", PREFIX, s.renderScale);
+
+		append(out, capacity, length, "# HELP %s_render_extent_pixels Scene render resolution.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_render_extent_pixels gauge\n", PREFIX);
+		append(out, capacity, length, "%s_render_extent_pixels{axis=\"width\"} %u\n", PREFIX, s.renderWidth);
+		append(out, capacity, length, "%s_render_extent_pixels{axis=\"height\"} %u\n", PREFIX, s.renderHeight);
+
+		append(out, capacity, length, "# HELP %s_gpu_frame_time_ms Last measured GPU frame time.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_gpu_frame_time_ms gauge\n", PREFIX);
+		append(out, capacity, length, "%s_gpu_frame_time_ms %.4f\n", PREFIX, s.gpuFrameMs);
+
+		append(out, capacity, length, "# HELP %s_validation_messages_total Validation layer messages by severity.\n", PREFIX);
+		append(out, capacity, length, "# TYPE %s_validation_messages_total counter\n", PREFIX);
+		for (int i = 0; i < SeverityCount; i++) {
+			append(out, capacity, length, "%s_validation_messages_total{severity=\"%s\"} %llu\n", PREFIX, severityNames[i],
+				static_cast<unsigned long long>(validationMessages[i].load(std::memory_order_relaxed)));
+		}
+
+		return length;
+	}
+};
+
+} // namespace metrics
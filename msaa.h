@@ -0,0 +1,66 @@
+/*
+* Multisampling helpers shared by the app and the bench.
+* - Sample counts come from the device's framebuffer limits, depth has its own limit.
+* - Multisampled attachments are transient: cleared at the start of the render pass, resolved
+*   at the end of the subpass and never stored. In LAZILY_ALLOCATED memory a tiler keeps them
+*   in tile memory and never backs them with real memory. Elsewhere they're device local.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <stdexcept>
+
+
+namespace msaa {
+
+inline VkSampleCountFlags usableSampleCounts(const VkPhysicalDeviceLimits& limits, bool depth) {
+	VkSampleCountFlags counts = limits.framebufferColorSampleCounts;
+	if (depth) counts &= limits.framebufferDepthSampleCounts;
+	return counts;
+}
+
+// Highest usable count up to `wanted`, 1 when multisampling isn't supported or wanted
+inline VkSampleCountFlagBits chooseSampleCount(VkSampleCountFlags usable, uint32_t wanted) {
+	for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count /= 2) {
+		if (count <= wanted && (usable & count)) return static_cast<VkSampleCountFlagBits>(count);
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+
+struct MemoryType {
+	uint32_t index;
+	bool lazy;
+};
+
+// For images with TRANSIENT_ATTACHMENT usage: lazily allocated when the device has it
+inline MemoryType transientMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t typeBits) {
+	const VkMemoryPropertyFlags candidates[] = {
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	};
+
+	for (VkMemoryPropertyFlags flags : candidates) {
+		for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+			if ((typeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags) {
+				return MemoryType{i, (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0};
+			}
+		}
+	}
+
+	throw std::runtime_error("failed to find memory for a transient attachment!");
+}
+
+// Bytes really backing the allocation right now, only lazy memory can hold less than its size
+inline VkDeviceSize committedBytes(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, bool lazy) {
+	if (!lazy) return size;
+
+	VkDeviceSize committed = 0;
+	vkGetDeviceMemoryCommitment(device, memory, &committed);
+	return committed;
+}
+
+} // namespace msaa
@@ -0,0 +1,220 @@
+/*
+* Hardware performance counters around profiling zones, via perf_event_open.
+* - PROFILE_ZONE_COUNTERS("name") is a PROFILE_ZONE that also records cycles, instructions,
+*   cache misses, branch misses and IPC for the scope, shown as zone args in the trace.
+* - Off until perfcounters::enable() is called. If the kernel refuses the counters
+*   (containers, perf_event_paranoid, VMs without a PMU) the zones fall back to plain
+*   timing and a single warning is printed.
+* - Counters are per thread and count user space only.
+*/
+
+#pragma once
+
+#include "profiler.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+namespace perfcounters {
+
+enum Counter {
+	Cycles,
+	Instructions,
+	CacheMisses,
+	BranchMisses,
+	CounterCount
+};
+
+inline const char* const counterNames[CounterCount] = {
+	"cycles",
+	"instructions",
+	"cache_misses",
+	"branch_misses"
+};
+
+inline const uint64_t counterConfigs[CounterCount] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+inline std::atomic<bool> enabled{false};
+
+
+struct Sample {
+	uint64_t values[CounterCount] = {};
+};
+
+
+// One counter group per thread, opened the first time the thread uses it.
+class ThreadCounters {
+public:
+	ThreadCounters() { open(); }
+
+	~ThreadCounters() {
+		for (int fd : fds) {
+			if (fd >= 0) close(fd);
+		}
+	}
+
+	ThreadCounters(const ThreadCounters&) = delete;
+	ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+	bool available() const { return fds[Cycles] >= 0; }
+	bool has(Counter counter) const { return fds[counter] >= 0; }
+
+	bool read(Sample& sample) const {
+		if (!available()) return false;
+
+		// PERF_FORMAT_GROUP | PERF_FORMAT_ID layout: nr, then {value, id} per counter
+		uint64_t data[1 + 2 * CounterCount];
+		ssize_t bytes = ::read(fds[Cycles], data, sizeof(data));
+		if (bytes < static_cast<ssize_t>(sizeof(uint64_t))) return false;
+
+		uint64_t nr = data[0];
+		for (uint64_t i = 0; i < nr && i < CounterCount; i++) {
+			uint64_t value = data[1 + 2 * i];
+			uint64_t id = data[2 + 2 * i];
+
+			for (int c = 0; c < CounterCount; c++) {
+				if (fds[c] >= 0 && ids[c] == id) sample.values[c] = value;
+			}
+		}
+
+		return true;
+	}
+
+private:
+	int fds[CounterCount] = {-1, -1, -1, -1};
+	uint64_t ids[CounterCount] = {};
+
+	static int openCounter(uint64_t config, int groupFd) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config;
+		attr.disabled = groupFd < 0 ? 1 : 0; // Leader starts disabled, enabled once the group is complete
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+	}
+
+	void open() {
+		fds[Cycles] = openCounter(counterConfigs[Cycles], -1);
+		if (fds[Cycles] < 0) {
+			warnOnce(errno);
+			return;
+		}
+
+		// Missing secondary counters are tolerated, their values stay 0 and aren't exported
+		for (int c = Cycles + 1; c < CounterCount; c++) {
+			fds[c] = openCounter(counterConfigs[c], fds[Cycles]);
+		}
+
+		for (int c = 0; c < CounterCount; c++) {
+			if (fds[c] >= 0 && ioctl(fds[c], PERF_EVENT_IOC_ID, &ids[c]) < 0) {
+				close(fds[c]);
+				fds[c] = -1;
+			}
+		}
+
+		if (fds[Cycles] < 0) return;
+
+		ioctl(fds[Cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[Cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	static void warnOnce(int error) {
+		static std::atomic<bool> warned{false};
+		if (!warned.exchange(true)) {
+			fprintf(stderr, "perf counters unavailable (%s), zones record timing only\n", strerror(error));
+		}
+	}
+};
+
+
+inline ThreadCounters& threadCounters() {
+	thread_local ThreadCounters counters;
+	return counters;
+}
+
+
+// Opt in. Opening the counters costs a few syscalls per thread.
+inline void enable() {
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+
+// Returns false when counters can't be used on this thread, e.g. inside a container.
+inline bool available() {
+	return threadCounters().available();
+}
+
+
+class ScopedCounterZone {
+public:
+	explicit ScopedCounterZone(const char* name) : name(name) {
+		active = enabled.load(std::memory_order_relaxed) && threadCounters().read(begin);
+		beginTicks = profiler::ticks();
+	}
+
+	~ScopedCounterZone() {
+		uint64_t endTicks = profiler::ticks();
+
+		Sample end;
+		if (!active || !threadCounters().read(end)) {
+			profiler::record(name, beginTicks, endTicks);
+			return;
+		}
+
+		const ThreadCounters& counters = threadCounters();
+		profiler::ZoneArgs args{};
+
+		for (int c = 0; c < CounterCount; c++) {
+			if (!counters.has(static_cast<Counter>(c))) continue;
+			args.names[args.count] = counterNames[c];
+			args.values[args.count] = static_cast<double>(end.values[c] - begin.values[c]);
+			args.count++;
+		}
+
+		uint64_t cycles = end.values[Cycles] - begin.values[Cycles];
+		if (counters.has(Instructions) && cycles > 0) {
+			args.names[args.count] = "ipc";
+			args.values[args.count] = static_cast<double>(end.values[Instructions] - begin.values[Instructions]) / cycles;
+			args.count++;
+		}
+
+		profiler::recordWithArgs(name, beginTicks, endTicks, args);
+	}
+
+	ScopedCounterZone(const ScopedCounterZone&) = delete;
+	ScopedCounterZone& operator=(const ScopedCounterZone&) = delete;
+
+private:
+	const char* name;
+	bool active = false;
+	Sample begin;
+	uint64_t beginTicks = 0;
+};
+
+} // namespace perfcounters
+
+
+#if PROFILING_ENABLED
+	#define PROFILE_ZONE_COUNTERS(name) perfcounters::ScopedCounterZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+	#define PROFILE_ZONE_COUNTERS(name) ((void)0)
+#endif
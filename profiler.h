@@ -0,0 +1,295 @@
+/*
+* Lightweight scoped CPU profiler.
+* - PROFILE_ZONE("name") records the time spent in the enclosing scope.
+* - Every thread writes into its own fixed size buffer, no locks on the hot path. Zones
+*   past the end are dropped: the first drop on a thread warns right away, and
+*   droppedZones() counts them for the HUD.
+* - profiler::writeChromeTrace() dumps all zones as Chrome trace JSON, open it in
+*   chrome://tracing or https://ui.perfetto.dev
+* - Compiled out when NDEBUG is defined, unless ENABLE_PROFILING is defined.
+*
+* Zone cost depends on the machine's clock read; `make profiler-bench` measures it. One
+* sample, an x86_64 VM with the rdtsc clock: ~30 ns per zone enabled (each clock read ~13 ns),
+* 0 ns compiled out.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define PROFILER_USE_RDTSC 1
+#else
+	#define PROFILER_USE_RDTSC 0
+#endif
+
+#if !defined(NDEBUG) || defined(ENABLE_PROFILING)
+	#define PROFILING_ENABLED 1
+#else
+	#define PROFILING_ENABLED 0
+#endif
+
+
+namespace profiler {
+
+// Max zones kept per thread. Zones past this are dropped and counted.
+const size_t THREAD_BUFFER_CAPACITY = 1 << 16;
+// Max zones per thread that carry extra values (e.g. hardware counters), and values per zone.
+const size_t THREAD_ARGS_CAPACITY = 1 << 12;
+const size_t MAX_ZONE_ARGS = 6;
+
+struct Zone {
+	const char* name; // Must outlive the profiler, use string literals or __func__
+	uint64_t begin;
+	uint64_t end;
+};
+
+// Named values attached to one zone, exported as the zone's "args".
+struct ZoneArgs {
+	size_t zoneIndex;
+	uint32_t count;
+	const char* names[MAX_ZONE_ARGS]; // Same lifetime rule as Zone::name
+	double values[MAX_ZONE_ARGS];
+};
+
+struct ThreadBuffer {
+	uint32_t threadId = 0;
+	std::unique_ptr<Zone[]> zones{new Zone[THREAD_BUFFER_CAPACITY]};
+	std::atomic<size_t> count{0}; // Written by the owning thread only
+	std::atomic<size_t> dropped{0};
+
+	std::unique_ptr<ZoneArgs[]> args{new ZoneArgs[THREAD_ARGS_CAPACITY]};
+	std::atomic<size_t> argsCount{0}; // Written by the owning thread only
+};
+
+struct Registry {
+	std::mutex mutex; // Only taken when a thread records its first zone, and on export
+	std::vector<std::unique_ptr<ThreadBuffer>> threads;
+	double nsPerTick = 1.0;
+	uint64_t startTicks = 0;
+	std::atomic<uint64_t> dropped{0}; // Every thread's, since the last reset
+};
+
+inline Registry& registry() {
+	static Registry instance;
+	return instance;
+}
+
+
+inline uint64_t monotonicNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+
+inline uint64_t ticks() {
+#if PROFILER_USE_RDTSC
+	return __rdtsc();
+#else
+	return monotonicNs();
+#endif
+}
+
+
+// Measure the tick rate against CLOCK_MONOTONIC. Call once at startup before recording zones.
+inline void init() {
+	Registry& reg = registry();
+
+#if PROFILER_USE_RDTSC
+	const uint64_t calibrationNs = 10 * 1000 * 1000;
+
+	uint64_t ns_begin = monotonicNs();
+	uint64_t ticks_begin = ticks();
+	while (monotonicNs() - ns_begin < calibrationNs) {}
+	uint64_t ns_end = monotonicNs();
+	uint64_t ticks_end = ticks();
+
+	reg.nsPerTick = static_cast<double>(ns_end - ns_begin) / static_cast<double>(ticks_end - ticks_begin);
+#else
+	reg.nsPerTick = 1.0;
+#endif
+
+	reg.startTicks = ticks();
+}
+
+
+inline double ticksToNs(uint64_t t) {
+	return static_cast<double>(t) * registry().nsPerTick;
+}
+
+
+inline ThreadBuffer& threadBuffer() {
+	thread_local ThreadBuffer* buffer = nullptr;
+
+	if (buffer == nullptr) {
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+
+		reg.threads.push_back(std::make_unique<ThreadBuffer>());
+		buffer = reg.threads.back().get();
+		buffer->threadId = static_cast<uint32_t>(reg.threads.size());
+	}
+
+	return *buffer;
+}
+
+
+inline void record(const char* name, uint64_t begin, uint64_t end) {
+	ThreadBuffer& buffer = threadBuffer();
+	size_t index = buffer.count.load(std::memory_order_relaxed);
+
+	if (index >= THREAD_BUFFER_CAPACITY) {
+		if (buffer.dropped.fetch_add(1, std::memory_order_relaxed) == 0) {
+			fprintf(stderr, "profiler: thread %u zone buffer full, dropping zones\n", buffer.threadId);
+		}
+		registry().dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.zones[index] = Zone{name, begin, end};
+	// Release so an exporting thread never reads a half written zone
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+
+// Record a zone with extra values. Args past THREAD_ARGS_CAPACITY are dropped, the zone is kept.
+inline void recordWithArgs(const char* name, uint64_t begin, uint64_t end, const ZoneArgs& zoneArgs) {
+	ThreadBuffer& buffer = threadBuffer();
+	size_t zoneIndex = buffer.count.load(std::memory_order_relaxed);
+
+	record(name, begin, end);
+	if (zoneIndex >= THREAD_BUFFER_CAPACITY) return;
+
+	size_t argsIndex = buffer.argsCount.load(std::memory_order_relaxed);
+	if (argsIndex >= THREAD_ARGS_CAPACITY) return;
+
+	buffer.args[argsIndex] = zoneArgs;
+	buffer.args[argsIndex].zoneIndex = zoneIndex;
+	buffer.argsCount.store(argsIndex + 1, std::memory_order_release);
+}
+
+
+// Zones dropped so far on all threads, cheap enough to poll every frame
+inline uint64_t droppedZones() {
+	return registry().dropped.load(std::memory_order_relaxed);
+}
+
+
+class ScopedZone {
+public:
+	explicit ScopedZone(const char* name) : name(name), begin(ticks()) {}
+	~ScopedZone() { record(name, begin, ticks()); }
+
+	ScopedZone(const ScopedZone&) = delete;
+	ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+	const char* name;
+	uint64_t begin;
+};
+
+
+// Forget all recorded zones. Only safe while no other thread is recording.
+inline void reset() {
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	for (auto& buffer : reg.threads) {
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->argsCount.store(0, std::memory_order_relaxed);
+	}
+	reg.dropped.store(0, std::memory_order_relaxed);
+}
+
+
+inline void writeJsonString(FILE* file, const char* str) {
+	fputc('"', file);
+	for (const char* c = str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') fputc('\\', file);
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+
+// Write every recorded zone as Chrome trace JSON ("X" complete events, microseconds).
+inline bool writeChromeTrace(const std::string& path) {
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr) return false;
+
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	bool first = true;
+	for (const auto& buffer : reg.threads) {
+		// Args are published after their zone, so load them first
+		size_t argsCount = buffer->argsCount.load(std::memory_order_acquire);
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		size_t nextArgs = 0;
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			"\"args\":{\"name\":\"thread %u\"}}", first ? "" : ",\n", buffer->threadId, buffer->threadId);
+		first = false;
+
+		for (size_t i = 0; i < count; i++) {
+			const Zone& zone = buffer->zones[i];
+			double ts = ticksToNs(zone.begin - reg.startTicks) / 1000.0;
+			double dur = ticksToNs(zone.end - zone.begin) / 1000.0;
+
+			fprintf(file, ",\n{\"name\":");
+			writeJsonString(file, zone.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				buffer->threadId, ts, dur);
+
+			// Args are appended in zone order
+			if (nextArgs < argsCount && buffer->args[nextArgs].zoneIndex == i) {
+				const ZoneArgs& zoneArgs = buffer->args[nextArgs++];
+
+				fprintf(file, ",\"args\":{");
+				for (uint32_t a = 0; a < zoneArgs.count; a++) {
+					fprintf(file, "%s", a ? "," : "");
+					writeJsonString(file, zoneArgs.names[a]);
+					fprintf(file, ":%.17g", zoneArgs.values[a]);
+				}
+				fprintf(file, "}");
+			}
+
+			fprintf(file, "}");
+		}
+
+		size_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+		if (dropped > 0) {
+			fprintf(stderr, "profiler: thread %u dropped %zu zones\n", buffer->threadId, dropped);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
+
+} // namespace profiler
+
+
+#if PROFILING_ENABLED
+	#define PROFILE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+	#define PROFILE_ZONE(name) profiler::ScopedZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+	#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+	#define PROFILE_ZONE(name) ((void)0)
+	#define PROFILE_FUNCTION() ((void)0)
+#endif
@@ -0,0 +1,67 @@
+/*
+* Microbenchmark for profiler.h zone overhead.
+* - Build and run with `make profiler-bench`.
+* - Reported numbers are per zone (one begin + one end timestamp + record).
+*/
+
+#define ENABLE_PROFILING
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+const size_t ITERATIONS = profiler::THREAD_BUFFER_CAPACITY;
+const int REPETITIONS = 50;
+
+// Keeps the compiler from deleting the loops.
+volatile uint64_t sink = 0;
+
+
+double measureEmptyLoop() {
+	uint64_t begin = profiler::monotonicNs();
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		sink = sink + i;
+	}
+	return static_cast<double>(profiler::monotonicNs() - begin) / ITERATIONS;
+}
+
+
+double measureTicks() {
+	uint64_t begin = profiler::monotonicNs();
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		sink = sink + profiler::ticks();
+	}
+	return static_cast<double>(profiler::monotonicNs() - begin) / ITERATIONS;
+}
+
+
+double measureZones() {
+	profiler::reset();
+
+	uint64_t begin = profiler::monotonicNs();
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		PROFILE_ZONE("bench");
+		sink = sink + i;
+	}
+	return static_cast<double>(profiler::monotonicNs() - begin) / ITERATIONS;
+}
+
+
+int main() {
+	profiler::init();
+	printf("ns per tick: %.4f\n", profiler::registry().nsPerTick);
+
+	// Take the best repetition, it's the least disturbed by the OS.
+	double empty = 1e9, tick = 1e9, zone = 1e9;
+	for (int r = 0; r < REPETITIONS; r++) {
+		empty = std::min(empty, measureEmptyLoop());
+		tick = std::min(tick, measureTicks());
+		zone = std::min(zone, measureZones());
+	}
+
+	printf("empty loop:     %6.2f ns/iter\n", empty);
+	printf("ticks():        %6.2f ns/call\n", tick - empty);
+	printf("PROFILE_ZONE:   %6.2f ns/zone\n", zone - empty);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+* Multi-tenant rendering: independent sessions sharing one instance, device and queue.
+* - Each session has its own command pool, targets and a device memory budget. Allocations
+*   past the budget fail the session instead of starving the others.
+* - FairScheduler decides whose frame goes to the queue next, weighted fair queuing on GPU
+*   time: a session's virtual time is the GPU time it was given divided by its weight, and
+*   the ready session furthest behind goes first. Ties go to the one that waited longest.
+* - Sessions joining late start at the current minimum virtual time, so they don't get a
+*   backlog of credit to burst through.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+
+namespace server {
+
+// Bytes of device memory one session may hold
+class MemoryBudget {
+public:
+	MemoryBudget() = default;
+	explicit MemoryBudget(uint64_t limitBytes) : limitBytes(limitBytes) {}
+
+	// False, and nothing reserved, if it doesn't fit
+	bool reserve(uint64_t bytes) {
+		if (bytes > limitBytes - usedBytes) return false;
+		usedBytes += bytes;
+		peakBytes = std::max(peakBytes, usedBytes);
+		return true;
+	}
+
+	void release(uint64_t bytes) {
+		usedBytes -= std::min(bytes, usedBytes);
+	}
+
+	uint64_t used() const { return usedBytes; }
+	uint64_t peak() const { return peakBytes; }
+	uint64_t limit() const { return limitBytes; }
+
+private:
+	uint64_t limitBytes = std::numeric_limits<uint64_t>::max();
+	uint64_t usedBytes = 0;
+	uint64_t peakBytes = 0;
+};
+
+
+class FairScheduler {
+public:
+	// Returns the session's id. A weight of 2 gets twice the GPU time of a weight of 1.
+	uint32_t add(uint32_t weight) {
+		if (weight == 0) {
+			throw std::runtime_error("session weight must be at least 1!");
+		}
+
+		double start = 0.0;
+		bool any = false;
+		for (const Tenant& tenant : tenants) {
+			if (!tenant.active) continue;
+			start = any ? std::min(start, tenant.virtualTime) : tenant.virtualTime;
+			any = true;
+		}
+
+		tenants.push_back(Tenant{start, 0.0, weight, 0, true});
+		return static_cast<uint32_t>(tenants.size() - 1);
+	}
+
+	void remove(uint32_t id) {
+		tenants[id].active = false;
+	}
+
+	// The next session to submit among those ready(id) accepts, -1 when none is.
+	template <typename Ready>
+	int next(Ready&& ready) {
+		int best = -1;
+		for (uint32_t id = 0; id < tenants.size(); id++) {
+			const Tenant& tenant = tenants[id];
+			if (!tenant.active || !ready(id)) continue;
+
+			if (best < 0 || tenant.virtualTime < tenants[best].virtualTime ||
+				(tenant.virtualTime == tenants[best].virtualTime && tenant.lastPick < tenants[best].lastPick)) {
+				best = static_cast<int>(id);
+			}
+		}
+
+		if (best >= 0) tenants[best].lastPick = ++picks;
+		return best;
+	}
+
+	// GPU time, or any cost in the same unit for every session, a finished frame took
+	void charge(uint32_t id, double cost) {
+		tenants[id].virtualTime += cost / tenants[id].weight;
+		tenants[id].service += cost;
+	}
+
+	double service(uint32_t id) const { return tenants[id].service; }
+	uint32_t weight(uint32_t id) const { return tenants[id].weight; }
+
+private:
+	struct Tenant {
+		double virtualTime;
+		double service;
+		uint32_t weight;
+		uint64_t lastPick;
+		bool active;
+	};
+
+	std::vector<Tenant> tenants;
+	uint64_t picks = 0;
+};
+
+// Jain's index of the sessions' service per unit of weight: 1 is perfectly fair, 1 / n is
+// one session getting everything.
+inline double fairness(const FairScheduler& scheduler, uint32_t sessionCount) {
+	double sum = 0.0, sumSquares = 0.0;
+	for (uint32_t id = 0; id < sessionCount; id++) {
+		double share = scheduler.service(id) / scheduler.weight(id);
+		sum += share;
+		sumSquares += share * share;
+	}
+	return sumSquares > 0.0 ? sum * sum / (sessionCount * sumSquares) : 1.0;
+}
+
+} // namespace server
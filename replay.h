@@ -0,0 +1,1073 @@
+/*
+* Plays back a capture written by capture.h on any device, as fast as it can.
+* - Runs headless: swap chains become plain images of the captured format and size,
+*   acquire is a no-op and present only marks the end of a frame.
+* - Memory types are picked from the captured property flags, resources are bound to
+*   memory sized for the replay device's own requirements.
+* - Semaphores are created but not waited on or signaled. Everything runs on one queue,
+*   so submission order already serializes the work; fences are waited on as captured.
+*/
+
+#pragma once
+
+#include "capture.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+
+// Separate from capture:: so the calls below reach the driver, not the recording wrappers
+namespace replay {
+
+using capture::Decoder;
+using capture::Op;
+
+// Loads a capture file and checks its header.
+inline std::vector<uint8_t> loadCapture(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open capture " + path + "!");
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Decoder header(data.data(), data.size());
+	if (data.size() < 8 || header.get<uint32_t>() != capture::MAGIC) {
+		throw std::runtime_error(path + " is not a capture file!");
+	}
+	if (header.get<uint32_t>() != capture::VERSION) {
+		throw std::runtime_error(path + " was captured with an incompatible version!");
+	}
+
+	return data;
+}
+
+
+struct ReplayStats {
+	double totalMs = 0.0;
+	std::vector<double> frameMs; // Present to present
+	uint64_t submits = 0;
+	uint64_t draws = 0;
+	uint64_t dispatches = 0;
+};
+
+
+class Replayer {
+public:
+	Replayer(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, VkQueue queue)
+		: physicalDevice(physicalDevice), device(device), queueFamily(queueFamily), queue(queue) {
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+		timestampsSupported = queueFamilies[queueFamily].timestampValidBits > 0;
+	}
+
+	// Replays every record, then destroys whatever the capture left alive.
+	ReplayStats run(const std::vector<uint8_t>& data) {
+		auto begin = std::chrono::steady_clock::now();
+		lastPresent = begin;
+		stats = ReplayStats{};
+
+		size_t pos = 8; // Past the header
+		while (pos + 6 <= data.size()) {
+			uint16_t op;
+			uint32_t size;
+			memcpy(&op, data.data() + pos, sizeof(op));
+			memcpy(&size, data.data() + pos + 2, sizeof(size));
+			pos += 6;
+
+			// A capture cut short (crash, kill) ends at the last complete record
+			if (pos + size > data.size()) break;
+
+			Decoder d(data.data() + pos, size);
+			execute(static_cast<Op>(op), d);
+			pos += size;
+		}
+
+		vkDeviceWaitIdle(device);
+		destroyAll();
+
+		stats.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		return stats;
+	}
+
+private:
+	enum class Type : uint8_t {
+		None, Swapchain, SwapchainImage, Image, ImageView, RenderPass, ShaderModule, PipelineLayout, Pipeline,
+		Framebuffer, CommandPool, CommandBuffer, Semaphore, Fence, QueryPool, Buffer, Memory, Sampler,
+		DescriptorSetLayout, DescriptorPool, DescriptorSet
+	};
+
+	struct Object {
+		Type type = Type::None;
+		uint64_t handle = 0;
+	};
+
+	struct Memory {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize capturedSize = 0;
+		VkMemoryPropertyFlags flags = 0;
+		uint8_t* mapped = nullptr;
+		VkDeviceSize mapOffset = 0;
+	};
+
+	struct Swapchain {
+		VkFormat format;
+		VkExtent2D extent;
+		VkImageUsageFlags usage;
+		std::vector<VkImage> images;
+		std::vector<VkDeviceMemory> memory;
+	};
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	uint32_t queueFamily;
+	VkQueue queue;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	bool timestampsSupported = false;
+
+	std::vector<Object> objects; // Indexed by capture id
+	std::unordered_map<uint32_t, Memory> memories;
+	std::unordered_map<uint32_t, Swapchain> swapchains;
+
+	ReplayStats stats;
+	std::chrono::steady_clock::time_point lastPresent;
+
+	template<typename T>
+	void add(uint32_t id, Type type, T handle) {
+		if (id >= objects.size()) objects.resize(id + 1);
+		objects[id] = Object{type, capture::handleKey(handle)};
+	}
+
+	template<typename T>
+	T get(uint32_t id) {
+		if (id == 0) return VK_NULL_HANDLE;
+		if (id >= objects.size() || objects[id].type == Type::None) {
+			throw std::runtime_error("replay: capture uses an unknown object!");
+		}
+		return reinterpret_cast<T>(static_cast<uintptr_t>(objects[id].handle));
+	}
+
+	template<typename T>
+	T get(Decoder& d) {
+		return get<T>(d.get<uint32_t>());
+	}
+
+	// Headless replay has no presentation engine
+	static VkImageLayout patchLayout(VkImageLayout layout) {
+		return layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_IMAGE_LAYOUT_GENERAL : layout;
+	}
+
+	static void check(VkResult result, const char* what) {
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error(std::string("replay: ") + what + " failed!");
+		}
+	}
+
+	uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags captured) {
+		VkMemoryPropertyFlags wanted = captured & (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+		// Replay writes mapped memory without flushing
+		if (wanted & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) wanted |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		// Drop the flags that are only about speed if the device doesn't have them
+		const VkMemoryPropertyFlags candidates[] = {
+			wanted,
+			wanted & ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+			wanted & ~(VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+
+		for (VkMemoryPropertyFlags flags : candidates) {
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+					return i;
+				}
+			}
+		}
+
+		throw std::runtime_error("replay: no compatible memory type!");
+	}
+
+	// Allocations are deferred until the first bind or map, when the replay device's requirements are known.
+	Memory& allocate(uint32_t id, uint32_t typeBits, VkDeviceSize minSize) {
+		Memory& memory = memories.at(id);
+		if (memory.memory != VK_NULL_HANDLE) return memory;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = std::max(memory.capturedSize, minSize);
+		allocInfo.memoryTypeIndex = findMemoryType(typeBits, memory.flags);
+		check(vkAllocateMemory(device, &allocInfo, nullptr, &memory.memory), "vkAllocateMemory");
+
+		add(id, Type::Memory, memory.memory);
+		return memory;
+	}
+
+	void destroy(uint32_t id) {
+		if (id >= objects.size()) return;
+
+		Object object = objects[id];
+		objects[id] = Object{};
+
+		switch (object.type) {
+			case Type::Swapchain: {
+				Swapchain& swapchain = swapchains.at(id);
+				for (size_t i = 0; i < swapchain.images.size(); i++) {
+					vkDestroyImage(device, swapchain.images[i], nullptr);
+					vkFreeMemory(device, swapchain.memory[i], nullptr);
+				}
+				swapchains.erase(id);
+				break;
+			}
+			case Type::Memory: {
+				// Freeing implicitly unmaps
+				vkFreeMemory(device, get<VkDeviceMemory>(object), nullptr);
+				memories.erase(id);
+				break;
+			}
+			case Type::Image: vkDestroyImage(device, get<VkImage>(object), nullptr); break;
+			case Type::ImageView: vkDestroyImageView(device, get<VkImageView>(object), nullptr); break;
+			case Type::RenderPass: vkDestroyRenderPass(device, get<VkRenderPass>(object), nullptr); break;
+			case Type::ShaderModule: vkDestroyShaderModule(device, get<VkShaderModule>(object), nullptr); break;
+			case Type::PipelineLayout: vkDestroyPipelineLayout(device, get<VkPipelineLayout>(object), nullptr); break;
+			case Type::Pipeline: vkDestroyPipeline(device, get<VkPipeline>(object), nullptr); break;
+			case Type::Framebuffer: vkDestroyFramebuffer(device, get<VkFramebuffer>(object), nullptr); break;
+			case Type::CommandPool: vkDestroyCommandPool(device, get<VkCommandPool>(object), nullptr); break;
+			case Type::Semaphore: vkDestroySemaphore(device, get<VkSemaphore>(object), nullptr); break;
+			case Type::Fence: vkDestroyFence(device, get<VkFence>(object), nullptr); break;
+			case Type::QueryPool: vkDestroyQueryPool(device, get<VkQueryPool>(object), nullptr); break;
+			case Type::Buffer: vkDestroyBuffer(device, get<VkBuffer>(object), nullptr); break;
+			case Type::Sampler: vkDestroySampler(device, get<VkSampler>(object), nullptr); break;
+			case Type::DescriptorSetLayout: vkDestroyDescriptorSetLayout(device, get<VkDescriptorSetLayout>(object), nullptr); break;
+			case Type::DescriptorPool: vkDestroyDescriptorPool(device, get<VkDescriptorPool>(object), nullptr); break;
+			default: break; // Swap chain images, command buffers and descriptor sets belong to their parent
+		}
+	}
+
+	template<typename T>
+	static T get(const Object& object) {
+		return reinterpret_cast<T>(static_cast<uintptr_t>(object.handle));
+	}
+
+	// Newest first, so views go before images and pipelines before layouts
+	void destroyAll() {
+		for (size_t id = objects.size(); id-- > 1;) {
+			destroy(static_cast<uint32_t>(id));
+		}
+		objects.clear();
+
+		// Memory that was allocated in the capture but never bound or mapped
+		memories.clear();
+	}
+
+	void execute(Op op, Decoder& d) {
+		switch (op) {
+			case Op::CreateSwapchain: {
+				uint32_t id = d.get<uint32_t>();
+				Swapchain& swapchain = swapchains[id];
+				swapchain.format = d.get<VkFormat>();
+				swapchain.extent = d.get<VkExtent2D>();
+				swapchain.usage = d.get<VkImageUsageFlags>();
+				add(id, Type::Swapchain, reinterpret_cast<void*>(static_cast<uintptr_t>(id)));
+				break;
+			}
+			case Op::GetSwapchainImages: {
+				uint32_t swapchainId = d.get<uint32_t>();
+				Swapchain& swapchain = swapchains.at(swapchainId);
+				uint32_t count = d.get<uint32_t>();
+
+				for (uint32_t i = 0; i < count; i++) {
+					VkImageCreateInfo imageInfo{};
+					imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+					imageInfo.imageType = VK_IMAGE_TYPE_2D;
+					imageInfo.format = swapchain.format;
+					imageInfo.extent = {swapchain.extent.width, swapchain.extent.height, 1};
+					imageInfo.mipLevels = 1;
+					imageInfo.arrayLayers = 1;
+					imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+					imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+					imageInfo.usage = swapchain.usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+					imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+					imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+					VkImage image;
+					check(vkCreateImage(device, &imageInfo, nullptr, &image), "vkCreateImage");
+
+					VkMemoryRequirements requirements;
+					vkGetImageMemoryRequirements(device, image, &requirements);
+
+					VkMemoryAllocateInfo allocInfo{};
+					allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+					allocInfo.allocationSize = requirements.size;
+					allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+					VkDeviceMemory memory;
+					check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+					vkBindImageMemory(device, image, memory, 0);
+
+					swapchain.images.push_back(image);
+					swapchain.memory.push_back(memory);
+					add(d.get<uint32_t>(), Type::SwapchainImage, image);
+				}
+				break;
+			}
+			case Op::CreateImageView: {
+				uint32_t id = d.get<uint32_t>();
+				VkImage image = get<VkImage>(d);
+				VkImageViewCreateInfo info = d.get<VkImageViewCreateInfo>();
+				info.pNext = nullptr;
+				info.image = image;
+
+				VkImageView view;
+				check(vkCreateImageView(device, &info, nullptr, &view), "vkCreateImageView");
+				add(id, Type::ImageView, view);
+				break;
+			}
+			case Op::CreateRenderPass: {
+				uint32_t id = d.get<uint32_t>();
+				VkRenderPassCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+				info.flags = d.get<VkFlags>();
+
+				std::vector<VkAttachmentDescription> attachments = d.getArray<VkAttachmentDescription>();
+				for (auto& attachment : attachments) {
+					attachment.initialLayout = patchLayout(attachment.initialLayout);
+					attachment.finalLayout = patchLayout(attachment.finalLayout);
+				}
+
+				uint32_t subpassCount = d.get<uint32_t>();
+				std::vector<VkSubpassDescription> subpasses(subpassCount);
+				std::vector<std::vector<VkAttachmentReference>> references(subpassCount * 4);
+				std::vector<std::vector<uint32_t>> preserves(subpassCount);
+
+				for (uint32_t i = 0; i < subpassCount; i++) {
+					VkSubpassDescription& subpass = subpasses[i];
+					subpass.flags = d.get<VkFlags>();
+					subpass.pipelineBindPoint = d.get<VkPipelineBindPoint>();
+
+					auto& input = references[i * 4 + 0] = d.getArray<VkAttachmentReference>();
+					auto& color = references[i * 4 + 1] = d.getArray<VkAttachmentReference>();
+					auto& resolve = references[i * 4 + 2] = d.getArray<VkAttachmentReference>();
+					auto& depth = references[i * 4 + 3] = d.getArray<VkAttachmentReference>();
+					preserves[i] = d.getArray<uint32_t>();
+
+					subpass.inputAttachmentCount = static_cast<uint32_t>(input.size());
+					subpass.pInputAttachments = input.empty() ? nullptr : input.data();
+					subpass.colorAttachmentCount = static_cast<uint32_t>(color.size());
+					subpass.pColorAttachments = color.empty() ? nullptr : color.data();
+					subpass.pResolveAttachments = resolve.empty() ? nullptr : resolve.data();
+					subpass.pDepthStencilAttachment = depth.empty() ? nullptr : depth.data();
+					subpass.preserveAttachmentCount = static_cast<uint32_t>(preserves[i].size());
+					subpass.pPreserveAttachments = preserves[i].empty() ? nullptr : preserves[i].data();
+				}
+
+				std::vector<VkSubpassDependency> dependencies = d.getArray<VkSubpassDependency>();
+
+				info.attachmentCount = static_cast<uint32_t>(attachments.size());
+				info.pAttachments = attachments.data();
+				info.subpassCount = subpassCount;
+				info.pSubpasses = subpasses.data();
+				info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+				info.pDependencies = dependencies.data();
+
+				VkRenderPass renderPass;
+				check(vkCreateRenderPass(device, &info, nullptr, &renderPass), "vkCreateRenderPass");
+				add(id, Type::RenderPass, renderPass);
+				break;
+			}
+			case Op::CreateShaderModule: {
+				uint32_t id = d.get<uint32_t>();
+				std::vector<uint8_t> bytes = d.getArray<uint8_t>();
+
+				// SPIR-V has to be 4 byte aligned
+				std::vector<uint32_t> code((bytes.size() + 3) / 4);
+				memcpy(code.data(), bytes.data(), bytes.size());
+
+				VkShaderModuleCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				info.codeSize = bytes.size();
+				info.pCode = code.data();
+
+				VkShaderModule module;
+				check(vkCreateShaderModule(device, &info, nullptr, &module), "vkCreateShaderModule");
+				add(id, Type::ShaderModule, module);
+				break;
+			}
+			case Op::CreatePipelineLayout: {
+				uint32_t id = d.get<uint32_t>();
+				std::vector<VkDescriptorSetLayout> setLayouts(d.get<uint32_t>());
+				for (auto& setLayout : setLayouts) setLayout = get<VkDescriptorSetLayout>(d);
+				std::vector<VkPushConstantRange> ranges = d.getArray<VkPushConstantRange>();
+
+				VkPipelineLayoutCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+				info.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+				info.pSetLayouts = setLayouts.data();
+				info.pushConstantRangeCount = static_cast<uint32_t>(ranges.size());
+				info.pPushConstantRanges = ranges.data();
+
+				VkPipelineLayout layout;
+				check(vkCreatePipelineLayout(device, &info, nullptr, &layout), "vkCreatePipelineLayout");
+				add(id, Type::PipelineLayout, layout);
+				break;
+			}
+			case Op::CreateGraphicsPipeline:
+				createGraphicsPipeline(d);
+				break;
+			case Op::CreateComputePipeline: {
+				uint32_t id = d.get<uint32_t>();
+				VkComputePipelineCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				info.flags = d.get<VkFlags>();
+				info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				info.stage.flags = d.get<VkFlags>();
+				info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+				info.stage.module = get<VkShaderModule>(d);
+				std::string entryPoint = d.getString();
+				info.stage.pName = entryPoint.c_str();
+				info.layout = get<VkPipelineLayout>(d);
+
+				VkPipeline pipeline;
+				check(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline), "vkCreateComputePipelines");
+				add(id, Type::Pipeline, pipeline);
+				break;
+			}
+			case Op::CreateFramebuffer: {
+				uint32_t id = d.get<uint32_t>();
+				VkFramebufferCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+				info.flags = d.get<VkFlags>();
+				info.renderPass = get<VkRenderPass>(d);
+
+				std::vector<VkImageView> attachments(d.get<uint32_t>());
+				for (auto& attachment : attachments) attachment = get<VkImageView>(d);
+				info.attachmentCount = static_cast<uint32_t>(attachments.size());
+				info.pAttachments = attachments.data();
+
+				info.width = d.get<uint32_t>();
+				info.height = d.get<uint32_t>();
+				info.layers = d.get<uint32_t>();
+
+				VkFramebuffer framebuffer;
+				check(vkCreateFramebuffer(device, &info, nullptr, &framebuffer), "vkCreateFramebuffer");
+				add(id, Type::Framebuffer, framebuffer);
+				break;
+			}
+			case Op::CreateCommandPool: {
+				uint32_t id = d.get<uint32_t>();
+				VkCommandPoolCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+				info.flags = d.get<VkCommandPoolCreateFlags>();
+				info.queueFamilyIndex = queueFamily;
+
+				VkCommandPool pool;
+				check(vkCreateCommandPool(device, &info, nullptr, &pool), "vkCreateCommandPool");
+				add(id, Type::CommandPool, pool);
+				break;
+			}
+			case Op::AllocateCommandBuffers: {
+				VkCommandBufferAllocateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				info.commandPool = get<VkCommandPool>(d);
+				info.level = d.get<VkCommandBufferLevel>();
+				info.commandBufferCount = d.get<uint32_t>();
+
+				std::vector<VkCommandBuffer> buffers(info.commandBufferCount);
+				check(vkAllocateCommandBuffers(device, &info, buffers.data()), "vkAllocateCommandBuffers");
+				for (VkCommandBuffer buffer : buffers) add(d.get<uint32_t>(), Type::CommandBuffer, buffer);
+				break;
+			}
+			case Op::FreeCommandBuffers: {
+				VkCommandPool pool = get<VkCommandPool>(d);
+				uint32_t count = d.get<uint32_t>();
+				std::vector<VkCommandBuffer> buffers(count);
+				for (auto& buffer : buffers) {
+					uint32_t id = d.get<uint32_t>();
+					buffer = get<VkCommandBuffer>(id);
+					objects[id] = Object{};
+				}
+				vkFreeCommandBuffers(device, pool, count, buffers.data());
+				break;
+			}
+			case Op::CreateSemaphore: {
+				VkSemaphoreCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+				VkSemaphore semaphore;
+				check(vkCreateSemaphore(device, &info, nullptr, &semaphore), "vkCreateSemaphore");
+				add(d.get<uint32_t>(), Type::Semaphore, semaphore);
+				break;
+			}
+			case Op::CreateFence: {
+				uint32_t id = d.get<uint32_t>();
+				VkFenceCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+				info.flags = d.get<VkFenceCreateFlags>();
+
+				VkFence fence;
+				check(vkCreateFence(device, &info, nullptr, &fence), "vkCreateFence");
+				add(id, Type::Fence, fence);
+				break;
+			}
+			case Op::CreateQueryPool: {
+				uint32_t id = d.get<uint32_t>();
+				VkQueryPoolCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				info.queryType = d.get<VkQueryType>();
+				info.queryCount = d.get<uint32_t>();
+				info.pipelineStatistics = d.get<VkFlags>();
+
+				VkQueryPool pool;
+				check(vkCreateQueryPool(device, &info, nullptr, &pool), "vkCreateQueryPool");
+				add(id, Type::QueryPool, pool);
+				break;
+			}
+			case Op::CreateBuffer: {
+				uint32_t id = d.get<uint32_t>();
+				VkBufferCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				info.flags = d.get<VkFlags>();
+				info.size = d.get<VkDeviceSize>();
+				info.usage = d.get<VkBufferUsageFlags>();
+				info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				VkBuffer buffer;
+				check(vkCreateBuffer(device, &info, nullptr, &buffer), "vkCreateBuffer");
+				add(id, Type::Buffer, buffer);
+				break;
+			}
+			case Op::CreateImage: {
+				uint32_t id = d.get<uint32_t>();
+				VkImageCreateInfo info = d.get<VkImageCreateInfo>();
+				info.pNext = nullptr;
+				info.queueFamilyIndexCount = 0;
+				info.pQueueFamilyIndices = nullptr;
+
+				VkImage image;
+				check(vkCreateImage(device, &info, nullptr, &image), "vkCreateImage");
+				add(id, Type::Image, image);
+				break;
+			}
+			case Op::CreateSampler: {
+				uint32_t id = d.get<uint32_t>();
+				VkSamplerCreateInfo info = d.get<VkSamplerCreateInfo>();
+				info.pNext = nullptr;
+
+				VkSampler sampler;
+				check(vkCreateSampler(device, &info, nullptr, &sampler), "vkCreateSampler");
+				add(id, Type::Sampler, sampler);
+				break;
+			}
+			case Op::CreateDescriptorSetLayout: {
+				uint32_t id = d.get<uint32_t>();
+				VkDescriptorSetLayoutCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+				info.flags = d.get<VkFlags>();
+
+				std::vector<VkDescriptorSetLayoutBinding> bindings = d.getArray<VkDescriptorSetLayoutBinding>();
+				for (auto& binding : bindings) binding.pImmutableSamplers = nullptr;
+				info.bindingCount = static_cast<uint32_t>(bindings.size());
+				info.pBindings = bindings.data();
+
+				VkDescriptorSetLayout layout;
+				check(vkCreateDescriptorSetLayout(device, &info, nullptr, &layout), "vkCreateDescriptorSetLayout");
+				add(id, Type::DescriptorSetLayout, layout);
+				break;
+			}
+			case Op::CreateDescriptorPool: {
+				uint32_t id = d.get<uint32_t>();
+				VkDescriptorPoolCreateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+				info.flags = d.get<VkDescriptorPoolCreateFlags>();
+				info.maxSets = d.get<uint32_t>();
+
+				std::vector<VkDescriptorPoolSize> sizes = d.getArray<VkDescriptorPoolSize>();
+				info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+				info.pPoolSizes = sizes.data();
+
+				VkDescriptorPool pool;
+				check(vkCreateDescriptorPool(device, &info, nullptr, &pool), "vkCreateDescriptorPool");
+				add(id, Type::DescriptorPool, pool);
+				break;
+			}
+			case Op::AllocateDescriptorSets: {
+				VkDescriptorPool pool = get<VkDescriptorPool>(d);
+				uint32_t count = d.get<uint32_t>();
+
+				std::vector<VkDescriptorSetLayout> layouts(count);
+				std::vector<uint32_t> ids(count);
+				for (uint32_t i = 0; i < count; i++) {
+					layouts[i] = get<VkDescriptorSetLayout>(d);
+					ids[i] = d.get<uint32_t>();
+				}
+
+				VkDescriptorSetAllocateInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+				info.descriptorPool = pool;
+				info.descriptorSetCount = count;
+				info.pSetLayouts = layouts.data();
+
+				std::vector<VkDescriptorSet> sets(count);
+				check(vkAllocateDescriptorSets(device, &info, sets.data()), "vkAllocateDescriptorSets");
+				for (uint32_t i = 0; i < count; i++) add(ids[i], Type::DescriptorSet, sets[i]);
+				break;
+			}
+			case Op::UpdateDescriptorSets:
+				updateDescriptorSets(d);
+				break;
+			case Op::Destroy:
+				destroy(d.get<uint32_t>());
+				break;
+
+			case Op::AllocateMemory: {
+				uint32_t id = d.get<uint32_t>();
+				Memory& memory = memories[id];
+				memory.capturedSize = d.get<VkDeviceSize>();
+				memory.flags = d.get<VkMemoryPropertyFlags>();
+				break;
+			}
+			case Op::BindBufferMemory: {
+				VkBuffer buffer = get<VkBuffer>(d);
+				uint32_t memoryId = d.get<uint32_t>();
+				VkDeviceSize offset = d.get<VkDeviceSize>();
+
+				VkMemoryRequirements requirements;
+				vkGetBufferMemoryRequirements(device, buffer, &requirements);
+				Memory& memory = allocate(memoryId, requirements.memoryTypeBits, offset + requirements.size);
+				check(vkBindBufferMemory(device, buffer, memory.memory, offset), "vkBindBufferMemory");
+				break;
+			}
+			case Op::BindImageMemory: {
+				VkImage image = get<VkImage>(d);
+				uint32_t memoryId = d.get<uint32_t>();
+				VkDeviceSize offset = d.get<VkDeviceSize>();
+
+				VkMemoryRequirements requirements;
+				vkGetImageMemoryRequirements(device, image, &requirements);
+				Memory& memory = allocate(memoryId, requirements.memoryTypeBits, offset + requirements.size);
+				check(vkBindImageMemory(device, image, memory.memory, offset), "vkBindImageMemory");
+				break;
+			}
+			case Op::MapMemory: {
+				uint32_t id = d.get<uint32_t>();
+				VkDeviceSize offset = d.get<VkDeviceSize>();
+				VkDeviceSize size = d.get<VkDeviceSize>();
+
+				Memory& memory = allocate(id, ~0u, offset + size);
+				void* data;
+				check(vkMapMemory(device, memory.memory, offset, size, 0, &data), "vkMapMemory");
+
+				// Matches the capture's zeroed shadow copy
+				memset(data, 0, static_cast<size_t>(size));
+				memory.mapped = static_cast<uint8_t*>(data);
+				memory.mapOffset = offset;
+				break;
+			}
+			case Op::UnmapMemory: {
+				Memory& memory = memories.at(d.get<uint32_t>());
+				vkUnmapMemory(device, memory.memory);
+				memory.mapped = nullptr;
+				break;
+			}
+			case Op::MemoryWrite: {
+				Memory& memory = memories.at(d.get<uint32_t>());
+				VkDeviceSize offset = d.get<VkDeviceSize>();
+				uint32_t size = d.get<uint32_t>();
+				memcpy(memory.mapped + (offset - memory.mapOffset), d.raw(size), size);
+				break;
+			}
+
+			case Op::BeginCommandBuffer: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkCommandBufferBeginInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				info.flags = d.get<VkCommandBufferUsageFlags>();
+				check(vkBeginCommandBuffer(commandBuffer, &info), "vkBeginCommandBuffer");
+				break;
+			}
+			case Op::EndCommandBuffer:
+				check(vkEndCommandBuffer(get<VkCommandBuffer>(d)), "vkEndCommandBuffer");
+				break;
+			case Op::ResetCommandBuffer: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				vkResetCommandBuffer(commandBuffer, d.get<VkFlags>());
+				break;
+			}
+			case Op::CmdResetQueryPool: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkQueryPool pool = get<VkQueryPool>(d);
+				uint32_t first = d.get<uint32_t>();
+				uint32_t count = d.get<uint32_t>();
+				vkCmdResetQueryPool(commandBuffer, pool, first, count);
+				break;
+			}
+			case Op::CmdBeginRenderPass: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkRenderPassBeginInfo info{};
+				info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				info.renderPass = get<VkRenderPass>(d);
+				info.framebuffer = get<VkFramebuffer>(d);
+				info.renderArea = d.get<VkRect2D>();
+
+				std::vector<VkClearValue> clearValues = d.getArray<VkClearValue>();
+				info.clearValueCount = static_cast<uint32_t>(clearValues.size());
+				info.pClearValues = clearValues.data();
+
+				vkCmdBeginRenderPass(commandBuffer, &info, d.get<VkSubpassContents>());
+				break;
+			}
+			case Op::CmdEndRenderPass:
+				vkCmdEndRenderPass(get<VkCommandBuffer>(d));
+				break;
+			case Op::CmdSetViewport: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				uint32_t first = d.get<uint32_t>();
+				std::vector<VkViewport> viewports = d.getArray<VkViewport>();
+				vkCmdSetViewport(commandBuffer, first, static_cast<uint32_t>(viewports.size()), viewports.data());
+				break;
+			}
+			case Op::CmdSetScissor: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				uint32_t first = d.get<uint32_t>();
+				std::vector<VkRect2D> scissors = d.getArray<VkRect2D>();
+				vkCmdSetScissor(commandBuffer, first, static_cast<uint32_t>(scissors.size()), scissors.data());
+				break;
+			}
+			case Op::CmdBindPipeline: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkPipelineBindPoint bindPoint = d.get<VkPipelineBindPoint>();
+				vkCmdBindPipeline(commandBuffer, bindPoint, get<VkPipeline>(d));
+				break;
+			}
+			case Op::CmdDraw: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				uint32_t vertexCount = d.get<uint32_t>();
+				uint32_t instanceCount = d.get<uint32_t>();
+				uint32_t firstVertex = d.get<uint32_t>();
+				uint32_t firstInstance = d.get<uint32_t>();
+				vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+				stats.draws++;
+				break;
+			}
+			case Op::CmdBindDescriptorSets: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkPipelineBindPoint bindPoint = d.get<VkPipelineBindPoint>();
+				VkPipelineLayout layout = get<VkPipelineLayout>(d);
+				uint32_t firstSet = d.get<uint32_t>();
+
+				std::vector<VkDescriptorSet> sets(d.get<uint32_t>());
+				for (auto& set : sets) set = get<VkDescriptorSet>(d);
+				std::vector<uint32_t> dynamicOffsets = d.getArray<uint32_t>();
+
+				vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, static_cast<uint32_t>(sets.size()),
+					sets.data(), static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+				break;
+			}
+			case Op::CmdPushConstants: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkPipelineLayout layout = get<VkPipelineLayout>(d);
+				VkShaderStageFlags stages = d.get<VkShaderStageFlags>();
+				uint32_t offset = d.get<uint32_t>();
+				std::vector<uint8_t> values = d.getArray<uint8_t>();
+				vkCmdPushConstants(commandBuffer, layout, stages, offset, static_cast<uint32_t>(values.size()), values.data());
+				break;
+			}
+			case Op::CmdBindVertexBuffers: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				uint32_t first = d.get<uint32_t>();
+				uint32_t count = d.get<uint32_t>();
+
+				std::vector<VkBuffer> buffers(count);
+				std::vector<VkDeviceSize> offsets(count);
+				for (uint32_t i = 0; i < count; i++) {
+					buffers[i] = get<VkBuffer>(d);
+					offsets[i] = d.get<VkDeviceSize>();
+				}
+				vkCmdBindVertexBuffers(commandBuffer, first, count, buffers.data(), offsets.data());
+				break;
+			}
+			case Op::CmdWriteTimestamp: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkPipelineStageFlagBits stage = d.get<VkPipelineStageFlagBits>();
+				VkQueryPool pool = get<VkQueryPool>(d);
+				uint32_t query = d.get<uint32_t>();
+
+				// Only valid on queues with timestamp support
+				if (timestampsSupported) vkCmdWriteTimestamp(commandBuffer, stage, pool, query);
+				break;
+			}
+			case Op::CmdPipelineBarrier:
+				pipelineBarrier(d);
+				break;
+			case Op::CmdCopyBufferToImage: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkBuffer buffer = get<VkBuffer>(d);
+				VkImage image = get<VkImage>(d);
+				VkImageLayout layout = patchLayout(d.get<VkImageLayout>());
+				std::vector<VkBufferImageCopy> regions = d.getArray<VkBufferImageCopy>();
+				vkCmdCopyBufferToImage(commandBuffer, buffer, image, layout, static_cast<uint32_t>(regions.size()), regions.data());
+				break;
+			}
+			case Op::CmdDispatch: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				uint32_t x = d.get<uint32_t>();
+				uint32_t y = d.get<uint32_t>();
+				uint32_t z = d.get<uint32_t>();
+				vkCmdDispatch(commandBuffer, x, y, z);
+				stats.dispatches++;
+				break;
+			}
+			case Op::CmdBlitImage: {
+				VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+				VkImage source = get<VkImage>(d);
+				VkImageLayout sourceLayout = patchLayout(d.get<VkImageLayout>());
+				VkImage destination = get<VkImage>(d);
+				VkImageLayout destinationLayout = patchLayout(d.get<VkImageLayout>());
+				std::vector<VkImageBlit> regions = d.getArray<VkImageBlit>();
+				VkFilter filter = d.get<VkFilter>();
+				vkCmdBlitImage(commandBuffer, source, sourceLayout, destination, destinationLayout,
+					static_cast<uint32_t>(regions.size()), regions.data(), filter);
+				break;
+			}
+
+			case Op::QueueSubmit:
+				queueSubmit(d);
+				break;
+			case Op::QueueWaitIdle:
+				vkQueueWaitIdle(queue);
+				break;
+			case Op::DeviceWaitIdle:
+				vkDeviceWaitIdle(device);
+				break;
+			case Op::WaitForFences: {
+				std::vector<VkFence> fences(d.get<uint32_t>());
+				for (auto& fence : fences) fence = get<VkFence>(d);
+				VkBool32 waitAll = d.get<VkBool32>();
+				vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), waitAll, UINT64_MAX);
+				break;
+			}
+			case Op::ResetFences: {
+				std::vector<VkFence> fences(d.get<uint32_t>());
+				for (auto& fence : fences) fence = get<VkFence>(d);
+				vkResetFences(device, static_cast<uint32_t>(fences.size()), fences.data());
+				break;
+			}
+			case Op::AcquireNextImage:
+				break; // The captured image index is already baked into the recorded framebuffers
+			case Op::QueuePresent: {
+				auto now = std::chrono::steady_clock::now();
+				stats.frameMs.push_back(std::chrono::duration<double, std::milli>(now - lastPresent).count());
+				lastPresent = now;
+				break;
+			}
+
+			default:
+				throw std::runtime_error("replay: unknown record in capture!");
+		}
+	}
+
+	void createGraphicsPipeline(Decoder& d) {
+		uint32_t id = d.get<uint32_t>();
+
+		VkGraphicsPipelineCreateInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		info.flags = d.get<VkFlags>();
+
+		uint32_t stageCount = d.get<uint32_t>();
+		std::vector<VkPipelineShaderStageCreateInfo> stages(stageCount);
+		std::vector<std::string> entryPoints(stageCount);
+		for (uint32_t i = 0; i < stageCount; i++) {
+			stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[i].flags = d.get<VkFlags>();
+			stages[i].stage = d.get<VkShaderStageFlagBits>();
+			stages[i].module = get<VkShaderModule>(d);
+			entryPoints[i] = d.getString();
+		}
+		for (uint32_t i = 0; i < stageCount; i++) stages[i].pName = entryPoints[i].c_str();
+		info.stageCount = stageCount;
+		info.pStages = stages.data();
+
+		std::vector<VkVertexInputBindingDescription> bindings = d.getArray<VkVertexInputBindingDescription>();
+		std::vector<VkVertexInputAttributeDescription> attributes = d.getArray<VkVertexInputAttributeDescription>();
+		VkPipelineVertexInputStateCreateInfo vertexInput{};
+		vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+		vertexInput.pVertexBindingDescriptions = bindings.data();
+		vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+		vertexInput.pVertexAttributeDescriptions = attributes.data();
+		info.pVertexInputState = &vertexInput;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+		info.pInputAssemblyState = getOptional(d, inputAssembly);
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		std::vector<VkViewport> viewports;
+		std::vector<VkRect2D> scissors;
+		if (d.get<uint8_t>()) {
+			viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewportState.viewportCount = d.get<uint32_t>();
+			viewportState.scissorCount = d.get<uint32_t>();
+			viewports = d.getArray<VkViewport>();
+			scissors = d.getArray<VkRect2D>();
+			viewportState.pViewports = viewports.empty() ? nullptr : viewports.data();
+			viewportState.pScissors = scissors.empty() ? nullptr : scissors.data();
+			info.pViewportState = &viewportState;
+		}
+
+		VkPipelineRasterizationStateCreateInfo rasterization;
+		info.pRasterizationState = getOptional(d, rasterization);
+
+		VkPipelineMultisampleStateCreateInfo multisample;
+		info.pMultisampleState = getOptional(d, multisample);
+		if (info.pMultisampleState) multisample.pSampleMask = nullptr;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil;
+		info.pDepthStencilState = getOptional(d, depthStencil);
+
+		VkPipelineColorBlendStateCreateInfo colorBlend{};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		if (d.get<uint8_t>()) {
+			colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlend.flags = d.get<VkFlags>();
+			colorBlend.logicOpEnable = d.get<VkBool32>();
+			colorBlend.logicOp = d.get<VkLogicOp>();
+			blendAttachments = d.getArray<VkPipelineColorBlendAttachmentState>();
+			colorBlend.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+			colorBlend.pAttachments = blendAttachments.data();
+			memcpy(colorBlend.blendConstants, d.raw(sizeof(colorBlend.blendConstants)), sizeof(colorBlend.blendConstants));
+			info.pColorBlendState = &colorBlend;
+		}
+
+		std::vector<VkDynamicState> dynamicStates = d.getArray<VkDynamicState>();
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
+		if (!dynamicStates.empty()) info.pDynamicState = &dynamicState;
+
+		info.layout = get<VkPipelineLayout>(d);
+		info.renderPass = get<VkRenderPass>(d);
+		info.subpass = d.get<uint32_t>();
+
+		VkPipeline pipeline;
+		check(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline), "vkCreateGraphicsPipelines");
+		add(id, Type::Pipeline, pipeline);
+	}
+
+	template<typename T>
+	static const T* getOptional(Decoder& d, T& storage) {
+		if (!d.get<uint8_t>()) return nullptr;
+		storage = d.get<T>();
+		storage.pNext = nullptr;
+		return &storage;
+	}
+
+	void updateDescriptorSets(Decoder& d) {
+		uint32_t writeCount = d.get<uint32_t>();
+		std::vector<VkWriteDescriptorSet> writes(writeCount);
+		std::vector<std::vector<VkDescriptorImageInfo>> imageInfos(writeCount);
+		std::vector<std::vector<VkDescriptorBufferInfo>> bufferInfos(writeCount);
+
+		for (uint32_t i = 0; i < writeCount; i++) {
+			VkWriteDescriptorSet& write = writes[i];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = get<VkDescriptorSet>(d);
+			write.dstBinding = d.get<uint32_t>();
+			write.dstArrayElement = d.get<uint32_t>();
+			write.descriptorType = d.get<VkDescriptorType>();
+			write.descriptorCount = d.get<uint32_t>();
+
+			if (d.get<uint8_t>()) {
+				imageInfos[i].resize(write.descriptorCount);
+				for (auto& imageInfo : imageInfos[i]) {
+					imageInfo.sampler = get<VkSampler>(d);
+					imageInfo.imageView = get<VkImageView>(d);
+					imageInfo.imageLayout = patchLayout(d.get<VkImageLayout>());
+				}
+				write.pImageInfo = imageInfos[i].data();
+			}
+
+			if (d.get<uint8_t>()) {
+				bufferInfos[i].resize(write.descriptorCount);
+				for (auto& bufferInfo : bufferInfos[i]) {
+					bufferInfo.buffer = get<VkBuffer>(d);
+					bufferInfo.offset = d.get<VkDeviceSize>();
+					bufferInfo.range = d.get<VkDeviceSize>();
+				}
+				write.pBufferInfo = bufferInfos[i].data();
+			}
+		}
+
+		vkUpdateDescriptorSets(device, writeCount, writes.data(), 0, nullptr);
+	}
+
+	void pipelineBarrier(Decoder& d) {
+		VkCommandBuffer commandBuffer = get<VkCommandBuffer>(d);
+		VkPipelineStageFlags srcStage = d.get<VkPipelineStageFlags>();
+		VkPipelineStageFlags dstStage = d.get<VkPipelineStageFlags>();
+		VkDependencyFlags dependencyFlags = d.get<VkDependencyFlags>();
+
+		std::vector<VkMemoryBarrier> memoryBarriers = d.getArray<VkMemoryBarrier>();
+		for (auto& barrier : memoryBarriers) barrier.pNext = nullptr;
+
+		std::vector<VkBufferMemoryBarrier> bufferBarriers(d.get<uint32_t>());
+		for (auto& barrier : bufferBarriers) {
+			VkBuffer buffer = get<VkBuffer>(d);
+			barrier = d.get<VkBufferMemoryBarrier>();
+			barrier.pNext = nullptr;
+			barrier.buffer = buffer;
+		}
+
+		std::vector<VkImageMemoryBarrier> imageBarriers(d.get<uint32_t>());
+		for (auto& barrier : imageBarriers) {
+			VkImage image = get<VkImage>(d);
+			barrier = d.get<VkImageMemoryBarrier>();
+			barrier.pNext = nullptr;
+			barrier.image = image;
+			barrier.oldLayout = patchLayout(barrier.oldLayout);
+			barrier.newLayout = patchLayout(barrier.newLayout);
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, dependencyFlags,
+			static_cast<uint32_t>(memoryBarriers.size()), memoryBarriers.data(),
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	void queueSubmit(Decoder& d) {
+		uint32_t submitCount = d.get<uint32_t>();
+		std::vector<VkSubmitInfo> submits(submitCount);
+		std::vector<std::vector<VkCommandBuffer>> commandBuffers(submitCount);
+
+		for (uint32_t i = 0; i < submitCount; i++) {
+			// Semaphores are dropped, see the top of this file
+			uint32_t waitCount = d.get<uint32_t>();
+			for (uint32_t j = 0; j < waitCount; j++) {
+				d.get<uint32_t>();
+				d.get<VkPipelineStageFlags>();
+			}
+
+			commandBuffers[i].resize(d.get<uint32_t>());
+			for (auto& commandBuffer : commandBuffers[i]) commandBuffer = get<VkCommandBuffer>(d);
+
+			uint32_t signalCount = d.get<uint32_t>();
+			for (uint32_t j = 0; j < signalCount; j++) d.get<uint32_t>();
+
+			submits[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submits[i].commandBufferCount = static_cast<uint32_t>(commandBuffers[i].size());
+			submits[i].pCommandBuffers = commandBuffers[i].data();
+		}
+
+		VkFence fence = get<VkFence>(d);
+		check(vkQueueSubmit(queue, submitCount, submits.data(), fence), "vkQueueSubmit");
+		stats.submits++;
+	}
+};
+
+} // namespace replay
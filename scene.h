@@ -0,0 +1,270 @@
+/*
+* Synthetic test scenes for the GPU benchmarks.
+* - Just enough vector / matrix math for a camera: column-major like GLSL, Vulkan clip space
+*   (y down, depth 0 to 1).
+* - city() builds a dense grid of buildings with streets between them. From street level
+*   most of the city hides behind the first few blocks, the case occlusion culling is for.
+* - cityLights() scatters point lights over the streets and roofs, for clustered lighting.
+*   traffic() adds moving boxes, the dynamic shadow casters. props() scatters small boxes
+*   through the whole city, enough of them to test spatial queries at scale.
+* - Buildings are boxes or round towers. Each mesh has a LOD chain, finest first, where every
+*   level stores its geometric error: how far its surface strays from the ideal shape.
+* - Everything is seeded, two runs see the same scene and camera path.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+namespace scene {
+
+struct Vec3 {
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3 operator*(Vec3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+
+inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline Vec3 cross(Vec3 a, Vec3 b) {
+	return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline Vec3 normalize(Vec3 v) {
+	return v * (1.0f / std::sqrt(dot(v, v)));
+}
+
+
+// Column-major, m[column * 4 + row], so it can be copied into a GLSL mat4 as is
+struct Mat4 {
+	float m[16] = {};
+};
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+	Mat4 r;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++) sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+			r.m[column * 4 + row] = sum;
+		}
+	}
+	return r;
+}
+
+// Right handed view looking down -z
+inline Mat4 lookAt(Vec3 eye, Vec3 center, Vec3 up) {
+	Vec3 f = normalize(center - eye);
+	Vec3 s = normalize(cross(f, up));
+	Vec3 u = cross(s, f);
+
+	Mat4 r;
+	r.m[0] = s.x; r.m[4] = s.y; r.m[8] = s.z; r.m[12] = -dot(s, eye);
+	r.m[1] = u.x; r.m[5] = u.y; r.m[9] = u.z; r.m[13] = -dot(u, eye);
+	r.m[2] = -f.x; r.m[6] = -f.y; r.m[10] = -f.z; r.m[14] = dot(f, eye);
+	r.m[15] = 1.0f;
+	return r;
+}
+
+// Vulkan clip space: y flipped, depth 0 at near and 1 at far
+inline Mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane) {
+	float f = 1.0f / std::tan(fovY / 2.0f);
+
+	Mat4 r;
+	r.m[0] = f / aspect;
+	r.m[5] = -f;
+	r.m[10] = farPlane / (nearPlane - farPlane);
+	r.m[11] = -1.0f;
+	r.m[14] = nearPlane * farPlane / (nearPlane - farPlane);
+	return r;
+}
+
+// Vulkan clip space like perspective(), for light views
+inline Mat4 orthographic(float left, float right, float bottom, float top, float nearPlane, float farPlane) {
+	Mat4 r;
+	r.m[0] = 2.0f / (right - left);
+	r.m[5] = -2.0f / (top - bottom);
+	r.m[10] = 1.0f / (nearPlane - farPlane);
+	r.m[12] = -(right + left) / (right - left);
+	r.m[13] = (top + bottom) / (top - bottom);
+	r.m[14] = nearPlane / (nearPlane - farPlane);
+	r.m[15] = 1.0f;
+	return r;
+}
+
+
+// Building bounds and mesh, laid out like the std430 struct the shaders read
+struct Box {
+	float center[3];
+	uint32_t mesh;
+	float extent[3]; // Half size
+	uint32_t pad;
+};
+
+
+/*
+* LOD chains
+*/
+
+struct LodLevel {
+	uint32_t vertexCount; // Non-indexed, triangles are vertexCount / 3
+	uint32_t segments; // Tower sides, 0 for a box
+	float error; // For a half extent of 1, scales with the instance's width
+	uint32_t pad;
+};
+
+struct Mesh {
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t pad[2];
+};
+
+// Every mesh's levels in one array, so the GPU gets them as two flat buffers.
+struct MeshLibrary {
+	std::vector<Mesh> meshes;
+	std::vector<LodLevel> lods;
+
+	uint32_t add(const std::vector<LodLevel>& chain) {
+		meshes.push_back(Mesh{static_cast<uint32_t>(lods.size()), static_cast<uint32_t>(chain.size()), {}});
+		lods.insert(lods.end(), chain.begin(), chain.end());
+		return static_cast<uint32_t>(meshes.size() - 1);
+	}
+};
+
+const uint32_t BOX_MESH = 0;
+const uint32_t TOWER_MESH = 1;
+
+// A box is exact at 12 triangles. A tower with n sides is n wall quads plus an n triangle
+// roof fan, and a polygon of n sides misses its circle by 1 - cos(pi / n).
+inline MeshLibrary cityMeshes() {
+	const float pi = 3.14159265f;
+
+	MeshLibrary library;
+	library.add({LodLevel{36, 0, 0.0f, 0}});
+
+	std::vector<LodLevel> tower;
+	for (uint32_t segments : {64u, 32u, 16u, 8u}) {
+		tower.push_back(LodLevel{segments * 9, segments, 1.0f - std::cos(pi / segments), 0});
+	}
+	library.add(tower);
+
+	return library;
+}
+
+
+const uint32_t CITY_BLOCKS = 96; // Per side
+const float BLOCK_SIZE = 12.0f;
+
+// One building per block, footprints leave streets at least 2 wide.
+inline std::vector<Box> city(uint32_t mesh = BOX_MESH, uint32_t blocks = CITY_BLOCKS, uint32_t seed = 1) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> halfWidth(3.0f, 5.0f);
+	std::uniform_real_distribution<float> height(4.0f, 40.0f);
+
+	std::vector<Box> boxes;
+	boxes.reserve(blocks * blocks);
+	for (uint32_t z = 0; z < blocks; z++) {
+		for (uint32_t x = 0; x < blocks; x++) {
+			float h = height(rng);
+			boxes.push_back(Box{
+				{x * BLOCK_SIZE, h / 2.0f, z * BLOCK_SIZE}, mesh,
+				{halfWidth(rng), h / 2.0f, halfWidth(rng)}, 0
+			});
+		}
+	}
+	return boxes;
+}
+
+// Cars driving up and down every other street, moved to where they are at `frame`.
+inline std::vector<Box> traffic(uint32_t count, uint32_t frame, uint32_t blocks = CITY_BLOCKS, uint32_t seed = 2) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<uint32_t> street(0, blocks / 2 - 1);
+	std::uniform_real_distribution<float> start(0.0f, blocks * BLOCK_SIZE);
+	std::uniform_real_distribution<float> speed(0.3f, 1.2f);
+
+	float length = blocks * BLOCK_SIZE;
+	std::vector<Box> cars;
+	cars.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		float x = (street(rng) * 2 + 0.5f) * BLOCK_SIZE; // Between two blocks
+		float z = std::fmod(start(rng) + speed(rng) * frame, length);
+		cars.push_back(Box{{x, 0.8f, z}, BOX_MESH, {0.9f, 0.8f, 2.0f}, 0});
+	}
+	return cars;
+}
+
+// Signs, lamps and debris anywhere between the streets and the tallest roofs
+inline std::vector<Box> props(uint32_t count, uint32_t blocks = CITY_BLOCKS, uint32_t seed = 3) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> ground(0.0f, blocks * BLOCK_SIZE);
+	std::uniform_real_distribution<float> height(0.0f, 40.0f);
+	std::uniform_real_distribution<float> halfSize(0.2f, 1.0f);
+
+	std::vector<Box> boxes;
+	boxes.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		float x = ground(rng);
+		float y = height(rng);
+		float z = ground(rng);
+		boxes.push_back(Box{{x, y, z}, BOX_MESH, {halfSize(rng), halfSize(rng), halfSize(rng)}, 0});
+	}
+	return boxes;
+}
+
+// Laid out like the std430 struct the shaders read
+struct PointLight {
+	float position[3];
+	float radius; // Falls off to nothing here
+	float color[3];
+	float pad;
+};
+
+inline std::vector<PointLight> cityLights(uint32_t count, uint32_t blocks = CITY_BLOCKS, uint32_t seed = 1) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> ground(0.0f, blocks * BLOCK_SIZE);
+	std::uniform_real_distribution<float> height(1.0f, 12.0f);
+	std::uniform_real_distribution<float> radius(4.0f, 12.0f);
+	std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+
+	std::vector<PointLight> lights;
+	lights.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		float x = ground(rng);
+		float y = height(rng);
+		float z = ground(rng);
+		float r = radius(rng);
+		lights.push_back(PointLight{{x, y, z}, r, {channel(rng), channel(rng), channel(rng)}, 0.0f});
+	}
+	return lights;
+}
+
+struct Camera {
+	Vec3 eye;
+	Mat4 view;
+	Mat4 viewProj;
+	float pixelsPerUnit; // Screen pixels covered by 1 unit facing the camera at distance 1
+};
+
+const float CAMERA_FOV_Y = 1.0f;
+const float CAMERA_NEAR = 0.5f;
+const float CAMERA_FAR = 2000.0f;
+
+// Walks up the middle street at head height, looking left and right as it goes.
+inline Camera streetCamera(uint32_t frame, float aspect, uint32_t viewportHeight, uint32_t blocks = CITY_BLOCKS) {
+	float street = (blocks / 2 - 0.5f) * BLOCK_SIZE;
+	Vec3 eye{street, 2.0f, 10.0f + frame * 1.5f};
+	float yaw = 0.6f * std::sin(frame * 0.05f);
+	Vec3 forward{std::sin(yaw), -0.05f, std::cos(yaw)};
+
+	Mat4 view = lookAt(eye, eye + forward, Vec3{0.0f, 1.0f, 0.0f});
+	Mat4 projection = perspective(CAMERA_FOV_Y, aspect, CAMERA_NEAR, CAMERA_FAR);
+	return Camera{eye, view, projection * view, viewportHeight / (2.0f * std::tan(CAMERA_FOV_Y / 2.0f))};
+}
+
+} // namespace scene
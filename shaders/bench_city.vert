@@ -0,0 +1,90 @@
+#version 450
+
+// Buildings generated from gl_VertexIndex: a 36 vertex box, or a tower with `segments`
+// sides and a flat roof. Instances are either the whole city or a visible list the
+// culling pass wrote, one list per mesh LOD.
+struct Box {
+	vec3 center;
+	uint mesh;
+	vec3 extent;
+	uint pad;
+};
+
+layout(std430, binding = 0) readonly buffer Boxes {
+	Box boxes[];
+};
+
+layout(std430, binding = 1) readonly buffer DrawList {
+	uint drawList[];
+};
+
+layout(push_constant) uniform Push {
+	mat4 viewProj;
+	uint listBase; // Where this draw's visible list starts in drawList
+	uint useList; // 0 draws every box, for the unculled baseline
+	uint segments; // 0 for boxes
+} push;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 worldPosition; // For bench_city_lit.frag
+layout(location = 2) out vec3 worldNormal;
+
+// Two triangles per face, corners numbered by their x/y/z sign bits
+const int corners[36] = int[](
+	0, 2, 6, 0, 6, 4, // -x
+	1, 5, 7, 1, 7, 3, // +x
+	0, 4, 5, 0, 5, 1, // -y
+	2, 3, 7, 2, 7, 6, // +y
+	0, 1, 3, 0, 3, 2, // -z
+	4, 6, 7, 4, 7, 5 // +z
+);
+
+const vec3 normals[6] = vec3[](
+	vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+	vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0)
+);
+
+// Wall quads as (next side, top) per vertex
+const ivec2 wallCorners[6] = ivec2[](
+	ivec2(0, 0), ivec2(1, 0), ivec2(1, 1),
+	ivec2(0, 0), ivec2(1, 1), ivec2(0, 1)
+);
+
+const float TWO_PI = 6.28318531;
+
+void main() {
+	uint boxIndex = push.useList != 0 ? drawList[push.listBase + gl_InstanceIndex] : gl_InstanceIndex;
+	Box box = boxes[boxIndex];
+
+	vec3 position;
+	vec3 normal;
+	int v = gl_VertexIndex;
+	int segments = int(push.segments);
+
+	if (segments == 0) {
+		int corner = corners[v];
+		position = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+		normal = normals[v / 6];
+	} else if (v < segments * 6) {
+		ivec2 wall = wallCorners[v % 6];
+		float angle = TWO_PI * float(v / 6 + wall.x) / float(segments);
+		float middle = TWO_PI * (float(v / 6) + 0.5) / float(segments);
+		position = vec3(cos(angle), wall.y * 2.0 - 1.0, sin(angle));
+		normal = vec3(cos(middle), 0.0, sin(middle));
+	} else {
+		// Roof fan around the center
+		int roof = (v - segments * 6) / 3;
+		int corner = (v - segments * 6) % 3;
+		float angle = TWO_PI * float(roof + corner - 1) / float(segments);
+		position = corner == 0 ? vec3(0.0, 1.0, 0.0) : vec3(cos(angle), 1.0, sin(angle));
+		normal = vec3(0.0, 1.0, 0.0);
+	}
+
+	worldPosition = box.center + box.extent * position;
+	worldNormal = normal / box.extent; // Inverse transpose of the scale
+	gl_Position = push.viewProj * vec4(worldPosition, 1.0);
+
+	float light = 0.4 + 0.6 * max(dot(normal, normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+	fragColor = vec3(0.5 + 0.5 * fract(float(boxIndex) * 0.618)) * light;
+}
@@ -0,0 +1,62 @@
+#version 450
+
+// bench_city.frag plus clustered point lights. The pixel's cluster comes from its screen
+// tile and linear depth, and only that cluster's lights are shaded. Grid as in clusters.h.
+struct Light {
+	vec3 position;
+	float radius;
+	vec3 color;
+	float pad;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Lights {
+	Light lights[];
+};
+
+// (offset, count) per cluster
+layout(std430, set = 1, binding = 1) readonly buffer Ranges {
+	uvec2 ranges[];
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer Indices {
+	uint indices[];
+};
+
+// After the vertex shader's part
+layout(push_constant) uniform Push {
+	layout(offset = 80) vec4 frustum; // scaleX, scaleY, near, far
+	vec2 targetSize;
+} push;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 worldPosition;
+layout(location = 2) in vec3 worldNormal;
+
+layout(location = 0) out vec4 outColor;
+
+const uint GRID_X = 16;
+const uint GRID_Y = 16;
+const uint GRID_Z = 24;
+
+void main() {
+	float nearPlane = push.frustum.z;
+	float farPlane = push.frustum.w;
+
+	// Vulkan depth 0 at near, 1 at far, back to view distance
+	float depth = nearPlane * farPlane / (farPlane + gl_FragCoord.z * (nearPlane - farPlane));
+	uint slice = uint(clamp(floor(log(depth / nearPlane) / log(farPlane / nearPlane) * float(GRID_Z)), 0.0, float(GRID_Z - 1)));
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / push.targetSize * vec2(GRID_X, GRID_Y)), uvec2(GRID_X - 1, GRID_Y - 1));
+	uvec2 range = ranges[tile.x + GRID_X * (tile.y + GRID_Y * slice)];
+
+	vec3 normal = normalize(worldNormal);
+	vec3 lit = vec3(0.0);
+	for (uint i = 0; i < range.y; i++) {
+		Light light = lights[indices[range.x + i]];
+		vec3 toLight = light.position - worldPosition;
+		float dist = length(toLight);
+		float falloff = max(1.0 - dist / light.radius, 0.0);
+		lit += light.color * falloff * falloff * max(dot(normal, toLight / max(dist, 1e-4)), 0.0);
+	}
+
+	outColor = vec4(fragColor * (0.5 + lit), 1.0);
+}
@@ -0,0 +1,39 @@
+#version 450
+
+// Depth only boxes for the shadow atlas and cascades, corners from gl_VertexIndex as in
+// bench_city.vert. The light's matrix comes from a buffer, so one set serves every tile.
+struct Box {
+	vec3 center;
+	uint mesh;
+	vec3 extent;
+	uint pad;
+};
+
+layout(std430, binding = 0) readonly buffer Boxes {
+	Box boxes[];
+};
+
+layout(std430, binding = 1) readonly buffer Matrices {
+	mat4 matrices[];
+};
+
+layout(push_constant) uniform Push {
+	uint matrix;
+} push;
+
+const int corners[36] = int[](
+	0, 2, 6, 0, 6, 4,
+	1, 5, 7, 1, 7, 3,
+	0, 4, 5, 0, 5, 1,
+	2, 3, 7, 2, 7, 6,
+	0, 1, 3, 0, 3, 2,
+	4, 6, 7, 4, 7, 5
+);
+
+void main() {
+	Box box = boxes[gl_InstanceIndex];
+	int corner = corners[gl_VertexIndex];
+	vec3 position = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+
+	gl_Position = matrices[push.matrix] * vec4(box.center + box.extent * position, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450
+
+// Characters skinned by bench_skin.comp earlier in the frame, one instance per character
+// and the mesh's index buffer bound, so gl_VertexIndex is the vertex within the character.
+layout(std430, binding = 2) readonly buffer Skinned {
+	vec4 skinned[];
+};
+
+layout(push_constant) uniform Push {
+	mat4 viewProj;
+	uint vertexCount; // Per character
+	uint characterCount;
+} push;
+
+layout(location = 0) out vec3 fragColor; // For bench_city.frag
+
+void main() {
+	vec4 position = skinned[gl_InstanceIndex * push.vertexCount + gl_VertexIndex];
+	gl_Position = push.viewProj * vec4(position.xyz, 1.0);
+	fragColor = vec3(0.4 + 0.5 * fract(float(gl_InstanceIndex) * 0.618), 0.5, 0.6);
+}
@@ -0,0 +1,39 @@
+#version 450
+
+// The baseline for bench_skinned.vert: every pass skins the vertices itself, like
+// bench_skin.comp does once per frame.
+struct Vertex {
+	vec3 position;
+	uint joints; // Four 8 bit indices
+	vec4 weights;
+};
+
+layout(std430, binding = 0) readonly buffer Vertices {
+	Vertex vertices[];
+};
+
+layout(std430, binding = 1) readonly buffer Palettes {
+	mat4 palettes[];
+};
+
+layout(push_constant) uniform Push {
+	mat4 viewProj;
+	uint vertexCount; // Per character
+	uint characterCount;
+} push;
+
+layout(location = 0) out vec3 fragColor; // For bench_city.frag
+
+const uint JOINT_COUNT = 16;
+
+void main() {
+	Vertex vertex = vertices[gl_VertexIndex];
+	uint base = gl_InstanceIndex * JOINT_COUNT;
+
+	mat4 skin = palettes[base + (vertex.joints & 0xFF)] * vertex.weights.x +
+		palettes[base + ((vertex.joints >> 8) & 0xFF)] * vertex.weights.y +
+		palettes[base + ((vertex.joints >> 16) & 0xFF)] * vertex.weights.z +
+		palettes[base + (vertex.joints >> 24)] * vertex.weights.w;
+	gl_Position = push.viewProj * (skin * vec4(vertex.position, 1.0));
+	fragColor = vec3(0.4 + 0.5 * fract(float(gl_InstanceIndex) * 0.618), 0.5, 0.6);
+}
@@ -0,0 +1,15 @@
+#version 450
+
+// Small triangle per instance, scattered over the target so draws don't all overlap.
+vec2 positions[3] = vec2[](
+	vec2(0.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+void main() {
+	uint hash = uint(gl_InstanceIndex) * 2654435761u;
+	vec2 offset = vec2(float(hash & 0xFFFFu), float(hash >> 16)) / 65535.0 * 2.0 - 1.0;
+
+	gl_Position = vec4(positions[gl_VertexIndex] * 0.02 + offset, 0.0, 1.0);
+}
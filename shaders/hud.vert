@@ -0,0 +1,19 @@
+#version 450
+
+// HUD vertices are in pixels, top left origin, like Vulkan's framebuffer space.
+layout(push_constant) uniform Push {
+	vec2 screenSize;
+} push;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+
+void main() {
+	gl_Position = vec4(inPosition / push.screenSize * 2.0 - 1.0, 0.0, 1.0);
+	fragTexCoord = inTexCoord;
+	fragColor = inColor;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+// Scene color target, only its top left render extent was drawn this frame.
+layout(binding = 0) uniform sampler2D scene;
+
+layout(push_constant) uniform Push {
+	vec2 uvScale; // Render extent / target size
+	vec2 uvMax; // Last rendered texel center, keeps bilinear taps off stale pixels
+} push;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = texture(scene, min(fragTexCoord * push.uvScale, push.uvMax));
+}
@@ -0,0 +1,155 @@
+/*
+* Shadow map atlas with cached static shadows, and cascades for a directional light.
+* - Spot lights get a fixed size tile each in one depth atlas.
+* - Static casters are rendered into a second, persistent atlas, and only when the light or
+*   the static geometry changed since (StaticCache). Each frame the static tiles are copied
+*   into the frame's atlas and the dynamic casters drawn on top.
+* - Cascades split the camera frustum with the practical split scheme. Each is a bounding
+*   sphere of its slice snapped to whole texels, so the shadow edges don't crawl as the
+*   camera moves. With VK_KHR_multiview all cascades render in one pass, one view per layer.
+*/
+
+#pragma once
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+namespace shadows {
+
+const uint32_t ATLAS_SIZE = 2048;
+const uint32_t TILE_SIZE = 512;
+const uint32_t TILES_PER_ROW = ATLAS_SIZE / TILE_SIZE;
+const uint32_t MAX_LIGHTS = TILES_PER_ROW * TILES_PER_ROW;
+
+struct Tile {
+	uint32_t x;
+	uint32_t y;
+};
+
+inline Tile tile(uint32_t slot) {
+	return Tile{(slot % TILES_PER_ROW) * TILE_SIZE, (slot / TILES_PER_ROW) * TILE_SIZE};
+}
+
+
+struct SpotLight {
+	scene::Vec3 position;
+	scene::Vec3 target;
+	float fovY;
+	float range;
+};
+
+inline scene::Mat4 viewProj(const SpotLight& light) {
+	scene::Vec3 direction = scene::normalize(light.target - light.position);
+	scene::Vec3 up = std::fabs(direction.y) > 0.99f ? scene::Vec3{0.0f, 0.0f, 1.0f} : scene::Vec3{0.0f, 1.0f, 0.0f};
+	return scene::perspective(light.fovY, 1.0f, 0.5f, light.range) * scene::lookAt(light.position, light.target, up);
+}
+
+
+// Which atlas tiles hold up to date static shadows.
+class StaticCache {
+public:
+	// Static casters moved, every tile is stale
+	void invalidateAll() {
+		staticVersion++;
+	}
+
+	// True when the slot's static shadows must be rendered now, then remembers them as done.
+	bool acquire(uint32_t slot, const SpotLight& light) {
+		if (slot >= entries.size()) entries.resize(slot + 1);
+
+		Entry& entry = entries[slot];
+		if (entry.valid && entry.version == staticVersion && same(entry.light, light)) return false;
+
+		entry = Entry{light, staticVersion, true};
+		refreshes++;
+		return true;
+	}
+
+	uint64_t refreshCount() const { return refreshes; }
+
+private:
+	struct Entry {
+		SpotLight light;
+		uint64_t version;
+		bool valid;
+	};
+
+	static bool same(const SpotLight& a, const SpotLight& b) {
+		return a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+			a.target.x == b.target.x && a.target.y == b.target.y && a.target.z == b.target.z &&
+			a.fovY == b.fovY && a.range == b.range;
+	}
+
+	std::vector<Entry> entries;
+	uint64_t staticVersion = 0;
+	uint64_t refreshes = 0;
+};
+
+
+const uint32_t CASCADE_COUNT = 4;
+const uint32_t CASCADE_SIZE = 1024;
+
+// Blend of logarithmic (lambda 1) and uniform (lambda 0) splits. splits[0] is near,
+// splits[CASCADE_COUNT] is far.
+inline void cascadeSplits(float nearPlane, float farPlane, float lambda, float splits[CASCADE_COUNT + 1]) {
+	for (uint32_t i = 0; i <= CASCADE_COUNT; i++) {
+		float t = static_cast<float>(i) / CASCADE_COUNT;
+		float logarithmic = nearPlane * std::pow(farPlane / nearPlane, t);
+		float uniform = nearPlane + (farPlane - nearPlane) * t;
+		splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+}
+
+// Orthographic light view of the camera frustum between two distances. casterReach pulls
+// the near plane back so casters outside the slice still shadow it.
+inline scene::Mat4 cascadeViewProj(const scene::Camera& camera, float fovY, float aspect, float nearSplit,
+	float farSplit, scene::Vec3 lightDirection, float casterReach) {
+	const float* v = camera.view.m;
+	// Camera basis from the rows of its view matrix
+	scene::Vec3 right{v[0], v[4], v[8]};
+	scene::Vec3 up{v[1], v[5], v[9]};
+	scene::Vec3 forward{-v[2], -v[6], -v[10]};
+
+	float tanY = std::tan(fovY / 2.0f);
+	float tanX = tanY * aspect;
+
+	scene::Vec3 corners[8];
+	for (uint32_t i = 0; i < 8; i++) {
+		float distance = (i & 4) ? farSplit : nearSplit;
+		float x = ((i & 1) ? 1.0f : -1.0f) * tanX * distance;
+		float y = ((i & 2) ? 1.0f : -1.0f) * tanY * distance;
+		corners[i] = camera.eye + forward * distance + right * x + up * y;
+	}
+
+	scene::Vec3 center{};
+	for (const scene::Vec3& corner : corners) center = center + corner * (1.0f / 8.0f);
+
+	// Rounded up, so the sphere and with it the texel size don't flicker between frames
+	float radius = 0.0f;
+	for (const scene::Vec3& corner : corners) {
+		scene::Vec3 d = corner - center;
+		radius = std::max(radius, std::sqrt(scene::dot(d, d)));
+	}
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	scene::Vec3 direction = scene::normalize(lightDirection);
+	scene::Vec3 lightUp = std::fabs(direction.y) > 0.99f ? scene::Vec3{0.0f, 0.0f, 1.0f} : scene::Vec3{0.0f, 1.0f, 0.0f};
+	scene::Mat4 view = scene::lookAt(center - direction * (radius + casterReach), center, lightUp);
+	scene::Mat4 projection = scene::orthographic(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterReach);
+	scene::Mat4 shadow = projection * view;
+
+	// Snap the world origin to a texel, which moves the whole cascade in texel steps
+	float half = CASCADE_SIZE / 2.0f;
+	float originX = shadow.m[12] * half;
+	float originY = shadow.m[13] * half;
+	shadow.m[12] += (std::round(originX) - originX) / half;
+	shadow.m[13] += (std::round(originY) - originY) / half;
+	return shadow;
+}
+
+} // namespace shadows
@@ -0,0 +1,217 @@
+/*
+* Skeletal animation for crowds of characters, skinned on the GPU.
+* - One humanoid skeleton of JOINT_COUNT joints, parents before children, with a bind pose of
+*   plain offsets. Every character walks in place with its own phase and pace.
+* - animate() poses every character on the CPU, split across the job system: local joint
+*   rotations, parent to child, then the palette the shaders read, world * joint * inverse
+*   bind per joint. With SSE2 the matrix products take a column per register.
+* - characterMesh() is an indexed tube per bone, each ring weighted between the bone's two
+*   joints, so a vertex is skinned once no matter how many triangles share it.
+* - bench_skin.comp skins every character's vertices once per frame into one buffer that the
+*   shadow and main passes both draw from.
+*/
+
+#pragma once
+
+#include "jobs.h"
+#include "scene.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+namespace skin {
+
+const uint32_t JOINT_COUNT = 16;
+
+struct Skeleton {
+	int32_t parents[JOINT_COUNT]; // -1 for the root
+	scene::Vec3 offsets[JOINT_COUNT]; // From the parent, in the bind pose
+	float radii[JOINT_COUNT]; // Of the bone from the parent to this joint
+	scene::Vec3 bindPositions[JOINT_COUNT];
+};
+
+// Hips, spine, chest, head, then the arms and legs
+inline Skeleton humanoid() {
+	Skeleton skeleton{
+		{-1, 0, 1, 2, 2, 4, 5, 2, 7, 8, 0, 10, 11, 0, 13, 14},
+		{
+			{0.0f, 1.0f, 0.0f}, {0.0f, 0.2f, 0.0f}, {0.0f, 0.25f, 0.0f}, {0.0f, 0.3f, 0.0f},
+			{0.2f, 0.05f, 0.0f}, {0.3f, 0.0f, 0.0f}, {0.25f, 0.0f, 0.0f},
+			{-0.2f, 0.05f, 0.0f}, {-0.3f, 0.0f, 0.0f}, {-0.25f, 0.0f, 0.0f},
+			{0.1f, -0.05f, 0.0f}, {0.0f, -0.45f, 0.0f}, {0.0f, -0.45f, 0.0f},
+			{-0.1f, -0.05f, 0.0f}, {0.0f, -0.45f, 0.0f}, {0.0f, -0.45f, 0.0f}
+		},
+		{0.0f, 0.15f, 0.15f, 0.1f, 0.06f, 0.05f, 0.04f, 0.06f, 0.05f, 0.04f, 0.08f, 0.07f, 0.06f, 0.08f, 0.07f, 0.06f},
+		{}
+	};
+	for (uint32_t j = 0; j < JOINT_COUNT; j++) {
+		int32_t parent = skeleton.parents[j];
+		skeleton.bindPositions[j] = parent < 0 ? skeleton.offsets[j] : skeleton.bindPositions[parent] + skeleton.offsets[j];
+	}
+	return skeleton;
+}
+
+
+// Laid out like the std430 struct bench_skin.comp reads
+struct Vertex {
+	float position[3];
+	uint32_t joints; // Four 8 bit joint indices, lowest first
+	float weights[4];
+};
+
+struct Mesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// A tube of `sides` around every bone. Ring t of `rings` goes from the parent joint (0) to the
+// child (1) and leans on the child by up to half, so elbows and knees bend smoothly.
+inline Mesh characterMesh(const Skeleton& skeleton, uint32_t sides = 8, uint32_t rings = 4) {
+	const float pi = 3.14159265f;
+
+	Mesh mesh;
+	for (uint32_t j = 1; j < JOINT_COUNT; j++) {
+		uint32_t parent = static_cast<uint32_t>(skeleton.parents[j]);
+		scene::Vec3 start = skeleton.bindPositions[parent];
+		scene::Vec3 axis = skeleton.offsets[j];
+
+		// Two directions across the bone
+		scene::Vec3 direction = scene::normalize(axis);
+		scene::Vec3 helper = std::fabs(direction.y) < 0.9f ? scene::Vec3{0.0f, 1.0f, 0.0f} : scene::Vec3{1.0f, 0.0f, 0.0f};
+		scene::Vec3 across = scene::normalize(scene::cross(direction, helper));
+		scene::Vec3 across2 = scene::cross(direction, across);
+
+		uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+		for (uint32_t ring = 0; ring < rings; ring++) {
+			float t = static_cast<float>(ring) / (rings - 1);
+			float childWeight = 0.5f * t;
+			for (uint32_t side = 0; side < sides; side++) {
+				float angle = 2.0f * pi * side / sides;
+				scene::Vec3 p = start + axis * t + (across * std::cos(angle) + across2 * std::sin(angle)) * skeleton.radii[j];
+				mesh.vertices.push_back(Vertex{{p.x, p.y, p.z}, parent | (j << 8), {1.0f - childWeight, childWeight, 0.0f, 0.0f}});
+			}
+		}
+
+		for (uint32_t ring = 0; ring + 1 < rings; ring++) {
+			for (uint32_t side = 0; side < sides; side++) {
+				uint32_t a = first + ring * sides + side;
+				uint32_t b = first + ring * sides + (side + 1) % sides;
+				uint32_t c = a + sides;
+				uint32_t d = b + sides;
+				mesh.indices.insert(mesh.indices.end(), {a, b, d, a, d, c});
+			}
+		}
+	}
+	return mesh;
+}
+
+
+struct Character {
+	scene::Vec3 position;
+	float heading; // Radians around y
+	float phase;
+	float pace; // Steps per second
+};
+
+// On a square grid 2 apart, facing anywhere
+inline std::vector<Character> crowd(uint32_t count, uint32_t seed = 5) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> pace(0.8f, 1.6f);
+
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+	std::vector<Character> characters;
+	characters.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		scene::Vec3 position{(i % side) * 2.0f, 0.0f, (i / side) * 2.0f};
+		characters.push_back(Character{position, angle(rng), angle(rng), pace(rng)});
+	}
+	return characters;
+}
+
+
+inline void multiply(const scene::Mat4& a, const scene::Mat4& b, scene::Mat4& out) {
+#if defined(__SSE2__)
+	__m128 c0 = _mm_loadu_ps(a.m);
+	__m128 c1 = _mm_loadu_ps(a.m + 4);
+	__m128 c2 = _mm_loadu_ps(a.m + 8);
+	__m128 c3 = _mm_loadu_ps(a.m + 12);
+	for (int column = 0; column < 4; column++) {
+		const float* bc = b.m + column * 4;
+		__m128 r = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(bc[0])), _mm_mul_ps(c1, _mm_set1_ps(bc[1]))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(bc[2])), _mm_mul_ps(c3, _mm_set1_ps(bc[3]))));
+		_mm_storeu_ps(out.m + column * 4, r);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+// Rotation by `angle` around `axis` (0 x, 1 y, 2 z), then a move by `offset`
+inline scene::Mat4 transform(int axis, float angle, scene::Vec3 offset) {
+	float c = std::cos(angle), s = std::sin(angle);
+	int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+	scene::Mat4 r;
+	r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+	r.m[u * 4 + u] = c;
+	r.m[u * 4 + v] = s;
+	r.m[v * 4 + u] = -s;
+	r.m[v * 4 + v] = c;
+	r.m[12] = offset.x;
+	r.m[13] = offset.y;
+	r.m[14] = offset.z;
+	return r;
+}
+
+// A walk cycle: legs and arms swing around x in opposition, knees and elbows only bend one
+// way, the hips bob and the spine twists a little.
+inline void pose(const Skeleton& skeleton, const Character& character, float time, scene::Mat4* palette) {
+	float cycle = 6.2831853f * character.pace * time + character.phase;
+	float swing = std::sin(cycle);
+	float bend = 0.5f - 0.5f * std::cos(cycle);
+	float otherBend = 0.5f + 0.5f * std::cos(cycle);
+
+	float angles[JOINT_COUNT] = {
+		0.0f, 0.1f * swing, 0.0f, 0.0f,
+		-0.4f * swing, -0.5f * otherBend, 0.0f,
+		0.4f * swing, -0.5f * bend, 0.0f,
+		0.5f * swing, 0.8f * bend, 0.0f,
+		-0.5f * swing, 0.8f * otherBend, 0.0f
+	};
+
+	scene::Mat4 world = transform(1, character.heading, character.position);
+	scene::Mat4 globals[JOINT_COUNT];
+	for (uint32_t j = 0; j < JOINT_COUNT; j++) {
+		int32_t parent = skeleton.parents[j];
+		scene::Vec3 offset = skeleton.offsets[j];
+		if (parent < 0) offset.y += 0.05f * std::fabs(swing);
+
+		scene::Mat4 local = transform(j == 1 ? 1 : 0, angles[j], offset);
+		multiply(parent < 0 ? world : globals[parent], local, globals[j]);
+
+		// The bind pose is offsets only, so its inverse is a move back
+		scene::Vec3 back = skeleton.bindPositions[j] * -1.0f;
+		multiply(globals[j], transform(0, 0.0f, back), palette[j]);
+	}
+}
+
+// Palettes of every character, JOINT_COUNT matrices each, into palettes
+inline void animate(jobs::JobSystem& jobSystem, const Skeleton& skeleton, const std::vector<Character>& characters,
+	float time, scene::Mat4* palettes) {
+	jobSystem.parallelFor(static_cast<uint32_t>(characters.size()), 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			pose(skeleton, characters[i], time, palettes + i * JOINT_COUNT);
+		}
+	});
+}
+
+} // namespace skin
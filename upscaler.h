@@ -0,0 +1,79 @@
+/*
+* Spatial upscaling presets for the scene, see dynamic_resolution.h.
+* - performance: the bilinear fragment pass (upscale.frag), drawn straight into the swap chain.
+* - balanced: upscale_edge.comp, a 16 tap filter whose kernel stretches along the local edge
+*   and shrinks across it, clamped to the nearest texels against ringing.
+* - quality: balanced, then sharpen.comp, contrast adaptive sharpening that backs off where
+*   the neighbourhood already has contrast.
+* - The compute presets write an export image. The swap chain is sRGB, which drivers rarely
+*   allow as a storage image, so a blit converts it into the swap chain image.
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+
+namespace upscale {
+
+enum class Preset {
+	Performance,
+	Balanced,
+	Quality
+};
+
+struct Settings {
+	bool compute; // Otherwise the bilinear fragment pass
+	bool sharpen;
+	float sharpness; // 0 to 1
+};
+
+inline Settings settings(Preset preset) {
+	switch (preset) {
+	case Preset::Balanced: return Settings{true, false, 0.0f};
+	case Preset::Quality: return Settings{true, true, 0.5f};
+	default: return Settings{false, false, 0.0f};
+	}
+}
+
+inline Preset parsePreset(const std::string& name) {
+	if (name == "performance") return Preset::Performance;
+	if (name == "balanced") return Preset::Balanced;
+	if (name == "quality") return Preset::Quality;
+	throw std::runtime_error("unknown upscale preset " + name + "!");
+}
+
+inline const char* presetName(Preset preset) {
+	switch (preset) {
+	case Preset::Balanced: return "balanced";
+	case Preset::Quality: return "quality";
+	default: return "performance";
+	}
+}
+
+// Linear, 16 bit so dark gradients survive until the sRGB encode in the blit
+const VkFormat IMAGE_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+// Matches the 8x8 workgroups of both shaders
+const uint32_t TILE_SIZE = 8;
+
+inline uint32_t groupCount(uint32_t pixels) {
+	return (pixels + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+struct EdgePush {
+	int32_t sourceSize[2]; // Rendered region, the top left of the source image
+	int32_t destinationSize[2];
+};
+
+struct SharpenPush {
+	int32_t size[2];
+	float sharpness;
+	float pad;
+};
+
+} // namespace upscale
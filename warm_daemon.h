@@ -0,0 +1,182 @@
+/*
+* Warm start rendering: a long lived daemon keeps the instance, device and pipeline cache
+* initialized, and short lived clients send it jobs over a Unix domain socket.
+* - The client creates the frame memory (memfd) and passes the descriptor along with the
+*   job (SCM_RIGHTS). The daemon maps it and reads the rendered frame back into it, so
+*   pixels never go through the socket. The memory is sealed against resizing before it's
+*   sent, so a client can't shrink it under the daemon's mapping, and the daemon rejects
+*   memory without the seals.
+* - Accepted sockets time out after CLIENT_TIMEOUT_MS, a silent client can't stall the daemon.
+* - One job per connection: Job with the descriptor in, Reply out.
+* - A job with no frames tells the daemon to shut down.
+*/
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace warm {
+
+const int CLIENT_TIMEOUT_MS = 5000;
+
+// The frame memory's size can't change once the client sends it
+const int FRAME_SEALS = F_SEAL_SHRINK | F_SEAL_GROW;
+
+struct Job {
+	uint32_t width;
+	uint32_t height;
+	uint32_t drawsPerFrame;
+	uint32_t frames; // 0 shuts the daemon down
+};
+
+struct Reply {
+	int32_t status; // 0 when the frame is in the client's memory
+	float renderMs; // Inside the daemon, without the socket round trip
+};
+
+// RGBA8, what the daemon renders
+inline size_t frameBytes(const Job& job) {
+	return static_cast<size_t>(job.width) * job.height * 4;
+}
+
+
+inline sockaddr_un socketAddress(const std::string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("daemon socket path too long!");
+	}
+	strcpy(address.sun_path, path.c_str());
+	return address;
+}
+
+// Replaces a stale socket file at path
+inline int listenOn(const std::string& path) {
+	sockaddr_un address = socketAddress(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::runtime_error("failed to create daemon socket!");
+	}
+
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 8) < 0) {
+		close(fd);
+		throw std::runtime_error("failed to bind daemon socket " + path + "!");
+	}
+	return fd;
+}
+
+// Receives on fd fail instead of blocking past timeoutMs
+inline void setReceiveTimeout(int fd, int timeoutMs) {
+	timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+inline int connectTo(const std::string& path) {
+	sockaddr_un address = socketAddress(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::runtime_error("failed to create daemon socket!");
+	}
+
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+		close(fd);
+		throw std::runtime_error("failed to connect to daemon " + path + "!");
+	}
+	return fd;
+}
+
+
+// Sends the job and the frame memory's descriptor in one message. A frameFd of -1 sends
+// the job alone, enough for a shutdown.
+inline bool sendJob(int socketFd, const Job& job, int frameFd) {
+	iovec data{const_cast<Job*>(&job), sizeof(job)};
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+	msghdr message{};
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+
+	if (frameFd >= 0) {
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+
+		cmsghdr* header = CMSG_FIRSTHDR(&message);
+		header->cmsg_level = SOL_SOCKET;
+		header->cmsg_type = SCM_RIGHTS;
+		header->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(header), &frameFd, sizeof(int));
+	}
+
+	return sendmsg(socketFd, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(job));
+}
+
+// frameFd is -1 if the client didn't send one. The caller closes it.
+inline bool receiveJob(int socketFd, Job& job, int& frameFd) {
+	iovec data{&job, sizeof(job)};
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+	msghdr message{};
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	frameFd = -1;
+	if (recvmsg(socketFd, &message, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(job))) return false;
+
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	if (header != nullptr && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+		memcpy(&frameFd, CMSG_DATA(header), sizeof(int));
+	}
+	return true;
+}
+
+inline bool sendReply(int socketFd, const Reply& reply) {
+	return send(socketFd, &reply, sizeof(reply), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(reply));
+}
+
+inline bool receiveReply(int socketFd, Reply& reply) {
+	return recv(socketFd, &reply, sizeof(reply), MSG_WAITALL) == static_cast<ssize_t>(sizeof(reply));
+}
+
+
+// Anonymous shared memory for one frame, passed to the daemon by descriptor. Sealed at
+// its size, see FRAME_SEALS.
+inline int createFrameMemory(size_t bytes) {
+	int fd = memfd_create("frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0 || ftruncate(fd, static_cast<off_t>(bytes)) < 0 || fcntl(fd, F_ADD_SEALS, FRAME_SEALS) < 0) {
+		if (fd >= 0) close(fd);
+		throw std::runtime_error("failed to create frame memory!");
+	}
+	return fd;
+}
+
+// nullptr when the memory isn't sealed or is smaller than bytes, so a client can't make the
+// daemon write past it, before or after the check
+inline void* mapFrameMemory(int fd, size_t bytes) {
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & FRAME_SEALS) != FRAME_SEALS) return nullptr;
+
+	struct stat info;
+	if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < bytes) return nullptr;
+
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return memory == MAP_FAILED ? nullptr : memory;
+}
+
+} // namespace warm